@@ -0,0 +1,88 @@
+#ifndef PS2RECOMP_ANALYSIS_PASS_MANAGER_H
+#define PS2RECOMP_ANALYSIS_PASS_MANAGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ps2recomp
+{
+    // Analysis results a pass can consume or produce
+    enum AnalysisResource : uint32_t
+    {
+        ANALYSIS_NONE = 0,
+        ANALYSIS_DECODED_CODE = 1 << 0,   // Decoded instructions of every function
+        ANALYSIS_FUNCTION_LISTS = 1 << 1, // Library (stub) and skip function lists
+        ANALYSIS_DATA_USAGE = 1 << 2,     // Per-function data symbol usage
+        ANALYSIS_PATCHES = 1 << 3,        // Instruction patches and their reasons
+        ANALYSIS_CFGS = 1 << 4,           // Per-function control flow graphs
+        ANALYSIS_CALL_GRAPH = 1 << 5,     // Direct calls between functions
+        ANALYSIS_JUMP_TABLES = 1 << 6,    // Recovered jump tables
+        ANALYSIS_VU_MICROCODE = 1 << 7,   // VU microprograms uploaded by VIF MPG commands
+    };
+
+    struct AnalysisPass
+    {
+        std::string name;
+        uint32_t inputs;  // AnalysisResource mask that must be available before the pass runs
+        uint32_t outputs; // AnalysisResource mask the pass produces or updates
+        std::function<void()> run;
+    };
+
+    // Runs analysis passes in registration order, after checking that every
+    // pass's inputs are available up front or produced by an earlier pass, and
+    // provides a worker pool the passes use for their per-function work. Results
+    // are always merged back by the calling thread in function order, so output
+    // stays deterministic regardless of the thread count.
+    class AnalysisPassManager
+    {
+    public:
+        explicit AnalysisPassManager(size_t threadCount = 0);
+        ~AnalysisPassManager();
+
+        AnalysisPassManager(const AnalysisPassManager &) = delete;
+        AnalysisPassManager &operator=(const AnalysisPassManager &) = delete;
+
+        void addPass(const std::string &name, uint32_t inputs, uint32_t outputs, std::function<void()> run);
+
+        // Runs every registered pass. Results in cached were restored from an
+        // earlier run; passes that only produce cached results are skipped.
+        bool run(uint32_t cached);
+
+        // Calls fn(index) for every index in [0, count) across the worker pool.
+        void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+        // Same as parallelFor, but each job writes to its own buffer which is
+        // flushed to out in index order after all jobs have finished.
+        void parallelForLogged(size_t count, const std::function<void(size_t, std::ostream &)> &fn, std::ostream &out);
+
+        size_t threadCount() const { return m_workers.size() + 1; }
+
+    private:
+        std::vector<AnalysisPass> m_passes;
+
+        std::vector<std::thread> m_workers;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const std::function<void(size_t)> *m_job = nullptr;
+        size_t m_jobCount = 0;
+        std::atomic<size_t> m_nextIndex{0};
+        size_t m_busyWorkers = 0;
+        uint64_t m_generation = 0;
+        bool m_stopping = false;
+        std::exception_ptr m_error;
+
+        void workerLoop();
+        void drainJob(const std::function<void(size_t)> &fn, size_t count);
+    };
+}
+
+#endif // PS2RECOMP_ANALYSIS_PASS_MANAGER_H
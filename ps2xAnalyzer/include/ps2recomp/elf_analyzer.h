@@ -22,8 +22,7 @@ namespace ps2recomp
 	struct Function;
 	class R5900Decoder;
 	class ElfParser;
-
-	using CFG = std::unordered_map<uint32_t, CFGNode>;
+	class AnalysisPassManager;
 
 	class ElfAnalyzer
     {
@@ -34,10 +33,16 @@ namespace ps2recomp
         bool analyze();
         bool generateToml(const std::string &outputPath);
 
+        // Splits a function's decoded instructions into basic blocks. A branch ends its
+        // block, its delay slot starts the next one, and the fall-through edge skips the
+        // delay slot. This is the CFG the jump table slicer walks.
+        static CFG buildCFG(const Function &function, const std::vector<Instruction> &instructions);
+
     private:
         std::string m_elfPath;
         std::unique_ptr<ElfParser> m_elfParser;
         std::unique_ptr<R5900Decoder> m_decoder;
+        std::unique_ptr<AnalysisPassManager> m_passManager;
 
         std::vector<Function> m_functions;
         std::vector<Symbol> m_symbols;
@@ -53,15 +58,26 @@ namespace ps2recomp
         std::map<uint32_t, std::string> m_patchReasons;
         std::unordered_map<uint32_t, CFG> m_functionCFGs;
         std::vector<JumpTable> m_jumpTables;
+        std::vector<VuMicroprogram> m_vuMicroprograms;
         std::unordered_map<uint32_t, std::vector<FunctionCall>> m_functionCalls;
+
+        // Decoded instructions keyed by function start, built once by decodeAllFunctions()
+        // and only read afterwards, so every pass can share it without copying.
+        std::unordered_map<uint32_t, std::vector<Instruction>> m_decodedFunctions;
  
         void initializeLibraryFunctions();
+        void decodeAllFunctions();
+        void categorizeFunctions();
+        uint32_t loadAnalysisDatabase();
+        void saveAnalysisDatabase() const;
         void analyzeEntryPoint();
         void analyzeLibraryFunctions();
         void analyzeDataUsage();
         void identifyPotentialPatches();
         void analyzeControlFlow();
         void detectJumpTables();
+        void findVuMicroprograms();
+        uint32_t findGpValue() const;
         void analyzePerformanceCriticalPaths() const;
         void identifyRecursiveFunctions();
         void analyzeRegisterUsage() const;
@@ -76,7 +92,7 @@ namespace ps2recomp
         bool isSystemFunction(const std::string &name) const;
         bool isLibraryFunction(const std::string &name) const;
         std::vector<Instruction> decodeFunction(const Function &function) const;
-        CFG buildCFG(const Function &function) const;
+        const std::vector<Instruction> &getDecodedFunction(const Function &function) const;
         std::string formatAddress(uint32_t address) const;
         std::string escapeBackslashes(const std::string &path);
         bool hasMMIInstructions(const Function &function) const;
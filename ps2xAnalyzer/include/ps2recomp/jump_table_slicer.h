@@ -0,0 +1,79 @@
+#ifndef PS2RECOMP_JUMP_TABLE_SLICER_H
+#define PS2RECOMP_JUMP_TABLE_SLICER_H
+
+#include "ps2recomp/types.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ps2recomp
+{
+    class ElfParser;
+
+    // Outcome of slicing one indirect jump
+    enum class JumpTableSliceResult
+    {
+        Resolved,
+        NotTableLoad, // Jump register is not loaded from a scaled table slot
+        UnknownBase,  // Load address is not a constant base plus a scaled index
+        NoBound,      // No bounds check on the index was found
+        NoEntries,    // Table slots do not all point into code
+    };
+
+    struct JumpTableCoverage
+    {
+        uint32_t indirectJumps = 0;
+        uint32_t resolved = 0;
+        uint32_t notTableLoad = 0;
+        uint32_t unknownBase = 0;
+        uint32_t noBound = 0;
+        uint32_t noEntries = 0;
+
+        void record(JumpTableSliceResult result);
+        JumpTableCoverage &operator+=(const JumpTableCoverage &other);
+    };
+
+    // Recovers jump tables by slicing backwards from a `jr` over the CFG.
+    // Register values are tracked as `base + scale * index`, which covers
+    // lui/addiu/ori and $gp-relative bases, sll scaling and addu. The index
+    // bound comes from the sltiu/sltu guarding the index on the paths that
+    // reach the jump, even when it sits in another block. Every walk has a
+    // fixed instruction budget, so the cost per jump stays small.
+    class JumpTableSlicer
+    {
+    public:
+        JumpTableSlicer(const ElfParser &parser, const std::vector<Section> &sections, uint32_t gpValue);
+
+        JumpTableSliceResult resolve(const Function &function, const std::vector<Instruction> &instructions,
+                                     const CFG *cfg, size_t jumpIndex, JumpTable &table) const;
+
+    private:
+        struct SliceValue
+        {
+            uint32_t base = 0;
+            uint32_t scale = 0;    // 0 for a constant
+            uint32_t indexReg = 0;
+            size_t indexDef = 0;   // Instruction that defined the index register
+        };
+
+        struct SliceContext
+        {
+            const Function &function;
+            const std::vector<Instruction> &instructions;
+            const CFG *cfg;
+        };
+
+        const ElfParser &m_parser;
+        const std::vector<Section> &m_sections;
+        uint32_t m_gpValue;
+
+        size_t definitionOf(const SliceContext &ctx, uint32_t reg, size_t position) const;
+        SliceValue valueBefore(const SliceContext &ctx, uint32_t reg, size_t position, int depth) const;
+        SliceValue valueOfDefinition(const SliceContext &ctx, uint32_t reg, size_t def, int depth) const;
+        uint32_t findIndexBound(const SliceContext &ctx, const SliceValue &index, size_t position) const;
+        void predecessors(const SliceContext &ctx, size_t position, std::vector<std::vector<size_t>> &paths) const;
+        bool isCodeAddress(uint32_t address) const;
+    };
+}
+
+#endif // PS2RECOMP_JUMP_TABLE_SLICER_H
@@ -0,0 +1,196 @@
+#include "ps2recomp/analysis_pass_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+namespace ps2recomp
+{
+    AnalysisPassManager::AnalysisPassManager(size_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // The calling thread takes part in every job, so it counts as one worker
+        m_workers.reserve(threadCount - 1);
+        for (size_t i = 1; i < threadCount; i++)
+        {
+            m_workers.emplace_back(&AnalysisPassManager::workerLoop, this);
+        }
+    }
+
+    AnalysisPassManager::~AnalysisPassManager()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+
+        for (auto &worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    void AnalysisPassManager::addPass(const std::string &name, uint32_t inputs, uint32_t outputs, std::function<void()> run)
+    {
+        m_passes.push_back({name, inputs, outputs, std::move(run)});
+    }
+
+    bool AnalysisPassManager::run(uint32_t cached)
+    {
+        uint32_t available = cached;
+        for (const auto &pass : m_passes)
+        {
+            uint32_t missing = pass.inputs & ~available;
+            if (missing != 0)
+            {
+                std::cerr << "Analysis pass '" << pass.name << "' depends on results no earlier pass produces (mask 0x"
+                          << std::hex << missing << std::dec << ")" << std::endl;
+                return false;
+            }
+            available |= pass.outputs;
+        }
+
+        for (const auto &pass : m_passes)
+        {
+            if (pass.outputs != ANALYSIS_NONE && (pass.outputs & ~cached) == 0)
+            {
+                std::cout << "Pass '" << pass.name << "' skipped, results loaded from analysis database" << std::endl;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            pass.run();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+            std::cout << "Pass '" << pass.name << "' finished in " << elapsed.count() << " ms" << std::endl;
+        }
+
+        return true;
+    }
+
+    void AnalysisPassManager::parallelFor(size_t count, const std::function<void(size_t)> &fn)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        if (m_workers.empty() || count == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                fn(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &fn;
+            m_jobCount = count;
+            m_nextIndex = 0;
+            m_busyWorkers = m_workers.size();
+            m_error = nullptr;
+            m_generation++;
+        }
+        m_wake.notify_all();
+
+        std::exception_ptr callerError;
+        try
+        {
+            drainJob(fn, count);
+        }
+        catch (...)
+        {
+            callerError = std::current_exception();
+            m_nextIndex = count;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]()
+                    { return m_busyWorkers == 0; });
+        m_job = nullptr;
+
+        if (callerError)
+        {
+            std::rethrow_exception(callerError);
+        }
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    void AnalysisPassManager::parallelForLogged(size_t count, const std::function<void(size_t, std::ostream &)> &fn, std::ostream &out)
+    {
+        std::vector<std::ostringstream> logs(count);
+
+        parallelFor(count, [&](size_t index)
+                    { fn(index, logs[index]); });
+
+        for (auto &log : logs)
+        {
+            out << log.str();
+        }
+        out.flush();
+    }
+
+    void AnalysisPassManager::workerLoop()
+    {
+        uint64_t seenGeneration = 0;
+
+        while (true)
+        {
+            const std::function<void(size_t)> *job = nullptr;
+            size_t count = 0;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&]()
+                            { return m_stopping || m_generation != seenGeneration; });
+
+                if (m_stopping)
+                {
+                    return;
+                }
+
+                seenGeneration = m_generation;
+                job = m_job;
+                count = m_jobCount;
+            }
+
+            try
+            {
+                drainJob(*job, count);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+                m_nextIndex = count;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_busyWorkers == 0)
+            {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    void AnalysisPassManager::drainJob(const std::function<void(size_t)> &fn, size_t count)
+    {
+        for (size_t i = m_nextIndex++; i < count; i = m_nextIndex++)
+        {
+            fn(i);
+        }
+    }
+}
@@ -1,7 +1,11 @@
 #include "ps2recomp/elf_analyzer.h"
+#include "ps2recomp/analysis_pass_manager.h"
+#include "ps2recomp/analysis_database.h"
 #include "ps2recomp/elf_parser.h"
+#include "ps2recomp/jump_table_slicer.h"
 #include "ps2recomp/r5900_decoder.h"
 #include "ps2recomp/types.h"
+#include "ps2recomp/vu_recompiler.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -24,6 +28,7 @@ namespace ps2recomp
     {
         m_elfParser = std::make_unique<ElfParser>(elfPath);
         m_decoder = std::make_unique<R5900Decoder>();
+        m_passManager = std::make_unique<AnalysisPassManager>();
 
         initializeLibraryFunctions();
     }
@@ -50,26 +55,44 @@ namespace ps2recomp
         std::cout << "Extracted " << m_sections.size() << " sections" << std::endl;
         std::cout << "Extracted " << m_relocations.size() << " relocations" << std::endl;
 
-        analyzeEntryPoint();
-        analyzeLibraryFunctions();
-        analyzeDataUsage();
-        identifyPotentialPatches();
-        analyzeControlFlow();
-        detectJumpTables();
-        analyzePerformanceCriticalPaths();
-        identifyRecursiveFunctions();
-        analyzeRegisterUsage();
-        analyzeFunctionSignatures();
-        optimizePatches();
+        m_passManager->addPass("decode", ANALYSIS_NONE, ANALYSIS_DECODED_CODE,
+                                [this]() { decodeAllFunctions(); });
+        m_passManager->addPass("entry point", ANALYSIS_DECODED_CODE, ANALYSIS_FUNCTION_LISTS,
+                                [this]() { analyzeEntryPoint(); });
+        m_passManager->addPass("library functions", ANALYSIS_NONE, ANALYSIS_FUNCTION_LISTS,
+                                [this]() { analyzeLibraryFunctions(); });
+        m_passManager->addPass("data usage", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_DATA_USAGE,
+                                [this]() { analyzeDataUsage(); });
+        m_passManager->addPass("potential patches", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_PATCHES,
+                                [this]() { identifyPotentialPatches(); });
+        m_passManager->addPass("control flow", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_CFGS | ANALYSIS_CALL_GRAPH,
+                                [this]() { analyzeControlFlow(); });
+        m_passManager->addPass("jump tables", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS | ANALYSIS_CFGS, ANALYSIS_JUMP_TABLES,
+                                [this]() { detectJumpTables(); });
+        m_passManager->addPass("vu microcode", ANALYSIS_NONE, ANALYSIS_VU_MICROCODE,
+                                [this]() { findVuMicroprograms(); });
+        m_passManager->addPass("performance critical paths", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_NONE,
+                                [this]() { analyzePerformanceCriticalPaths(); });
+        m_passManager->addPass("recursive functions", ANALYSIS_CALL_GRAPH | ANALYSIS_FUNCTION_LISTS, ANALYSIS_NONE,
+                                [this]() { identifyRecursiveFunctions(); });
+        m_passManager->addPass("register usage", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_NONE,
+                                [this]() { analyzeRegisterUsage(); });
+        m_passManager->addPass("function signatures", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_NONE,
+                                [this]() { analyzeFunctionSignatures(); });
+        m_passManager->addPass("optimize patches", ANALYSIS_PATCHES | ANALYSIS_FUNCTION_LISTS, ANALYSIS_PATCHES | ANALYSIS_FUNCTION_LISTS,
+                                [this]() { optimizePatches(); });
+        m_passManager->addPass("categorize functions", ANALYSIS_DECODED_CODE | ANALYSIS_FUNCTION_LISTS, ANALYSIS_FUNCTION_LISTS,
+                                [this]() { categorizeFunctions(); });
+
+        uint32_t cached = loadAnalysisDatabase();
+        if (!m_passManager->run(cached))
+        {
+            return false;
+        }
 
-        for (auto &func : m_functions)
+        if (cached == ANALYSIS_NONE)
         {
-            if (!m_skipFunctions.contains(func.name) &&
-                !m_libFunctions.contains(func.name))
-            {
-                categorizeFunction(func);
-                func.instructions = decodeFunction(func);
-            }
+            saveAnalysisDatabase();
         }
 
         std::cout << "Analysis completed" << std::endl;
@@ -77,10 +100,78 @@ namespace ps2recomp
         std::cout << "- " << m_skipFunctions.size() << " functions to skip" << std::endl;
         std::cout << "- " << m_patches.size() << " potential patches identified" << std::endl;
         std::cout << "- " << m_jumpTables.size() << " jump tables detected" << std::endl;
+        std::cout << "- " << m_vuMicroprograms.size() << " VU microprograms found" << std::endl;
 
         return true;
     }
 
+    uint32_t ElfAnalyzer::loadAnalysisDatabase()
+    {
+        std::string dbPath = AnalysisDatabase::pathForElf(m_elfPath);
+
+        AnalysisDatabase database;
+        if (!database.open(dbPath, m_elfPath))
+        {
+            return ANALYSIS_NONE;
+        }
+
+        m_decodedFunctions.clear();
+        m_functionCFGs.clear();
+        m_functionCalls.clear();
+
+        for (const auto &function : database.functions())
+        {
+            auto instructions = database.instructions(function);
+            m_decodedFunctions.emplace(function.start, std::vector<Instruction>(instructions.begin(), instructions.end()));
+
+            if (database.hasCFG(function))
+            {
+                m_functionCFGs[function.start] = database.loadCFG(function);
+            }
+
+            if (function.callCount != 0)
+            {
+                m_functionCalls[function.start] = database.loadCalls(function);
+            }
+        }
+
+        m_jumpTables = database.loadJumpTables();
+
+        std::cout << "Loaded analysis database: " << dbPath << " (" << m_decodedFunctions.size()
+                  << " functions, " << m_jumpTables.size() << " jump tables)" << std::endl;
+
+        return ANALYSIS_DECODED_CODE | ANALYSIS_CFGS | ANALYSIS_CALL_GRAPH | ANALYSIS_JUMP_TABLES;
+    }
+
+    void ElfAnalyzer::saveAnalysisDatabase() const
+    {
+        std::string dbPath = AnalysisDatabase::pathForElf(m_elfPath);
+        AnalysisSnapshot snapshot{m_functions, m_decodedFunctions, m_functionCFGs, m_jumpTables, m_functionCalls};
+
+        if (AnalysisDatabase::save(dbPath, m_elfPath, snapshot))
+        {
+            std::cout << "Wrote analysis database: " << dbPath << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to write analysis database: " << dbPath << std::endl;
+        }
+    }
+
+    void ElfAnalyzer::categorizeFunctions()
+    {
+        // Categorization extends the skip list as it goes, so it stays sequential
+        for (auto &func : m_functions)
+        {
+            if (!m_skipFunctions.contains(func.name) &&
+                !m_libFunctions.contains(func.name))
+            {
+                categorizeFunction(func);
+                func.instructions = getDecodedFunction(func);
+            }
+        }
+    }
+
     bool ElfAnalyzer::generateToml(const std::string &outputPath)
     {
         std::ofstream file(outputPath);
@@ -139,7 +230,8 @@ namespace ps2recomp
             for (const auto & jt : m_jumpTables)
             {
                 file << "[[jump_tables.table]]\n";
-                file << "address = \"0x" << std::hex << jt.address << "\"\n"
+                file << "address = \"0x" << std::hex << jt.address << "\"\n";
+                file << "jump_address = \"0x" << jt.jumpAddress << "\"\n"
                      << std::dec;
                 file << "entries = [\n";
 
@@ -154,6 +246,26 @@ namespace ps2recomp
             }
         }
 
+        if (!m_vuMicroprograms.empty())
+        {
+            file << "# VU microcode uploaded by VIF MPG commands, recompiled ahead of time\n";
+            file << "[vu_microcode]\n";
+
+            for (const auto &program : m_vuMicroprograms)
+            {
+                file << "[[vu_microcode.program]]\n";
+                file << "address = \"0x" << std::hex << program.address << "\"\n";
+                file << "size = \"0x" << program.size << "\"\n";
+                file << "load_address = \"0x" << program.loadAddress << "\"\n"
+                     << std::dec;
+                if (program.unit >= 0)
+                {
+                    file << "unit = " << program.unit << "\n";
+                }
+                file << "\n";
+            }
+        }
+
         if (!m_patches.empty())
         {
             file << "# Patches to apply during recompilation\n";
@@ -251,7 +363,7 @@ namespace ps2recomp
 
             m_skipFunctions.insert(it->name);
 
-            std::vector<Instruction> instructions = decodeFunction(*it);
+            const std::vector<Instruction> &instructions = getDecodedFunction(*it);
 
             for (const auto &inst : instructions)
             {
@@ -315,17 +427,37 @@ namespace ps2recomp
     {
         std::cout << "Analyzing data usage patterns..." << std::endl;
 
-        std::map<uint32_t, std::set<std::string>> memoryAccessMap;
+        // Try to find GP value in ELF sections
+        uint32_t gpValue = 0;
+        for (const auto &section : m_sections)
+        {
+            if (section.name == ".got" || section.name == ".data" ||
+                section.name == ".sdata" || section.name == ".sbss")
+            {
+                gpValue = section.address;
+                break;
+            }
+        }
 
-        for (const auto &func : m_functions)
+        struct FunctionDataUsage
         {
+            std::vector<uint32_t> gpAccesses;
+            std::set<std::string> dataSymbols;
+        };
+
+        std::vector<FunctionDataUsage> usage(m_functions.size());
+
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
+        {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            auto &result = usage[index];
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
             for (const auto &inst : instructions)
             {
@@ -339,23 +471,11 @@ namespace ps2recomp
                     if (inst.rs == 28) // $gp is typically register 28
                     {
                         int16_t offset = static_cast<int16_t>(inst.immediate);
-                        uint32_t gpValue = 0;
-
-                        // Try to find GP value in ELF sections
-                        for (const auto &section : m_sections)
-                        {
-                            if (section.name == ".got" || section.name == ".data" ||
-                                section.name == ".sdata" || section.name == ".sbss")
-                            {
-                                gpValue = section.address;
-                                break;
-                            }
-                        }
 
                         if (gpValue != 0)
                         {
                             uint32_t targetAddr = gpValue + offset;
-                            memoryAccessMap[targetAddr].insert(func.name);
+                            result.gpAccesses.push_back(targetAddr);
 
                             auto symIt = std::find_if(m_symbols.begin(), m_symbols.end(),
                                                       [targetAddr](const Symbol &s)
@@ -363,11 +483,11 @@ namespace ps2recomp
 
                             if (symIt != m_symbols.end())
                             {
-                                std::cout << "Function " << func.name << " accesses data symbol "
-                                          << symIt->name << " at 0x" << std::hex << targetAddr
-                                          << std::dec << std::endl;
+                                log << "Function " << func.name << " accesses data symbol "
+                                    << symIt->name << " at 0x" << std::hex << targetAddr
+                                    << std::dec << "\n";
 
-                                m_functionDataUsage[func.name].insert(symIt->name);
+                                result.dataSymbols.insert(symIt->name);
                             }
                             else
                             {
@@ -377,11 +497,11 @@ namespace ps2recomp
                                     if (!sym.isFunction && targetAddr >= sym.address &&
                                         targetAddr < sym.address + sym.size)
                                     {
-                                        std::cout << "Function " << func.name << " accesses data within symbol "
-                                                  << sym.name << " at offset 0x" << std::hex << (targetAddr - sym.address)
-                                                  << std::dec << std::endl;
+                                        log << "Function " << func.name << " accesses data within symbol "
+                                            << sym.name << " at offset 0x" << std::hex << (targetAddr - sym.address)
+                                            << std::dec << "\n";
 
-                                        m_functionDataUsage[func.name].insert(sym.name);
+                                        result.dataSymbols.insert(sym.name);
                                         break;
                                     }
                                 }
@@ -421,12 +541,12 @@ namespace ps2recomp
 
                                     if (symIt != m_symbols.end())
                                     {
-                                        std::cout << "Function " << func.name << " directly accesses "
-                                                  << (inst.opcode == OPCODE_LW ? "reads from" : "writes to")
-                                                  << " data symbol " << symIt->name
-                                                  << " at 0x" << std::hex << targetAddr << std::dec << std::endl;
+                                        log << "Function " << func.name << " directly accesses "
+                                            << (inst.opcode == OPCODE_LW ? "reads from" : "writes to")
+                                            << " data symbol " << symIt->name
+                                            << " at 0x" << std::hex << targetAddr << std::dec << "\n";
 
-                                        m_functionDataUsage[func.name].insert(symIt->name);
+                                        result.dataSymbols.insert(symIt->name);
                                     }
                                     break;
                                 }
@@ -435,6 +555,23 @@ namespace ps2recomp
                     }
                 }
             }
+        }, std::cout);
+
+        std::map<uint32_t, std::set<std::string>> memoryAccessMap;
+
+        for (size_t i = 0; i < m_functions.size(); i++)
+        {
+            const auto &func = m_functions[i];
+
+            for (uint32_t addr : usage[i].gpAccesses)
+            {
+                memoryAccessMap[addr].insert(func.name);
+            }
+
+            if (!usage[i].dataSymbols.empty())
+            {
+                m_functionDataUsage[func.name].insert(usage[i].dataSymbols.begin(), usage[i].dataSymbols.end());
+            }
         }
 
         // Identify commonly accessed data (potential global structures)
@@ -460,15 +597,16 @@ namespace ps2recomp
             }
         }
 
-        for (const auto &func : m_functions)
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
             for (size_t i = 0; i < instructions.size(); i++)
             {
@@ -484,28 +622,41 @@ namespace ps2recomp
                         if ((nextInst.opcode == OPCODE_LW || nextInst.opcode == OPCODE_SW) &&
                             nextInst.rs == inst.rd)
                         {
-                            std::cout << "Found possible array access in function " << func.name
-                                      << " at 0x" << std::hex << nextInst.address << std::dec << std::endl;
+                            log << "Found possible array access in function " << func.name
+                                << " at 0x" << std::hex << nextInst.address << std::dec << "\n";
                             break;
                         }
                     }
                 }
             }
-        }
+        }, std::cout);
     }
 
     void ElfAnalyzer::identifyPotentialPatches()
     {
         std::cout << "Identifying potential patches..." << std::endl;
 
-        for (const auto &func : m_functions)
+        struct PatchRecord
+        {
+            uint32_t address;
+            bool replacesInstruction;
+            std::string reason;
+        };
+
+        std::vector<std::vector<PatchRecord>> patches(m_functions.size());
+        std::vector<std::vector<PatchRecord>> multimediaPatches(m_functions.size());
+
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            auto &records = patches[index];
+
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
             for (size_t i = 0; i < instructions.size(); i++)
             {
@@ -513,23 +664,20 @@ namespace ps2recomp
 
                 if (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_SYSCALL)
                 {
-                    std::cout << "Found syscall at " << formatAddress(inst.address) << " in function " << func.name << std::endl;
-                    m_patches[inst.address] = 0x00000000; // NOP
-                    m_patchReasons[inst.address] = "Syscall requires special handling";
+                    log << "Found syscall at " << formatAddress(inst.address) << " in function " << func.name << "\n";
+                    records.push_back({inst.address, true, "Syscall requires special handling"});
                 }
 
                 if (inst.opcode == OPCODE_COP0)
                 {
-                    std::cout << "Found COP0 instruction at " << formatAddress(inst.address) << " in function " << func.name << std::endl;
-                    m_patches[inst.address] = 0x00000000; // NOP
-                    m_patchReasons[inst.address] = "Privileged COP0 instruction";
+                    log << "Found COP0 instruction at " << formatAddress(inst.address) << " in function " << func.name << "\n";
+                    records.push_back({inst.address, true, "Privileged COP0 instruction"});
                 }
 
                 if (inst.opcode == OPCODE_CACHE)
                 {
-                    std::cout << "Found CACHE instruction at " << formatAddress(inst.address) << " in function " << func.name << std::endl;
-                    m_patches[inst.address] = 0x00000000; // NOP
-                    m_patchReasons[inst.address] = "Cache manipulation not supported";
+                    log << "Found CACHE instruction at " << formatAddress(inst.address) << " in function " << func.name << "\n";
+                    records.push_back({inst.address, true, "Cache manipulation not supported"});
                 }
 
                 // Detect potential self-modifying code
@@ -545,9 +693,8 @@ namespace ps2recomp
                         {
                             if (section.isCode && jumpTarget >= section.address && jumpTarget < section.address + section.size)
                             {
-                                std::cout << "Potential self-modifying code at " << formatAddress(inst.address) << " in function " << func.name << std::endl;
-                                m_patches[inst.address] = 0x00000000; // NOP the store
-                                m_patchReasons[inst.address] = "Potential self-modifying code";
+                                log << "Potential self-modifying code at " << formatAddress(inst.address) << " in function " << func.name << "\n";
+                                records.push_back({inst.address, true, "Potential self-modifying code"});
                             }
                         }
                     }
@@ -578,108 +725,144 @@ namespace ps2recomp
                             (targetAddr >= 0x10020000 && targetAddr < 0x10030000) || // DMAC registers
                             (targetAddr >= 0x12000000 && targetAddr < 0x12010000))   // GS registers
                         {
-                            std::cout << "Hardware register access at " << formatAddress(inst.address)
-                                      << " to address 0x" << std::hex << targetAddr << std::dec
-                                      << " in function " << func.name << std::endl;
+                            log << "Hardware register access at " << formatAddress(inst.address)
+                                << " to address 0x" << std::hex << targetAddr << std::dec
+                                << " in function " << func.name << "\n";
 
                             // We might need to replace this with a special function call but lets just patch it for now
-                            m_patchReasons[inst.address] = "Hardware register access to " + formatAddress(targetAddr);
+                            records.push_back({inst.address, false, "Hardware register access to " + formatAddress(targetAddr)});
                         }
                     }
                 }
 
                 if (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_SYNC)
                 {
-                    std::cout << "SYNC instruction (memory barrier) at " << formatAddress(inst.address)
-                              << " in function " << func.name << std::endl;
+                    log << "SYNC instruction (memory barrier) at " << formatAddress(inst.address)
+                        << " in function " << func.name << "\n";
                     // We might need to add memory barriers in the recompiled code
                 }
 
                 // Detect instructions that use special PS2 features like quad load/store
                 if (inst.opcode == OPCODE_LQ || inst.opcode == OPCODE_SQ)
                 {
-                    std::cout << "Quad word " << (inst.opcode == OPCODE_LQ ? "load" : "store")
-                              << " at " << formatAddress(inst.address) << " in function " << func.name << std::endl;
+                    log << "Quad word " << (inst.opcode == OPCODE_LQ ? "load" : "store")
+                        << " at " << formatAddress(inst.address) << " in function " << func.name << "\n";
                     // These will require special handling with SIMD instructions
                 }
             }
-        }
+        }, std::cout);
 
-        for (const auto &func : m_functions)
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            auto &records = multimediaPatches[index];
+
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
             for (const auto &inst : instructions)
             {
                 if (inst.isMMI || inst.isVU)
                 {
-                    std::cout << "Found PS2 multimedia instruction at " << formatAddress(inst.address)
-                              << " in function " << func.name << std::endl;
+                    log << "Found PS2 multimedia instruction at " << formatAddress(inst.address)
+                        << " in function " << func.name << "\n";
 
                     // These might need special handling, but we won't patch them with NOPs
-                    m_patchReasons[inst.address] = "PS2 multimedia instruction";
+                    records.push_back({inst.address, false, "PS2 multimedia instruction"});
                 }
             }
-        }
+        }, std::cout);
+
+        auto applyRecords = [this](const std::vector<std::vector<PatchRecord>> &functionRecords)
+        {
+            for (const auto &records : functionRecords)
+            {
+                for (const auto &record : records)
+                {
+                    if (record.replacesInstruction)
+                    {
+                        m_patches[record.address] = 0x00000000; // NOP
+                    }
+                    m_patchReasons[record.address] = record.reason;
+                }
+            }
+        };
+
+        applyRecords(patches);
+        applyRecords(multimediaPatches);
     }
 
     void ElfAnalyzer::analyzeControlFlow()
     {
         std::cout << "Analyzing control flow of functions..." << std::endl;
 
-        for (const auto &func : m_functions)
+        // First function wins when several symbols share a start address
+        std::unordered_map<uint32_t, size_t> functionByStart;
+        for (size_t i = 0; i < m_functions.size(); i++)
         {
+            functionByStart.try_emplace(m_functions[i].start, i);
+        }
+
+        std::vector<CFG> cfgs(m_functions.size());
+        std::vector<std::vector<FunctionCall>> calls(m_functions.size());
+
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
+        {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            CFG cfg = buildCFG(func);
-            m_functionCFGs[func.start] = cfg;
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
+            cfgs[index] = buildCFG(func, instructions);
 
-            std::vector<Instruction> instructions = decodeFunction(func);
             for (const auto &inst : instructions)
             {
-                if (inst.opcode == OPCODE_JAL ||
-                    (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_JALR))
+                // For JALR, the target is in the register - harder to statically analyze so lets skip it
+                if (inst.opcode != OPCODE_JAL)
                 {
+                    continue;
+                }
 
-                    uint32_t targetAddr = 0;
+                uint32_t targetAddr = (inst.address & 0xF0000000) | (inst.target << 2);
 
-                    if (inst.opcode == OPCODE_JAL)
-                    {
-                        targetAddr = (inst.address & 0xF0000000) | (inst.target << 2);
-                    }
-                    else
-                    {
-                        // For JALR, the target is in the register - harder to statically analyze so lets skip it
-                        continue;
-                    }
+                auto targetIt = functionByStart.find(targetAddr);
+                if (targetIt != functionByStart.end())
+                {
+                    const Function &targetFunc = m_functions[targetIt->second];
 
-                    for (const auto &targetFunc : m_functions)
-                    {
-                        if (targetFunc.start == targetAddr)
-                        {
-                            FunctionCall call;
-                            call.callerAddress = inst.address;
-                            call.calleeAddress = targetAddr;
-                            call.calleeName = targetFunc.name;
+                    FunctionCall call;
+                    call.callerAddress = inst.address;
+                    call.calleeAddress = targetAddr;
+                    call.calleeName = targetFunc.name;
 
-                            m_functionCalls[func.start].push_back(call);
+                    calls[index].push_back(call);
 
-                            std::cout << "Function " << func.name << " calls " << targetFunc.name
-                                      << " at " << formatAddress(inst.address) << std::endl;
-                            break;
-                        }
-                    }
+                    log << "Function " << func.name << " calls " << targetFunc.name
+                        << " at " << formatAddress(inst.address) << "\n";
                 }
             }
+        }, std::cout);
+
+        for (size_t i = 0; i < m_functions.size(); i++)
+        {
+            const auto &func = m_functions[i];
+            if (m_skipFunctions.contains(func.name) ||
+                m_libFunctions.contains(func.name))
+            {
+                continue;
+            }
+
+            m_functionCFGs[func.start] = std::move(cfgs[i]);
+
+            auto &functionCalls = m_functionCalls[func.start];
+            functionCalls.insert(functionCalls.end(), calls[i].begin(), calls[i].end());
         }
     }
 
@@ -687,113 +870,161 @@ namespace ps2recomp
     {
         std::cout << "Detecting jump tables..." << std::endl;
 
-        for (const auto &func : m_functions)
+        JumpTableSlicer slicer(*m_elfParser, m_sections, findGpValue());
+
+        std::vector<std::vector<JumpTable>> tables(m_functions.size());
+        std::vector<JumpTableCoverage> coverage(m_functions.size());
+
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
+            auto cfgIt = m_functionCFGs.find(func.start);
+            const CFG *cfg = (cfgIt != m_functionCFGs.end()) ? &cfgIt->second : nullptr;
 
             for (size_t i = 0; i < instructions.size(); i++)
             {
                 const auto &inst = instructions[i];
 
-                if (inst.opcode == OPCODE_SLTIU && i + 2 < instructions.size())
+                // jr $ra is a return, not a dispatch
+                if (inst.opcode != OPCODE_SPECIAL || inst.function != SPECIAL_JR || inst.rs == 31)
                 {
-                    const auto &nextInst = instructions[i + 1];
-                    if (nextInst.opcode == OPCODE_BNE || nextInst.opcode == OPCODE_BEQ)
-                    {
-                        for (size_t j = i + 2; j < std::min(i + 10, instructions.size()); j++)
-                        {
-                            const auto &loadInst = instructions[j];
+                    continue;
+                }
 
-                            if (loadInst.opcode == OPCODE_LW && j + 1 < instructions.size())
-                            {
-                                const auto &jumpInst = instructions[j + 1];
+                JumpTable jumpTable{};
+                JumpTableSliceResult result = slicer.resolve(func, instructions, cfg, i, jumpTable);
+                coverage[index].record(result);
 
-                                if (jumpInst.opcode == OPCODE_SPECIAL && jumpInst.function == SPECIAL_JR &&
-                                    jumpInst.rs == loadInst.rt)
-                                {
-                                    std::cout << "Detected jump table in function " << func.name
-                                              << " at " << formatAddress(loadInst.address) << std::endl;
+                if (result != JumpTableSliceResult::Resolved)
+                {
+                    continue;
+                }
 
-                                    uint32_t baseAddr = 0;
-                                    uint32_t numEntries = inst.immediate; // From the bounds check
+                log << "Detected jump table in function " << func.name
+                    << " at " << formatAddress(jumpTable.address)
+                    << " (jr at " << formatAddress(inst.address) << ", "
+                    << jumpTable.entries.size() << " entries)\n";
 
-                                    for (int k = j - 1; k >= static_cast<int>(i); k--)
-                                    {
-                                        const auto &addrInst = instructions[k];
+                for (const auto &entry : jumpTable.entries)
+                {
+                    log << "  - Jump table entry " << entry.index << ": 0x"
+                        << std::hex << entry.target << std::dec << "\n";
+                }
 
-                                        if (addrInst.opcode == OPCODE_LUI && k + 1 < instructions.size())
-                                        {
-                                            const auto &offsetInst = instructions[k + 1];
+                tables[index].push_back(std::move(jumpTable));
+            }
+        }, std::cout);
 
-                                            if ((offsetInst.opcode == OPCODE_ADDIU || offsetInst.opcode == OPCODE_ORI) &&
-                                                offsetInst.rs == addrInst.rt && offsetInst.rt == loadInst.rs)
-                                            {
+        JumpTableCoverage total;
+        for (size_t i = 0; i < tables.size(); i++)
+        {
+            m_jumpTables.insert(m_jumpTables.end(), tables[i].begin(), tables[i].end());
+            total += coverage[i];
+        }
 
-                                                baseAddr = (addrInst.immediate << 16) | (offsetInst.immediate & 0xFFFF);
-                                                break;
-                                            }
-                                        }
-                                    }
+        std::cout << "Jump table coverage: " << total.resolved << " of " << total.indirectJumps
+                  << " indirect jumps resolved";
+        if (total.indirectJumps != 0)
+        {
+            std::cout << " (" << std::fixed << std::setprecision(1)
+                      << (100.0 * total.resolved / total.indirectJumps) << "%)";
+            std::cout.unsetf(std::ios::floatfield);
+        }
+        std::cout << std::endl;
+        std::cout << "  - " << total.notTableLoad << " not loaded from a table" << std::endl;
+        std::cout << "  - " << total.unknownBase << " with an unknown table base" << std::endl;
+        std::cout << "  - " << total.noBound << " without an index bound" << std::endl;
+        std::cout << "  - " << total.noEntries << " with entries outside code" << std::endl;
+    }
 
-                                    if (baseAddr != 0 && numEntries > 0 && numEntries < 1000)
-                                    {
-                                        JumpTable jumpTable;
-                                        jumpTable.address = baseAddr;
-                                        jumpTable.baseRegister = loadInst.rs;
-
-                                        for (uint32_t e = 0; e < numEntries; e++)
-                                        {
-                                            uint32_t entryAddr = baseAddr + (e * 4);
-
-                                            if (m_elfParser->isValidAddress(entryAddr))
-                                            {
-                                                uint32_t targetAddr = m_elfParser->readWord(entryAddr);
-
-                                                JumpTableEntry entry;
-                                                entry.index = e;
-                                                entry.target = targetAddr;
-                                                jumpTable.entries.push_back(entry);
-
-                                                std::cout << "  - Jump table entry " << e << ": 0x"
-                                                          << std::hex << targetAddr << std::dec << std::endl;
-                                            }
-                                        }
-
-                                        if (!jumpTable.entries.empty())
-                                        {
-                                            m_jumpTables.push_back(jumpTable);
-                                        }
-                                    }
+    void ElfAnalyzer::findVuMicroprograms()
+    {
+        std::cout << "Scanning data for VU microcode..." << std::endl;
 
-                                    break;
-                                }
-                            }
-                        }
-                    }
+        m_vuMicroprograms.clear();
+        for (const auto &section : m_sections)
+        {
+            if (section.isBSS || !section.data || section.size == 0)
+            {
+                continue;
+            }
+
+            std::vector<VuMicroprogram> found = VuRecompiler::findMpgUploads(section.data, section.size, section.address);
+            for (const auto &program : found)
+            {
+                std::cout << "VU microprogram in " << section.name << " at 0x" << std::hex << program.address
+                          << ": 0x" << program.size << " bytes loaded at 0x" << program.loadAddress << std::dec << std::endl;
+            }
+            m_vuMicroprograms.insert(m_vuMicroprograms.end(), found.begin(), found.end());
+        }
+    }
+
+    uint32_t ElfAnalyzer::findGpValue() const
+    {
+        auto symbolIt = std::find_if(m_symbols.begin(), m_symbols.end(),
+                                     [](const Symbol &symbol)
+                                     { return symbol.name == "_gp"; });
+        if (symbolIt != m_symbols.end())
+        {
+            return symbolIt->address;
+        }
+
+        // Without the symbol, take the value crt0 loads into $gp with lui/addiu
+        uint32_t entry = m_elfParser->getEntryPoint();
+        auto funcIt = std::find_if(m_functions.begin(), m_functions.end(),
+                                   [entry](const Function &f)
+                                   { return entry >= f.start && entry < f.end; });
+        if (funcIt == m_functions.end())
+        {
+            return 0;
+        }
+
+        uint32_t upper = 0;
+        bool haveUpper = false;
+        for (const auto &inst : getDecodedFunction(*funcIt))
+        {
+            if (inst.opcode == OPCODE_LUI && inst.rt == 28)
+            {
+                upper = inst.immediate << 16;
+                haveUpper = true;
+            }
+            else if (haveUpper && inst.rt == 28 && inst.rs == 28)
+            {
+                if (inst.opcode == OPCODE_ADDIU)
+                {
+                    return upper + inst.simmediate;
+                }
+                if (inst.opcode == OPCODE_ORI)
+                {
+                    return upper | inst.immediate;
                 }
             }
         }
+
+        return 0;
     }
 
     void ElfAnalyzer::analyzePerformanceCriticalPaths() const
 	{
         std::cout << "Analyzing performance-critical paths..." << std::endl;
 
-        for (const auto &func : m_functions)
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
             for (const auto& inst : instructions)
             {
@@ -808,10 +1039,10 @@ namespace ps2recomp
 
                         if (loopSize < 20)
                         {
-                            std::cout << "Found tight loop in function " << func.name
-                                      << " from " << formatAddress(targetAddr)
-                                      << " to " << formatAddress(inst.address)
-                                      << " (size: " << loopSize << " instructions)" << std::endl;
+                            log << "Found tight loop in function " << func.name
+                                << " from " << formatAddress(targetAddr)
+                                << " to " << formatAddress(inst.address)
+                                << " (size: " << loopSize << " instructions)\n";
 
                             bool hasMultimedia = false;
                             for (const auto& instruction : instructions)
@@ -828,13 +1059,13 @@ namespace ps2recomp
 
                             if (hasMultimedia)
                             {
-                                std::cout << "  - Loop contains multimedia instructions" << std::endl;
+                                log << "  - Loop contains multimedia instructions\n";
                             }
                         }
                     }
                 }
             }
-        }
+        }, std::cout);
     }
 
     void ElfAnalyzer::identifyRecursiveFunctions()
@@ -862,12 +1093,13 @@ namespace ps2recomp
             }
         }
 
-        for (const auto &func : m_functions)
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
             std::set<std::string> visited;
@@ -880,9 +1112,15 @@ namespace ps2recomp
                     return currFunc == func.name;
                 }
 
+                auto calleesIt = callGraph.find(currFunc);
+                if (calleesIt == callGraph.end())
+                {
+                    return false;
+                }
+
                 visited.insert(currFunc);
 
-                for (const auto &callee : callGraph[currFunc])
+                for (const auto &callee : calleesIt->second)
                 {
                     if (detectCycle(callee))
                     {
@@ -896,24 +1134,25 @@ namespace ps2recomp
 
             if (detectCycle(func.name))
             {
-                std::cout << "Function " << func.name << " is part of a mutually recursive cycle" << std::endl;
+                log << "Function " << func.name << " is part of a mutually recursive cycle\n";
             }
-        }
+        }, std::cout);
     }
 
     void ElfAnalyzer::analyzeRegisterUsage() const
 	{
         std::cout << "Analyzing register usage patterns..." << std::endl;
 
-        for (const auto &func : m_functions)
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
             std::set<uint32_t> regsRead, regsWritten;
 
             for (const auto &inst : instructions)
@@ -979,40 +1218,41 @@ namespace ps2recomp
 
             if (hasStackOps)
             {
-                std::cout << "Function " << func.name << " allocates a stack frame" << std::endl;
+                log << "Function " << func.name << " allocates a stack frame\n";
 
                 if (savesFP)
-                    std::cout << "  - Saves frame pointer ($fp)" << std::endl;
+                    log << "  - Saves frame pointer ($fp)\n";
                 if (savesRA)
-                    std::cout << "  - Saves return address ($ra)" << std::endl;
+                    log << "  - Saves return address ($ra)\n";
             }
 
             if (regsRead.contains(4) || regsRead.contains(5) ||
                 regsRead.contains(6) || regsRead.contains(7))
             {
-                std::cout << "  - Uses argument registers (a0-a3)" << std::endl;
+                log << "  - Uses argument registers (a0-a3)\n";
             }
 
             if (regsWritten.contains(2) || regsWritten.contains(3))
             {
-                std::cout << "  - Sets return values (v0-v1)" << std::endl;
+                log << "  - Sets return values (v0-v1)\n";
             }
-        }
+        }, std::cout);
     }
 
     void ElfAnalyzer::analyzeFunctionSignatures() const
 	{
         std::cout << "Analyzing function signatures..." << std::endl;
 
-        for (const auto &func : m_functions)
+        m_passManager->parallelForLogged(m_functions.size(), [&](size_t index, std::ostream &log)
         {
+            const auto &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
             int paramCount = 0;
             bool usesFloatingPoint = false;
@@ -1061,25 +1301,25 @@ namespace ps2recomp
 
             if (paramCount > 0 || usesFloatingPoint || usesDoublewords || returnsSomething)
             {
-                std::cout << "Function " << func.name << " signature analysis:" << std::endl;
+                log << "Function " << func.name << " signature analysis:\n";
                 if (paramCount > 0)
                 {
-                    std::cout << "  - Uses approximately " << paramCount << " parameter(s)" << std::endl;
+                    log << "  - Uses approximately " << paramCount << " parameter(s)\n";
                 }
                 if (usesFloatingPoint)
                 {
-                    std::cout << "  - Uses floating point operations" << std::endl;
+                    log << "  - Uses floating point operations\n";
                 }
                 if (usesDoublewords)
                 {
-                    std::cout << "  - Uses 64-bit operations" << std::endl;
+                    log << "  - Uses 64-bit operations\n";
                 }
                 if (returnsSomething)
                 {
-                    std::cout << "  - Returns a value" << std::endl;
+                    log << "  - Returns a value\n";
                 }
             }
-        }
+        }, std::cout);
     }
 
     void ElfAnalyzer::optimizePatches()
@@ -1162,7 +1402,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyMemcpyPattern(const Function &func) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
         bool hasLoop = false;
         bool loadsData = false;
@@ -1206,7 +1446,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyMemsetPattern(const Function &func) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
         bool hasLoop = false;
         bool usesConstant = false;
@@ -1249,7 +1489,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyStringOperationPattern(const Function &func) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
         bool hasLoop = false;
         bool checksZero = false;
@@ -1289,7 +1529,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyMathPattern(const Function &func) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = getDecodedFunction(func);
 
         int mathOps = 0;
         bool usesFPU = false;
@@ -1318,10 +1558,9 @@ namespace ps2recomp
         return mathOps > instructions.size() * 0.3 || usesFPU;
     }
 
-    CFG ElfAnalyzer::buildCFG(const Function &function) const
+    CFG ElfAnalyzer::buildCFG(const Function &function, const std::vector<Instruction> &instructions)
 	{
         CFG cfg;
-        std::vector<Instruction> instructions = decodeFunction(function);
         std::map<uint32_t, size_t> addrToIndex;
 
         for (size_t i = 0; i < instructions.size(); i++)
@@ -1589,6 +1828,40 @@ namespace ps2recomp
         return instructions;
     }
 
+    void ElfAnalyzer::decodeAllFunctions()
+    {
+        m_decodedFunctions.clear();
+
+        std::vector<std::vector<Instruction>> decoded(m_functions.size());
+        m_passManager->parallelFor(m_functions.size(), [&](size_t index)
+                                   { decoded[index] = decodeFunction(m_functions[index]); });
+
+        m_decodedFunctions.reserve(m_functions.size());
+        for (size_t i = 0; i < m_functions.size(); i++)
+        {
+            // Aliased symbols share a start address; the first one decoded wins.
+            m_decodedFunctions.try_emplace(m_functions[i].start, std::move(decoded[i]));
+        }
+
+        std::cout << "Decoded " << m_decodedFunctions.size() << " functions using "
+                  << m_passManager->threadCount() << " thread(s)" << std::endl;
+    }
+
+    const std::vector<Instruction> &ElfAnalyzer::getDecodedFunction(const Function &function) const
+    {
+        static const std::vector<Instruction> kEmpty;
+
+        auto it = m_decodedFunctions.find(function.start);
+        if (it == m_decodedFunctions.end())
+        {
+            std::cerr << "Function " << function.name << " at " << formatAddress(function.start)
+                      << " was not decoded" << std::endl;
+            return kEmpty;
+        }
+
+        return it->second;
+    }
+
     std::string ElfAnalyzer::formatAddress(uint32_t address) const
     {
         std::stringstream ss;
@@ -1598,7 +1871,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::hasMMIInstructions(const Function &function) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = getDecodedFunction(function);
 
         for (const auto &inst : instructions)
         {
@@ -1613,7 +1886,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::hasVUInstructions(const Function &function) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = getDecodedFunction(function);
 
         for (const auto &inst : instructions)
         {
@@ -1642,7 +1915,7 @@ namespace ps2recomp
             return false;
         }
 
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = getDecodedFunction(function);
 
         bool hasHardwareIO = false;
         bool hasComplexMMI = false;
@@ -1711,7 +1984,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::isSelfModifyingCode(const Function &function) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = getDecodedFunction(function);
 
         for (size_t i = 0; i < instructions.size(); i++)
         {
@@ -1757,7 +2030,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::isLoopHeavyFunction(const Function &function) const
 	{
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = getDecodedFunction(function);
         int loopCount = 0;
 
         for (const auto & inst : instructions)
@@ -0,0 +1,493 @@
+#include "ps2recomp/jump_table_slicer.h"
+#include "ps2recomp/elf_parser.h"
+#include "ps2recomp/instructions.h"
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+namespace ps2recomp
+{
+    namespace
+    {
+        constexpr size_t kEntryDefinition = std::numeric_limits<size_t>::max();         // Value comes from the caller
+        constexpr size_t kAmbiguousDefinition = std::numeric_limits<size_t>::max() - 1; // Paths disagree or budget ran out
+        constexpr size_t kSliceBudget = 64;          // Join points visited per backward walk
+        constexpr int kMaxSliceDepth = 12;           // Nested definitions followed per value
+        constexpr uint32_t kMaxJumpTableEntries = 1024;
+        constexpr uint32_t kGpRegister = 28;
+
+        bool isCallerSaved(uint32_t reg)
+        {
+            return (reg >= 1 && reg <= 15) || reg == 24 || reg == 25 || reg == 31;
+        }
+
+        bool writesRegister(const Instruction &inst, uint32_t reg)
+        {
+            if (reg == 0)
+            {
+                return false;
+            }
+
+            if (inst.isCall)
+            {
+                return isCallerSaved(reg);
+            }
+
+            switch (inst.opcode)
+            {
+            case OPCODE_SPECIAL:
+                return inst.function != SPECIAL_JR && inst.rd == reg;
+            case OPCODE_MMI:
+                return inst.rd == reg;
+            case OPCODE_REGIMM:
+                return (inst.rt & 0x10) != 0 && reg == 31;
+            case OPCODE_JAL:
+                return reg == 31;
+            case OPCODE_J:
+            case OPCODE_BEQ:
+            case OPCODE_BNE:
+            case OPCODE_BLEZ:
+            case OPCODE_BGTZ:
+            case OPCODE_BEQL:
+            case OPCODE_BNEL:
+            case OPCODE_BLEZL:
+            case OPCODE_BGTZL:
+            case OPCODE_CACHE:
+            case OPCODE_PREF:
+            case OPCODE_LWC1:
+            case OPCODE_LWC2:
+            case OPCODE_LDC1:
+            case OPCODE_LDC2:
+                return false;
+            case OPCODE_COP0:
+            case OPCODE_COP1:
+            case OPCODE_COP2:
+                // MFC/DMFC/CFC (and QMFC2) move into rt, everything else stays in the coprocessor
+                return inst.rs <= 2 && inst.rt == reg;
+            case OPCODE_SC:
+            case OPCODE_SCD:
+                return inst.rt == reg;
+            default:
+                return !inst.isStore && inst.rt == reg;
+            }
+        }
+
+        size_t indexOf(const std::vector<Instruction> &instructions, uint32_t address)
+        {
+            if (instructions.empty() || address < instructions.front().address)
+            {
+                return kEntryDefinition;
+            }
+
+            size_t index = (address - instructions.front().address) / 4;
+            if (index < instructions.size() && instructions[index].address == address)
+            {
+                return index;
+            }
+            return kEntryDefinition;
+        }
+    }
+
+    void JumpTableCoverage::record(JumpTableSliceResult result)
+    {
+        indirectJumps++;
+        switch (result)
+        {
+        case JumpTableSliceResult::Resolved:
+            resolved++;
+            break;
+        case JumpTableSliceResult::NotTableLoad:
+            notTableLoad++;
+            break;
+        case JumpTableSliceResult::UnknownBase:
+            unknownBase++;
+            break;
+        case JumpTableSliceResult::NoBound:
+            noBound++;
+            break;
+        case JumpTableSliceResult::NoEntries:
+            noEntries++;
+            break;
+        }
+    }
+
+    JumpTableCoverage &JumpTableCoverage::operator+=(const JumpTableCoverage &other)
+    {
+        indirectJumps += other.indirectJumps;
+        resolved += other.resolved;
+        notTableLoad += other.notTableLoad;
+        unknownBase += other.unknownBase;
+        noBound += other.noBound;
+        noEntries += other.noEntries;
+        return *this;
+    }
+
+    JumpTableSlicer::JumpTableSlicer(const ElfParser &parser, const std::vector<Section> &sections, uint32_t gpValue)
+        : m_parser(parser), m_sections(sections), m_gpValue(gpValue)
+    {
+    }
+
+    JumpTableSliceResult JumpTableSlicer::resolve(const Function &function, const std::vector<Instruction> &instructions,
+                                                  const CFG *cfg, size_t jumpIndex, JumpTable &table) const
+    {
+        SliceContext ctx{function, instructions, cfg};
+        const Instruction &jump = instructions[jumpIndex];
+
+        size_t loadIndex = definitionOf(ctx, jump.rs, jumpIndex);
+        if (loadIndex == kEntryDefinition || loadIndex == kAmbiguousDefinition)
+        {
+            return JumpTableSliceResult::NotTableLoad;
+        }
+
+        const Instruction &load = instructions[loadIndex];
+        if (load.opcode != OPCODE_LW && load.opcode != OPCODE_LWU)
+        {
+            return JumpTableSliceResult::NotTableLoad;
+        }
+
+        SliceValue slot = valueBefore(ctx, load.rs, loadIndex, 0);
+        slot.base += load.simmediate;
+
+        if (slot.scale == 0)
+        {
+            // Function pointer read from a fixed location
+            return JumpTableSliceResult::NotTableLoad;
+        }
+        if (slot.scale != 4 || slot.indexDef == kAmbiguousDefinition || !m_parser.isValidAddress(slot.base))
+        {
+            return JumpTableSliceResult::UnknownBase;
+        }
+
+        uint32_t bound = findIndexBound(ctx, slot, loadIndex);
+        if (bound == 0 || bound > kMaxJumpTableEntries)
+        {
+            return JumpTableSliceResult::NoBound;
+        }
+
+        std::vector<JumpTableEntry> entries;
+        entries.reserve(bound);
+        for (uint32_t e = 0; e < bound; e++)
+        {
+            uint32_t entryAddr = slot.base + e * 4;
+            if (!m_parser.isValidAddress(entryAddr))
+            {
+                return JumpTableSliceResult::NoEntries;
+            }
+
+            uint32_t target = m_parser.readWord(entryAddr);
+            if ((target & 3) != 0 || !isCodeAddress(target))
+            {
+                return JumpTableSliceResult::NoEntries;
+            }
+
+            entries.push_back({e, target});
+        }
+
+        table.address = slot.base;
+        table.baseRegister = load.rs;
+        table.jumpAddress = jump.address;
+        table.entries = std::move(entries);
+        return JumpTableSliceResult::Resolved;
+    }
+
+    void JumpTableSlicer::predecessors(const SliceContext &ctx, size_t position, std::vector<std::vector<size_t>> &paths) const
+    {
+        paths.clear();
+
+        if (ctx.cfg)
+        {
+            auto nodeIt = ctx.cfg->find(ctx.instructions[position].address);
+            if (nodeIt != ctx.cfg->end() && !nodeIt->second.predecessors.empty())
+            {
+                for (uint32_t predAddr : nodeIt->second.predecessors)
+                {
+                    auto predIt = ctx.cfg->find(predAddr);
+                    if (predIt == ctx.cfg->end())
+                    {
+                        continue;
+                    }
+
+                    size_t last = indexOf(ctx.instructions, predIt->second.endAddress);
+                    if (last == kEntryDefinition)
+                    {
+                        continue;
+                    }
+
+                    // Blocks end at the branch, so a taken edge skips the delay slot that
+                    // still executes before the target
+                    const Instruction &lastInst = ctx.instructions[last];
+                    if (lastInst.hasDelaySlot && lastInst.address + 4 != ctx.instructions[position].address &&
+                        last + 1 < ctx.instructions.size())
+                    {
+                        paths.push_back({last + 1, last});
+                    }
+                    else
+                    {
+                        paths.push_back({last});
+                    }
+                }
+                return;
+            }
+        }
+
+        // Straight-line code, or a block the CFG left unlinked (such as the return point of a call)
+        if (position > 0)
+        {
+            paths.push_back({position - 1});
+        }
+    }
+
+    size_t JumpTableSlicer::definitionOf(const SliceContext &ctx, uint32_t reg, size_t position) const
+    {
+        size_t found = kEntryDefinition;
+        bool reachedEntry = false;
+
+        std::vector<size_t> pending{position};
+        std::unordered_set<size_t> visited;
+        std::vector<std::vector<size_t>> paths;
+
+        while (!pending.empty())
+        {
+            size_t current = pending.back();
+            pending.pop_back();
+
+            predecessors(ctx, current, paths);
+            if (paths.empty())
+            {
+                reachedEntry = true;
+                continue;
+            }
+
+            for (const auto &path : paths)
+            {
+                bool defined = false;
+                for (size_t p : path)
+                {
+                    if (writesRegister(ctx.instructions[p], reg))
+                    {
+                        if (found != kEntryDefinition && found != p)
+                        {
+                            return kAmbiguousDefinition;
+                        }
+                        found = p;
+                        defined = true;
+                        break;
+                    }
+                }
+
+                if (!defined && visited.insert(path.back()).second)
+                {
+                    if (visited.size() > kSliceBudget)
+                    {
+                        return kAmbiguousDefinition;
+                    }
+                    pending.push_back(path.back());
+                }
+            }
+        }
+
+        if (found != kEntryDefinition && reachedEntry)
+        {
+            return kAmbiguousDefinition;
+        }
+        return found;
+    }
+
+    JumpTableSlicer::SliceValue JumpTableSlicer::valueBefore(const SliceContext &ctx, uint32_t reg, size_t position, int depth) const
+    {
+        if (reg == 0)
+        {
+            return {};
+        }
+
+        size_t def = definitionOf(ctx, reg, position);
+        if (def == kEntryDefinition || def == kAmbiguousDefinition)
+        {
+            if (reg == kGpRegister && m_gpValue != 0)
+            {
+                return {m_gpValue, 0, 0, 0};
+            }
+            return {0, 1, reg, def};
+        }
+
+        return valueOfDefinition(ctx, reg, def, depth);
+    }
+
+    JumpTableSlicer::SliceValue JumpTableSlicer::valueOfDefinition(const SliceContext &ctx, uint32_t reg, size_t def, int depth) const
+    {
+        const SliceValue symbol{0, 1, reg, def};
+        if (depth >= kMaxSliceDepth)
+        {
+            return symbol;
+        }
+
+        const Instruction &inst = ctx.instructions[def];
+        switch (inst.opcode)
+        {
+        case OPCODE_LUI:
+            return {inst.immediate << 16, 0, 0, 0};
+
+        case OPCODE_ADDI:
+        case OPCODE_ADDIU:
+        case OPCODE_DADDI:
+        case OPCODE_DADDIU:
+        {
+            // Offsets on an address keep tracking the table; an offset on a raw index
+            // starts a new index, since the bounds check is done on the adjusted value
+            SliceValue value = valueBefore(ctx, inst.rs, def, depth + 1);
+            if (value.scale == 1)
+            {
+                return symbol;
+            }
+            value.base += inst.simmediate;
+            return value;
+        }
+
+        case OPCODE_ORI:
+        {
+            SliceValue value = valueBefore(ctx, inst.rs, def, depth + 1);
+            if (value.scale != 0)
+            {
+                return symbol;
+            }
+            value.base |= inst.immediate;
+            return value;
+        }
+
+        case OPCODE_SPECIAL:
+            switch (inst.function)
+            {
+            case SPECIAL_SLL:
+            {
+                SliceValue value = valueBefore(ctx, inst.rt, def, depth + 1);
+                value.base <<= inst.sa;
+                value.scale <<= inst.sa;
+                return value;
+            }
+
+            case SPECIAL_ADD:
+            case SPECIAL_ADDU:
+            case SPECIAL_DADD:
+            case SPECIAL_DADDU:
+            case SPECIAL_OR:
+            {
+                if (inst.function == SPECIAL_OR && inst.rs != 0 && inst.rt != 0)
+                {
+                    return symbol;
+                }
+
+                SliceValue lhs = valueBefore(ctx, inst.rs, def, depth + 1);
+                SliceValue rhs = valueBefore(ctx, inst.rt, def, depth + 1);
+                if (lhs.scale == 0)
+                {
+                    rhs.base += lhs.base;
+                    return rhs;
+                }
+                if (rhs.scale == 0)
+                {
+                    lhs.base += rhs.base;
+                    return lhs;
+                }
+                return symbol;
+            }
+
+            default:
+                return symbol;
+            }
+
+        default:
+            return symbol;
+        }
+    }
+
+    uint32_t JumpTableSlicer::findIndexBound(const SliceContext &ctx, const SliceValue &index, size_t position) const
+    {
+        if (index.indexDef == kAmbiguousDefinition)
+        {
+            return 0;
+        }
+
+        // The guard has to test the same definition of the index that feeds the load
+        auto guardsIndex = [&](const Instruction &inst, size_t p)
+        {
+            return inst.rs == index.indexReg && definitionOf(ctx, inst.rs, p) == index.indexDef;
+        };
+
+        // An sltiu/sltu only counts when its result feeds a branch against zero shortly after
+        auto feedsBranch = [&](size_t p, uint32_t flagReg)
+        {
+            for (size_t q = p + 1; q < std::min(p + 5, ctx.instructions.size()); q++)
+            {
+                const Instruction &next = ctx.instructions[q];
+                bool isEqualityBranch = next.opcode == OPCODE_BEQ || next.opcode == OPCODE_BNE ||
+                                        next.opcode == OPCODE_BEQL || next.opcode == OPCODE_BNEL;
+                if (isEqualityBranch && ((next.rs == flagReg && next.rt == 0) || (next.rt == flagReg && next.rs == 0)))
+                {
+                    return true;
+                }
+                if (writesRegister(next, flagReg))
+                {
+                    return false;
+                }
+            }
+            return false;
+        };
+
+        uint32_t bound = 0;
+        std::vector<size_t> pending{position};
+        std::unordered_set<size_t> visited;
+        std::vector<std::vector<size_t>> paths;
+
+        while (!pending.empty())
+        {
+            size_t current = pending.back();
+            pending.pop_back();
+
+            predecessors(ctx, current, paths);
+            for (const auto &path : paths)
+            {
+                bool stop = false;
+                for (size_t p : path)
+                {
+                    if (p == index.indexDef)
+                    {
+                        stop = true;
+                        break;
+                    }
+
+                    const Instruction &inst = ctx.instructions[p];
+                    if (inst.opcode == OPCODE_SLTIU && guardsIndex(inst, p) && feedsBranch(p, inst.rt))
+                    {
+                        bound = std::max(bound, inst.simmediate);
+                        stop = true;
+                        break;
+                    }
+                    if (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_SLTU &&
+                        guardsIndex(inst, p) && feedsBranch(p, inst.rd))
+                    {
+                        SliceValue limit = valueBefore(ctx, inst.rt, p, 0);
+                        if (limit.scale == 0)
+                        {
+                            bound = std::max(bound, limit.base);
+                            stop = true;
+                            break;
+                        }
+                    }
+                }
+
+                if (!stop && visited.insert(path.back()).second && visited.size() <= kSliceBudget)
+                {
+                    pending.push_back(path.back());
+                }
+            }
+        }
+
+        return bound;
+    }
+
+    bool JumpTableSlicer::isCodeAddress(uint32_t address) const
+    {
+        return std::any_of(m_sections.begin(), m_sections.end(), [address](const Section &section)
+                           { return section.isCode && address >= section.address && address - section.address < section.size; });
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef PS2RECOMP_ANALYSIS_DATABASE_H
+#define PS2RECOMP_ANALYSIS_DATABASE_H
+
+#include "ps2recomp/types.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ps2recomp
+{
+    // On-disk layout of the analysis database. Every table is an array of
+    // fixed-size records at a 16-byte aligned offset, so a mapped file can be
+    // read in place without parsing.
+    constexpr char kAnalysisDatabaseMagic[8] = {'P', 'S', '2', 'X', 'A', 'D', 'B', '\0'};
+    constexpr uint32_t kAnalysisDatabaseVersion = 3;
+
+    struct AnalysisDatabaseHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t instructionSize; // sizeof(Instruction) of the writer
+        uint64_t elfSize;
+        uint64_t elfHash; // FNV-1a of the ELF contents
+
+        uint32_t functionCount;
+        uint32_t instructionCount;
+        uint32_t cfgNodeCount;
+        uint32_t edgeCount;
+        uint32_t jumpTableCount;
+        uint32_t jumpTableEntryCount;
+        uint32_t callCount;
+        uint32_t stringBytes;
+
+        uint64_t functionsOffset;
+        uint64_t instructionsOffset;
+        uint64_t cfgNodesOffset;
+        uint64_t edgesOffset;
+        uint64_t jumpTablesOffset;
+        uint64_t jumpTableEntriesOffset;
+        uint64_t callsOffset;
+        uint64_t stringsOffset;
+    };
+
+    struct DbFunction
+    {
+        uint32_t start;
+        uint32_t end;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t firstInstruction;
+        uint32_t instructionCount;
+        uint32_t firstCfgNode;
+        uint32_t cfgNodeCount; // 0 when no CFG was built for the function
+        uint32_t firstCall;
+        uint32_t callCount;
+    };
+
+    struct DbCFGNode
+    {
+        uint32_t startAddress;
+        uint32_t endAddress;
+        uint32_t firstInstruction; // Index into the owning function's instructions
+        uint32_t instructionCount;
+        uint32_t firstPredecessor; // Index into the edge table
+        uint32_t predecessorCount;
+        uint32_t firstSuccessor;
+        uint32_t successorCount;
+        uint32_t isJumpTarget;
+    };
+
+    struct DbJumpTable
+    {
+        uint32_t address;
+        uint32_t baseRegister;
+        uint32_t firstEntry;
+        uint32_t entryCount;
+        uint32_t jumpAddress;
+    };
+
+    struct DbFunctionCall
+    {
+        uint32_t callerAddress;
+        uint32_t calleeAddress;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+    };
+
+    // Analysis results that get persisted, borrowed from the analyzer
+    struct AnalysisSnapshot
+    {
+        const std::vector<Function> &functions;
+        const std::unordered_map<uint32_t, std::vector<Instruction>> &decodedFunctions;
+        const std::unordered_map<uint32_t, CFG> &cfgs;
+        const std::vector<JumpTable> &jumpTables;
+        const std::unordered_map<uint32_t, std::vector<FunctionCall>> &functionCalls;
+    };
+
+    // Versioned, memory-mapped store for decoded functions, CFGs, jump tables
+    // and the call graph of one ELF. A database is only accepted when its
+    // format version, instruction layout and ELF hash all match.
+    class AnalysisDatabase
+    {
+    public:
+        AnalysisDatabase();
+        ~AnalysisDatabase();
+
+        AnalysisDatabase(const AnalysisDatabase &) = delete;
+        AnalysisDatabase &operator=(const AnalysisDatabase &) = delete;
+
+        static std::string pathForElf(const std::string &elfPath);
+        static bool save(const std::string &dbPath, const std::string &elfPath, const AnalysisSnapshot &snapshot);
+
+        bool open(const std::string &dbPath, const std::string &elfPath);
+        void close();
+        bool isOpen() const { return m_header != nullptr; }
+
+        std::span<const DbFunction> functions() const;
+        const DbFunction *findFunction(uint32_t start) const;
+
+        std::string_view functionName(const DbFunction &function) const;
+        std::span<const Instruction> instructions(const DbFunction &function) const;
+        bool hasCFG(const DbFunction &function) const { return function.cfgNodeCount != 0; }
+        CFG loadCFG(const DbFunction &function) const;
+        std::vector<FunctionCall> loadCalls(const DbFunction &function) const;
+        std::vector<JumpTable> loadJumpTables() const;
+
+    private:
+        const uint8_t *m_data = nullptr;
+        size_t m_size = 0;
+        const AnalysisDatabaseHeader *m_header = nullptr;
+#ifdef _WIN32
+        void *m_fileHandle = nullptr;
+        void *m_mappingHandle = nullptr;
+#else
+        int m_fd = -1;
+#endif
+
+        template <typename T>
+        const T *table(uint64_t offset) const
+        {
+            return reinterpret_cast<const T *>(m_data + offset);
+        }
+
+        std::string_view string(uint32_t offset, uint32_t length) const;
+        bool validate(const std::string &elfPath) const;
+    };
+}
+
+#endif // PS2RECOMP_ANALYSIS_DATABASE_H
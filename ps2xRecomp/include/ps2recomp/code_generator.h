@@ -33,12 +33,14 @@ namespace ps2recomp
         };
 
         std::string generateFunction(const Function &function, const std::vector<Instruction> &instructions, const bool &useHeaders);
-        std::string generateFunctionRegistration(const std::vector<Function> &functions, const std::map<uint32_t, std::string> &stubs);
+        std::string generateFunctionRegistration(const std::vector<Function> &functions, const std::map<uint32_t, std::string> &stubs,
+                                                 bool registerVuMicroprograms = false);
         std::string handleBranchDelaySlots(const Instruction &branchInst, const Instruction &delaySlot,
                                            const Function &function, const std::unordered_set<uint32_t> &internalTargets);
 
         void setRenamedFunctions(const std::unordered_map<uint32_t, std::string> &renames);
         void setBootstrapInfo(const BootstrapInfo &info);
+        void setJumpTables(const std::vector<JumpTable> &jumpTables);
         std::unordered_set<uint32_t> collectInternalBranchTargets(const Function &function,
                                                                   const std::vector<Instruction> &instructions);
 
@@ -46,6 +48,7 @@ namespace ps2recomp
         std::unordered_map<uint32_t, Symbol> m_symbols;
         std::unordered_map<uint32_t, std::string> m_renamedFunctions;
         BootstrapInfo m_bootstrapInfo;
+        std::unordered_map<uint32_t, JumpTable> m_jumpTables; // Keyed by the address of the dispatching JR
 
         std::string translateInstruction(const Instruction &inst);
         std::string translateMMIInstruction(const Instruction &inst);
@@ -119,7 +122,9 @@ namespace ps2recomp
 
         // Jump Table Generation
         std::string generateJumpTableSwitch(const Instruction &inst, uint32_t tableAddress,
-                                            const std::vector<JumpTableEntry> &entries);
+                                            const std::vector<JumpTableEntry> &entries,
+                                            const std::unordered_set<uint32_t> &internalTargets = {},
+                                            const std::string &delaySlotCode = "");
         std::string generateBootstrapFunction() const;
 
         Symbol *findSymbolByAddress(uint32_t address);
@@ -3,6 +3,8 @@
 
 #include "code_generator.h"
 #include "config_manager.h"
+#include "analysis_database.h"
+#include "vu_recompiler.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -30,6 +32,8 @@ namespace ps2recomp
         std::unique_ptr<R5900Decoder> m_decoder;
         std::unique_ptr<CodeGenerator> m_codeGenerator;
         RecompilerConfig m_config;
+        AnalysisDatabase m_analysisDatabase;
+        VuRecompiler m_vuRecompiler;
 
         std::vector<Function> m_functions;
         std::vector<Symbol> m_symbols;
@@ -44,7 +48,9 @@ namespace ps2recomp
         CodeGenerator::BootstrapInfo m_bootstrapInfo;
 
         bool decodeFunction(Function &function);
+        bool loadDecodedFunction(const Function &function);
         void discoverAdditionalEntryPoints();
+        void collectVuMicroprograms();
         bool shouldSkipFunction(const std::string &name) const;
         bool isStubFunction(const std::string &name) const;
         bool generateFunctionHeader();
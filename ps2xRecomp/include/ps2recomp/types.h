@@ -137,6 +137,16 @@ namespace ps2recomp
         uint32_t address;
         uint32_t baseRegister;
         std::vector<JumpTableEntry> entries;
+        uint32_t jumpAddress; // Address of the JR that dispatches through the table
+    };
+
+    // VU microcode uploaded from the ELF
+    struct VuMicroprogram
+    {
+        uint32_t address;     // Where the code is in the ELF
+        uint32_t size;        // Bytes, a multiple of 8
+        uint32_t loadAddress; // Bytes into micro memory
+        int32_t unit;         // 0 or 1, -1 when the upload does not say
     };
 
     // Control flow graph
@@ -152,6 +162,8 @@ namespace ps2recomp
         JumpTable jumpTable;
     };
 
+    using CFG = std::unordered_map<uint32_t, CFGNode>;
+
     // Function call
     struct FunctionCall
     {
@@ -169,6 +181,8 @@ namespace ps2recomp
         std::vector<std::string> skipFunctions;
         std::unordered_map<uint32_t, std::string> patches;
         std::vector<std::string> stubImplementations;
+        std::vector<JumpTable> jumpTables;
+        std::vector<VuMicroprogram> vuMicroprograms;
     };
 
 } // namespace ps2recomp
@@ -0,0 +1,55 @@
+#ifndef PS2RECOMP_VU_RECOMPILER_H
+#define PS2RECOMP_VU_RECOMPILER_H
+
+#include "ps2recomp/types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ps2recomp
+{
+    // Recompiles VU microprograms ahead of time into C++ that runs on the runtime's
+    // PS2VectorUnit. Each program becomes one function with a label per instruction and
+    // a switch for entering at any of them, so MSCAL, VCALLMS and JR can start anywhere
+    // in it. FMAC ops, loads and stores, integer ops, moves and branches are emitted as
+    // SSE code with their field masks and broadcasts resolved; the rest (FDIV, EFU, flag
+    // ops, XGKICK, CLIP) call back into the interpreter for that one instruction.
+    //
+    // The runtime only runs a program while micro memory still holds the same bytes, so
+    // every program is keyed by the FNV-1a hash of its code.
+    class VuRecompiler
+    {
+    public:
+        // Finds VIF MPG commands in ELF data and returns the microcode they upload.
+        // Uploads split over several MPGs of one DMA chain are joined. Only uploads that
+        // hold an E bit, and set no debug bits, are taken to be code.
+        static std::vector<VuMicroprogram> findMpgUploads(const uint8_t *data, uint32_t size, uint32_t address);
+
+        static uint64_t hashCode(const std::vector<uint8_t> &code);
+        static std::string functionName(const VuMicroprogram &program, uint64_t hash);
+
+        // code holds the program's bytes as they land in micro memory. A program already
+        // added with the same bytes and load address is skipped.
+        void addProgram(const VuMicroprogram &program, std::vector<uint8_t> code);
+        bool empty() const { return m_programs.empty(); }
+        size_t programCount() const { return m_programs.size(); }
+
+        std::string generateFunction(size_t index) const;
+        // Every program plus registerVuMicroprograms(PS2Runtime &), which hands them to the runtime
+        std::string generateOutput() const;
+
+    private:
+        struct Program
+        {
+            VuMicroprogram info;
+            std::vector<uint8_t> code;
+            uint64_t hash;
+        };
+
+        std::vector<Program> m_programs;
+
+        static bool canRunOnVu0(const Program &program);
+    };
+}
+
+#endif // PS2RECOMP_VU_RECOMPILER_H
@@ -0,0 +1,542 @@
+#include "ps2recomp/analysis_database.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ps2recomp
+{
+    static_assert(std::is_trivially_copyable_v<Instruction>, "Instruction is stored in the database as raw bytes");
+
+    namespace
+    {
+        constexpr uint64_t kTableAlignment = 16;
+
+        bool hashFile(const std::string &path, uint64_t &size, uint64_t &hash)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+            {
+                return false;
+            }
+
+            hash = 0xcbf29ce484222325ull;
+            size = 0;
+
+            std::vector<char> buffer(1 << 16);
+            while (file)
+            {
+                file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                std::streamsize count = file.gcount();
+                for (std::streamsize i = 0; i < count; i++)
+                {
+                    hash ^= static_cast<uint8_t>(buffer[i]);
+                    hash *= 0x100000001b3ull;
+                }
+                size += static_cast<uint64_t>(count);
+            }
+
+            return true;
+        }
+
+        uint64_t alignOffset(uint64_t offset)
+        {
+            return (offset + kTableAlignment - 1) & ~(kTableAlignment - 1);
+        }
+
+        template <typename T>
+        uint64_t appendTable(std::vector<uint8_t> &out, const std::vector<T> &table)
+        {
+            out.resize(alignOffset(out.size()), 0);
+            uint64_t offset = out.size();
+            if (!table.empty())
+            {
+                const auto *bytes = reinterpret_cast<const uint8_t *>(table.data());
+                out.insert(out.end(), bytes, bytes + table.size() * sizeof(T));
+            }
+            return offset;
+        }
+
+        uint32_t appendString(std::vector<char> &strings, const std::string &value)
+        {
+            uint32_t offset = static_cast<uint32_t>(strings.size());
+            strings.insert(strings.end(), value.begin(), value.end());
+            return offset;
+        }
+    }
+
+    AnalysisDatabase::AnalysisDatabase() = default;
+
+    AnalysisDatabase::~AnalysisDatabase()
+    {
+        close();
+    }
+
+    std::string AnalysisDatabase::pathForElf(const std::string &elfPath)
+    {
+        return elfPath + ".ps2xdb";
+    }
+
+    bool AnalysisDatabase::save(const std::string &dbPath, const std::string &elfPath, const AnalysisSnapshot &snapshot)
+    {
+        AnalysisDatabaseHeader header{};
+        std::memcpy(header.magic, kAnalysisDatabaseMagic, sizeof(header.magic));
+        header.version = kAnalysisDatabaseVersion;
+        header.instructionSize = sizeof(Instruction);
+
+        if (!hashFile(elfPath, header.elfSize, header.elfHash))
+        {
+            std::cerr << "Failed to hash ELF file for analysis database: " << elfPath << std::endl;
+            return false;
+        }
+
+        std::vector<uint32_t> starts;
+        starts.reserve(snapshot.decodedFunctions.size());
+        for (const auto &[start, instructions] : snapshot.decodedFunctions)
+        {
+            starts.push_back(start);
+        }
+        std::sort(starts.begin(), starts.end());
+
+        std::vector<DbFunction> functions;
+        std::vector<Instruction> instructions;
+        std::vector<DbCFGNode> cfgNodes;
+        std::vector<uint32_t> edges;
+        std::vector<DbJumpTable> jumpTables;
+        std::vector<JumpTableEntry> jumpTableEntries;
+        std::vector<DbFunctionCall> calls;
+        std::vector<char> strings;
+
+        for (uint32_t start : starts)
+        {
+            const auto &decoded = snapshot.decodedFunctions.at(start);
+
+            auto funcIt = std::find_if(snapshot.functions.begin(), snapshot.functions.end(),
+                                       [start](const Function &f)
+                                       { return f.start == start; });
+            if (funcIt == snapshot.functions.end())
+            {
+                continue;
+            }
+
+            DbFunction record{};
+            record.start = start;
+            record.end = funcIt->end;
+            record.nameOffset = appendString(strings, funcIt->name);
+            record.nameLength = static_cast<uint32_t>(funcIt->name.size());
+            record.firstInstruction = static_cast<uint32_t>(instructions.size());
+            record.instructionCount = static_cast<uint32_t>(decoded.size());
+            instructions.insert(instructions.end(), decoded.begin(), decoded.end());
+
+            record.firstCfgNode = static_cast<uint32_t>(cfgNodes.size());
+            auto cfgIt = snapshot.cfgs.find(start);
+            if (cfgIt != snapshot.cfgs.end())
+            {
+                std::unordered_map<uint32_t, uint32_t> indexByAddress;
+                for (uint32_t i = 0; i < decoded.size(); i++)
+                {
+                    indexByAddress[decoded[i].address] = i;
+                }
+
+                std::vector<const CFGNode *> nodes;
+                for (const auto &[address, node] : cfgIt->second)
+                {
+                    nodes.push_back(&node);
+                }
+                std::sort(nodes.begin(), nodes.end(), [](const CFGNode *a, const CFGNode *b)
+                          { return a->startAddress < b->startAddress; });
+
+                for (const CFGNode *node : nodes)
+                {
+                    DbCFGNode nodeRecord{};
+                    nodeRecord.startAddress = node->startAddress;
+                    nodeRecord.endAddress = node->endAddress;
+                    nodeRecord.isJumpTarget = node->isJumpTarget ? 1 : 0;
+
+                    if (!node->instructions.empty())
+                    {
+                        auto indexIt = indexByAddress.find(node->instructions.front().address);
+                        if (indexIt != indexByAddress.end())
+                        {
+                            nodeRecord.firstInstruction = indexIt->second;
+                            nodeRecord.instructionCount = static_cast<uint32_t>(node->instructions.size());
+                        }
+                    }
+
+                    nodeRecord.firstPredecessor = static_cast<uint32_t>(edges.size());
+                    nodeRecord.predecessorCount = static_cast<uint32_t>(node->predecessors.size());
+                    edges.insert(edges.end(), node->predecessors.begin(), node->predecessors.end());
+
+                    nodeRecord.firstSuccessor = static_cast<uint32_t>(edges.size());
+                    nodeRecord.successorCount = static_cast<uint32_t>(node->successors.size());
+                    edges.insert(edges.end(), node->successors.begin(), node->successors.end());
+
+                    cfgNodes.push_back(nodeRecord);
+                }
+            }
+            record.cfgNodeCount = static_cast<uint32_t>(cfgNodes.size()) - record.firstCfgNode;
+
+            record.firstCall = static_cast<uint32_t>(calls.size());
+            auto callsIt = snapshot.functionCalls.find(start);
+            if (callsIt != snapshot.functionCalls.end())
+            {
+                for (const auto &call : callsIt->second)
+                {
+                    DbFunctionCall callRecord{};
+                    callRecord.callerAddress = call.callerAddress;
+                    callRecord.calleeAddress = call.calleeAddress;
+                    callRecord.nameOffset = appendString(strings, call.calleeName);
+                    callRecord.nameLength = static_cast<uint32_t>(call.calleeName.size());
+                    calls.push_back(callRecord);
+                }
+            }
+            record.callCount = static_cast<uint32_t>(calls.size()) - record.firstCall;
+
+            functions.push_back(record);
+        }
+
+        for (const auto &jumpTable : snapshot.jumpTables)
+        {
+            DbJumpTable tableRecord{};
+            tableRecord.address = jumpTable.address;
+            tableRecord.baseRegister = jumpTable.baseRegister;
+            tableRecord.jumpAddress = jumpTable.jumpAddress;
+            tableRecord.firstEntry = static_cast<uint32_t>(jumpTableEntries.size());
+            tableRecord.entryCount = static_cast<uint32_t>(jumpTable.entries.size());
+            jumpTableEntries.insert(jumpTableEntries.end(), jumpTable.entries.begin(), jumpTable.entries.end());
+            jumpTables.push_back(tableRecord);
+        }
+
+        header.functionCount = static_cast<uint32_t>(functions.size());
+        header.instructionCount = static_cast<uint32_t>(instructions.size());
+        header.cfgNodeCount = static_cast<uint32_t>(cfgNodes.size());
+        header.edgeCount = static_cast<uint32_t>(edges.size());
+        header.jumpTableCount = static_cast<uint32_t>(jumpTables.size());
+        header.jumpTableEntryCount = static_cast<uint32_t>(jumpTableEntries.size());
+        header.callCount = static_cast<uint32_t>(calls.size());
+        header.stringBytes = static_cast<uint32_t>(strings.size());
+
+        std::vector<uint8_t> out(sizeof(AnalysisDatabaseHeader), 0);
+        header.functionsOffset = appendTable(out, functions);
+        header.instructionsOffset = appendTable(out, instructions);
+        header.cfgNodesOffset = appendTable(out, cfgNodes);
+        header.edgesOffset = appendTable(out, edges);
+        header.jumpTablesOffset = appendTable(out, jumpTables);
+        header.jumpTableEntriesOffset = appendTable(out, jumpTableEntries);
+        header.callsOffset = appendTable(out, calls);
+        header.stringsOffset = appendTable(out, strings);
+        std::memcpy(out.data(), &header, sizeof(header));
+
+        std::ofstream file(dbPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "Failed to open analysis database for writing: " << dbPath << std::endl;
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()));
+        return static_cast<bool>(file);
+    }
+
+    bool AnalysisDatabase::open(const std::string &dbPath, const std::string &elfPath)
+    {
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(dbPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(AnalysisDatabaseHeader)))
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        m_fileHandle = file;
+        m_mappingHandle = mapping;
+        m_data = static_cast<const uint8_t *>(view);
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(dbPath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(AnalysisDatabaseHeader)))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        m_fd = fd;
+        m_data = static_cast<const uint8_t *>(view);
+        m_size = static_cast<size_t>(st.st_size);
+#endif
+
+        m_header = reinterpret_cast<const AnalysisDatabaseHeader *>(m_data);
+        if (!validate(elfPath))
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void AnalysisDatabase::close()
+    {
+#ifdef _WIN32
+        if (m_data)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mappingHandle)
+        {
+            CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+        }
+        if (m_fileHandle)
+        {
+            CloseHandle(static_cast<HANDLE>(m_fileHandle));
+        }
+        m_fileHandle = nullptr;
+        m_mappingHandle = nullptr;
+#else
+        if (m_data)
+        {
+            munmap(const_cast<uint8_t *>(m_data), m_size);
+        }
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+        }
+        m_fd = -1;
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_header = nullptr;
+    }
+
+    bool AnalysisDatabase::validate(const std::string &elfPath) const
+    {
+        const AnalysisDatabaseHeader &header = *m_header;
+
+        if (std::memcmp(header.magic, kAnalysisDatabaseMagic, sizeof(header.magic)) != 0 ||
+            header.version != kAnalysisDatabaseVersion ||
+            header.instructionSize != sizeof(Instruction))
+        {
+            std::cout << "Analysis database has an incompatible format, ignoring it" << std::endl;
+            return false;
+        }
+
+        auto fits = [this](uint64_t offset, uint64_t count, uint64_t recordSize)
+        {
+            return offset % kTableAlignment == 0 && offset <= m_size && count * recordSize <= m_size - offset;
+        };
+
+        if (!fits(header.functionsOffset, header.functionCount, sizeof(DbFunction)) ||
+            !fits(header.instructionsOffset, header.instructionCount, sizeof(Instruction)) ||
+            !fits(header.cfgNodesOffset, header.cfgNodeCount, sizeof(DbCFGNode)) ||
+            !fits(header.edgesOffset, header.edgeCount, sizeof(uint32_t)) ||
+            !fits(header.jumpTablesOffset, header.jumpTableCount, sizeof(DbJumpTable)) ||
+            !fits(header.jumpTableEntriesOffset, header.jumpTableEntryCount, sizeof(JumpTableEntry)) ||
+            !fits(header.callsOffset, header.callCount, sizeof(DbFunctionCall)) ||
+            !fits(header.stringsOffset, header.stringBytes, 1))
+        {
+            std::cout << "Analysis database is truncated, ignoring it" << std::endl;
+            return false;
+        }
+
+        uint64_t elfSize = 0;
+        uint64_t elfHash = 0;
+        if (!hashFile(elfPath, elfSize, elfHash) || elfSize != header.elfSize || elfHash != header.elfHash)
+        {
+            std::cout << "Analysis database was built from a different ELF, ignoring it" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    std::span<const DbFunction> AnalysisDatabase::functions() const
+    {
+        if (!m_header)
+        {
+            return {};
+        }
+        return {table<DbFunction>(m_header->functionsOffset), m_header->functionCount};
+    }
+
+    const DbFunction *AnalysisDatabase::findFunction(uint32_t start) const
+    {
+        auto all = functions();
+        auto it = std::lower_bound(all.begin(), all.end(), start, [](const DbFunction &f, uint32_t value)
+                                   { return f.start < value; });
+        if (it == all.end() || it->start != start)
+        {
+            return nullptr;
+        }
+        return &*it;
+    }
+
+    std::string_view AnalysisDatabase::string(uint32_t offset, uint32_t length) const
+    {
+        if (static_cast<uint64_t>(offset) + length > m_header->stringBytes)
+        {
+            return {};
+        }
+        return {table<char>(m_header->stringsOffset) + offset, length};
+    }
+
+    std::string_view AnalysisDatabase::functionName(const DbFunction &function) const
+    {
+        return string(function.nameOffset, function.nameLength);
+    }
+
+    std::span<const Instruction> AnalysisDatabase::instructions(const DbFunction &function) const
+    {
+        if (static_cast<uint64_t>(function.firstInstruction) + function.instructionCount > m_header->instructionCount)
+        {
+            return {};
+        }
+        return {table<Instruction>(m_header->instructionsOffset) + function.firstInstruction, function.instructionCount};
+    }
+
+    CFG AnalysisDatabase::loadCFG(const DbFunction &function) const
+    {
+        CFG cfg;
+        if (static_cast<uint64_t>(function.firstCfgNode) + function.cfgNodeCount > m_header->cfgNodeCount)
+        {
+            return cfg;
+        }
+
+        auto code = instructions(function);
+        const DbCFGNode *nodes = table<DbCFGNode>(m_header->cfgNodesOffset) + function.firstCfgNode;
+        const uint32_t *edges = table<uint32_t>(m_header->edgesOffset);
+
+        auto edgeRange = [&](uint32_t first, uint32_t count)
+        {
+            if (static_cast<uint64_t>(first) + count > m_header->edgeCount)
+            {
+                return std::vector<uint32_t>();
+            }
+            return std::vector<uint32_t>(edges + first, edges + first + count);
+        };
+
+        for (uint32_t i = 0; i < function.cfgNodeCount; i++)
+        {
+            const DbCFGNode &record = nodes[i];
+
+            CFGNode node{};
+            node.startAddress = record.startAddress;
+            node.endAddress = record.endAddress;
+            node.isJumpTarget = record.isJumpTarget != 0;
+            node.hasJumpTable = false;
+
+            if (static_cast<uint64_t>(record.firstInstruction) + record.instructionCount <= code.size())
+            {
+                node.instructions.assign(code.begin() + record.firstInstruction,
+                                         code.begin() + record.firstInstruction + record.instructionCount);
+            }
+
+            node.predecessors = edgeRange(record.firstPredecessor, record.predecessorCount);
+            node.successors = edgeRange(record.firstSuccessor, record.successorCount);
+
+            cfg[node.startAddress] = std::move(node);
+        }
+
+        return cfg;
+    }
+
+    std::vector<FunctionCall> AnalysisDatabase::loadCalls(const DbFunction &function) const
+    {
+        std::vector<FunctionCall> calls;
+        if (static_cast<uint64_t>(function.firstCall) + function.callCount > m_header->callCount)
+        {
+            return calls;
+        }
+
+        const DbFunctionCall *records = table<DbFunctionCall>(m_header->callsOffset) + function.firstCall;
+        calls.reserve(function.callCount);
+        for (uint32_t i = 0; i < function.callCount; i++)
+        {
+            FunctionCall call;
+            call.callerAddress = records[i].callerAddress;
+            call.calleeAddress = records[i].calleeAddress;
+            call.calleeName = std::string(string(records[i].nameOffset, records[i].nameLength));
+            calls.push_back(std::move(call));
+        }
+
+        return calls;
+    }
+
+    std::vector<JumpTable> AnalysisDatabase::loadJumpTables() const
+    {
+        std::vector<JumpTable> jumpTables;
+        if (!m_header)
+        {
+            return jumpTables;
+        }
+
+        const DbJumpTable *records = table<DbJumpTable>(m_header->jumpTablesOffset);
+        const JumpTableEntry *entries = table<JumpTableEntry>(m_header->jumpTableEntriesOffset);
+
+        jumpTables.reserve(m_header->jumpTableCount);
+        for (uint32_t i = 0; i < m_header->jumpTableCount; i++)
+        {
+            const DbJumpTable &record = records[i];
+            if (static_cast<uint64_t>(record.firstEntry) + record.entryCount > m_header->jumpTableEntryCount)
+            {
+                continue;
+            }
+
+            JumpTable jumpTable;
+            jumpTable.address = record.address;
+            jumpTable.baseRegister = record.baseRegister;
+            jumpTable.jumpAddress = record.jumpAddress;
+            jumpTable.entries.assign(entries + record.firstEntry, entries + record.firstEntry + record.entryCount);
+            jumpTables.push_back(std::move(jumpTable));
+        }
+
+        return jumpTables;
+    }
+}
@@ -45,6 +45,18 @@ namespace ps2recomp
         m_bootstrapInfo = info;
     }
 
+    void CodeGenerator::setJumpTables(const std::vector<JumpTable> &jumpTables)
+    {
+        m_jumpTables.clear();
+        for (const auto &jumpTable : jumpTables)
+        {
+            if (jumpTable.jumpAddress != 0 && !jumpTable.entries.empty())
+            {
+                m_jumpTables[jumpTable.jumpAddress] = jumpTable;
+            }
+        }
+    }
+
     std::string CodeGenerator::getFunctionName(uint32_t address)
     {
         auto it = m_renamedFunctions.find(address);
@@ -151,6 +163,15 @@ namespace ps2recomp
                 ss << "    SET_GPR_U32(ctx, " << static_cast<int>(link_reg) << ", 0x" << std::hex << (branchInst.address + 8) << ");\n"
                    << std::dec;
             }
+
+            auto tableIt = (link_reg == 0) ? m_jumpTables.find(branchInst.address) : m_jumpTables.end();
+            if (tableIt != m_jumpTables.end())
+            {
+                ss << generateJumpTableSwitch(branchInst, tableIt->second.address, tableIt->second.entries,
+                                              internalTargets, delaySlotCode);
+                return ss.str();
+            }
+
             if (hasValidDelaySlot)
             {
                 ss << "    " << delaySlotCode << "\n";
@@ -264,7 +285,10 @@ namespace ps2recomp
             }
             else if (isInternalTarget)
             {
-                targetAction = fmt::format("goto label_{:x};", target);
+                // Backward branches close loops; give a spinning thread a chance to take interrupts
+                targetAction = target <= branchInst.address
+                                   ? fmt::format("runtime->loopSafePoint(); goto label_{:x};", target)
+                                   : fmt::format("goto label_{:x};", target);
             }
             else
             {
@@ -350,6 +374,23 @@ namespace ps2recomp
                     }
                 }
             }
+            else if (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_JR)
+            {
+                auto tableIt = m_jumpTables.find(inst.address);
+                if (tableIt == m_jumpTables.end())
+                {
+                    continue;
+                }
+
+                for (const auto &entry : tableIt->second.entries)
+                {
+                    if (entry.target >= function.start && entry.target < function.end &&
+                        getFunctionName(entry.target).empty())
+                    {
+                        targets.insert(entry.target);
+                    }
+                }
+            }
         }
 
         return targets;
@@ -363,15 +404,16 @@ namespace ps2recomp
             "FlushCache", "ResetEE", "SetMemoryMode",
             "CreateThread", "DeleteThread", "StartThread", "ExitThread", "ExitDeleteThread",
             "TerminateThread", "SuspendThread", "ResumeThread", "GetThreadId", "ReferThreadStatus",
-            "SleepThread", "WakeupThread", "iWakeupThread", "ChangeThreadPriority",
-            "RotateThreadReadyQueue", "ReleaseWaitThread", "iReleaseWaitThread",
+            "SleepThread", "WakeupThread", "iWakeupThread", "CancelWakeupThread", "iCancelWakeupThread",
+            "ChangeThreadPriority", "RotateThreadReadyQueue", "ReleaseWaitThread", "iReleaseWaitThread",
             "CreateSema", "DeleteSema", "SignalSema", "iSignalSema", "WaitSema", "PollSema",
             "iPollSema", "ReferSemaStatus", "iReferSemaStatus", "CreateEventFlag",
             "DeleteEventFlag", "SetEventFlag", "iSetEventFlag", "ClearEventFlag",
             "iClearEventFlag", "WaitEventFlag", "PollEventFlag", "iPollEventFlag",
             "ReferEventFlagStatus", "iReferEventFlagStatus", "SetAlarm", "iSetAlarm",
-            "CancelAlarm", "iCancelAlarm", "EnableIntc", "DisableIntc", "EnableDmac",
-            "DisableDmac", "SifStopModule", "SifLoadModule", "SifInitRpc", "SifBindRpc",
+            "CancelAlarm", "iCancelAlarm", "AddIntcHandler", "AddIntcHandler2", "RemoveIntcHandler",
+            "AddDmacHandler", "AddDmacHandler2", "RemoveDmacHandler", "EnableIntc", "iEnableIntc",
+            "DisableIntc", "iDisableIntc", "EnableDmac", "iEnableDmac", "DisableDmac", "iDisableDmac", "SifStopModule", "SifLoadModule", "SifInitRpc", "SifBindRpc",
             "SifCallRpc", "SifRegisterRpc", "SifCheckStatRpc", "SifSetRpcQueue",
             "SifRemoveRpcQueue", "SifRemoveRpc", "fioOpen", "fioClose", "fioRead", "fioWrite",
             "fioLseek", "fioMkdir", "fioChdir", "fioRmdir", "fioGetstat", "fioRemove",
@@ -840,7 +882,7 @@ namespace ps2recomp
             case COP0_REG_BADVADDR:
                 return fmt::format("SET_GPR_U32(ctx, {}, ctx->cop0_badvaddr);", rt);
             case COP0_REG_COUNT:
-                return fmt::format("SET_GPR_U32(ctx, {}, ctx->cop0_count);", rt);
+                return fmt::format("SET_GPR_U32(ctx, {}, runtime->readCop0Count(ctx));", rt);
             case COP0_REG_ENTRYHI:
                 return fmt::format("SET_GPR_U32(ctx, {}, ctx->cop0_entryhi);", rt);
             case COP0_REG_COMPARE:
@@ -890,7 +932,7 @@ namespace ps2recomp
             case COP0_REG_BADVADDR:
                 return "// MTC0 to BADVADDR register ignored (read-only)";
             case COP0_REG_COUNT:
-                return fmt::format("ctx->cop0_count = GPR_U32(ctx, {});", rt);
+                return fmt::format("runtime->writeCop0Count(ctx, GPR_U32(ctx, {}));", rt);
             case COP0_REG_ENTRYHI:
                 return fmt::format("ctx->cop0_entryhi = GPR_U32(ctx, {}) & 0xC00000FF;", rt);
             case COP0_REG_COMPARE:
@@ -2196,7 +2238,8 @@ namespace ps2recomp
     }
 
     std::string CodeGenerator::generateFunctionRegistration(const std::vector<Function> &functions,
-                                                            const std::map<uint32_t, std::string> &stubs)
+                                                            const std::map<uint32_t, std::string> &stubs,
+                                                            bool registerVuMicroprograms)
     {
         std::stringstream ss;
 
@@ -2209,6 +2252,11 @@ namespace ps2recomp
         ss << "#include \"ps2_recompiled_stubs.h\"//this will give duplicated erros because runtime maybe has it define already, just delete the TODOS ones\n";
         ss << "#include \"ps2_syscalls.h\"\n\n";
 
+        if (registerVuMicroprograms)
+        {
+            ss << "void registerVuMicroprograms(PS2Runtime &runtime); // ps2_vu_microprograms.cpp\n\n";
+        }
+
         // Registration function
         ss << "void registerAllFunctions(PS2Runtime& runtime) {\n";
 
@@ -2272,42 +2320,89 @@ namespace ps2recomp
                << ", " << function.second << ");\n";
         }
 
+        if (registerVuMicroprograms)
+        {
+            ss << "\n    // Register recompiled VU microprograms\n";
+            ss << "    registerVuMicroprograms(runtime);\n";
+        }
+
         ss << "}\n";
 
         return ss.str();
     }
 
     std::string CodeGenerator::generateJumpTableSwitch(const Instruction &inst, uint32_t tableAddress,
-                                                       const std::vector<JumpTableEntry> &entries)
+                                                       const std::vector<JumpTableEntry> &entries,
+                                                       const std::unordered_set<uint32_t> &internalTargets,
+                                                       const std::string &delaySlotCode)
     {
         std::stringstream ss;
 
-        uint32_t indexReg = inst.rs;
-
-        ss << "switch (ctx->r[" << indexReg << "]) {\n";
-
+        // Cases are keyed on the loaded target rather than the table index, since the index
+        // register is usually scaled or clobbered by the time the JR executes. Several indices
+        // can share a target, so keep one case per target in address order.
+        std::map<uint32_t, std::vector<uint32_t>> indicesByTarget;
         for (const auto &entry : entries)
         {
-            ss << "    case " << entry.index << ": {\n";
-
-            std::string funcName = getFunctionName(entry.target);
-            if (!funcName.empty())
+            if ((entry.target & 3) == 0)
             {
-                ss << "        " << funcName << "(rdram, ctx, runtime);\n";
+                indicesByTarget[entry.target].push_back(entry.index);
             }
-            else
+        }
+
+        ss << "    {\n";
+        ss << "        // Jump table at 0x" << std::hex << tableAddress << std::dec << "\n";
+        ss << "        const uint32_t jumpTarget = GPR_U32(ctx, " << static_cast<int>(inst.rs) << ");\n";
+        if (!delaySlotCode.empty())
+        {
+            ss << "        " << delaySlotCode << "\n";
+        }
+
+        if (!indicesByTarget.empty())
+        {
+            uint32_t low = indicesByTarget.begin()->first;
+            uint32_t high = indicesByTarget.rbegin()->first;
+
+            ss << std::hex;
+            ss << "        if (jumpTarget >= 0x" << low << " && jumpTarget <= 0x" << high << " && (jumpTarget & 3) == 0) {\n";
+            ss << "            switch ((jumpTarget - 0x" << low << ") >> 2) {\n";
+
+            for (const auto &[target, indices] : indicesByTarget)
             {
-                ss << "        func_" << std::hex << entry.target << std::dec << "(rdram, ctx,  runtime);\n";
+                ss << "            case 0x" << ((target - low) >> 2) << ": // index" << std::dec;
+                for (uint32_t index : indices)
+                {
+                    ss << " " << index;
+                }
+                ss << std::hex << "\n";
+
+                std::string funcName = getFunctionName(target);
+                if (internalTargets.contains(target))
+                {
+                    ss << "                goto label_" << target << ";\n";
+                }
+                else if (!funcName.empty())
+                {
+                    ss << "                " << funcName << "(rdram, ctx, runtime);\n";
+                    ss << "                return;\n";
+                }
+                else
+                {
+                    ss << "                ctx->pc = 0x" << target << ";\n";
+                    ss << "                return;\n";
+                }
             }
 
-            ss << "        return;\n";
-            ss << "    }\n";
+            ss << "            default:\n";
+            ss << "                break;\n";
+            ss << "            }\n";
+            ss << "        }\n";
+            ss << std::dec;
         }
 
-        ss << "    default:\n";
-        ss << "        // Unknown jump table target\n";
-        ss << "        return;\n";
-        ss << "}\n";
+        ss << "        // Target not in the recovered table\n";
+        ss << "        ctx->pc = jumpTarget; return;\n";
+        ss << "    }\n";
 
         return ss.str();
     }
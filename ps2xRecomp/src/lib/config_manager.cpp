@@ -48,6 +48,59 @@ namespace ps2recomp
                     }
                 }
             }
+
+            if (data.contains("jump_tables") && data.at("jump_tables").is_table())
+            {
+                const auto &jumpTables = toml::find(data, "jump_tables");
+
+                if (jumpTables.contains("table") && jumpTables.at("table").is_array())
+                {
+                    for (const auto &table : toml::find(jumpTables, "table").as_array())
+                    {
+                        if (!table.contains("address") || !table.contains("jump_address") || !table.contains("entries"))
+                        {
+                            continue;
+                        }
+
+                        JumpTable jumpTable{};
+                        jumpTable.address = std::stoul(toml::find<std::string>(table, "address"), nullptr, 0);
+                        jumpTable.jumpAddress = std::stoul(toml::find<std::string>(table, "jump_address"), nullptr, 0);
+
+                        for (const auto &entry : toml::find(table, "entries").as_array())
+                        {
+                            JumpTableEntry jumpEntry;
+                            jumpEntry.index = toml::find<uint32_t>(entry, "index");
+                            jumpEntry.target = std::stoul(toml::find<std::string>(entry, "target"), nullptr, 0);
+                            jumpTable.entries.push_back(jumpEntry);
+                        }
+
+                        config.jumpTables.push_back(jumpTable);
+                    }
+                }
+            }
+
+            if (data.contains("vu_microcode") && data.at("vu_microcode").is_table())
+            {
+                const auto &vuMicrocode = toml::find(data, "vu_microcode");
+
+                if (vuMicrocode.contains("program") && vuMicrocode.at("program").is_array())
+                {
+                    for (const auto &program : toml::find(vuMicrocode, "program").as_array())
+                    {
+                        if (!program.contains("address") || !program.contains("size") || !program.contains("load_address"))
+                        {
+                            continue;
+                        }
+
+                        VuMicroprogram microprogram{};
+                        microprogram.address = std::stoul(toml::find<std::string>(program, "address"), nullptr, 0);
+                        microprogram.size = std::stoul(toml::find<std::string>(program, "size"), nullptr, 0);
+                        microprogram.loadAddress = std::stoul(toml::find<std::string>(program, "load_address"), nullptr, 0);
+                        microprogram.unit = program.contains("unit") ? toml::find<int32_t>(program, "unit") : -1;
+                        config.vuMicroprograms.push_back(microprogram);
+                    }
+                }
+            }
         }
         catch (const std::exception &e)
         {
@@ -71,6 +71,12 @@ namespace ps2recomp
                 return false;
             }
 
+            std::string dbPath = AnalysisDatabase::pathForElf(m_config.inputPath);
+            if (m_analysisDatabase.open(dbPath, m_config.inputPath))
+            {
+                std::cout << "Using analysis database: " << dbPath << std::endl;
+            }
+
             m_functions = m_elfParser->extractFunctions();
             m_symbols = m_elfParser->extractSymbols();
             m_sections = m_elfParser->getSections();
@@ -164,6 +170,20 @@ namespace ps2recomp
             m_codeGenerator = std::make_unique<CodeGenerator>(m_symbols);
             m_codeGenerator->setBootstrapInfo(m_bootstrapInfo);
 
+            // Tables listed in the config take precedence over the ones the analyzer cached
+            std::vector<JumpTable> jumpTables = m_config.jumpTables;
+            if (jumpTables.empty() && m_analysisDatabase.isOpen())
+            {
+                jumpTables = m_analysisDatabase.loadJumpTables();
+            }
+            if (!jumpTables.empty())
+            {
+                m_codeGenerator->setJumpTables(jumpTables);
+                std::cout << "Using " << jumpTables.size() << " recovered jump tables" << std::endl;
+            }
+
+            collectVuMicroprograms();
+
             fs::create_directories(m_config.outputPath);
 
             return true;
@@ -405,7 +425,15 @@ namespace ps2recomp
                 std::cout << "Wrote individual function files to: " << m_config.outputPath << std::endl;
             }
 
-            std::string registerFunctions = m_codeGenerator->generateFunctionRegistration(m_functions, m_generatedStubs);
+            if (!m_vuRecompiler.empty())
+            {
+                fs::path vuPath = fs::path(m_config.outputPath) / "ps2_vu_microprograms.cpp";
+                writeToFile(vuPath.string(), m_vuRecompiler.generateOutput());
+                std::cout << "Wrote " << m_vuRecompiler.programCount() << " VU microprograms to: " << vuPath << std::endl;
+            }
+
+            std::string registerFunctions = m_codeGenerator->generateFunctionRegistration(m_functions, m_generatedStubs,
+                                                                                          !m_vuRecompiler.empty());
 
             fs::path registerPath = fs::path(m_config.outputPath) / "register_functions.cpp";
             writeToFile(registerPath.string(), registerFunctions);
@@ -634,8 +662,92 @@ namespace ps2recomp
         }
     }
 
+    void PS2Recompiler::collectVuMicroprograms()
+    {
+        // Programs listed in the config take precedence over scanning the ELF for VIF MPG uploads
+        std::vector<VuMicroprogram> programs = m_config.vuMicroprograms;
+        if (programs.empty())
+        {
+            for (const auto &section : m_sections)
+            {
+                if (section.isBSS || !section.data || section.size == 0)
+                {
+                    continue;
+                }
+                std::vector<VuMicroprogram> found = VuRecompiler::findMpgUploads(section.data, section.size, section.address);
+                programs.insert(programs.end(), found.begin(), found.end());
+            }
+        }
+
+        for (const auto &program : programs)
+        {
+            const Section *source = nullptr;
+            for (const auto &section : m_sections)
+            {
+                if (!section.isBSS && section.data && program.address >= section.address &&
+                    program.address - section.address + program.size <= section.size)
+                {
+                    source = &section;
+                    break;
+                }
+            }
+            if (!source || program.size == 0 || program.size % 8 != 0)
+            {
+                std::cerr << "Skipping VU microprogram at 0x" << std::hex << program.address << std::dec
+                          << ": not a whole program inside the ELF's data" << std::endl;
+                continue;
+            }
+
+            const uint8_t *code = source->data + (program.address - source->address);
+            m_vuRecompiler.addProgram(program, std::vector<uint8_t>(code, code + program.size));
+        }
+
+        if (!m_vuRecompiler.empty())
+        {
+            std::cout << "Recompiling " << m_vuRecompiler.programCount() << " VU microprograms" << std::endl;
+        }
+    }
+
+    bool PS2Recompiler::loadDecodedFunction(const Function &function)
+    {
+        if (!m_analysisDatabase.isOpen())
+        {
+            return false;
+        }
+
+        const DbFunction *cached = m_analysisDatabase.findFunction(function.start);
+        if (!cached || cached->end != function.end ||
+            cached->instructionCount != (function.end - function.start) / 4)
+        {
+            return false;
+        }
+
+        auto cachedInstructions = m_analysisDatabase.instructions(*cached);
+        std::vector<Instruction> instructions(cachedInstructions.begin(), cachedInstructions.end());
+
+        // The database holds the unpatched code, so re-decode patched words only
+        for (auto &inst : instructions)
+        {
+            auto patchIt = m_config.patches.find(inst.address);
+            if (patchIt != m_config.patches.end())
+            {
+                uint32_t rawInstruction = std::stoul(patchIt->second, nullptr, 0);
+                inst = m_decoder->decodeInstruction(inst.address, rawInstruction);
+                std::cout << "Applied patch at 0x" << std::hex << inst.address << std::dec << std::endl;
+            }
+        }
+
+        m_decodedFunctions[function.start] = std::move(instructions);
+        return true;
+    }
+
     bool PS2Recompiler::decodeFunction(Function &function)
     {
+        if (loadDecodedFunction(function))
+        {
+            return true;
+        }
+
         std::vector<Instruction> instructions;
 
         uint32_t start = function.start;
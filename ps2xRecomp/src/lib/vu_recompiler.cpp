@@ -0,0 +1,764 @@
+#include "ps2recomp/vu_recompiler.h"
+#include "ps2_vu_microcode.h"
+#include <fmt/format.h>
+#include <cstring>
+#include <sstream>
+
+namespace ps2recomp
+{
+    namespace
+    {
+        constexpr uint32_t kVifMpg = 0x4A;
+        constexpr uint32_t kVu0CodeSize = 4 * 1024;
+        constexpr uint32_t kVu1CodeSize = 16 * 1024;
+
+        // Upper word flag bits
+        constexpr uint32_t kUpperI = 0x80000000u;
+        constexpr uint32_t kUpperE = 0x40000000u;
+        constexpr uint32_t kUpperDebug = 0x18000000u; // D and T, which shipped code leaves clear
+
+        enum FmacOp
+        {
+            OP_NONE,
+            OP_ADD,
+            OP_SUB,
+            OP_MADD,
+            OP_MSUB,
+            OP_MAX,
+            OP_MINI,
+            OP_MUL,
+            OP_OPMSUB,
+            OP_OPMULA,
+        };
+
+        enum Operand
+        {
+            OPERAND_BROADCAST,
+            OPERAND_FULL,
+            OPERAND_Q,
+            OPERAND_I,
+        };
+
+        uint32_t load32(const uint8_t *p)
+        {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        int32_t signExtend(uint32_t value, int bits)
+        {
+            const uint32_t shift = 32 - bits;
+            return static_cast<int32_t>(value << shift) >> shift;
+        }
+
+        uint32_t lowerSpecial(uint32_t lower)
+        {
+            return ((lower >> 4) & 0x7C) | (lower & 3);
+        }
+
+        bool isBranch(uint32_t lower)
+        {
+            if (lower & 0x80000000u)
+            {
+                return false;
+            }
+            switch (lower >> 25)
+            {
+            case 0x20: case 0x21: case 0x24: case 0x25:
+            case 0x28: case 0x29: case 0x2C: case 0x2D: case 0x2E: case 0x2F:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        bool isRegisterJump(uint32_t lower)
+        {
+            return isBranch(lower) && ((lower >> 25) == 0x24 || (lower >> 25) == 0x25);
+        }
+
+        bool isXgkick(uint32_t lower)
+        {
+            return (lower & 0x80000000u) && (lower & 0x3C) == 0x3C && lowerSpecial(lower) == 0x6C;
+        }
+
+        uint32_t branchTarget(uint32_t lower, uint32_t pc)
+        {
+            return pc + 8 + static_cast<uint32_t>(signExtend(lower & 0x7FF, 11) * 8);
+        }
+
+        std::string label(uint32_t pc)
+        {
+            return fmt::format("pc_{:04X}", pc);
+        }
+
+        std::string loadVf(int reg)
+        {
+            return fmt::format("_mm_load_ps(regs.vf[{}])", reg);
+        }
+
+        std::string dataPointer(const std::string &qword)
+        {
+            return fmt::format("reinterpret_cast<float *>(vu.dataQword(static_cast<uint32_t>({})))", qword);
+        }
+
+        // VF0 is read-only and an empty dest writes nothing
+        std::string storeVf(int reg, uint32_t dest, const std::string &value)
+        {
+            if (reg == 0 || dest == 0)
+            {
+                return "";
+            }
+            if (dest == 0xF)
+            {
+                return fmt::format("        _mm_store_ps(regs.vf[{}], {});\n", reg, value);
+            }
+            return fmt::format("        _mm_store_ps(regs.vf[{0}], ps2_vu::blend(_mm_load_ps(regs.vf[{0}]), {1}, ps2_vu::laneMask(0x{2:X})));\n",
+                               reg, value, dest);
+        }
+
+        std::string storeAcc(uint32_t dest, const std::string &value)
+        {
+            if (dest == 0xF)
+            {
+                return fmt::format("        _mm_store_ps(regs.acc, {});\n", value);
+            }
+            return fmt::format("        _mm_store_ps(regs.acc, ps2_vu::blend(_mm_load_ps(regs.acc), {}, ps2_vu::laneMask(0x{:X})));\n",
+                               value, dest);
+        }
+
+        std::string storeQword(const std::string &qword, uint32_t dest, int reg)
+        {
+            if (dest == 0)
+            {
+                return "";
+            }
+            if (dest == 0xF)
+            {
+                return fmt::format("        _mm_storeu_ps({}, {});\n", dataPointer(qword), loadVf(reg));
+            }
+            return fmt::format("        {{\n"
+                               "            float *out = {};\n"
+                               "            _mm_storeu_ps(out, ps2_vu::blend(_mm_loadu_ps(out), {}, ps2_vu::laneMask(0x{:X})));\n"
+                               "        }}\n",
+                               dataPointer(qword), loadVf(reg), dest);
+        }
+
+        // VI fields are five bits wide, but there are only 16 integer registers
+        std::string vi(int reg)
+        {
+            return fmt::format("regs.vi[{}]", reg & 15);
+        }
+
+        std::string setVi(int reg, const std::string &value)
+        {
+            if ((reg & 15) == 0)
+            {
+                return "";
+            }
+            return fmt::format("        {} = static_cast<uint16_t>({});\n", vi(reg), value);
+        }
+
+        // Code for the upper op: `compute` runs before the lower op, `commit` after it
+        struct UpperCode
+        {
+            std::string compute;
+            std::string commit;
+        };
+
+        UpperCode delegateUpper(uint32_t upper)
+        {
+            return {fmt::format("        vu.executeUpper(0x{:08X}u);\n", upper), "        vu.commitUpper();\n"};
+        }
+
+        UpperCode translateUpper(uint32_t upper)
+        {
+            const uint32_t dest = (upper >> 21) & 0xF;
+            const int ft = (upper >> 16) & 0x1F;
+            const int fs = (upper >> 11) & 0x1F;
+            const int fd = (upper >> 6) & 0x1F;
+            const uint32_t bc = upper & 3;
+            const uint32_t op = upper & 0x3F;
+
+            FmacOp fmac = OP_NONE;
+            Operand operand = OPERAND_FULL;
+            bool toAcc = false;
+            int target = fd;
+
+            if (op < 0x1C)
+            {
+                static constexpr FmacOp kBroadcastOps[7] = {OP_ADD, OP_SUB, OP_MADD, OP_MSUB, OP_MAX, OP_MINI, OP_MUL};
+                fmac = kBroadcastOps[op >> 2];
+                operand = OPERAND_BROADCAST;
+            }
+            else if (op < 0x3C)
+            {
+                switch (op)
+                {
+                case 0x1C: fmac = OP_MUL; operand = OPERAND_Q; break;
+                case 0x1D: fmac = OP_MAX; operand = OPERAND_I; break;
+                case 0x1E: fmac = OP_MUL; operand = OPERAND_I; break;
+                case 0x1F: fmac = OP_MINI; operand = OPERAND_I; break;
+                case 0x20: fmac = OP_ADD; operand = OPERAND_Q; break;
+                case 0x21: fmac = OP_MADD; operand = OPERAND_Q; break;
+                case 0x22: fmac = OP_ADD; operand = OPERAND_I; break;
+                case 0x23: fmac = OP_MADD; operand = OPERAND_I; break;
+                case 0x24: fmac = OP_SUB; operand = OPERAND_Q; break;
+                case 0x25: fmac = OP_MSUB; operand = OPERAND_Q; break;
+                case 0x26: fmac = OP_SUB; operand = OPERAND_I; break;
+                case 0x27: fmac = OP_MSUB; operand = OPERAND_I; break;
+                case 0x28: fmac = OP_ADD; break;
+                case 0x29: fmac = OP_MADD; break;
+                case 0x2A: fmac = OP_MUL; break;
+                case 0x2B: fmac = OP_MAX; break;
+                case 0x2C: fmac = OP_SUB; break;
+                case 0x2D: fmac = OP_MSUB; break;
+                case 0x2E: fmac = OP_OPMSUB; break;
+                case 0x2F: fmac = OP_MINI; break;
+                default:
+                    return {};
+                }
+            }
+            else
+            {
+                // Accumulator forms, conversions, ABS and CLIP; fd is part of the opcode
+                const uint32_t special = ((upper >> 4) & 0x7C) | bc;
+                toAcc = true;
+                target = 0;
+                if (special < 0x10 || (special >= 0x18 && special < 0x1C))
+                {
+                    static constexpr FmacOp kAccOps[7] = {OP_ADD, OP_SUB, OP_MADD, OP_MSUB, OP_MAX, OP_MINI, OP_MUL};
+                    fmac = kAccOps[special >> 2];
+                    operand = OPERAND_BROADCAST;
+                }
+                else if (special < 0x18)
+                {
+                    // ITOF/FTOI move VF[fs] to VF[ft] without touching the flags
+                    static constexpr const char *kScale[4] = {"1.0f", "16.0f", "4096.0f", "32768.0f"};
+                    const std::string value = special < 0x14
+                                                  ? fmt::format("ps2_vu::itof({}, {})", loadVf(fs), kScale[bc])
+                                                  : fmt::format("ps2_vu::ftoi(ps2_vu::operand({}), {})", loadVf(fs), kScale[bc]);
+                    if (ft == 0 || dest == 0)
+                    {
+                        return {};
+                    }
+                    return {fmt::format("        const __m128 upper = {};\n", value), storeVf(ft, dest, "upper")};
+                }
+                else
+                {
+                    switch (special)
+                    {
+                    case 0x1C: fmac = OP_MUL; operand = OPERAND_Q; break;
+                    case 0x1D:
+                        if (ft == 0 || dest == 0)
+                        {
+                            return {};
+                        }
+                        return {fmt::format("        const __m128 upper = _mm_andnot_ps(_mm_set1_ps(-0.0f), ps2_vu::operand({}));\n", loadVf(fs)),
+                                storeVf(ft, dest, "upper")};
+                    case 0x1E: fmac = OP_MUL; operand = OPERAND_I; break;
+                    case 0x1F:
+                        return delegateUpper(upper); // CLIP
+                    case 0x20: fmac = OP_ADD; operand = OPERAND_Q; break;
+                    case 0x21: fmac = OP_MADD; operand = OPERAND_Q; break;
+                    case 0x22: fmac = OP_ADD; operand = OPERAND_I; break;
+                    case 0x23: fmac = OP_MADD; operand = OPERAND_I; break;
+                    case 0x24: fmac = OP_SUB; operand = OPERAND_Q; break;
+                    case 0x25: fmac = OP_MSUB; operand = OPERAND_Q; break;
+                    case 0x26: fmac = OP_SUB; operand = OPERAND_I; break;
+                    case 0x27: fmac = OP_MSUB; operand = OPERAND_I; break;
+                    case 0x28: fmac = OP_ADD; break;
+                    case 0x29: fmac = OP_MADD; break;
+                    case 0x2A: fmac = OP_MUL; break;
+                    case 0x2C: fmac = OP_SUB; break;
+                    case 0x2D: fmac = OP_MSUB; break;
+                    case 0x2E: fmac = OP_OPMULA; break;
+                    default:
+                        return {}; // NOP
+                    }
+                }
+            }
+
+            // MAXA/MINIA do not exist, and MAX/MINI to VF0 or with no fields do nothing
+            if ((fmac == OP_MAX || fmac == OP_MINI) && (toAcc || target == 0 || dest == 0))
+            {
+                return {};
+            }
+
+            std::string b;
+            switch (operand)
+            {
+            case OPERAND_BROADCAST:
+                b = fmt::format("ps2_vu::operand(_mm_set1_ps(regs.vf[{}][{}]))", ft, bc);
+                break;
+            case OPERAND_FULL:
+                b = fmt::format("ps2_vu::operand({})", loadVf(ft));
+                break;
+            case OPERAND_Q:
+                b = "_mm_set1_ps(ps2_vu::scalar(regs.q))";
+                break;
+            case OPERAND_I:
+                b = "_mm_set1_ps(ps2_vu::scalar(regs.i))";
+                break;
+            }
+
+            UpperCode code;
+            code.compute = fmt::format("        const __m128 ua = ps2_vu::operand({});\n"
+                                       "        const __m128 ub = {};\n",
+                                       loadVf(fs), b);
+            const std::string acc = "ps2_vu::operand(_mm_load_ps(regs.acc))";
+            std::string result;
+            switch (fmac)
+            {
+            case OP_ADD: result = "_mm_add_ps(ua, ub)"; break;
+            case OP_SUB: result = "_mm_sub_ps(ua, ub)"; break;
+            case OP_MUL: result = "_mm_mul_ps(ua, ub)"; break;
+            case OP_MADD: result = fmt::format("_mm_add_ps({}, ps2_vu::operand(_mm_mul_ps(ua, ub)))", acc); break;
+            case OP_MSUB: result = fmt::format("_mm_sub_ps({}, ps2_vu::operand(_mm_mul_ps(ua, ub)))", acc); break;
+            case OP_OPMULA:
+            case OP_OPMSUB:
+            {
+                // Cross product terms: fs.yzx * ft.zxy
+                const std::string product = "_mm_mul_ps(_mm_shuffle_ps(ua, ua, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(ub, ub, _MM_SHUFFLE(3, 1, 0, 2)))";
+                result = fmac == OP_OPMULA ? product : fmt::format("_mm_sub_ps({}, ps2_vu::operand({}))", acc, product);
+                break;
+            }
+            case OP_MAX:
+            case OP_MINI:
+                // No flags
+                code.compute += fmt::format("        const __m128 upper = {}(ua, ub);\n", fmac == OP_MAX ? "_mm_max_ps" : "_mm_min_ps");
+                code.commit = storeVf(target, dest, "upper");
+                return code;
+            case OP_NONE:
+                return {};
+            }
+
+            code.commit = toAcc ? storeAcc(dest, "upper") : storeVf(target, dest, "upper");
+            const std::string flags = fmt::format("ps2_vu::fmacResult({}, 0x{:X}, regs.mac, regs.status)", result, dest);
+            if (code.commit.empty())
+            {
+                // Only the flags are kept
+                code.compute += fmt::format("        {};\n", flags);
+            }
+            else
+            {
+                code.compute += fmt::format("        const __m128 upper = {};\n", flags);
+            }
+            return code;
+        }
+
+        // Lower ops other than branches; those are handled where the delay slot ends
+        std::string translateLower(uint32_t lower, uint32_t pc)
+        {
+            const uint32_t dest = (lower >> 21) & 0xF;
+            const int it = (lower >> 16) & 0x1F;
+            const int is = (lower >> 11) & 0x1F;
+            const int id = (lower >> 6) & 0x1F;
+            const int32_t imm11 = signExtend(lower & 0x7FF, 11);
+            const std::string delegate = fmt::format("        vu.executeLower(0x{:08X}u, 0x{:X});\n", lower, pc);
+
+            if (lower & 0x80000000u)
+            {
+                switch (lower & 0x3F)
+                {
+                case 0x30: // IADD
+                    return setVi(id, fmt::format("{} + {}", vi(is), vi(it)));
+                case 0x31: // ISUB
+                    return setVi(id, fmt::format("{} - {}", vi(is), vi(it)));
+                case 0x32: // IADDI
+                    return setVi(it, fmt::format("{} + {}", vi(is), signExtend((lower >> 6) & 0x1F, 5)));
+                case 0x34: // IAND
+                    return setVi(id, fmt::format("{} & {}", vi(is), vi(it)));
+                case 0x35: // IOR
+                    return setVi(id, fmt::format("{} | {}", vi(is), vi(it)));
+                case 0x3C:
+                case 0x3D:
+                case 0x3E:
+                case 0x3F:
+                    break;
+                default:
+                    return "";
+                }
+
+                const int ft = it;
+                const int fs = is;
+                switch (lowerSpecial(lower))
+                {
+                case 0x30: // MOVE; MOVE.none VF0, VF0 is the lower NOP
+                    return storeVf(ft, dest, loadVf(fs));
+                case 0x31: // MR32
+                    return storeVf(ft, dest, fmt::format("_mm_shuffle_ps({0}, {0}, _MM_SHUFFLE(0, 3, 2, 1))", loadVf(fs)));
+                case 0x34: // LQI
+                    return storeVf(ft, dest, fmt::format("_mm_loadu_ps({})", dataPointer(vi(fs)))) +
+                           setVi(fs, fmt::format("{} + 1", vi(fs)));
+                case 0x35: // SQI
+                    return storeQword(vi(ft), dest, fs) +
+                           setVi(ft, fmt::format("{} + 1", vi(ft)));
+                case 0x36: // LQD
+                {
+                    const std::string effects = setVi(fs, "address") + storeVf(ft, dest, fmt::format("_mm_loadu_ps({})", dataPointer("address")));
+                    return effects.empty() ? "" : fmt::format("        const uint32_t address = {} - 1u;\n", vi(fs)) + effects;
+                }
+                case 0x37: // SQD
+                {
+                    const std::string effects = setVi(ft, "address") + storeQword("address", dest, fs);
+                    return effects.empty() ? "" : fmt::format("        const uint32_t address = {} - 1u;\n", vi(ft)) + effects;
+                }
+                case 0x3B: // WAITQ
+                    return "        vu.waitQ();\n";
+                case 0x7B: // WAITP
+                    return "        vu.waitP();\n";
+                default:
+                    return delegate;
+                }
+            }
+
+            const uint32_t imm15 = ((lower >> 10) & 0x7800) | (lower & 0x7FF);
+            switch (lower >> 25)
+            {
+            case 0x00: // LQ
+                return storeVf(it, dest, fmt::format("_mm_loadu_ps({})", dataPointer(fmt::format("{} + {}", vi(is), imm11))));
+            case 0x01: // SQ
+                return storeQword(fmt::format("{} + {}", vi(it), imm11), dest, is);
+            case 0x08: // IADDIU
+                return setVi(it, fmt::format("{} + 0x{:X}u", vi(is), imm15));
+            case 0x09: // ISUBIU
+                return setVi(it, fmt::format("{} - 0x{:X}u", vi(is), imm15));
+            case 0x20: // B
+                return fmt::format("        branch = true;\n        target = 0x{:X};\n", branchTarget(lower, pc));
+            case 0x21: // BAL
+                return setVi(it, fmt::format("0x{:X}", (pc + 16) / 8)) +
+                       fmt::format("        branch = true;\n        target = 0x{:X};\n", branchTarget(lower, pc));
+            case 0x24: // JR
+                return fmt::format("        branch = true;\n        target = {} * 8u;\n", vi(is));
+            case 0x25: // JALR
+                return fmt::format("        branch = true;\n        target = {} * 8u;\n", vi(is)) +
+                       setVi(it, fmt::format("0x{:X}", (pc + 16) / 8));
+            case 0x28: // IBEQ
+            case 0x29: // IBNE
+            case 0x2C: // IBLTZ
+            case 0x2D: // IBGTZ
+            case 0x2E: // IBLEZ
+            case 0x2F: // IBGEZ
+            {
+                std::string condition;
+                switch (lower >> 25)
+                {
+                case 0x28: condition = fmt::format("{} == {}", vi(it), vi(is)); break;
+                case 0x29: condition = fmt::format("{} != {}", vi(it), vi(is)); break;
+                case 0x2C: condition = fmt::format("static_cast<int16_t>({}) < 0", vi(is)); break;
+                case 0x2D: condition = fmt::format("static_cast<int16_t>({}) > 0", vi(is)); break;
+                case 0x2E: condition = fmt::format("static_cast<int16_t>({}) <= 0", vi(is)); break;
+                default: condition = fmt::format("static_cast<int16_t>({}) >= 0", vi(is)); break;
+                }
+                return fmt::format("        if ({})\n"
+                                   "        {{\n"
+                                   "            branch = true;\n"
+                                   "            target = 0x{:X};\n"
+                                   "        }}\n",
+                                   condition, branchTarget(lower, pc));
+            }
+            case 0x04: // ILW
+            case 0x05: // ISW
+            case 0x10: case 0x11: case 0x12: case 0x13: // clip flag ops
+            case 0x14: case 0x15: case 0x16: case 0x17: // status flag ops
+            case 0x18: case 0x1A: case 0x1B: case 0x1C: // MAC flag ops, FCGET
+                return delegate;
+            default:
+                return "";
+            }
+        }
+    }
+
+    std::vector<VuMicroprogram> VuRecompiler::findMpgUploads(const uint8_t *data, uint32_t size, uint32_t address)
+    {
+        std::vector<VuMicroprogram> uploads;
+        if (!data)
+        {
+            return uploads;
+        }
+
+        // MPG data has to start on a doubleword, so the command itself sits at 4 mod 8
+        for (uint32_t offset = 4; offset + 4 <= size; offset += 8)
+        {
+            const uint32_t vifCode = load32(data + offset);
+            if (((vifCode >> 24) & 0x7F) != kVifMpg)
+            {
+                continue;
+            }
+
+            const uint32_t num = ((vifCode >> 16) & 0xFF) ? ((vifCode >> 16) & 0xFF) : 256;
+            const uint32_t loadAddress = (vifCode & 0xFFFF) * 8;
+            const uint32_t bytes = num * 8;
+            if (loadAddress + bytes > kVu1CodeSize || bytes > size - offset - 4)
+            {
+                continue;
+            }
+
+            const uint8_t *code = data + offset + 4;
+            bool plausible = true;
+            for (uint32_t i = 0; i < bytes && plausible; i += 8)
+            {
+                plausible = (load32(code + i + 4) & kUpperDebug) == 0;
+            }
+            if (!plausible)
+            {
+                continue;
+            }
+
+            VuMicroprogram upload{address + offset + 4, bytes, loadAddress, -1};
+
+            // The next MPG of a chain follows after at most a DMA tag and a NOP
+            if (!uploads.empty())
+            {
+                VuMicroprogram &last = uploads.back();
+                const uint32_t lastEnd = last.address + last.size;
+                if (upload.address >= lastEnd && upload.address - lastEnd <= 16 &&
+                    upload.loadAddress == last.loadAddress + last.size &&
+                    upload.loadAddress + upload.size <= kVu1CodeSize)
+                {
+                    last.size += upload.size;
+                    offset += bytes;
+                    continue;
+                }
+            }
+
+            uploads.push_back(upload);
+            offset += bytes;
+        }
+
+        std::vector<VuMicroprogram> programs;
+        for (VuMicroprogram &upload : uploads)
+        {
+            const uint8_t *code = data + (upload.address - address);
+            bool hasEnd = false;
+            bool kicks = false;
+            for (uint32_t i = 0; i < upload.size; i += 8)
+            {
+                const uint32_t upper = load32(code + i + 4);
+                hasEnd |= (upper & kUpperE) != 0;
+                kicks |= !(upper & kUpperI) && isXgkick(load32(code + i));
+            }
+            if (!hasEnd)
+            {
+                continue;
+            }
+            // Only VU1 has XGKICK and more than 4KB of micro memory
+            if (kicks || upload.loadAddress + upload.size > kVu0CodeSize)
+            {
+                upload.unit = 1;
+            }
+            programs.push_back(upload);
+        }
+        return programs;
+    }
+
+    uint64_t VuRecompiler::hashCode(const std::vector<uint8_t> &code)
+    {
+        return ps2VuMicrocodeHash(code.data(), static_cast<uint32_t>(code.size()));
+    }
+
+    std::string VuRecompiler::functionName(const VuMicroprogram &program, uint64_t hash)
+    {
+        return fmt::format("vu_microprogram_{:04x}_{:016x}", program.loadAddress, hash);
+    }
+
+    void VuRecompiler::addProgram(const VuMicroprogram &program, std::vector<uint8_t> code)
+    {
+        code.resize(code.size() & ~size_t{7});
+        if (code.empty())
+        {
+            return;
+        }
+
+        const uint64_t hash = hashCode(code);
+        for (const Program &existing : m_programs)
+        {
+            if (existing.hash == hash && existing.info.loadAddress == program.loadAddress &&
+                existing.code.size() == code.size())
+            {
+                return;
+            }
+        }
+
+        VuMicroprogram info = program;
+        info.size = static_cast<uint32_t>(code.size());
+        m_programs.push_back({info, std::move(code), hash});
+    }
+
+    bool VuRecompiler::canRunOnVu0(const Program &program)
+    {
+        return program.info.unit != 1 && program.info.loadAddress + program.info.size <= kVu0CodeSize;
+    }
+
+    std::string VuRecompiler::generateFunction(size_t index) const
+    {
+        const Program &program = m_programs.at(index);
+        const uint32_t begin = program.info.loadAddress;
+        const uint32_t end = begin + program.info.size;
+
+        auto words = [&](uint32_t pc, uint32_t &lower, uint32_t &upper)
+        {
+            lower = load32(program.code.data() + (pc - begin));
+            upper = load32(program.code.data() + (pc - begin) + 4);
+        };
+        auto inRange = [&](uint32_t pc)
+        { return pc >= begin && pc < end && (pc & 7) == 0; };
+
+        std::stringstream ss;
+        ss << fmt::format("// Microcode at 0x{:X}-0x{:X} in micro memory, uploaded from 0x{:08X}\n", begin, end, program.info.address);
+        ss << "static bool " << functionName(program.info, program.hash) << "(PS2VectorUnit &vu)\n{\n";
+        ss << "    PS2VectorUnit::Registers &regs = vu.registers();\n";
+        ss << "    [[maybe_unused]] bool branch = false;\n";
+        ss << "    [[maybe_unused]] uint32_t target = 0;\n";
+        ss << "    [[maybe_unused]] bool end = false;\n";
+        ss << "    uint32_t next = regs.pc;\n\n";
+
+        std::stringstream body;
+        bool dispatched = false;
+        for (uint32_t pc = begin; pc < end; pc += 8)
+        {
+            uint32_t lower, upper;
+            words(pc, lower, upper);
+            const bool iBit = (upper & kUpperI) != 0;
+
+            bool afterBranch = false;
+            bool afterEnd = false;
+            uint32_t previousLower = 0;
+            if (pc > begin)
+            {
+                uint32_t previousUpper;
+                words(pc - 8, previousLower, previousUpper);
+                afterBranch = !(previousUpper & kUpperI) && isBranch(previousLower);
+                afterEnd = (previousUpper & kUpperE) != 0;
+            }
+            const bool setsBranch = !iBit && isBranch(lower);
+            const bool setsEnd = (upper & kUpperE) != 0;
+
+            body << label(pc) << ": // " << fmt::format("{:08X} {:08X}", upper, lower) << "\n";
+            body << "    {\n";
+            if (afterBranch)
+            {
+                body << "        const bool jump = branch;\n";
+                body << "        [[maybe_unused]] const uint32_t jumpTo = target;\n";
+                body << "        branch = false;\n";
+            }
+            if (afterEnd)
+            {
+                body << "        const bool ending = end;\n";
+                body << "        end = false;\n";
+            }
+            body << "        vu.beginInstruction();\n";
+            if (iBit)
+            {
+                body << fmt::format("        regs.i = ps2_vu::fromBits(0x{:08X}u);\n", lower);
+            }
+
+            const UpperCode upperCode = translateUpper(upper);
+            body << upperCode.compute;
+            if (!iBit)
+            {
+                body << translateLower(lower, pc);
+            }
+            body << upperCode.commit;
+            body << "        vu.endInstruction();\n";
+            if (setsEnd)
+            {
+                body << "        end = true;\n";
+            }
+
+            // The delay slot is done: end the program or take the branch
+            if (afterEnd)
+            {
+                body << "        if (ending)\n        {\n";
+                body << fmt::format("            regs.pc = {};\n", afterBranch ? fmt::format("jump ? jumpTo : 0x{:X}", pc + 8) : fmt::format("0x{:X}", pc + 8));
+                body << "            return true;\n        }\n";
+            }
+            if (afterBranch)
+            {
+                body << "        if (jump)\n        {\n";
+                if (setsBranch || setsEnd)
+                {
+                    // A branch or E bit in the delay slot is left to the interpreter
+                    body << "            if (branch || end)\n            {\n";
+                    body << "                vu.leaveRecompiled(jumpTo, branch, target, end);\n";
+                    body << "                return false;\n            }\n";
+                }
+
+                const uint32_t branchPc = pc - 8;
+                const bool known = !isRegisterJump(previousLower);
+                const uint32_t destination = known ? branchTarget(previousLower, branchPc) : 0;
+                if (!known || destination <= branchPc || !inRange(destination))
+                {
+                    body << "            if (vu.overBudget())\n            {\n";
+                    body << "                vu.leaveRecompiled(jumpTo, false, 0, false);\n";
+                    body << "                return false;\n            }\n";
+                }
+                if (known && inRange(destination))
+                {
+                    body << "            goto " << label(destination) << ";\n";
+                }
+                else
+                {
+                    body << "            next = jumpTo;\n";
+                    body << "            goto dispatch;\n";
+                    dispatched = true;
+                }
+                body << "        }\n";
+            }
+            body << "    }\n";
+        }
+
+        // Entry, and the target of jumps not known until run time
+        if (dispatched)
+        {
+            ss << "dispatch:\n";
+        }
+        ss << "    switch (next & (vu.codeSize() - 1) & ~7u)\n    {\n";
+        for (uint32_t pc = begin; pc < end; pc += 8)
+        {
+            ss << fmt::format("    case 0x{:X}:\n        goto {};\n", pc, label(pc));
+        }
+        ss << "    default:\n";
+        ss << "        vu.leaveRecompiled(next, false, 0, false);\n";
+        ss << "        return false;\n";
+        ss << "    }\n\n";
+        ss << body.str();
+        ss << fmt::format("    vu.leaveRecompiled(0x{:X}, branch, target, end);\n", end);
+        ss << "    return false;\n";
+        ss << "}\n";
+        return ss.str();
+    }
+
+    std::string VuRecompiler::generateOutput() const
+    {
+        std::stringstream ss;
+        ss << "#include \"ps2_runtime.h\"\n";
+        ss << "#include \"ps2_vu.h\"\n\n";
+
+        for (size_t i = 0; i < m_programs.size(); i++)
+        {
+            ss << generateFunction(i) << "\n";
+        }
+
+        ss << "void registerVuMicroprograms(PS2Runtime &runtime)\n{\n";
+        for (const Program &program : m_programs)
+        {
+            const std::string name = functionName(program.info, program.hash);
+            // Uploads that do not say which VU they are for are offered to both
+            if (program.info.unit != 0)
+            {
+                ss << fmt::format("    runtime.registerVuMicroprogram({{1, 0x{:X}, 0x{:X}, 0x{:016X}ull, {}}});\n",
+                                  program.info.loadAddress, program.info.size, program.hash, name);
+            }
+            if (canRunOnVu0(program))
+            {
+                ss << fmt::format("    runtime.registerVuMicroprogram({{0, 0x{:X}, 0x{:X}, 0x{:016X}ull, {}}});\n",
+                                  program.info.loadAddress, program.info.size, program.hash, name);
+            }
+        }
+        ss << "}\n";
+        return ss.str();
+    }
+}
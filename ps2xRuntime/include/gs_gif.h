@@ -0,0 +1,77 @@
+#ifndef GS_GIF_H
+#define GS_GIF_H
+
+#include <array>
+#include <cstdint>
+
+class GSState;
+
+/**
+ * @brief GIF packet processor
+ *
+ * Decodes GIFtags and the data that follows them for each of the three paths
+ * into the GS: PATH1 (VU1 XGKICK), PATH2 (VIF1 DIRECT/DIRECTHL) and PATH3 (GIF
+ * DMA channel and FIFO). A tag's data may be split across any number of
+ * transfers; each path remembers where it stopped.
+ *
+ * PACKED data goes to the GS a qword per register descriptor, REGLIST data a
+ * doubleword per descriptor, and IMAGE data to the HWREG port in one block.
+ */
+class GSGif
+{
+public:
+    enum Path
+    {
+        PATH1 = 0,
+        PATH2 = 1,
+        PATH3 = 2,
+    };
+
+    // GIFtag.FLG
+    enum Mode : uint32_t
+    {
+        PACKED = 0,
+        REGLIST = 1,
+        IMAGE = 2,
+    };
+
+    explicit GSGif(GSState& gs);
+
+    void reset();
+
+    /**
+     * @brief Process qwc qwords of GIF data arriving on a path
+     *
+     * PATH1 stops after the data of a tag with EOP set, as XGKICK sends one
+     * packet; the other paths consume everything they are given.
+     * @return Number of qwords consumed
+     */
+    uint32_t transfer(Path path, const uint8_t* data, uint32_t qwc);
+
+    /**
+     * @brief True when the path is between tags (not inside a tag's data)
+     */
+    bool idle(Path path) const { return m_paths[path].qwordsLeft == 0; }
+
+private:
+    struct PathState
+    {
+        Mode mode = PACKED;
+        bool eop = false;
+        bool allAD = false;        // every descriptor is A+D, the common case
+        uint32_t qwordsLeft = 0;   // data qwords of the current tag still to come
+        uint32_t wordsLeft = 0;    // REGLIST doublewords still to come (the last qword may be padding)
+        uint32_t nreg = 0;
+        uint32_t reg = 0;          // descriptor the next data belongs to
+        std::array<uint8_t, 16> regs{};
+    };
+
+    GSState& m_gs;
+    std::array<PathState, 3> m_paths;
+
+    void readTag(PathState& state, const uint8_t* tag);
+    void writePacked(PathState& state, const uint8_t* data, uint32_t qwc);
+    void writeRegList(PathState& state, const uint8_t* data, uint32_t qwc);
+};
+
+#endif // GS_GIF_H
@@ -0,0 +1,99 @@
+#ifndef GS_LOCAL_MEMORY_H
+#define GS_LOCAL_MEMORY_H
+
+#include <bitset>
+#include <cstdint>
+
+/**
+ * @brief GS local memory (VRAM) addressing
+ *
+ * VRAM is 4 MB of 8 KB pages. Each page is 32 blocks of 256 bytes, and the
+ * order of blocks within a page and of pixels within a block depends on the
+ * pixel storage mode (PSM). All swizzles come from per-PSM lookup tables
+ * built on first use; transfers walk the rectangle a block at a time, so the
+ * block's base address is worked out once per block rather than per pixel.
+ *
+ * Base pointers (BP) are in 256-byte blocks and buffer widths (BW) in 64-pixel
+ * units, as in BITBLTBUF/FRAME/TEX0. Addresses wrap at the end of VRAM.
+ */
+class GSLocalMemory
+{
+public:
+    enum PSM : uint32_t
+    {
+        PSMCT32 = 0x00,
+        PSMCT24 = 0x01,
+        PSMCT16 = 0x02,
+        PSMCT16S = 0x0A,
+        PSMT8 = 0x13,
+        PSMT4 = 0x14,
+        PSMT8H = 0x1B,
+        PSMT4HL = 0x24,
+        PSMT4HH = 0x2C,
+        PSMZ32 = 0x30,
+        PSMZ24 = 0x31,
+        PSMZ16 = 0x32,
+        PSMZ16S = 0x3A,
+    };
+
+    static constexpr uint32_t kPageSize = 8192;
+    static constexpr uint32_t kBlockSize = 256;
+    static constexpr uint32_t kBlocksPerPage = 32;
+    static constexpr uint32_t kPageCount = 512; // 4 MB of VRAM
+
+    // One bit per VRAM page
+    using PageMask = std::bitset<kPageCount>;
+
+    static bool isSupported(uint32_t psm);
+
+    /**
+     * @brief Bits per pixel in host transfers (32, 24, 16, 8 or 4)
+     */
+    static uint32_t transferBits(uint32_t psm);
+
+    /**
+     * @brief Page dimensions in pixels
+     */
+    static uint32_t pageWidth(uint32_t psm);
+    static uint32_t pageHeight(uint32_t psm);
+
+    /**
+     * @brief Block dimensions in pixels; a block is 256 contiguous bytes
+     */
+    static uint32_t blockWidth(uint32_t psm);
+    static uint32_t blockHeight(uint32_t psm);
+
+    /**
+     * @brief Set the bit of every page a rectangle of the given buffer touches
+     */
+    static void markPages(PageMask& pages, uint32_t psm, uint32_t bp, uint32_t bw,
+                          uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+    /**
+     * @brief Byte offset in VRAM of the storage word holding pixel (x, y)
+     *
+     * For 4-bit formats two pixels share a byte; the low nibble is the even pixel.
+     */
+    static uint32_t pixelByteOffset(uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y);
+
+    static uint32_t readPixel(const uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y);
+    static void writePixel(uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y, uint32_t value);
+
+    /**
+     * @brief Copy a rectangle of packed host pixels into VRAM (HOSTLOCAL transfer)
+     *
+     * Source rows are w pixels long and tightly packed at transferBits(psm);
+     * 4-bit pixels fill the low nibble first. Formats that share a word with
+     * another (24-bit, 8H, 4HL, 4HH) leave the other bits untouched.
+     */
+    static void writeImage(uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw,
+                           uint32_t x, uint32_t y, uint32_t w, uint32_t h, const uint8_t* src);
+
+    /**
+     * @brief Copy a rectangle out of VRAM into packed host pixels (LOCALHOST transfer)
+     */
+    static void readImage(const uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw,
+                          uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t* dst);
+};
+
+#endif // GS_LOCAL_MEMORY_H
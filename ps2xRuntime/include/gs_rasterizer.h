@@ -0,0 +1,211 @@
+#ifndef GS_RASTERIZER_H
+#define GS_RASTERIZER_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gs_local_memory.h"
+
+/**
+ * @brief Drawing environment a primitive is rendered with
+ *
+ * A snapshot of the context registers (FRAME, ZBUF, TEST, ALPHA, TEX0...) taken
+ * when the primitive was kicked, already split into fields.
+ */
+struct GSDrawState
+{
+    // FRAME / ZBUF, base pointers in blocks
+    uint32_t fbp = 0;
+    uint32_t fbw = 0;
+    uint32_t fpsm = 0;
+    uint32_t fbmsk = 0;
+    uint32_t zbp = 0;
+    uint32_t zpsm = 0x30;
+    bool zmsk = true;
+
+    // SCISSOR, inclusive, in pixels
+    int32_t scissorX0 = 0;
+    int32_t scissorY0 = 0;
+    int32_t scissorX1 = 0;
+    int32_t scissorY1 = 0;
+
+    // PRIM / PRMODE attributes
+    bool iip = false; // Gouraud shading
+    bool tme = false; // texture mapping
+    bool fge = false; // fog
+    bool abe = false; // alpha blending
+    bool fst = false; // UV rather than STQ coordinates
+
+    // TEST
+    bool ate = false;
+    uint32_t atst = 1;
+    uint32_t aref = 0;
+    uint32_t afail = 0;
+    bool date = false;
+    bool datm = false;
+    bool zte = false;
+    uint32_t ztst = 1;
+
+    // ALPHA, PABE, FBA, COLCLAMP, FOGCOL
+    uint32_t alphaA = 0;
+    uint32_t alphaB = 0;
+    uint32_t alphaC = 0;
+    uint32_t alphaD = 0;
+    uint32_t alphaFix = 0;
+    bool pabe = false;
+    bool fba = false;
+    bool colclamp = true;
+    uint32_t fogcol = 0;
+
+    // TEX0 / TEX1 / CLAMP / TEXA
+    uint32_t tbp = 0;
+    uint32_t tbw = 0;
+    uint32_t tpsm = 0;
+    uint32_t tw = 0; // log2 of the texture width
+    uint32_t th = 0;
+    bool tcc = false;
+    uint32_t tfx = 0;
+    bool bilinear = false;
+    uint32_t wms = 0;
+    uint32_t wmt = 0;
+    uint32_t minu = 0;
+    uint32_t maxu = 0;
+    uint32_t minv = 0;
+    uint32_t maxv = 0;
+    uint32_t ta0 = 0;
+    uint32_t ta1 = 0x80;
+    bool aem = false;
+};
+
+/**
+ * @brief CPU rasterizer for GS primitives
+ *
+ * Primitives are collected into a batch and binned into 32x32 pixel screen
+ * tiles. A flush hands the tiles to a pool of workers; each worker draws every
+ * primitive of a tile in submission order, so per-pixel results match drawing
+ * one primitive at a time while different tiles run in parallel.
+ *
+ * The batch is flushed before a primitive would read (as a texture) pages that
+ * an earlier one writes, or write pages an earlier one reads. Anything else
+ * that touches VRAM must flush first.
+ */
+class GSRasterizer
+{
+public:
+    enum class PrimitiveType : uint8_t
+    {
+        Point,
+        Line,
+        Triangle,
+        Sprite,
+    };
+
+    struct Vertex
+    {
+        int32_t x = 0; // window coordinates in 1/16 pixel (XYOFFSET already applied)
+        int32_t y = 0;
+        uint32_t z = 0;
+        uint8_t r = 0;
+        uint8_t g = 0;
+        uint8_t b = 0;
+        uint8_t a = 0;
+        uint8_t fog = 0;
+        float s = 0.0f;
+        float t = 0.0f;
+        float q = 1.0f;
+        uint32_t u = 0; // 1/16 texel
+        uint32_t v = 0;
+    };
+
+    static constexpr uint32_t kTileShift = 5;
+    static constexpr uint32_t kTilesPerRow = 2048 >> kTileShift;
+    static constexpr uint32_t kMaxPrimitives = 16384;
+
+    GSRasterizer();
+    ~GSRasterizer();
+
+    void attach(uint8_t* vram, GSLocalMemory::PageMask* dirtyPages);
+
+    /**
+     * @brief Number of threads a flush draws with, the calling one included (0 or 1: caller only)
+     */
+    void setThreadCount(uint32_t threads);
+    uint32_t threadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+    /**
+     * @brief Set the drawing environment for the primitives that follow
+     * @param palette 256 RGBA entries for indexed texture formats, nullptr otherwise
+     */
+    void setState(const GSDrawState& state, const uint32_t* palette);
+
+    /**
+     * @brief Add a primitive; may flush first when it depends on pages the batch touches
+     */
+    void addPrimitive(PrimitiveType type, const Vertex* vertices);
+
+    /**
+     * @brief Draw everything in the batch and empty it; returns once VRAM is up to date
+     */
+    void flush();
+
+    bool empty() const { return m_primitives.empty(); }
+
+    // True when a queued primitive draws to one of the pages
+    bool pendingWrites(const GSLocalMemory::PageMask& pages) const { return (pages & m_writePages).any(); }
+
+    // Per-state data the workers read
+    struct State
+    {
+        GSDrawState draw;
+        uint32_t palette = 0;          // index into m_palettes
+        bool hasPalette = false;
+        bool simpleFill = false;       // untextured, flat, no blending or tests: block fills allowed
+        GSLocalMemory::PageMask texturePages;
+    };
+
+    struct Primitive
+    {
+        PrimitiveType type;
+        uint32_t state;
+        int32_t x0, y0, x1, y1; // inclusive bounds in pixels, scissored
+        Vertex v[3];
+    };
+
+private:
+    uint8_t* m_vram = nullptr;
+    GSLocalMemory::PageMask* m_dirtyPages = nullptr;
+
+    State m_current;
+    std::array<uint32_t, 256> m_currentPalette{};
+    bool m_currentQueued = false; // m_current is the last entry of m_states
+
+    std::vector<State> m_states;
+    std::vector<std::array<uint32_t, 256>> m_palettes;
+    std::vector<Primitive> m_primitives;
+    std::vector<std::vector<uint32_t>> m_bins; // primitive indices, per tile
+    std::vector<uint32_t> m_activeTiles;
+    GSLocalMemory::PageMask m_readPages;
+    GSLocalMemory::PageMask m_writePages;
+
+    // Worker pool. Workers sleep until m_generation changes, then take tiles from m_nextTile.
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    uint64_t m_generation = 0;
+    uint32_t m_busyWorkers = 0;
+    bool m_quit = false;
+    std::atomic<uint32_t> m_nextTile{0};
+
+    void stopWorkers();
+    void workerLoop();
+    void drawTiles();
+    void drawTile(uint32_t tile);
+};
+
+#endif // GS_RASTERIZER_H
@@ -1,9 +1,12 @@
 #ifndef GS_RENDERER_H
 #define GS_RENDERER_H
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <string>
 
 // Forward declarations
 struct R5900Context;
@@ -13,7 +16,12 @@ class PS2Memory;
  * @brief Graphics Synthesizer (GS) Renderer
  * 
  * Handles conversion of PS2 VRAM framebuffer data to host-displayable format.
- * Currently supports PSMCT32 (32-bit color) format.
+ * Supports PSMCT32, PSMCT16/16S, and PSMT8/PSMT4 looked up through the CLUT
+ * buffer the last TEX0/TEX2 CLUT load filled.
+ *
+ * Converted frames are handed to the presenter through three buffers. The guest
+ * thread converts into the back buffer and publishes it; the presenter swaps the
+ * newest published frame into the front buffer. Neither side ever waits.
  */
 class GSRenderer
 {
@@ -29,62 +37,112 @@ public:
 
     struct FramebufferConfig
     {
-        uint32_t basePointer;  // FBP (Framebuffer Pointer) in 2048-byte units
+        uint32_t basePointer;  // FBP (Framebuffer Pointer) in 8 KB pages (2048 words)
         uint32_t width;        // FBW (Framebuffer Width) in 64-pixel blocks
         uint32_t height;       // Display height in pixels
         PixelFormat format;
+
+        bool operator==(const FramebufferConfig&) const = default;
+    };
+
+    // Instruction sets the framebuffer conversion kernels can use, in increasing order
+    enum class SimdLevel
+    {
+        Scalar,
+        SSSE3,
+        AVX2,
     };
 
     GSRenderer();
     ~GSRenderer();
 
     /**
-     * @brief Initialize the renderer with display dimensions
+     * @brief Best kernel level the host CPU supports (detected once)
      */
-    bool initialize(uint32_t displayWidth, uint32_t displayHeight);
+    static SimdLevel supportedSimdLevel();
 
     /**
-     * @brief Update the framebuffer from VRAM data
+     * @brief Select the conversion kernels; levels the CPU lacks fall back to the best supported one
      */
-    void updateFramebuffer(const PS2Memory& memory, const FramebufferConfig& config);
+    void setSimdLevel(SimdLevel level);
+    SimdLevel simdLevel() const { return m_simdLevel; }
 
     /**
-     * @brief Get the current framebuffer as RGBA32 data
+     * @brief Initialize the renderer with display dimensions
      */
-    const std::vector<uint32_t>& getFramebufferRGBA() const { return m_framebufferRGBA; }
+    bool initialize(uint32_t displayWidth, uint32_t displayHeight);
 
     /**
-     * @brief Get framebuffer dimensions
+     * @brief Convert the framebuffer from VRAM data and publish it (guest thread)
+     *
+     * Only pages marked in memory.vramDirtyPages() are converted again, and their
+     * bits are cleared. Nothing is published when neither those pages nor the
+     * config changed since the last call.
+     * @return true if a frame was published
      */
-    uint32_t getWidth() const { return m_displayWidth; }
-    uint32_t getHeight() const { return m_displayHeight; }
+    bool updateFramebuffer(PS2Memory& memory, const FramebufferConfig& config);
 
     /**
-     * @brief Check if framebuffer has been updated since last call
+     * @brief Convert the whole display on the next update, dirty or not
      */
-    bool isFramebufferDirty() const { return m_framebufferDirty; }
-    void clearFramebufferDirty() { m_framebufferDirty = false; }
+    void invalidate() { m_invalid = true; }
 
-private:
-    uint32_t m_displayWidth = 0;
-    uint32_t m_displayHeight = 0;
-    std::vector<uint32_t> m_framebufferRGBA;
-    bool m_framebufferDirty = false;
+    /**
+     * @brief Make the newest published frame current (presenter thread)
+     * @return false when nothing was published since the last call
+     */
+    bool acquireFrame();
 
     /**
-     * @brief Convert PSMCT32 pixel format to RGBA32
+     * @brief Get the current frame as RGBA32 data (presenter thread)
      */
-    uint32_t convertPSMCT32ToRGBA(uint32_t psColor) const;
+    const std::vector<uint32_t>& getFramebufferRGBA() const { return m_frames[m_front]; }
 
     /**
-     * @brief Convert PSMCT16 pixel format to RGBA32
+     * @brief Write the current framebuffer to a binary PPM file (alpha is dropped)
      */
-    uint32_t convertPSMCT16ToRGBA(uint16_t psColor) const;
+    bool saveFramePPM(const std::string& path) const;
 
     /**
-     * @brief Calculate VRAM offset from framebuffer coordinates
+     * @brief Get framebuffer dimensions
      */
-    uint32_t calculateVRAMOffset(uint32_t x, uint32_t y, uint32_t fbw, PixelFormat format) const;
+    uint32_t getWidth() const { return m_displayWidth; }
+    uint32_t getHeight() const { return m_displayHeight; }
+
+private:
+    // Set in m_ready while the spare buffer holds a frame the presenter has not taken
+    static constexpr uint8_t kFreshFrame = 0x4;
+
+    uint32_t m_displayWidth = 0;
+    uint32_t m_displayHeight = 0;
+    std::array<std::vector<uint32_t>, 3> m_frames;
+    uint8_t m_back = 0;                 // written by the guest thread only
+    uint8_t m_front = 1;                // read by the presenter only
+    std::atomic<uint8_t> m_ready{2};    // spare buffer index, plus kFreshFrame
+
+    // Converts `count` pixels of one VRAM row into RGBA32
+    using ConvertRowFn = void (*)(const uint8_t* src, uint32_t* dst, uint32_t count);
+    SimdLevel m_simdLevel = SimdLevel::Scalar;
+    ConvertRowFn m_convertRowPSMCT32 = nullptr;
+    ConvertRowFn m_convertRowPSMCT16 = nullptr;
+
+    // Converts `count` indexed pixels of one VRAM row through a palette of RGBA32 colours
+    using ConvertIndexedRowFn = void (*)(const uint8_t* src, uint32_t* dst, uint32_t count, const uint32_t* palette);
+    ConvertIndexedRowFn m_convertRowPSMT8 = nullptr;
+    ConvertIndexedRowFn m_convertRowPSMT4 = nullptr;
+
+    // The CLUT as RGBA32, rebuilt only when GSState reports a reload
+    std::array<uint32_t, 256> m_palette{};
+    uint32_t m_paletteGeneration = 0;
+    uint32_t m_paletteEntries = 0; // 0 until first built
+
+    // The display as last converted; dirty pages are patched into it in place
+    std::vector<uint32_t> m_converted;
+    FramebufferConfig m_lastConfig{};
+    bool m_invalid = true;
+
+    // One page of displayed pixels in VRAM format, unswizzled
+    std::vector<uint8_t> m_readout;
 };
 
 #endif // GS_RENDERER_H
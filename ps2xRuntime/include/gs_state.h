@@ -0,0 +1,191 @@
+#ifndef GS_STATE_H
+#define GS_STATE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gs_local_memory.h"
+#include "gs_rasterizer.h"
+
+struct GSRegisters;
+
+/**
+ * @brief GS general registers, the drawing environment and the BITBLT (transmission) engine
+ *
+ * Register writes arrive from the GIF as A+D, PACKED or REGLIST data; IMAGE data
+ * arrives as a HWREG byte stream. Writing TRXDIR starts a transmission between
+ * the buffers set up in BITBLTBUF/TRXPOS/TRXREG: host to local transmissions
+ * then consume HWREG data whole rows at a time, local to local copies happen
+ * on the spot. Every VRAM page written is marked in the dirty page mask.
+ *
+ * XYZ2/XYZF2 writes kick vertices into primitives for the rasterizer, which
+ * draws them in batches. Anything reading VRAM must call flush() first.
+ * TEX0/TEX2 writes load the CLUT buffer as their CLD field asks.
+ *
+ * SIGNAL, FINISH and LABEL update CSR and SIGLBLID in the privileged registers.
+ */
+class GSState
+{
+public:
+    enum Register : uint32_t
+    {
+        PRIM = 0x00,
+        RGBAQ = 0x01,
+        ST = 0x02,
+        UV = 0x03,
+        XYZF2 = 0x04,
+        XYZ2 = 0x05,
+        TEX0_1 = 0x06,
+        TEX0_2 = 0x07,
+        CLAMP_1 = 0x08,
+        CLAMP_2 = 0x09,
+        FOG = 0x0A,
+        XYZF3 = 0x0C,
+        XYZ3 = 0x0D,
+        TEX1_1 = 0x14,
+        TEX1_2 = 0x15,
+        TEX2_1 = 0x16,
+        TEX2_2 = 0x17,
+        XYOFFSET_1 = 0x18,
+        XYOFFSET_2 = 0x19,
+        PRMODECONT = 0x1A,
+        PRMODE = 0x1B,
+        TEXCLUT = 0x1C,
+        SCANMSK = 0x22,
+        MIPTBP1_1 = 0x34,
+        MIPTBP1_2 = 0x35,
+        MIPTBP2_1 = 0x36,
+        MIPTBP2_2 = 0x37,
+        TEXA = 0x3B,
+        FOGCOL = 0x3D,
+        TEXFLUSH = 0x3F,
+        SCISSOR_1 = 0x40,
+        SCISSOR_2 = 0x41,
+        ALPHA_1 = 0x42,
+        ALPHA_2 = 0x43,
+        DIMX = 0x44,
+        DTHE = 0x45,
+        COLCLAMP = 0x46,
+        TEST_1 = 0x47,
+        TEST_2 = 0x48,
+        PABE = 0x49,
+        FBA_1 = 0x4A,
+        FBA_2 = 0x4B,
+        FRAME_1 = 0x4C,
+        FRAME_2 = 0x4D,
+        ZBUF_1 = 0x4E,
+        ZBUF_2 = 0x4F,
+        BITBLTBUF = 0x50,
+        TRXPOS = 0x51,
+        TRXREG = 0x52,
+        TRXDIR = 0x53,
+        HWREG = 0x54,
+        SIGNAL = 0x60,
+        FINISH = 0x61,
+        LABEL = 0x62,
+    };
+
+    static constexpr uint32_t kNumRegisters = 0x80;
+
+    GSState();
+
+    // VRAM, its dirty page mask and the privileged registers, owned by PS2Memory
+    void attach(uint8_t* vram, GSLocalMemory::PageMask* dirtyPages, GSRegisters* privileged);
+    void reset();
+
+    uint64_t reg(uint32_t address) const { return m_regs[address % kNumRegisters]; }
+
+    /**
+     * @brief Write a general register (A+D, REGLIST)
+     */
+    void writeRegister(uint32_t address, uint64_t value);
+
+    /**
+     * @brief Write one PACKED qword for the given register descriptor
+     */
+    void writePacked(uint32_t descriptor, const uint8_t* qword);
+
+    /**
+     * @brief Feed IMAGE / HWREG data to the active host to local transmission
+     */
+    void writeImage(const uint8_t* data, size_t bytes);
+
+    bool transferActive() const { return m_transfer.active; }
+
+    // True once after SIGNAL or FINISH raised an unmasked GS interrupt
+    bool takeInterrupt();
+
+    /**
+     * @brief Draw every queued primitive so VRAM is up to date
+     */
+    void flush() { m_rasterizer.flush(); }
+
+    /**
+     * @brief Raw entries of the last CLUT load, PSMCT32 words or PSMCT16 halves as clutFormat() says
+     *
+     * 16 entries start at the CSA of that load, 256 at the start of the buffer.
+     */
+    void readClut(uint32_t* entries, uint32_t count) const;
+    uint32_t clutFormat() const { return m_clutFormat; }
+
+    // Changes whenever the CLUT buffer is reloaded
+    uint32_t clutGeneration() const { return m_clutGeneration; }
+
+    void setRasterizerThreads(uint32_t threads) { m_rasterizer.setThreadCount(threads); }
+    uint32_t rasterizerThreads() const { return m_rasterizer.threadCount(); }
+
+private:
+    struct Transfer
+    {
+        bool active = false;
+        uint32_t psm = 0;
+        uint32_t bp = 0;
+        uint32_t bw = 0;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t bits = 0;
+        uint64_t pixelsDone = 0;
+        std::vector<uint8_t> partialRow; // bytes of a row not complete yet
+    };
+
+    std::array<uint64_t, kNumRegisters> m_regs{};
+    uint32_t m_packedQ = 0x3F800000; // Q from the last PACKED ST, 1.0f until then
+    Transfer m_transfer;
+    bool m_interruptPending = false;
+
+    uint8_t* m_vram = nullptr;
+    GSLocalMemory::PageMask* m_dirtyPages = nullptr;
+    GSRegisters* m_privileged = nullptr;
+
+    GSRasterizer m_rasterizer;
+    std::array<GSRasterizer::Vertex, 3> m_vertices{};
+    uint32_t m_vertexCount = 0;
+    bool m_stateDirty = true; // drawing registers changed since the rasterizer last got them
+
+    // CLUT buffer, 16-bit entries; CT32 colours keep their low half at [i] and high half at [i + 256]
+    std::array<uint16_t, 512> m_clut{};
+    std::array<uint32_t, 256> m_palette{};
+    uint32_t m_cbp0 = 0;
+    uint32_t m_cbp1 = 0;
+    uint32_t m_clutFormat = 0; // CPSM and CSA offset of the last load
+    uint32_t m_clutOffset = 0;
+    uint32_t m_clutGeneration = 0;
+
+    void vertexKick(uint64_t xyz, bool hasFog, bool draw);
+    void drawPrimitive(uint32_t type);
+    GSDrawState drawState(uint64_t attributes) const;
+    void loadClut(uint64_t tex0);
+    void expandPalette(uint64_t tex0);
+
+    void startTransfer();
+    void copyLocalToLocal();
+    void writeTransferRows(const uint8_t* src, uint32_t rows);
+    void writeTransferPixels(const uint8_t* src, size_t bytes);
+    void raiseInterrupt(uint64_t csrBit, uint64_t imrBit);
+};
+
+#endif // GS_STATE_H
@@ -0,0 +1,83 @@
+#ifndef PS2_ALARMS_H
+#define PS2_ALARMS_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Kernel alarms (SetAlarm/CancelAlarm) kept in a hierarchical timer wheel.
+//
+// Time is counted in HSYNC ticks. Level 0 has one slot per tick for the next
+// 256 ticks, level 1 one slot per 256 ticks and level 2 one slot per 16384
+// ticks, which covers the 16-bit range SetAlarm accepts with room to spare.
+// Slots are intrusive lists over a fixed pool, so adding and cancelling are
+// O(1), and advancing costs one slot visit per elapsed tick plus a cascade
+// every 256 ticks.
+class PS2AlarmService
+{
+public:
+    static constexpr int kMaxAlarms = 64; // Same limit as the EE kernel
+
+    struct Expired
+    {
+        int id;
+        uint32_t handler;
+        uint32_t arg;
+        uint32_t gp;
+        uint16_t ticks;
+    };
+
+    PS2AlarmService();
+
+    PS2AlarmService(const PS2AlarmService &) = delete;
+    PS2AlarmService &operator=(const PS2AlarmService &) = delete;
+
+    void reset(uint64_t now);
+
+    // Schedules an alarm `ticks` HSYNCs after `now`. Returns the alarm id, or -1 if the pool is full.
+    int add(uint64_t now, uint16_t ticks, uint32_t handler, uint32_t arg, uint32_t gp);
+    bool cancel(int id);
+
+    // Moves time forward to `now` and appends every alarm that expired, in expiry order
+    void advance(uint64_t now, std::vector<Expired> &expired);
+
+    // Earliest pending expiry, if any alarm is armed
+    std::optional<uint64_t> nextExpiry() const;
+    uint64_t now() const { return m_now; }
+
+private:
+    static constexpr int kLevel0Bits = 8;
+    static constexpr int kLevelBits = 6;
+    static constexpr int kLevel0Slots = 1 << kLevel0Bits;
+    static constexpr int kLevelSlots = 1 << kLevelBits;
+    static constexpr int kNil = -1;
+
+    struct Node
+    {
+        uint64_t expire = 0;
+        uint32_t handler = 0;
+        uint32_t arg = 0;
+        uint32_t gp = 0;
+        uint16_t ticks = 0;
+        uint16_t generation = 0; // Keeps stale ids from cancelling a reused slot
+        bool active = false;
+        int prev = kNil;
+        int next = kNil;
+        int *head = nullptr; // Slot list the node is linked into
+    };
+
+    std::array<Node, kMaxAlarms> m_nodes;
+    std::array<int, kLevel0Slots> m_level0;
+    std::array<int, kLevelSlots> m_level1;
+    std::array<int, kLevelSlots> m_level2;
+    uint64_t m_now = 0;
+    int m_active = 0;
+
+    void insert(int index);
+    void unlink(int index);
+    void cascade(int &head);
+    int makeId(int index) const;
+};
+
+#endif // PS2_ALARMS_H
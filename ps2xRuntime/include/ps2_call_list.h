@@ -20,6 +20,8 @@
     X(SleepThread)            \
     X(WakeupThread)           \
     X(iWakeupThread)          \
+    X(CancelWakeupThread)     \
+    X(iCancelWakeupThread)    \
     X(ChangeThreadPriority)   \
     X(RotateThreadReadyQueue) \
     X(ReleaseWaitThread)      \
@@ -52,10 +54,20 @@
     X(CancelAlarm)            \
     X(iCancelAlarm)           \
                               \
+    X(AddIntcHandler)         \
+    X(AddIntcHandler2)        \
+    X(RemoveIntcHandler)      \
+    X(AddDmacHandler)         \
+    X(AddDmacHandler2)        \
+    X(RemoveDmacHandler)      \
     X(EnableIntc)             \
+    X(iEnableIntc)            \
     X(DisableIntc)            \
+    X(iDisableIntc)           \
     X(EnableDmac)             \
+    X(iEnableDmac)            \
     X(DisableDmac)            \
+    X(iDisableDmac)           \
                               \
     X(SifStopModule)          \
     X(SifLoadModule)          \
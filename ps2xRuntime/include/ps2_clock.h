@@ -0,0 +1,76 @@
+#ifndef PS2_CLOCK_H
+#define PS2_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+// Guest time base. Video timing (HSYNC) is what the EE kernel counts alarms in,
+// so everything timed in the runtime is expressed in scanlines since reset.
+//
+// Guest time normally follows the host clock. An unthrottled runtime may skip it
+// ahead while every guest thread is idle; all host time points handed out here
+// already account for the skip.
+class PS2Clock
+{
+public:
+    using HostClock = std::chrono::steady_clock;
+
+    enum class VideoMode
+    {
+        NTSC,
+        PAL,
+    };
+
+    static constexpr double kNtscHsyncHz = 15734.264; // 525 lines at 59.94 Hz
+    static constexpr double kPalHsyncHz = 15625.0;    // 625 lines at 50 Hz
+    static constexpr uint64_t kEeClockHz = 294912000; // R5900 core, drives COP0 Count
+    static constexpr uint64_t kBusClockHz = 147456000; // EE bus, drives the timers
+
+    PS2Clock();
+
+    void reset();
+
+    // Switching standards keeps every count monotonic; the new field starts at the switch
+    void setVideoMode(VideoMode mode);
+    VideoMode videoMode() const { return m_mode; }
+    double hsyncHz() const { return m_mode == VideoMode::PAL ? kPalHsyncHz : kNtscHsyncHz; }
+    // Fields are 262.5 (NTSC) or 312.5 (PAL) lines, so they are counted in half lines
+    uint32_t halfLinesPerField() const { return m_mode == VideoMode::PAL ? 625 : 525; }
+    // Lines of vertical blank at the end of each field
+    uint32_t blankLines() const { return m_mode == VideoMode::PAL ? 25 : 22; }
+
+    // Scanlines elapsed since reset
+    uint64_t hsyncCount() const;
+    // Host time at which the given scanline starts
+    HostClock::time_point timeOfHsync(uint64_t hsync) const;
+
+    // VBLANK edges since reset: even edges are VBLANK_START, odd ones VBLANK_END
+    uint64_t vblankEdges() const;
+    HostClock::time_point timeOfVblankEdge(uint64_t edge) const;
+
+    // Cycles of a clock running at `hz` since reset
+    uint64_t cycles(uint64_t hz) const;
+    uint64_t eeCycles() const { return cycles(kEeClockHz); }
+    uint64_t busCycles() const { return cycles(kBusClockHz); }
+    // Host time at which a clock running at `hz` reaches the given cycle
+    HostClock::time_point timeOfCycles(uint64_t hz, uint64_t cycle) const;
+
+    // Moves guest time forward so that `when` is now. Earlier times are ignored.
+    void skipTo(HostClock::time_point when);
+
+private:
+    HostClock::time_point m_start;
+    HostClock::duration m_skipped{};
+
+    // Counts at the last video mode switch, and the guest time it happened at
+    VideoMode m_mode = VideoMode::NTSC;
+    HostClock::duration m_segmentStart{};
+    uint64_t m_segmentHsync = 0;
+    uint64_t m_segmentEdge = 0;
+
+    HostClock::duration elapsed() const;
+    double segmentSeconds() const;
+    HostClock::time_point timeOfSegmentOffset(double seconds) const;
+};
+
+#endif // PS2_CLOCK_H
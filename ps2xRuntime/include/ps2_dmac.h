@@ -0,0 +1,192 @@
+#ifndef PS2_DMAC_H
+#define PS2_DMAC_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PS2InterruptController;
+
+// EE DMA controller: the ten channel register blocks (Dn_CHCR/MADR/QWC/TADR/ASR0/ASR1/SADR
+// from 0x10008000) and the global D_CTRL/D_PCR/D_SQWC/D_RBSR/D_RBOR registers. D_STAT
+// belongs to the interrupt controller.
+//
+// Setting CHCR.STR snapshots the channel and queues it for a worker thread, which runs
+// the whole transfer: normal, source chain (CNT/NEXT/REF/REFS/REFE/CALL/RET/END with the
+// ASR stack), destination chain for the peripheral-to-memory channels, and interleave
+// for the scratchpad channels. Each tag's data goes to the channel's sink as one span.
+// With D_CTRL.MFD set, fromSPR writes into the ring at D_RBOR and the drain channel reads
+// its tags from there. A drain that runs out of data sets MEIS and parks until fromSPR
+// adds more.
+//
+// Until the guest sees a transfer finish, its channel keeps STR set and its registers
+// hold their start values. Finished transfers are applied by update() on the guest
+// thread: the channel registers are written back, STR is cleared and D_STAT CIS raised.
+// Sinks run on the worker. Anything else touching the state behind a sink (GS, VIF)
+// must call waitIdle() first.
+class PS2Dmac
+{
+public:
+    static constexpr int kNumChannels = 10;
+
+    enum Channel
+    {
+        VIF0 = 0,
+        VIF1 = 1,
+        GIF = 2,
+        IPU_FROM = 3,
+        IPU_TO = 4,
+        SIF0 = 5,
+        SIF1 = 6,
+        SIF2 = 7,
+        SPR_FROM = 8,
+        SPR_TO = 9,
+    };
+
+    // Channel register offsets
+    static constexpr uint32_t CHCR = 0x00;
+    static constexpr uint32_t MADR = 0x10;
+    static constexpr uint32_t QWC = 0x20;
+    static constexpr uint32_t TADR = 0x30;
+    static constexpr uint32_t ASR0 = 0x40;
+    static constexpr uint32_t ASR1 = 0x50;
+    static constexpr uint32_t SADR = 0x80;
+
+    static constexpr uint32_t D_CTRL = 0x1000E000;
+    static constexpr uint32_t D_PCR = 0x1000E020;
+    static constexpr uint32_t D_SQWC = 0x1000E030;
+    static constexpr uint32_t D_RBSR = 0x1000E040;
+    static constexpr uint32_t D_RBOR = 0x1000E050;
+    static constexpr uint32_t D_STADR = 0x1000E060;
+    static constexpr uint32_t D_ENABLER = 0x1000F520;
+    static constexpr uint32_t D_ENABLEW = 0x1000F590;
+
+    // CHCR bits
+    static constexpr uint32_t CHCR_DIR = 0x001; // 1 = from memory
+    static constexpr uint32_t CHCR_MOD = 0x00C; // 0 = normal, 1 = chain, 2 = interleave
+    static constexpr uint32_t CHCR_ASP = 0x030;
+    static constexpr uint32_t CHCR_TTE = 0x040;
+    static constexpr uint32_t CHCR_TIE = 0x080;
+    static constexpr uint32_t CHCR_STR = 0x100;
+
+    // D_STAT bits past the channel CIS bits
+    static constexpr int kStallInterrupt = 13;
+    static constexpr int kMfifoEmptyInterrupt = 14;
+    static constexpr int kBusErrorInterrupt = 15;
+
+    // Hands a span of qwords to the peripheral. Runs on the worker; returns the INTC
+    // causes the data raised, one bit each, which are raised when the transfer finishes.
+    using Sink = std::function<uint32_t(const uint8_t *data, uint32_t qwc)>;
+
+    explicit PS2Dmac(PS2InterruptController &interrupts);
+    ~PS2Dmac();
+
+    PS2Dmac(const PS2Dmac &) = delete;
+    PS2Dmac &operator=(const PS2Dmac &) = delete;
+
+    void attach(uint8_t *rdram, uint32_t ramSize, uint8_t *scratchpad);
+    // Channels without a sink drop what they are sent; peripheral-to-memory channels
+    // other than fromSPR have nothing to deliver and finish straight away
+    void setSink(int channel, Sink sink);
+    // Called on the worker after it queues finished transfers, so the guest can be told to update()
+    void setCompletionNotifier(std::function<void()> notifier) { m_notifier = std::move(notifier); }
+    // Without a worker, transfers run to completion inside the CHCR write. Deterministic, for tools and tests.
+    void setThreaded(bool threaded);
+
+    // Waits for running transfers and drops parked ones
+    void reset();
+
+    static bool isRegister(uint32_t address);
+    uint32_t read(uint32_t address);
+    void write(uint32_t address, uint32_t value);
+
+    void update();
+    void waitIdle();
+    bool busy(int channel) const { return (m_busy & (1u << channel)) != 0; }
+
+    uint64_t startCount() const { return m_startCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Registers
+    {
+        uint32_t chcr = 0;
+        uint32_t madr = 0;
+        uint32_t qwc = 0;
+        uint32_t tadr = 0;
+        uint32_t asr[2] = {};
+        uint32_t sadr = 0;
+    };
+
+    struct Transfer
+    {
+        int channel = 0;
+        Registers regs;
+        uint32_t ctrl = 0;
+        uint32_t sqwc = 0;
+        uint32_t rbor = 0;
+        uint32_t rbsr = 0;
+        uint32_t intc = 0;     // INTC causes raised by the sink
+        uint32_t dstat = 0;    // D_STAT bits to raise besides the channel's CIS
+        bool parked = false;   // MFIFO drain waiting for data
+    };
+
+    PS2InterruptController &m_interrupts;
+    uint8_t *m_rdram = nullptr;
+    uint32_t m_ramSize = 0;
+    uint8_t *m_scratchpad = nullptr;
+    std::array<Sink, kNumChannels> m_sinks;
+    std::function<void()> m_notifier;
+
+    // Guest side
+    std::array<Registers, kNumChannels> m_channels{};
+    uint32_t m_ctrl = 1;
+    uint32_t m_pcr = 0;
+    uint32_t m_sqwc = 0;
+    uint32_t m_rbsr = 0;
+    uint32_t m_rbor = 0;
+    uint32_t m_stadr = 0;
+    uint32_t m_enable = 0;
+    uint32_t m_busy = 0; // channels started and not yet seen to finish
+    std::atomic<uint64_t> m_startCount{0};
+
+    // Worker side. m_ringWrite is where fromSPR will write next in MFIFO mode.
+    uint32_t m_ringWrite = 0;
+    bool m_ringWriteKnown = false;
+    uint32_t m_reportedUnsupported = 0;
+
+    bool m_threaded = true;
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<Transfer> m_queue;
+    std::vector<Transfer> m_parked;
+    std::vector<Transfer> m_finished;
+    bool m_running = false;
+    bool m_quit = false;
+    std::atomic<bool> m_finishedPending{false};
+
+    static int channelIndex(uint32_t base);
+    void start(int channel);
+    void finish(const Transfer &transfer);
+    void stopWorker();
+    void workerLoop();
+
+    // Transfer engine, worker side
+    void run(Transfer &transfer);
+    bool drainsMfifo(const Transfer &transfer) const;
+    uint8_t *pointer(uint32_t address, uint32_t &qwcAvailable) const;
+    bool toPeripheral(Transfer &transfer, uint32_t address, uint32_t qwc, bool ring);
+    bool transferSpr(Transfer &transfer, uint32_t address, uint32_t qwc, bool ring);
+    bool sourceChain(Transfer &transfer);
+    bool destinationChain(Transfer &transfer);
+    bool interleave(Transfer &transfer);
+};
+
+#endif // PS2_DMAC_H
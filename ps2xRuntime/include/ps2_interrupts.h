@@ -0,0 +1,92 @@
+#ifndef PS2_INTERRUPTS_H
+#define PS2_INTERRUPTS_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// INTC and DMAC interrupt state (INTC_STAT/INTC_MASK at 0x1000F000, D_STAT at
+// 0x1000E010) together with the kernel's handler chains from AddIntcHandler
+// and AddDmacHandler.
+//
+// Raising an interrupt only sets its status bit. The runtime collects the
+// unmasked bits at the next safe point and runs the handlers there, the same
+// way alarms are delivered.
+class PS2InterruptController
+{
+public:
+    static constexpr uint32_t INTC_STAT = 0x1000F000;
+    static constexpr uint32_t INTC_MASK = 0x1000F010;
+    static constexpr uint32_t D_STAT = 0x1000E010;
+
+    static constexpr int kNumIntcCauses = 15;
+    static constexpr int kNumDmacChannels = 16; // CIS 0-9 plus SIS/MEIS/BEIS in the upper half
+
+    enum IntcCause
+    {
+        INTC_GS = 0,
+        INTC_SBUS = 1,
+        INTC_VBLANK_START = 2,
+        INTC_VBLANK_END = 3,
+        INTC_VIF0 = 4,
+        INTC_VIF1 = 5,
+        INTC_VU0 = 6,
+        INTC_VU1 = 7,
+        INTC_IPU = 8,
+        INTC_TIM0 = 9,
+        INTC_TIM1 = 10,
+        INTC_TIM2 = 11,
+        INTC_TIM3 = 12,
+        INTC_SFIFO = 13,
+        INTC_VU0WD = 14,
+    };
+
+    struct Handler
+    {
+        int id;
+        uint32_t func;
+        uint32_t arg;
+        uint32_t gp;
+    };
+
+    PS2InterruptController();
+
+    void reset();
+
+    // Hardware side
+    static bool isRegister(uint32_t address);
+    uint32_t read(uint32_t address) const;
+    void write(uint32_t address, uint32_t value);
+    void raiseIntc(int cause);
+    void raiseDmac(int channel);
+    bool pending() const;
+    // Acknowledges the unmasked status bits and returns them, one bit per cause / channel
+    uint32_t takeIntc();
+    uint32_t takeDmac();
+
+    // Kernel side. Both return whether the source was previously masked / unmasked.
+    bool setIntcEnabled(int cause, bool enabled);
+    bool setDmacEnabled(int channel, bool enabled);
+
+    // `atHead` mirrors the kernel's `next` argument: non-zero puts the handler in front of the chain
+    int addIntcHandler(int cause, uint32_t func, bool atHead, uint32_t arg, uint32_t gp);
+    int addDmacHandler(int channel, uint32_t func, bool atHead, uint32_t arg, uint32_t gp);
+    bool removeIntcHandler(int cause, int id);
+    bool removeDmacHandler(int channel, int id);
+    const std::vector<Handler> &intcHandlers(int cause) const { return m_intcHandlers[cause]; }
+    const std::vector<Handler> &dmacHandlers(int channel) const { return m_dmacHandlers[channel]; }
+
+private:
+    uint32_t m_intcStat = 0;
+    uint32_t m_intcMask = 0;
+    uint32_t m_dmacStat = 0; // D_STAT: status in bits 0-15, mask in bits 16-31
+    int m_nextHandlerId = 1;
+
+    std::array<std::vector<Handler>, kNumIntcCauses> m_intcHandlers;
+    std::array<std::vector<Handler>, kNumDmacChannels> m_dmacHandlers;
+
+    int addHandler(std::vector<Handler> &chain, uint32_t func, bool atHead, uint32_t arg, uint32_t gp);
+    static bool removeHandler(std::vector<Handler> &chain, int id);
+};
+
+#endif // PS2_INTERRUPTS_H
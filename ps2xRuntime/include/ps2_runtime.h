@@ -8,12 +8,26 @@
 #include <functional>
 #include <immintrin.h> // For SSE/AVX instructions
 #include <atomic>
+#include <mutex>
 #include <filesystem>
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <optional>
+#include <utility>
 
 #include "gs_renderer.h"
+#include "gs_local_memory.h"
+#include "gs_state.h"
+#include "gs_gif.h"
+#include "ps2_scheduler.h"
+#include "ps2_clock.h"
+#include "ps2_alarms.h"
+#include "ps2_timers.h"
+#include "ps2_interrupts.h"
+#include "ps2_dmac.h"
+#include "ps2_vif.h"
+#include "ps2_vu.h"
 
 constexpr uint32_t PS2_RAM_SIZE = 32 * 1024 * 1024; // 32MB
 constexpr uint32_t PS2_RAM_MASK = 0x1FFFFFF;        // Mask for 32MB alignment
@@ -24,6 +38,7 @@ constexpr uint32_t PS2_IO_BASE = 0x10000000;        // Base for many I/O regs (T
 constexpr uint32_t PS2_IO_SIZE = 0x10000;           // 64KB
 constexpr uint32_t PS2_BIOS_BASE = 0x1FC00000;      // Or BFC00000 depending on KSEG
 constexpr uint32_t PS2_BIOS_SIZE = 4 * 1024 * 1024; // 4MB
+constexpr uint32_t PS2_INTERRUPT_STACK_TOP = 0x00080000; // Top of kernel RAM; guest handlers run on this stack
 
 constexpr uint32_t PS2_VU0_CODE_BASE = 0x11000000; // Base address as seen from EE
 constexpr uint32_t PS2_VU0_DATA_BASE = 0x11004000;
@@ -307,22 +322,6 @@ struct GSRegisters
     uint64_t siglblid; // Signal label ID
 };
 
-// PS2 VIF (VPU Interface) registers
-struct VIFRegisters
-{
-    uint32_t stat;   // Status
-    uint32_t fbrst;  // VIF Force Break
-    uint32_t err;    // Error
-    uint32_t mark;   // Mark
-    uint32_t cycle;  // Cycle
-    uint32_t mode;   // Mode
-    uint32_t num;    // Number of data
-    uint32_t mask;   // Mask
-    uint32_t code;   // Code
-    uint32_t itops;  // ITOPs
-    uint32_t itop;   // ITOP
-};
-
 // PS2 Memory management
 class PS2Memory
 {
@@ -350,13 +349,54 @@ public:
     uint8_t *getRDRAM() { return m_rdram; }
     uint8_t *getScratchpad() { return m_scratchpad; }
     uint8_t *getGSVRAM() const { return m_gsvram; }
-    GSRegisters &gs() { return m_gs; }
+    // The GS is fed by the DMAC worker and VU1, so both accessors wait for them first
+    GSRegisters &gs()
+    {
+        waitIdle();
+        return m_gs;
+    }
+    PS2Timers &timers() { return m_timers; }
+    PS2InterruptController &interrupts() { return m_interrupts; }
+    PS2Dmac &dmac() { return m_dmac; }
+    // VIF0/VIF1 are fed by the DMAC worker as well
+    PS2Vif &vif(int unit)
+    {
+        waitIdle();
+        return unit == 0 ? m_vif0 : m_vif1;
+    }
+    PS2VectorUnit &vu0() { return m_vu0; }
+    PS2VectorUnit &vu1() { return m_vu1; }
+    // VU micro and data memory as mapped at 0x11000000; the VIFs and VU1 use it off the guest thread
+    uint8_t *getVUCode(int unit) { return m_vuMemory + ((unit == 0 ? PS2_VU0_CODE_BASE : PS2_VU1_CODE_BASE) - PS2_VU0_CODE_BASE); }
+    uint8_t *getVUData(int unit) { return m_vuMemory + ((unit == 0 ? PS2_VU0_DATA_BASE : PS2_VU1_DATA_BASE) - PS2_VU0_CODE_BASE); }
+    GSState &gsState()
+    {
+        waitIdle();
+        return m_gsState;
+    }
+    // Waits for DMA transfers and the VU1 microprogram they started
+    void waitIdle()
+    {
+        m_dmac.waitIdle();
+        m_vu1.waitIdle();
+    }
+    // Feeds GIF packets to the GS on the given path and raises INTC_GS if they asked for it
+    void gifTransfer(GSGif::Path path, const uint8_t *data, uint32_t qwc);
+    // GS VRAM pages written since the display last converted them
+    GSLocalMemory::PageMask &vramDirtyPages() { return m_vramDirtyPages; }
+    void markVramWritten(uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+    {
+        GSLocalMemory::markPages(m_vramDirtyPages, psm, bp, bw, x, y, w, h);
+    }
+
+    // True once after the guest rewrites the displayed framebuffer registers
+    bool takeDisplayChanged() { return std::exchange(m_displayChanged, false); }
 
     uint32_t translateAddress(uint32_t addr) const;
     void registerCodeRegion(uint32_t start, uint32_t end);
     
     // Hardware counters
-    uint64_t dmaStartCount() const { return m_dmaStartCount.load(std::memory_order_relaxed); }
+    uint64_t dmaStartCount() const { return m_dmac.startCount(); }
     uint64_t gifCopyCount() const { return m_gifCopyCount.load(std::memory_order_relaxed); }
     uint64_t gsWriteCount() const { return m_gsWriteCount.load(std::memory_order_relaxed); }
     uint64_t vifWriteCount() const { return m_vifWriteCount.load(std::memory_order_relaxed); }
@@ -386,27 +426,39 @@ public:
     
     // Utility methods
     bool isScratchpad(uint32_t address) const;
+    uint8_t *vuMemoryPtr(uint32_t address);
+    // Same for a store: one into micro memory makes the VU match its recompiled programs again
+    uint8_t *vuMemoryWritePtr(uint32_t address);
     uint64_t* gsRegPtr(GSRegisters& regs, uint32_t address);
+    void writeGsCsr(uint64_t value);
+    void noteDisplayWrite(const uint64_t *reg);
 
 private:
     uint8_t *m_rdram;
     uint8_t *m_scratchpad;
     uint8_t *m_gsvram;
+    uint8_t *m_vuMemory = nullptr;
     uint8_t *iop_ram = nullptr;
     GSRegisters m_gs;
+    PS2Timers m_timers;
+    PS2InterruptController m_interrupts;
+    PS2Dmac m_dmac{m_interrupts};
+    GSState m_gsState;
+    GSGif m_gif{m_gsState};
+    PS2Vif m_vif0{0};
+    PS2Vif m_vif1{1};
+    PS2VectorUnit m_vu0{0, m_interrupts};
+    PS2VectorUnit m_vu1{1, m_interrupts};
+    std::mutex m_gifMutex; // the DMAC worker and VU1 both feed the GIF
     std::vector<CodeRegion> m_codeRegions;
     std::unordered_map<uint32_t, uint32_t> m_ioRegisters;
     std::vector<TLBEntry> m_tlbEntries;
-    
-    uint32_t vif0_regs[32];
-    uint32_t vif1_regs[32];
-    uint32_t dma_regs[128];
-    
-    std::atomic<uint64_t> m_dmaStartCount{0};
+
     std::atomic<uint64_t> m_gifCopyCount{0};
     std::atomic<uint64_t> m_gsWriteCount{0};
     std::atomic<uint64_t> m_vifWriteCount{0};
-    bool m_seenGifCopy = false;
+    bool m_displayChanged = false;
+    GSLocalMemory::PageMask m_vramDirtyPages;
 };
 
 // PS2 Runtime
@@ -421,13 +473,70 @@ public:
     bool initialize(const char *title);
     bool loadELF(const std::string &elfPath);
     void registerFunction(uint32_t address, RecompiledFunction func);
+    // Microprograms ps2recomp compiled; VU0/VU1 run them in place of the interpreter when their code is loaded
+    void registerVuMicroprogram(const PS2VuMicroprogram &program);
     bool hasFunction(uint32_t address) const;
     RecompiledFunction lookupFunction(uint32_t address);
 
+    // How guest video time relates to the host:
+    //   Realtime    - VBLANK follows the host clock at the NTSC/PAL field rate
+    //   Unthrottled - as Realtime, but time the guest spends idle is skipped (benchmarking)
+    //   HostVsync   - every host presentation raises VBLANK (play without tearing or drift)
+    enum class FramePacing
+    {
+        Realtime,
+        Unthrottled,
+        HostVsync,
+    };
+
+    // Set before initialize(); the window's vsync setting depends on it
+    void setFramePacing(FramePacing pacing) { m_pacing = pacing; }
+    FramePacing framePacing() const { return m_pacing; }
+    void setVideoMode(PS2Clock::VideoMode mode) { m_clock.setVideoMode(mode); }
+
+    // Runs without a window or GL context. Frames are converted at guest VBLANK instead of by
+    // the render loop, which also makes dumped frames line up with guest time.
+    struct HeadlessOptions
+    {
+        uint64_t maxFrames = 0;    // stop after this many frames, 0 for no limit
+        double maxSeconds = 0.0;   // stop after this much host time, 0 for no limit
+        std::string dumpDirectory; // writes frame_NNNNNN.ppm here when not empty
+    };
+
+    // Set before initialize()
+    void setHeadless(const HeadlessOptions &options) { m_headless = options; }
+
+    // Host threads the GS rasterizer draws with, set before initialize(); 0 picks one from the core count
+    void setRasterizerThreads(uint32_t threads) { m_rasterizerThreads = threads; }
+    bool isHeadless() const { return m_headless.has_value(); }
+    uint64_t presentedFrames() const { return m_presentedFrames.load(std::memory_order_relaxed); }
+
     PS2Memory &memory() { return m_memory; }
     R5900Context &cpu() { return m_cpuContext; }
     GSRenderer &renderer() { return m_renderer; }
+    PS2Scheduler &scheduler() { return m_scheduler; }
+    PS2Clock &clock() { return m_clock; }
+    PS2AlarmService &alarms() { return m_alarms; }
+
+    // Runs a guest interrupt or alarm handler on the kernel interrupt stack and returns its v0
+    int32_t callGuestHandler(uint32_t handler, uint32_t gp, uint32_t a0, uint32_t a1, uint32_t a2);
 
+    // Generated code calls this on every backward branch. Every kLoopSafePointInterval
+    // calls it runs a scheduler safe point, so a thread spinning in a loop still sees
+    // alarms and interrupts without paying for a clock read on each iteration.
+    void loopSafePoint()
+    {
+        if (--m_loopBudget <= 0) [[unlikely]]
+        {
+            loopSafePointSlow();
+        }
+    }
+
+    // COP0 Count ticks at the core clock; it is worked out from host time when MFC0 reads it
+    uint32_t readCop0Count(R5900Context *ctx);
+    void writeCop0Count(R5900Context *ctx, uint32_t value);
+
+    // VCALLMS/VCALLMSR: runs the VU0 program to its end on the macro-mode registers in ctx
     void executeVU0Microprogram(uint8_t *rdram, R5900Context *ctx, uint32_t address);
     void SignalException(R5900Context *ctx, PS2Exception exception);
     void HandleIntegerOverflow(R5900Context *ctx);
@@ -447,6 +556,20 @@ private:
     PS2Memory m_memory;
     R5900Context m_cpuContext;
     GSRenderer m_renderer;
+    PS2Scheduler m_scheduler;
+    PS2Clock m_clock;
+    PS2AlarmService m_alarms;
+    uint64_t m_countEpoch = 0; // EE cycle at which Count last held m_countBase
+    uint32_t m_countBase = 0;
+    FramePacing m_pacing = FramePacing::Realtime;
+    uint64_t m_vblankEdgesSeen = 0;
+    std::optional<uint64_t> m_hostVblankEnd; // HSYNC at which a host-driven blank ends
+    std::optional<HeadlessOptions> m_headless;
+    std::atomic<uint64_t> m_presentedFrames{0};
+    bool m_framePublished = false; // a DISPFB write published a frame during this field
+    uint32_t m_rasterizerThreads = 0;
+    static constexpr int32_t kLoopSafePointInterval = 4096;
+    int32_t m_loopBudget = kLoopSafePointInterval;
     std::unordered_map<uint32_t, RecompiledFunction> m_functionTable;
 
     struct LoadedModule
@@ -457,6 +580,54 @@ private:
         bool active;
     };
     std::vector<LoadedModule> m_loadedModules;
+
+    std::chrono::steady_clock::time_point serviceTimers();
+    std::chrono::steady_clock::time_point serviceVblank();
+    void hostVsync();
+    void vblankStart();
+    void vblankEnd();
+    void presentHeadlessFrame();
+    void runWindowed();
+    void runHeadless();
+    void dispatchInterrupts();
+    void loopSafePointSlow();
 };
 
+// Generated code indexes RDRAM directly. Hardware registers (0x10000000-0x1FFFFFFF and
+// the KSEG1 alias at 0xB0000000) have to reach PS2Memory so timers, DMAC and the GS see them.
+inline bool ps2IsHardwareAddress(uint32_t addr)
+{
+    uint32_t segment = addr >> 28;
+    return segment == 0x1 || segment == 0xB;
+}
+
+#define PS2_GUEST_READ(type, method, addr)                                 \
+    if (ps2IsHardwareAddress(addr)) [[unlikely]]                           \
+    {                                                                      \
+        return runtime->memory().method(addr & 0x1FFFFFFF);                \
+    }                                                                      \
+    return *reinterpret_cast<type *>(rdram + (addr & PS2_RAM_MASK))
+
+#define PS2_GUEST_WRITE(type, method, addr, val)                           \
+    if (ps2IsHardwareAddress(addr)) [[unlikely]]                           \
+    {                                                                      \
+        runtime->memory().method(addr & 0x1FFFFFFF, val);                  \
+        return;                                                            \
+    }                                                                      \
+    *reinterpret_cast<type *>(rdram + (addr & PS2_RAM_MASK)) = val
+
+inline uint8_t ps2GuestRead8(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr) { PS2_GUEST_READ(uint8_t, read8, addr); }
+inline uint16_t ps2GuestRead16(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr) { PS2_GUEST_READ(uint16_t, read16, addr); }
+inline uint32_t ps2GuestRead32(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr) { PS2_GUEST_READ(uint32_t, read32, addr); }
+inline uint64_t ps2GuestRead64(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr) { PS2_GUEST_READ(uint64_t, read64, addr); }
+inline __m128i ps2GuestRead128(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr) { PS2_GUEST_READ(__m128i, read128, addr); }
+inline void ps2GuestWrite8(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr, uint8_t val) { PS2_GUEST_WRITE(uint8_t, write8, addr, val); }
+inline void ps2GuestWrite16(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr, uint16_t val) { PS2_GUEST_WRITE(uint16_t, write16, addr, val); }
+inline void ps2GuestWrite32(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr, uint32_t val) { PS2_GUEST_WRITE(uint32_t, write32, addr, val); }
+inline void ps2GuestWrite64(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr, uint64_t val) { PS2_GUEST_WRITE(uint64_t, write64, addr, val); }
+inline void ps2GuestWrite128(uint8_t *rdram, PS2Runtime *runtime, uint32_t addr, __m128i val) { PS2_GUEST_WRITE(__m128i, write128, addr, val); }
+
+#undef PS2_GUEST_READ
+#undef PS2_GUEST_WRITE
+
 #endif // PS2_RUNTIME_H
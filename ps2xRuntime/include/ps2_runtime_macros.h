@@ -75,17 +75,17 @@ inline uint32_t ps2_clz32(uint32_t val) {
 #define PS2_VDIV(a, b) _mm_div_ps((__m128)(a), (__m128)(b))
 #define PS2_VMULQ(a, q) _mm_mul_ps((__m128)(a), _mm_set1_ps(q))
 
-// Memory access helpers
-#define READ8(addr) (*(uint8_t*)((rdram) + ((addr) & PS2_RAM_MASK)))
-#define READ16(addr) (*(uint16_t*)((rdram) + ((addr) & PS2_RAM_MASK)))
-#define READ32(addr) (*(uint32_t*)((rdram) + ((addr) & PS2_RAM_MASK)))
-#define READ64(addr) (*(uint64_t*)((rdram) + ((addr) & PS2_RAM_MASK)))
-#define READ128(addr) (*((__m128i*)((rdram) + ((addr) & PS2_RAM_MASK))))
-#define WRITE8(addr, val) (*(uint8_t*)((rdram) + ((addr) & PS2_RAM_MASK)) = (val))
-#define WRITE16(addr, val) (*(uint16_t*)((rdram) + ((addr) & PS2_RAM_MASK)) = (val))
-#define WRITE32(addr, val) (*(uint32_t*)((rdram) + ((addr) & PS2_RAM_MASK)) = (val))
-#define WRITE64(addr, val) (*(uint64_t*)((rdram) + ((addr) & PS2_RAM_MASK)) = (val))
-#define WRITE128(addr, val) (*((__m128i*)((rdram) + ((addr) & PS2_RAM_MASK))) = (val))
+// Memory access helpers (see ps2GuestRead32 in ps2_runtime.h for the hardware register window)
+#define READ8(addr) ps2GuestRead8(rdram, runtime, (addr))
+#define READ16(addr) ps2GuestRead16(rdram, runtime, (addr))
+#define READ32(addr) ps2GuestRead32(rdram, runtime, (addr))
+#define READ64(addr) ps2GuestRead64(rdram, runtime, (addr))
+#define READ128(addr) ps2GuestRead128(rdram, runtime, (addr))
+#define WRITE8(addr, val) ps2GuestWrite8(rdram, runtime, (addr), (val))
+#define WRITE16(addr, val) ps2GuestWrite16(rdram, runtime, (addr), (val))
+#define WRITE32(addr, val) ps2GuestWrite32(rdram, runtime, (addr), (val))
+#define WRITE64(addr, val) ps2GuestWrite64(rdram, runtime, (addr), (val))
+#define WRITE128(addr, val) ps2GuestWrite128(rdram, runtime, (addr), (val))
 
 // Packed Compare Greater Than (PCGT)
 #define PS2_PCGTW(a, b) _mm_cmpgt_epi32((__m128i)(a), (__m128i)(b))
@@ -0,0 +1,209 @@
+#ifndef PS2_SCHEDULER_H
+#define PS2_SCHEDULER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct R5900Context;
+class PS2Runtime;
+
+// Thread status bits reported by ReferThreadStatus
+constexpr uint32_t PS2_THS_RUN = 0x01;
+constexpr uint32_t PS2_THS_READY = 0x02;
+constexpr uint32_t PS2_THS_WAIT = 0x04;
+constexpr uint32_t PS2_THS_SUSPEND = 0x08;
+constexpr uint32_t PS2_THS_WAITSUSPEND = 0x0C;
+constexpr uint32_t PS2_THS_DORMANT = 0x10;
+
+// Cooperative scheduler for EE kernel threads.
+//
+// Every guest thread runs on its own fiber, and all fibers share the host thread
+// that calls run(). Like the EE kernel, scheduling is strictly by priority (lower
+// value wins, FIFO within a level) and a thread only loses the CPU when it blocks,
+// yields, or makes a higher priority thread ready. Nothing is time sliced, so
+// guest code never races with itself on RDRAM and runs are reproducible.
+class PS2Scheduler
+{
+public:
+    static constexpr int kMaxThreads = 256;
+    static constexpr int kPriorityLevels = 128;
+    static constexpr int kMainThreadId = 1;
+    static constexpr int kSelfThreadId = 0; // TH_SELF in thread syscalls
+
+    enum class ThreadState
+    {
+        Free,
+        Dormant,
+        Ready,
+        Running,
+        Waiting,
+        Suspended,
+        WaitSuspended,
+    };
+
+    // Values match the waitType field of the kernel's thread status
+    enum class WaitType : uint32_t
+    {
+        None = 0,
+        Sleep = 1,
+        Sema = 2,
+        EventFlag = 3,
+    };
+
+    struct ThreadParams
+    {
+        uint32_t entry = 0;
+        uint32_t stack = 0;
+        uint32_t stackSize = 0;
+        uint32_t gp = 0;
+        uint32_t priority = 0;
+        uint32_t attr = 0;
+        uint32_t option = 0;
+    };
+
+    struct Fiber;
+
+    struct Thread
+    {
+        int id = 0;
+        ThreadState state = ThreadState::Free;
+        ThreadParams params;
+        int priority = 0;
+        uint32_t arg = 0;
+
+        WaitType waitType = WaitType::None;
+        int waitId = 0;
+        int waitResult = 0;
+        uint32_t wakeupCount = 0; // WakeupThread calls not yet consumed by SleepThread
+        bool deleteOnExit = false;
+
+        R5900Context *context = nullptr;             // Guest registers while the thread is switched out
+        std::unique_ptr<R5900Context> ownedContext;  // Storage for every thread except main
+        std::unique_ptr<Fiber> fiber;
+
+        Thread();
+        ~Thread();
+    };
+
+    PS2Scheduler();
+    ~PS2Scheduler();
+
+    PS2Scheduler(const PS2Scheduler &) = delete;
+    PS2Scheduler &operator=(const PS2Scheduler &) = delete;
+
+    // Runs the guest entry point as the main thread and keeps scheduling until every
+    // thread is dormant or stop() is called. All guest code executes inside this call.
+    void run(PS2Runtime *runtime, uint8_t *rdram, R5900Context *mainContext, uint32_t entry);
+    void stop();
+
+    int createThread(const ThreadParams &params);
+    int deleteThread(int tid);
+    int startThread(int tid, uint32_t arg, const R5900Context &creator);
+    [[noreturn]] void exitThread(bool deleteAfterExit);
+    int terminateThread(int tid);
+    int suspendThread(int tid);
+    int resumeThread(int tid);
+    int changePriority(int tid, int priority);
+    int rotateReadyQueue(int priority);
+    int releaseWait(int tid);
+    void yield();
+
+    // Consumes a pending wakeup, or blocks until WakeupThread names this thread
+    int sleep();
+    int wakeup(int tid);
+    // Drops pending wakeups and returns how many there were
+    int cancelWakeup(int tid);
+
+    // Blocks the running thread until wake() names the same wait; returns the wake result
+    int wait(WaitType type, int waitId);
+    // Readies a thread blocked in wait(type, waitId). Returns false if it is not waiting on that.
+    bool wake(int tid, WaitType type, int waitId, int result);
+
+    int currentThreadId() const { return m_current; }
+    int resolveThreadId(int tid) const { return tid == kSelfThreadId ? m_current : tid; }
+    const Thread *thread(int tid) const;
+    uint32_t threadStatus(const Thread &thread) const;
+
+    // While handlers run, wakeups only queue threads; the switch happens when the
+    // outermost handler returns, as on hardware.
+    void beginInterrupt();
+    void endInterrupt();
+    bool inInterrupt() const { return m_interruptDepth != 0; }
+
+    // Thread-safe. Queues work from another host thread to run on the guest thread
+    // at the next scheduling point.
+    void post(std::function<void()> event);
+
+    // Runs due timers (alarms, interrupts) in interrupt context and returns when the
+    // next one is due, so an idle scheduler knows how long it may sleep.
+    using TimerService = std::function<std::chrono::steady_clock::time_point()>;
+    void setTimerService(TimerService service);
+
+    // When set, an idle scheduler hands the next timer deadline to this instead of
+    // sleeping until it. Lets an unthrottled runtime skip guest time forward.
+    using IdleSkip = std::function<void(std::chrono::steady_clock::time_point)>;
+    void setIdleSkip(IdleSkip skip);
+
+    // Delivers queued host events and due timers. Called between threads and at
+    // syscalls; does nothing inside a handler, since handlers do not nest. After
+    // stop() it ends the calling thread instead, so a busy guest cannot outlive run().
+    void safePoint();
+
+private:
+    struct ThreadExit
+    {
+    };
+
+    PS2Runtime *m_runtime = nullptr;
+    uint8_t *m_rdram = nullptr;
+
+    std::array<std::unique_ptr<Thread>, kMaxThreads> m_threads;
+    std::array<std::deque<int>, kPriorityLevels> m_readyQueues;
+    std::array<uint64_t, 2> m_readyMask{};
+    int m_current = 0; // 0 while the scheduler itself is running
+    int m_interruptDepth = 0;
+    bool m_preemptPending = false;
+    std::unique_ptr<Fiber> m_schedulerFiber;
+    std::vector<int> m_finishedThreads;
+    std::vector<std::unique_ptr<Fiber>> m_abandonedFibers; // Terminated mid-stack, still to be unwound
+    Fiber *m_unwinding = nullptr;
+
+    std::mutex m_hostMutex;
+    std::condition_variable m_hostWake;
+    std::vector<std::function<void()>> m_hostEvents;
+    std::atomic<bool> m_stopping{false};
+
+    TimerService m_timerService;
+    IdleSkip m_idleSkip;
+    std::chrono::steady_clock::time_point m_nextDeadline = std::chrono::steady_clock::time_point::max();
+
+    Thread *lookup(int tid) const;
+    int allocateThreadId() const;
+    void enqueueReady(Thread &thread, bool front = false);
+    void removeReady(Thread &thread);
+    int highestReadyPriority() const;
+    int popReady();
+    bool hasLiveThreads() const;
+
+    void prepareFiber(Thread &thread);
+    void switchToThread(Thread &thread);
+    void switchToScheduler();
+    void preemptIfNeeded();
+    void reclaimFinishedThreads();
+    // Resumes each abandoned fiber once so ThreadExit unwinds the host frames on its stack
+    void unwindAbandonedFibers();
+    [[noreturn]] void finishUnwind();
+    [[noreturn]] void finishCurrentThread();
+
+    static void fiberMain();
+};
+
+#endif // PS2_SCHEDULER_H
@@ -0,0 +1,70 @@
+#ifndef PS2_TIMERS_H
+#define PS2_TIMERS_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "ps2_clock.h"
+
+// EE timers T0-T3 (Tn_COUNT/MODE/COMP/HOLD at 0x10000000 + n * 0x800).
+//
+// Counters are not ticked. Each timer remembers the clock-source reading it was
+// last brought up to date at, and any register access first advances it by the
+// ticks elapsed since then, raising the equal/overflow flags it crossed on the
+// way. Nothing runs between accesses, so an idle timer costs nothing.
+class PS2Timers
+{
+public:
+    static constexpr int kNumTimers = 4;
+    static constexpr uint32_t kBase = 0x10000000;
+    static constexpr uint32_t kStride = 0x800;
+
+    // Tn_MODE bits
+    static constexpr uint32_t MODE_CLKS = 0x003; // 0 = BUSCLK, 1 = BUSCLK/16, 2 = BUSCLK/256, 3 = HBLNK
+    static constexpr uint32_t MODE_GATE = 0x004;
+    static constexpr uint32_t MODE_GATS = 0x008;
+    static constexpr uint32_t MODE_GATM = 0x030;
+    static constexpr uint32_t MODE_ZRET = 0x040; // Clear the counter when it reaches COMP
+    static constexpr uint32_t MODE_CUE = 0x080;  // Count enable
+    static constexpr uint32_t MODE_CMPE = 0x100;
+    static constexpr uint32_t MODE_OVFE = 0x200;
+    static constexpr uint32_t MODE_EQUF = 0x400; // Write 1 to clear
+    static constexpr uint32_t MODE_OVFF = 0x800; // Write 1 to clear
+
+    PS2Timers();
+
+    // Without a clock the counters hold still, which is enough for tools and tests
+    void attachClock(const PS2Clock *clock) { m_clock = clock; }
+    void reset();
+
+    static bool isTimerRegister(uint32_t address);
+    uint32_t read(uint32_t address);
+    void write(uint32_t address, uint32_t value);
+
+    // Brings every timer with CMPE or OVFE up to date and returns the timers that
+    // newly raised an enabled flag since the last call, one bit per timer
+    uint32_t pollInterrupts();
+    // Host time of the next compare or overflow interrupt any timer can raise
+    std::optional<PS2Clock::HostClock::time_point> nextInterruptTime() const;
+
+private:
+    struct Timer
+    {
+        uint32_t count = 0;
+        uint32_t mode = 0;
+        uint32_t comp = 0;
+        uint32_t hold = 0;
+        uint64_t synced = 0; // Clock-source reading the fields above are current for
+    };
+
+    std::array<Timer, kNumTimers> m_timers;
+    const PS2Clock *m_clock = nullptr;
+    uint32_t m_pendingInterrupts = 0;
+
+    uint64_t sourceTicks(uint32_t mode) const;
+    void sync(int index);
+    static void advance(Timer &timer, uint64_t ticks);
+};
+
+#endif // PS2_TIMERS_H
@@ -0,0 +1,139 @@
+#ifndef PS2_VIF_H
+#define PS2_VIF_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// PS2 VIF (VPU Interface) registers
+struct VIFRegisters
+{
+    uint32_t stat;   // Status
+    uint32_t fbrst;  // VIF Force Break
+    uint32_t err;    // Error
+    uint32_t mark;   // Mark
+    uint32_t cycle;  // Cycle
+    uint32_t mode;   // Mode
+    uint32_t num;    // Number of data
+    uint32_t mask;   // Mask
+    uint32_t code;   // Code
+    uint32_t itops;  // ITOPs
+    uint32_t itop;   // ITOP
+    uint32_t base;   // Base (VIF1)
+    uint32_t ofst;   // Offset (VIF1)
+    uint32_t tops;   // TOPs (VIF1)
+    uint32_t top;    // TOP (VIF1)
+    uint32_t r[4];   // Row
+    uint32_t c[4];   // Column
+};
+
+// VIF0 / VIF1 command processor (registers at 0x10003800 / 0x10003C00, FIFOs at
+// 0x10004000 / 0x10005000).
+//
+// transfer() takes VIF codes and their data as they arrive from DMA or the FIFO.
+// A command's data may be split over any number of transfers. UNPACK writes to VU
+// data memory through SSE2 kernels chosen per format, sign, mask and STMOD mode at
+// compile time. MPG loads micro memory. VIF1 DIRECT/DIRECTHL data goes to the
+// direct handler (GIF PATH2). MSCAL/MSCALF/MSCNT call the microprogram handler.
+//
+// Work is done as data arrives, so the VIF never reports itself busy. Before
+// anything that touches VU memory or starts a program (UNPACK, MPG, MSCAL, MSCNT and
+// the FLUSH codes) it calls the VU sync handler, which waits for the running
+// microprogram. An interrupt bit raises the VIF's INTC cause and sets STAT.INT; it
+// does not stall the stream.
+class PS2Vif
+{
+public:
+    // STAT bits
+    static constexpr uint32_t STAT_MRK = 0x40;
+    static constexpr uint32_t STAT_DBF = 0x80;
+    static constexpr uint32_t STAT_INT = 0x800;
+    static constexpr uint32_t STAT_ER1 = 0x2000;
+
+    // Returns the INTC causes the data raised, one bit each
+    using DirectHandler = std::function<uint32_t(const uint8_t *data, uint32_t qwc)>;
+    // `address` is in micro memory bytes; MSCNT passes `resume` to carry on where the program stopped
+    using MicroprogramHandler = std::function<void(uint32_t address, bool resume)>;
+    using SyncHandler = std::function<void()>;
+
+    explicit PS2Vif(int unit);
+
+    void attach(uint8_t *code, uint32_t codeSize, uint8_t *data, uint32_t dataSize);
+    void setDirectHandler(DirectHandler handler) { m_direct = std::move(handler); }
+    void setMicroprogramHandler(MicroprogramHandler handler) { m_microprogram = std::move(handler); }
+    void setVuSyncHandler(SyncHandler handler) { m_vuSync = std::move(handler); }
+    // Called when MPG is about to load micro memory, after the VU sync
+    void setCodeWriteHandler(SyncHandler handler) { m_codeWrite = std::move(handler); }
+    void reset();
+
+    bool isRegister(uint32_t address) const;
+    uint32_t read(uint32_t address) const;
+    void write(uint32_t address, uint32_t value);
+
+    // Processes qwc qwords of VIF codes and data; returns the INTC causes raised
+    uint32_t transfer(const uint8_t *data, uint32_t qwc);
+
+    const VIFRegisters &regs() const { return m_regs; }
+    bool path3Masked() const { return m_maskPath3; }
+
+    // Everything an UNPACK kernel needs; public so the kernels can live outside the class
+    struct UnpackState
+    {
+        uint8_t *memory = nullptr;
+        uint32_t addressMask = 0; // qwords of data memory - 1
+        uint32_t address = 0;     // qword
+        uint32_t cl = 1;
+        uint32_t wl = 1;
+        uint32_t cycle = 0;       // write position within the CL/WL cycle
+        uint32_t mask = 0;
+        uint32_t *row = nullptr;
+        const uint32_t *col = nullptr;
+    };
+
+private:
+    enum class Payload
+    {
+        None,
+        StMask,
+        StRow,
+        StCol,
+        Mpg,
+        Direct,
+        Unpack,
+    };
+
+    int m_unit;
+    uint32_t m_base;
+    uint8_t *m_code = nullptr;
+    uint32_t m_codeSize = 0;
+    uint8_t *m_data = nullptr;
+    uint32_t m_dataSize = 0;
+    DirectHandler m_direct;
+    MicroprogramHandler m_microprogram;
+    SyncHandler m_vuSync;
+    SyncHandler m_codeWrite;
+
+    VIFRegisters m_regs{};
+    bool m_maskPath3 = false;
+
+    // Command whose data is still arriving
+    Payload m_payload = Payload::None;
+    uint32_t m_wordsLeft = 0;
+    uint32_t m_wordIndex = 0;
+    uint32_t m_mpgAddress = 0;
+    std::vector<uint8_t> m_pending;    // UNPACK data collected across transfers
+    std::array<uint8_t, 16> m_directQword{};
+    bool m_interruptAfter = false;     // the command had its interrupt bit set
+    bool m_reportedMicroprogram = false;
+
+    uint32_t command(uint32_t code);
+    uint32_t payload(const uint8_t *words, uint32_t count);
+    uint32_t finishCommand();
+    void syncVu();
+    void startMicroprogram(uint32_t address, bool resume);
+    void unpack(const uint8_t *data);
+    uint32_t unpackDataQwords(uint32_t num) const;
+};
+
+#endif // PS2_VIF_H
@@ -0,0 +1,304 @@
+#ifndef PS2_VU_H
+#define PS2_VU_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <immintrin.h>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ps2_vu_microcode.h"
+
+class PS2InterruptController;
+
+// SIMD building blocks shared by the interpreter and recompiled microprograms, so both
+// round and flag exactly alike
+namespace ps2_vu
+{
+    // Fields of the 4-bit dest/flag masks run x, y, z, w from bit 3 down; lanes run x to w
+    inline constexpr uint8_t kReverse4[16] = {0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
+
+    inline __m128 laneMask(uint32_t dest)
+    {
+        const uint32_t lanes = kReverse4[dest & 0xF];
+        return _mm_castsi128_ps(_mm_setr_epi32((lanes & 1) ? -1 : 0, (lanes & 2) ? -1 : 0, (lanes & 4) ? -1 : 0, (lanes & 8) ? -1 : 0));
+    }
+
+    inline __m128 blend(__m128 old, __m128 value, __m128 mask)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, value), _mm_andnot_ps(mask, old));
+    }
+
+    // The VU has no infinities or NaNs: exponent 255 reads as the largest value of that
+    // sign, and denormals read as zero
+    inline __m128 operand(__m128 v)
+    {
+        const __m128i bits = _mm_castps_si128(v);
+        const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+        const __m128i exponent = _mm_and_si128(bits, _mm_set1_epi32(0x7F800000));
+        const __m128i huge = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7F800000));
+        const __m128i tiny = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+        __m128i out = _mm_or_si128(_mm_and_si128(huge, _mm_or_si128(sign, _mm_set1_epi32(0x7F7FFFFF))), _mm_andnot_si128(huge, bits));
+        out = _mm_or_si128(_mm_and_si128(tiny, sign), _mm_andnot_si128(tiny, out));
+        return _mm_castsi128_ps(out);
+    }
+
+    inline float fromBits(uint32_t bits)
+    {
+        return _mm_cvtss_f32(_mm_castsi128_ps(_mm_cvtsi32_si128(static_cast<int>(bits))));
+    }
+
+    inline float scalar(float value)
+    {
+        return _mm_cvtss_f32(operand(_mm_set_ss(value)));
+    }
+
+    // Clamps an FMAC result and sets MAC and the status flags (Z, S, U, O and their
+    // sticky copies) from the fields in dest
+    inline __m128 fmacResult(__m128 value, uint32_t dest, uint32_t &mac, uint32_t &status)
+    {
+        const __m128i bits = _mm_castps_si128(value);
+        const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+        const __m128i exponent = _mm_and_si128(bits, _mm_set1_epi32(0x7F800000));
+        const __m128i mantissa = _mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF));
+        const __m128i over = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7F800000));
+        const __m128i under = _mm_andnot_si128(_mm_cmpeq_epi32(mantissa, _mm_setzero_si128()),
+                                               _mm_cmpeq_epi32(exponent, _mm_setzero_si128()));
+
+        __m128i out = _mm_or_si128(_mm_and_si128(over, _mm_or_si128(sign, _mm_set1_epi32(0x7F7FFFFF))), _mm_andnot_si128(over, bits));
+        out = _mm_or_si128(_mm_and_si128(under, sign), _mm_andnot_si128(under, out));
+        const __m128i zero = _mm_cmpeq_epi32(_mm_and_si128(out, _mm_set1_epi32(0x7FFFFFFF)), _mm_setzero_si128());
+
+        // MAC flags cover the written fields only
+        const uint32_t lanes = kReverse4[dest & 0xF];
+        const uint32_t z = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(zero))) & lanes;
+        const uint32_t s = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(out))) & lanes;
+        const uint32_t u = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(under))) & lanes;
+        const uint32_t o = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(over))) & lanes;
+        mac = kReverse4[z] | (kReverse4[s] << 4) | (kReverse4[u] << 8) | (kReverse4[o] << 12);
+
+        const uint32_t flags = (z ? 0x1u : 0u) | (s ? 0x2u : 0u) | (u ? 0x4u : 0u) | (o ? 0x8u : 0u);
+        status = (status & ~0xFu) | flags | (flags << 6);
+        return _mm_castsi128_ps(out);
+    }
+
+    // FTOI0/4/12/15: scaled and truncated, saturating to the largest positive integer
+    inline __m128 ftoi(__m128 a, float scale)
+    {
+        const __m128 scaled = _mm_mul_ps(a, _mm_set1_ps(scale));
+        const __m128i truncated = _mm_cvttps_epi32(scaled);
+        const __m128i tooBig = _mm_castps_si128(_mm_cmpge_ps(scaled, _mm_set1_ps(2147483648.0f)));
+        return _mm_castsi128_ps(_mm_or_si128(_mm_andnot_si128(tooBig, truncated), _mm_and_si128(tooBig, _mm_set1_epi32(0x7FFFFFFF))));
+    }
+
+    // ITOF0/4/12/15 read the raw register, not a VU operand
+    inline __m128 itof(__m128 raw, float scale)
+    {
+        return _mm_div_ps(_mm_cvtepi32_ps(_mm_castps_si128(raw)), _mm_set1_ps(scale));
+    }
+}
+
+// Vector unit in micro mode: runs microprograms from micro memory on data memory.
+//
+// Each 64-bit instruction pairs an upper (FMAC) and a lower (load/store, integer,
+// branch, FDIV, EFU) operation. Both read the registers as they were before the pair;
+// when both write the same register the upper result wins. DIV/SQRT/RSQRT results reach
+// Q, and EFU results reach P, after their latency in instructions, and WAITQ/WAITP wait
+// for them. MAC, status and clip flags are produced by the FMAC ops and seen by the
+// flag instructions four instructions later. Floats follow the VU rules: no NaN or
+// infinity, overflow clamps to the largest value and denormals read as zero.
+//
+// start() hands the program to a worker thread and returns, so the VU runs alongside
+// the EE. XGKICK passes the GIF packet at the given address to the kick handler (GIF
+// PATH1) on that thread. The INTC causes it returns are raised by update() on the
+// guest thread. Anything touching VU memory, registers or the GS must waitIdle() first.
+//
+// Microprograms recompiled by ps2recomp are registered with addMicroprogram(). When a
+// program starts inside one whose code still matches micro memory, the recompiled
+// function runs instead of the interpreter. It drives the same pipeline through the
+// "recompiled code" members below, so Q/P latency and flag delay behave the same.
+class PS2VectorUnit
+{
+public:
+    // Status flag bits
+    static constexpr uint32_t STATUS_Z = 0x001;
+    static constexpr uint32_t STATUS_S = 0x002;
+    static constexpr uint32_t STATUS_U = 0x004;
+    static constexpr uint32_t STATUS_O = 0x008;
+    static constexpr uint32_t STATUS_I = 0x010;
+    static constexpr uint32_t STATUS_D = 0x020;
+
+    // Gets qwc qwords of GIF data; returns the INTC causes they raised, one bit each
+    using KickHandler = std::function<uint32_t(const uint8_t *data, uint32_t qwc)>;
+
+    struct Registers
+    {
+        alignas(16) float vf[32][4];
+        alignas(16) float acc[4];
+        uint16_t vi[16];
+        float q = 0.0f;
+        float p = 0.0f;
+        float i = 0.0f;
+        uint32_t r = 0x3F800000;
+        uint32_t mac = 0;
+        uint32_t status = 0;
+        uint32_t clip = 0;
+        uint32_t pc = 0; // bytes into micro memory; where MSCNT carries on
+        uint32_t itop = 0;
+        uint32_t top = 0;
+    };
+
+    PS2VectorUnit(int unit, PS2InterruptController &interrupts);
+    ~PS2VectorUnit();
+
+    PS2VectorUnit(const PS2VectorUnit &) = delete;
+    PS2VectorUnit &operator=(const PS2VectorUnit &) = delete;
+
+    void attach(uint8_t *code, uint32_t codeSize, uint8_t *data, uint32_t dataSize);
+    void setKickHandler(KickHandler handler) { m_kick = std::move(handler); }
+    // Called on the worker when a program raised INTC causes, so the guest can be told to update()
+    void setCompletionNotifier(std::function<void()> notifier) { m_notifier = std::move(notifier); }
+    // Without a worker, programs run to their end inside start(). Deterministic, for tools and tests.
+    void setThreaded(bool threaded);
+    void reset();
+
+    // Runs the program at `address` (bytes) or, with `resume`, from where the last one
+    // ended. A program still running is waited for first, as VIF MSCAL does.
+    void start(uint32_t address, bool resume, uint32_t itop, uint32_t top);
+    void waitIdle();
+    bool running();
+    // Raises the INTC causes of finished programs; guest thread only
+    void update();
+
+    // Only stable while the VU is idle
+    Registers &registers() { return m_regs; }
+    uint64_t instructionCount() const { return m_instructionCount.load(std::memory_order_relaxed); }
+    uint64_t recompiledRuns() const { return m_recompiledRuns.load(std::memory_order_relaxed); }
+
+    void addMicroprogram(const PS2VuMicroprogram &program);
+    // Micro memory was written, so recompiled programs have to be matched against it again
+    void invalidateMicroprograms();
+
+    // A program that runs this long without an E bit is stopped, so a bad jump cannot hang waitIdle()
+    static constexpr uint64_t kMaxInstructions = 1ull << 24;
+
+    // Recompiled code: each instruction runs between beginInstruction() and endInstruction().
+    // Operations it does not inline go through executeUpper()/executeLower(); an upper
+    // result is held back until commitUpper(), after the lower op has read its operands.
+    void beginInstruction()
+    {
+        if (m_pendingQ.active && m_cycle >= m_pendingQ.readyAt)
+        {
+            commitPending(m_pendingQ, m_regs.q);
+        }
+        if (m_pendingP.active && m_cycle >= m_pendingP.readyAt)
+        {
+            commitPending(m_pendingP, m_regs.p);
+        }
+        m_visibleFlags = m_flagPipe[m_cycle & 3];
+    }
+    void endInstruction()
+    {
+        m_flagPipe[m_cycle & 3] = Flags{m_regs.mac, m_regs.status, m_regs.clip};
+        m_cycle++;
+    }
+    bool overBudget() const { return m_cycle - m_runStart >= kMaxInstructions; }
+    uint32_t codeSize() const { return m_codeSize; }
+    uint8_t *dataQword(uint32_t qword) { return m_data + (qword & (m_dataSize / 16 - 1)) * 16; }
+    void executeUpper(uint32_t upper);
+    void executeLower(uint32_t lower, uint32_t pc);
+    void commitUpper();
+    void waitQ() { commitPending(m_pendingQ, m_regs.q); }
+    void waitP() { commitPending(m_pendingP, m_regs.p); }
+    // Leaves recompiled code at pc; a branch or E bit still waiting on its delay slot carries over
+    void leaveRecompiled(uint32_t pc, bool branch, uint32_t target, bool end);
+
+private:
+    // Result of a DIV/SQRT/RSQRT or EFU op waiting out its latency
+    struct PendingResult
+    {
+        bool active = false;
+        float value = 0.0f;
+        uint64_t readyAt = 0;
+    };
+
+    struct Flags
+    {
+        uint32_t mac = 0;
+        uint32_t status = 0;
+        uint32_t clip = 0;
+    };
+
+    // Upper result held back until the lower op of the pair has read its operands
+    struct UpperWrite
+    {
+        bool active = false;
+        bool toAcc = false;
+        int reg = 0;
+        __m128 value;
+        __m128 mask;
+    };
+
+    int m_unit;
+    PS2InterruptController &m_interrupts;
+    uint8_t *m_code = nullptr;
+    uint32_t m_codeSize = 0;
+    uint8_t *m_data = nullptr;
+    uint32_t m_dataSize = 0;
+    KickHandler m_kick;
+    std::function<void()> m_notifier;
+
+    // Worker side while a program runs
+    Registers m_regs{};
+    uint64_t m_cycle = 0;
+    PendingResult m_pendingQ;
+    PendingResult m_pendingP;
+    Flags m_flagPipe[4];      // flags after each of the last four instructions
+    Flags m_visibleFlags;     // what the flag instructions of this one see
+    UpperWrite m_upperWrite;
+    bool m_branchPending = false;
+    uint32_t m_branchTarget = 0;
+    bool m_endPending = false;
+    uint32_t m_intc = 0;
+    uint64_t m_runStart = 0; // m_cycle when the current program started
+    std::atomic<uint64_t> m_instructionCount{0};
+    std::atomic<uint64_t> m_recompiledRuns{0};
+
+    // Recompiled programs, and which one each start address matched since micro memory last changed
+    std::vector<PS2VuMicroprogram> m_microprograms;
+    std::unordered_map<uint32_t, const PS2VuMicroprogram *> m_matched;
+
+    bool m_threaded = true;
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    bool m_startRequested = false;
+    bool m_running = false;
+    std::atomic<bool> m_busy{false}; // started and not yet finished; lets waitIdle() skip the lock
+    bool m_quit = false;
+    std::atomic<uint32_t> m_pendingIntc{0};
+
+    void stopWorker();
+    void workerLoop();
+    void run();
+    void finishRun();
+
+    const PS2VuMicroprogram *findMicroprogram(uint32_t pc);
+    void step();
+    void executeLowerSpecial(uint32_t lower);
+
+    __m128 vf(int reg) const;
+    void writeVf(int reg, uint32_t dest, __m128 value);
+    void writeFmac(int reg, bool toAcc, uint32_t dest, __m128 value);
+    void setVi(int reg, uint32_t value);
+    void commitPending(PendingResult &pending, float &target);
+    void startQ(float value, uint32_t latency);
+    void startP(float value, uint32_t latency);
+    void kick(uint32_t qword);
+};
+
+#endif // PS2_VU_H
@@ -0,0 +1,37 @@
+#ifndef PS2_VU_MICROCODE_H
+#define PS2_VU_MICROCODE_H
+
+#include <cstdint>
+
+class PS2VectorUnit;
+
+// A VU microprogram recompiled ahead of time by ps2recomp.
+//
+// The function starts at the VU's pc and runs until the program ends, returning true.
+// If control leaves the recompiled code (a jump outside it, or past its last
+// instruction) it sets pc and returns false, and the interpreter carries on from there.
+using PS2VuMicroFunction = bool (*)(PS2VectorUnit &vu);
+
+struct PS2VuMicroprogram
+{
+    int unit = 1;
+    uint32_t address = 0; // bytes into micro memory
+    uint32_t size = 0;    // bytes
+    uint64_t hash = 0;    // ps2VuMicrocodeHash of those bytes
+    PS2VuMicroFunction function = nullptr;
+};
+
+// FNV-1a of the code. ps2recomp keys the programs it emits with it, and the VU checks
+// micro memory against it before running one.
+inline uint64_t ps2VuMicrocodeHash(const uint8_t *code, uint32_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        hash ^= code[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+#endif // PS2_VU_MICROCODE_H
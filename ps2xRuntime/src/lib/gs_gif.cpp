@@ -0,0 +1,147 @@
+#include "gs_gif.h"
+#include "gs_state.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t kQwordSize = 16;
+    constexpr uint8_t kDescriptorAD = 0xE;
+    constexpr uint8_t kDescriptorNop = 0xF;
+
+    inline uint64_t loadDoubleword(const uint8_t* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+GSGif::GSGif(GSState& gs)
+    : m_gs(gs)
+{
+}
+
+void GSGif::reset()
+{
+    m_paths.fill(PathState());
+}
+
+uint32_t GSGif::transfer(Path path, const uint8_t* data, uint32_t qwc)
+{
+    PathState& state = m_paths[path];
+    uint32_t done = 0;
+    while (done < qwc)
+    {
+        if (state.qwordsLeft == 0)
+        {
+            readTag(state, data + done * kQwordSize);
+            done++;
+        }
+        else
+        {
+            uint32_t count = std::min(state.qwordsLeft, qwc - done);
+            const uint8_t* payload = data + done * kQwordSize;
+            switch (state.mode)
+            {
+            case PACKED:
+                writePacked(state, payload, count);
+                break;
+            case REGLIST:
+                writeRegList(state, payload, count);
+                break;
+            default:
+                m_gs.writeImage(payload, static_cast<size_t>(count) * kQwordSize);
+                break;
+            }
+            state.qwordsLeft -= count;
+            done += count;
+        }
+
+        if (path == PATH1 && state.eop && state.qwordsLeft == 0)
+        {
+            state.eop = false;
+            break;
+        }
+    }
+    return done;
+}
+
+void GSGif::readTag(PathState& state, const uint8_t* tag)
+{
+    const uint64_t lo = loadDoubleword(tag);
+    const uint64_t hi = loadDoubleword(tag + 8);
+
+    const uint32_t nloop = static_cast<uint32_t>(lo & 0x7FFF);
+    const uint32_t flg = static_cast<uint32_t>((lo >> 58) & 0x3);
+    const uint32_t nreg = static_cast<uint32_t>(lo >> 60);
+
+    state.eop = (lo >> 15) & 1;
+    state.mode = flg == REGLIST ? REGLIST : (flg == PACKED ? PACKED : IMAGE); // FLG 3 behaves as IMAGE
+    state.nreg = nreg ? nreg : 16;
+    state.reg = 0;
+    state.allAD = true;
+    for (uint32_t i = 0; i < state.nreg; i++)
+    {
+        state.regs[i] = static_cast<uint8_t>((hi >> (i * 4)) & 0xF);
+        state.allAD = state.allAD && state.regs[i] == kDescriptorAD;
+    }
+
+    switch (state.mode)
+    {
+    case PACKED:
+        if ((lo >> 46) & 1) // PRE
+        {
+            m_gs.writeRegister(GSState::PRIM, (lo >> 47) & 0x7FF);
+        }
+        state.qwordsLeft = nloop * state.nreg;
+        break;
+    case REGLIST:
+        state.wordsLeft = nloop * state.nreg;
+        state.qwordsLeft = (state.wordsLeft + 1) / 2;
+        break;
+    default:
+        state.qwordsLeft = nloop;
+        break;
+    }
+}
+
+void GSGif::writePacked(PathState& state, const uint8_t* data, uint32_t qwc)
+{
+    if (state.allAD)
+    {
+        for (uint32_t i = 0; i < qwc; i++, data += kQwordSize)
+        {
+            m_gs.writeRegister(data[8], loadDoubleword(data));
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < qwc; i++, data += kQwordSize)
+    {
+        m_gs.writePacked(state.regs[state.reg], data);
+        if (++state.reg == state.nreg)
+        {
+            state.reg = 0;
+        }
+    }
+}
+
+void GSGif::writeRegList(PathState& state, const uint8_t* data, uint32_t qwc)
+{
+    const uint32_t words = std::min(qwc * 2, state.wordsLeft);
+    for (uint32_t i = 0; i < words; i++)
+    {
+        // A+D and NOP descriptors have no register to write in REGLIST mode
+        const uint8_t descriptor = state.regs[state.reg];
+        if (descriptor != kDescriptorAD && descriptor != kDescriptorNop)
+        {
+            m_gs.writeRegister(descriptor, loadDoubleword(data + i * 8));
+        }
+        if (++state.reg == state.nreg)
+        {
+            state.reg = 0;
+        }
+    }
+    state.wordsLeft -= words;
+}
@@ -0,0 +1,587 @@
+#include "gs_local_memory.h"
+#include "ps2_runtime.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+    constexpr uint32_t kVramBlockMask = PS2_GS_VRAM_SIZE / GSLocalMemory::kBlockSize - 1;
+
+    // Block order within a page, indexed [block row][block column]
+    constexpr uint8_t kBlockTable32[4][8] = {
+        {0, 1, 4, 5, 16, 17, 20, 21},
+        {2, 3, 6, 7, 18, 19, 22, 23},
+        {8, 9, 12, 13, 24, 25, 28, 29},
+        {10, 11, 14, 15, 26, 27, 30, 31},
+    };
+    constexpr uint8_t kBlockTable32Z[4][8] = {
+        {24, 25, 28, 29, 8, 9, 12, 13},
+        {26, 27, 30, 31, 10, 11, 14, 15},
+        {16, 17, 20, 21, 0, 1, 4, 5},
+        {18, 19, 22, 23, 2, 3, 6, 7},
+    };
+    constexpr uint8_t kBlockTable16[8][4] = {
+        {0, 2, 8, 10},
+        {1, 3, 9, 11},
+        {4, 6, 12, 14},
+        {5, 7, 13, 15},
+        {16, 18, 24, 26},
+        {17, 19, 25, 27},
+        {20, 22, 28, 30},
+        {21, 23, 29, 31},
+    };
+    constexpr uint8_t kBlockTable16S[8][4] = {
+        {0, 2, 16, 18},
+        {1, 3, 17, 19},
+        {8, 10, 24, 26},
+        {9, 11, 25, 27},
+        {4, 6, 20, 22},
+        {5, 7, 21, 23},
+        {12, 14, 28, 30},
+        {13, 15, 29, 31},
+    };
+    constexpr uint8_t kBlockTable16Z[8][4] = {
+        {24, 26, 16, 18},
+        {25, 27, 17, 19},
+        {28, 30, 20, 22},
+        {29, 31, 21, 23},
+        {8, 10, 0, 2},
+        {9, 11, 1, 3},
+        {12, 14, 4, 6},
+        {13, 15, 5, 7},
+    };
+    constexpr uint8_t kBlockTable16SZ[8][4] = {
+        {24, 26, 8, 10},
+        {25, 27, 9, 11},
+        {16, 18, 0, 2},
+        {17, 19, 1, 3},
+        {28, 30, 12, 14},
+        {29, 31, 13, 15},
+        {20, 22, 4, 6},
+        {21, 23, 5, 7},
+    };
+    constexpr uint8_t kBlockTable8[4][8] = {
+        {0, 1, 4, 5, 16, 17, 20, 21},
+        {2, 3, 6, 7, 18, 19, 22, 23},
+        {8, 9, 12, 13, 24, 25, 28, 29},
+        {10, 11, 14, 15, 26, 27, 30, 31},
+    };
+    constexpr uint8_t kBlockTable4[8][4] = {
+        {0, 2, 8, 10},
+        {1, 3, 9, 11},
+        {4, 6, 12, 14},
+        {5, 7, 13, 15},
+        {16, 18, 24, 26},
+        {17, 19, 25, 27},
+        {20, 22, 28, 30},
+        {21, 23, 29, 31},
+    };
+
+    // How a format stores one pixel in its storage unit
+    enum class Storage
+    {
+        Word32, // CT32, Z32
+        Word24, // CT24, Z24: low 24 bits of a word
+        Byte8H, // T8H: bits 24-31 of a word
+        Nib4HL, // T4HL: bits 24-27 of a word
+        Nib4HH, // T4HH: bits 28-31 of a word
+        Half16, // CT16, CT16S and the Z16 variants
+        Byte8,  // T8
+        Nib4,   // T4
+    };
+
+    struct Layout
+    {
+        bool valid = false;
+        Storage storage = Storage::Word32;
+        uint32_t unitBits = 32;     // size of the addressed storage unit
+        uint32_t transferBits = 32; // size of a pixel in host transfers
+        uint32_t pageWidth = 0;
+        uint32_t pageHeight = 0;
+        uint32_t blockWidth = 0;
+        uint32_t blockHeight = 0;
+        uint32_t unitsPerBlock = 0;
+        std::array<uint8_t, 32> pageBlocks{}; // block number, by block row then column
+        std::array<uint16_t, 512> blockUnits{}; // unit offset within the block, by pixel row then column
+    };
+
+    template <size_t Rows, size_t Cols>
+    void fillPageBlocks(Layout &layout, const uint8_t (&table)[Rows][Cols])
+    {
+        for (size_t row = 0; row < Rows; row++)
+        {
+            for (size_t col = 0; col < Cols; col++)
+            {
+                layout.pageBlocks[row * Cols + col] = table[row][col];
+            }
+        }
+    }
+
+    // Pixel order within a block. Blocks are four columns stacked vertically; in the
+    // 8- and 4-bit layouts every other pair of rows swaps the halves of its column.
+    uint32_t columnOffset32(uint32_t x, uint32_t y)
+    {
+        return (y >> 1) * 16 + (y & 1) * 2 + (x >> 1) * 4 + (x & 1);
+    }
+
+    uint32_t columnOffset16(uint32_t x, uint32_t y)
+    {
+        return (y >> 1) * 32 + (y & 1) * 4 + ((x & 7) >> 1) * 8 + (x & 1) * 2 + (x >> 3);
+    }
+
+    uint32_t columnOffset8(uint32_t x, uint32_t y)
+    {
+        uint32_t column = y >> 2;
+        uint32_t row = y & 3;
+        uint32_t swap = ((row >> 1) ^ (column & 1)) ? 2 : 0;
+        return column * 64 + ((((x >> 1) & 3) ^ swap) * 16) + (x & 1) * 4 + (x >> 3) * 2 + (row & 1) * 8 + (row >> 1);
+    }
+
+    uint32_t columnOffset4(uint32_t x, uint32_t y)
+    {
+        uint32_t column = y >> 2;
+        uint32_t row = y & 3;
+        uint32_t swap = ((row >> 1) ^ (column & 1)) ? 2 : 0;
+        return column * 128 + ((((x >> 1) & 3) ^ swap) * 32) + (x & 1) * 8 + (x >> 3) * 2 + (row & 1) * 16 + (row >> 1);
+    }
+
+    template <size_t Rows, size_t Cols>
+    Layout makeLayout(Storage storage, uint32_t unitBits, uint32_t transferBits, uint32_t blockWidth, uint32_t blockHeight,
+                      const uint8_t (&table)[Rows][Cols], uint32_t (*columnOffset)(uint32_t, uint32_t))
+    {
+        Layout layout;
+        layout.valid = true;
+        layout.storage = storage;
+        layout.unitBits = unitBits;
+        layout.transferBits = transferBits;
+        layout.blockWidth = blockWidth;
+        layout.blockHeight = blockHeight;
+        layout.pageWidth = blockWidth * Cols;
+        layout.pageHeight = blockHeight * Rows;
+        layout.unitsPerBlock = GSLocalMemory::kBlockSize * 8 / unitBits;
+        fillPageBlocks(layout, table);
+        for (uint32_t y = 0; y < blockHeight; y++)
+        {
+            for (uint32_t x = 0; x < blockWidth; x++)
+            {
+                layout.blockUnits[y * blockWidth + x] = static_cast<uint16_t>(columnOffset(x, y));
+            }
+        }
+        return layout;
+    }
+
+    const std::array<Layout, 64> &layouts()
+    {
+        static const std::array<Layout, 64> table = []()
+        {
+            std::array<Layout, 64> t{};
+            t[GSLocalMemory::PSMCT32] = makeLayout(Storage::Word32, 32, 32, 8, 8, kBlockTable32, columnOffset32);
+            t[GSLocalMemory::PSMCT24] = makeLayout(Storage::Word24, 32, 24, 8, 8, kBlockTable32, columnOffset32);
+            t[GSLocalMemory::PSMT8H] = makeLayout(Storage::Byte8H, 32, 8, 8, 8, kBlockTable32, columnOffset32);
+            t[GSLocalMemory::PSMT4HL] = makeLayout(Storage::Nib4HL, 32, 4, 8, 8, kBlockTable32, columnOffset32);
+            t[GSLocalMemory::PSMT4HH] = makeLayout(Storage::Nib4HH, 32, 4, 8, 8, kBlockTable32, columnOffset32);
+            t[GSLocalMemory::PSMZ32] = makeLayout(Storage::Word32, 32, 32, 8, 8, kBlockTable32Z, columnOffset32);
+            t[GSLocalMemory::PSMZ24] = makeLayout(Storage::Word24, 32, 24, 8, 8, kBlockTable32Z, columnOffset32);
+            t[GSLocalMemory::PSMCT16] = makeLayout(Storage::Half16, 16, 16, 16, 8, kBlockTable16, columnOffset16);
+            t[GSLocalMemory::PSMCT16S] = makeLayout(Storage::Half16, 16, 16, 16, 8, kBlockTable16S, columnOffset16);
+            t[GSLocalMemory::PSMZ16] = makeLayout(Storage::Half16, 16, 16, 16, 8, kBlockTable16Z, columnOffset16);
+            t[GSLocalMemory::PSMZ16S] = makeLayout(Storage::Half16, 16, 16, 16, 8, kBlockTable16SZ, columnOffset16);
+            t[GSLocalMemory::PSMT8] = makeLayout(Storage::Byte8, 8, 8, 16, 16, kBlockTable8, columnOffset8);
+            t[GSLocalMemory::PSMT4] = makeLayout(Storage::Nib4, 4, 4, 32, 16, kBlockTable4, columnOffset4);
+            return t;
+        }();
+        return table;
+    }
+
+    const Layout *layoutOf(uint32_t psm)
+    {
+        const Layout &layout = layouts()[psm & 0x3F];
+        return (psm < 64 && layout.valid) ? &layout : nullptr;
+    }
+
+    // First storage unit of the block holding pixel (x, y)
+    uint32_t blockBaseUnit(const Layout &layout, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y)
+    {
+        // BW counts 64-pixel columns, so 128-pixel pages (8 and 4 bit) take half as many per row
+        uint32_t pagesPerRow = bw * 64 / layout.pageWidth;
+        uint32_t page = (y / layout.pageHeight) * pagesPerRow + x / layout.pageWidth;
+        uint32_t blocksPerRow = layout.pageWidth / layout.blockWidth;
+        uint32_t blockInPage = ((y % layout.pageHeight) / layout.blockHeight) * blocksPerRow + (x % layout.pageWidth) / layout.blockWidth;
+        uint32_t block = (bp + page * GSLocalMemory::kBlocksPerPage + layout.pageBlocks[blockInPage]) & kVramBlockMask;
+        return block * layout.unitsPerBlock;
+    }
+
+    uint32_t pixelUnit(const Layout &layout, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y)
+    {
+        uint32_t inBlock = (y % layout.blockHeight) * layout.blockWidth + (x % layout.blockWidth);
+        return blockBaseUnit(layout, bp, bw, x, y) + layout.blockUnits[inBlock];
+    }
+
+    template <Storage S>
+    uint32_t loadUnit(const uint8_t *vram, uint32_t unit)
+    {
+        if constexpr (S == Storage::Half16)
+        {
+            uint16_t value;
+            std::memcpy(&value, vram + unit * 2, sizeof(value));
+            return value;
+        }
+        else if constexpr (S == Storage::Byte8)
+        {
+            return vram[unit];
+        }
+        else if constexpr (S == Storage::Nib4)
+        {
+            return (vram[unit >> 1] >> ((unit & 1) * 4)) & 0xF;
+        }
+        else
+        {
+            uint32_t word;
+            std::memcpy(&word, vram + unit * 4, sizeof(word));
+            switch (S)
+            {
+            case Storage::Word24:
+                return word & 0xFFFFFF;
+            case Storage::Byte8H:
+                return word >> 24;
+            case Storage::Nib4HL:
+                return (word >> 24) & 0xF;
+            case Storage::Nib4HH:
+                return word >> 28;
+            default:
+                return word;
+            }
+        }
+    }
+
+    template <Storage S>
+    void storeUnit(uint8_t *vram, uint32_t unit, uint32_t value)
+    {
+        if constexpr (S == Storage::Half16)
+        {
+            uint16_t half = static_cast<uint16_t>(value);
+            std::memcpy(vram + unit * 2, &half, sizeof(half));
+        }
+        else if constexpr (S == Storage::Byte8)
+        {
+            vram[unit] = static_cast<uint8_t>(value);
+        }
+        else if constexpr (S == Storage::Nib4)
+        {
+            uint8_t &byte = vram[unit >> 1];
+            uint32_t shift = (unit & 1) * 4;
+            byte = static_cast<uint8_t>((byte & ~(0xF << shift)) | ((value & 0xF) << shift));
+        }
+        else
+        {
+            uint32_t word;
+            std::memcpy(&word, vram + unit * 4, sizeof(word));
+            switch (S)
+            {
+            case Storage::Word24:
+                word = (word & 0xFF000000) | (value & 0xFFFFFF);
+                break;
+            case Storage::Byte8H:
+                word = (word & 0x00FFFFFF) | (value << 24);
+                break;
+            case Storage::Nib4HL:
+                word = (word & 0xF0FFFFFF) | ((value & 0xF) << 24);
+                break;
+            case Storage::Nib4HH:
+                word = (word & 0x0FFFFFFF) | ((value & 0xF) << 28);
+                break;
+            default:
+                word = value;
+                break;
+            }
+            std::memcpy(vram + unit * 4, &word, sizeof(word));
+        }
+    }
+
+    // Packed host pixels, addressed by pixel index
+    template <uint32_t Bits>
+    uint32_t loadPacked(const uint8_t *data, size_t index)
+    {
+        if constexpr (Bits == 32)
+        {
+            uint32_t value;
+            std::memcpy(&value, data + index * 4, sizeof(value));
+            return value;
+        }
+        else if constexpr (Bits == 24)
+        {
+            const uint8_t *p = data + index * 3;
+            return p[0] | (p[1] << 8) | (p[2] << 16);
+        }
+        else if constexpr (Bits == 16)
+        {
+            uint16_t value;
+            std::memcpy(&value, data + index * 2, sizeof(value));
+            return value;
+        }
+        else if constexpr (Bits == 8)
+        {
+            return data[index];
+        }
+        else
+        {
+            return (data[index >> 1] >> ((index & 1) * 4)) & 0xF;
+        }
+    }
+
+    template <uint32_t Bits>
+    void storePacked(uint8_t *data, size_t index, uint32_t value)
+    {
+        if constexpr (Bits == 32)
+        {
+            std::memcpy(data + index * 4, &value, sizeof(value));
+        }
+        else if constexpr (Bits == 24)
+        {
+            uint8_t *p = data + index * 3;
+            p[0] = static_cast<uint8_t>(value);
+            p[1] = static_cast<uint8_t>(value >> 8);
+            p[2] = static_cast<uint8_t>(value >> 16);
+        }
+        else if constexpr (Bits == 16)
+        {
+            uint16_t half = static_cast<uint16_t>(value);
+            std::memcpy(data + index * 2, &half, sizeof(half));
+        }
+        else if constexpr (Bits == 8)
+        {
+            data[index] = static_cast<uint8_t>(value);
+        }
+        else
+        {
+            uint8_t &byte = data[index >> 1];
+            uint32_t shift = (index & 1) * 4;
+            byte = static_cast<uint8_t>((byte & ~(0xF << shift)) | ((value & 0xF) << shift));
+        }
+    }
+
+    // Whole 32-bit blocks: each 64-byte column holds two 8-pixel rows interleaved in
+    // pairs (row 0 takes words 0-1, 4-5, 8-9, 12-13), so 64-bit unpacks split them.
+    template <bool ToVram>
+    void transferBlock32(uint8_t *vram, uint32_t base, uint8_t *host, size_t hostStride)
+    {
+        for (uint32_t column = 0; column < 4; column++)
+        {
+            __m128i *local = reinterpret_cast<__m128i *>(vram + (base + column * 16) * 4);
+            uint8_t *row0 = host + hostStride * (column * 2);
+            uint8_t *row1 = row0 + hostStride;
+            if constexpr (ToVram)
+            {
+                __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0));
+                __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 16));
+                __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1));
+                __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 16));
+                _mm_storeu_si128(local + 0, _mm_unpacklo_epi64(a0, b0));
+                _mm_storeu_si128(local + 1, _mm_unpackhi_epi64(a0, b0));
+                _mm_storeu_si128(local + 2, _mm_unpacklo_epi64(a1, b1));
+                _mm_storeu_si128(local + 3, _mm_unpackhi_epi64(a1, b1));
+            }
+            else
+            {
+                __m128i q0 = _mm_loadu_si128(local + 0);
+                __m128i q1 = _mm_loadu_si128(local + 1);
+                __m128i q2 = _mm_loadu_si128(local + 2);
+                __m128i q3 = _mm_loadu_si128(local + 3);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row0), _mm_unpacklo_epi64(q0, q1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row0 + 16), _mm_unpacklo_epi64(q2, q3));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row1), _mm_unpackhi_epi64(q0, q1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row1 + 16), _mm_unpackhi_epi64(q2, q3));
+            }
+        }
+    }
+
+    // Moves a rectangle between VRAM and packed host pixels one block at a time. Only the
+    // block base needs the page/block tables; pixels inside come from the block's unit table.
+    template <Storage S, uint32_t Bits, bool ToVram>
+    void transferImage(uint8_t *vram, const Layout &layout, uint32_t bp, uint32_t bw,
+                       uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t *host)
+    {
+        const uint32_t blockW = layout.blockWidth;
+        const uint32_t blockH = layout.blockHeight;
+        const uint32_t xEnd = x + w;
+        const uint32_t yEnd = y + h;
+
+        for (uint32_t by = y - y % blockH; by < yEnd; by += blockH)
+        {
+            const uint32_t y0 = std::max(by, y);
+            const uint32_t y1 = std::min(by + blockH, yEnd);
+            for (uint32_t bx = x - x % blockW; bx < xEnd; bx += blockW)
+            {
+                const uint32_t x0 = std::max(bx, x);
+                const uint32_t x1 = std::min(bx + blockW, xEnd);
+                const uint32_t base = blockBaseUnit(layout, bp, bw, bx, by);
+
+                if constexpr (S == Storage::Word32)
+                {
+                    if (x1 - x0 == blockW && y1 - y0 == blockH)
+                    {
+                        size_t first = static_cast<size_t>(by - y) * w + (bx - x);
+                        transferBlock32<ToVram>(vram, base, host + first * 4, static_cast<size_t>(w) * 4);
+                        continue;
+                    }
+                }
+
+                for (uint32_t py = y0; py < y1; py++)
+                {
+                    const uint16_t *units = &layout.blockUnits[(py - by) * blockW];
+                    const size_t rowIndex = static_cast<size_t>(py - y) * w;
+                    for (uint32_t px = x0; px < x1; px++)
+                    {
+                        const uint32_t unit = base + units[px - bx];
+                        const size_t index = rowIndex + (px - x);
+                        if constexpr (ToVram)
+                        {
+                            storeUnit<S>(vram, unit, loadPacked<Bits>(host, index));
+                        }
+                        else
+                        {
+                            storePacked<Bits>(host, index, loadUnit<S>(vram, unit));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <bool ToVram>
+    void transfer(uint8_t *vram, uint32_t psm, uint32_t bp, uint32_t bw,
+                  uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t *host)
+    {
+        const Layout *layout = layoutOf(psm);
+        if (!layout || w == 0 || h == 0)
+        {
+            return;
+        }
+
+        switch (layout->storage)
+        {
+        case Storage::Word32:
+            transferImage<Storage::Word32, 32, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Word24:
+            transferImage<Storage::Word24, 24, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Byte8H:
+            transferImage<Storage::Byte8H, 8, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Nib4HL:
+            transferImage<Storage::Nib4HL, 4, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Nib4HH:
+            transferImage<Storage::Nib4HH, 4, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Half16:
+            transferImage<Storage::Half16, 16, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Byte8:
+            transferImage<Storage::Byte8, 8, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        case Storage::Nib4:
+            transferImage<Storage::Nib4, 4, ToVram>(vram, *layout, bp, bw, x, y, w, h, host);
+            break;
+        }
+    }
+}
+
+bool GSLocalMemory::isSupported(uint32_t psm)
+{
+    return layoutOf(psm) != nullptr;
+}
+
+uint32_t GSLocalMemory::transferBits(uint32_t psm)
+{
+    const Layout *layout = layoutOf(psm);
+    return layout ? layout->transferBits : 0;
+}
+
+uint32_t GSLocalMemory::pageWidth(uint32_t psm)
+{
+    const Layout *layout = layoutOf(psm);
+    return layout ? layout->pageWidth : 0;
+}
+
+uint32_t GSLocalMemory::pageHeight(uint32_t psm)
+{
+    const Layout *layout = layoutOf(psm);
+    return layout ? layout->pageHeight : 0;
+}
+
+uint32_t GSLocalMemory::blockWidth(uint32_t psm)
+{
+    const Layout *layout = layoutOf(psm);
+    return layout ? layout->blockWidth : 0;
+}
+
+uint32_t GSLocalMemory::blockHeight(uint32_t psm)
+{
+    const Layout *layout = layoutOf(psm);
+    return layout ? layout->blockHeight : 0;
+}
+
+void GSLocalMemory::markPages(PageMask& pages, uint32_t psm, uint32_t bp, uint32_t bw,
+                              uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    const Layout *layout = layoutOf(psm);
+    if (!layout || w == 0 || h == 0)
+    {
+        return;
+    }
+
+    // A base pointer inside a page shifts every block, so the buffer's pages straddle two VRAM pages
+    const uint32_t pagesPerRow = bw * 64 / layout->pageWidth;
+    const uint32_t firstPage = bp / kBlocksPerPage;
+    const bool straddles = (bp % kBlocksPerPage) != 0;
+    for (uint32_t py = y / layout->pageHeight; py <= (y + h - 1) / layout->pageHeight; py++)
+    {
+        for (uint32_t px = x / layout->pageWidth; px <= (x + w - 1) / layout->pageWidth; px++)
+        {
+            uint32_t page = firstPage + py * pagesPerRow + px;
+            pages.set(page % kPageCount);
+            if (straddles)
+            {
+                pages.set((page + 1) % kPageCount);
+            }
+        }
+    }
+}
+
+uint32_t GSLocalMemory::pixelByteOffset(uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y)
+{
+    const Layout *layout = layoutOf(psm);
+    if (!layout)
+    {
+        return 0;
+    }
+    return pixelUnit(*layout, bp, bw, x, y) * layout->unitBits / 8;
+}
+
+uint32_t GSLocalMemory::readPixel(const uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y)
+{
+    uint32_t value = 0;
+    transfer<false>(const_cast<uint8_t*>(vram), psm, bp, bw, x, y, 1, 1, reinterpret_cast<uint8_t*>(&value));
+    return value;
+}
+
+void GSLocalMemory::writePixel(uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y, uint32_t value)
+{
+    transfer<true>(vram, psm, bp, bw, x, y, 1, 1, reinterpret_cast<uint8_t*>(&value));
+}
+
+void GSLocalMemory::writeImage(uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw,
+                               uint32_t x, uint32_t y, uint32_t w, uint32_t h, const uint8_t* src)
+{
+    transfer<true>(vram, psm, bp, bw, x, y, w, h, const_cast<uint8_t*>(src));
+}
+
+void GSLocalMemory::readImage(const uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw,
+                              uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t* dst)
+{
+    transfer<false>(const_cast<uint8_t*>(vram), psm, bp, bw, x, y, w, h, dst);
+}
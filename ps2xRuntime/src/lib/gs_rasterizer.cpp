@@ -0,0 +1,1031 @@
+#include "gs_rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+    using PrimitiveType = GSRasterizer::PrimitiveType;
+    using Vertex = GSRasterizer::Vertex;
+
+    constexpr int32_t kTileSize = 1 << GSRasterizer::kTileShift;
+    constexpr int32_t kMaxCoordinate = 2047;
+
+    struct Rect
+    {
+        int32_t x0, y0, x1, y1; // inclusive
+
+        bool empty() const { return x0 > x1 || y0 > y1; }
+        Rect intersect(const Rect& other) const
+        {
+            return {std::max(x0, other.x0), std::max(y0, other.y0), std::min(x1, other.x1), std::min(y1, other.y1)};
+        }
+    };
+
+    // 12.4 fixed point to whole pixels
+    inline int32_t floorPixel(int32_t v) { return v >> 4; }
+    inline int32_t ceilPixel(int32_t v) { return (v + 15) >> 4; }
+    inline int32_t roundPixel(int32_t v) { return (v + 8) >> 4; }
+
+    inline int64_t floorDiv(int64_t a, int64_t b)
+    {
+        int64_t q = a / b;
+        return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+    }
+
+    inline int64_t ceilDiv(int64_t a, int64_t b)
+    {
+        return -floorDiv(-a, b);
+    }
+
+    // Render target storage: 32-bit words, the low 24 bits of a word, or 16-bit halves
+    inline uint32_t targetBits(uint32_t psm)
+    {
+        switch (psm)
+        {
+        case GSLocalMemory::PSMCT24:
+        case GSLocalMemory::PSMZ24:
+            return 24;
+        case GSLocalMemory::PSMCT16:
+        case GSLocalMemory::PSMCT16S:
+        case GSLocalMemory::PSMZ16:
+        case GSLocalMemory::PSMZ16S:
+            return 16;
+        default:
+            return 32;
+        }
+    }
+
+    inline uint32_t loadTarget(const uint8_t* vram, uint32_t bits, uint32_t offset)
+    {
+        if (bits == 16)
+        {
+            uint16_t half;
+            std::memcpy(&half, vram + offset, sizeof(half));
+            return half;
+        }
+        uint32_t word;
+        std::memcpy(&word, vram + offset, sizeof(word));
+        return bits == 24 ? (word & 0xFFFFFF) : word;
+    }
+
+    inline void storeTarget(uint8_t* vram, uint32_t bits, uint32_t offset, uint32_t value)
+    {
+        if (bits == 16)
+        {
+            uint16_t half = static_cast<uint16_t>(value);
+            std::memcpy(vram + offset, &half, sizeof(half));
+            return;
+        }
+        if (bits == 24)
+        {
+            // The top byte belongs to whatever 8H/4HL/4HH data shares the word
+            uint32_t word;
+            std::memcpy(&word, vram + offset, sizeof(word));
+            value = (word & 0xFF000000) | (value & 0xFFFFFF);
+        }
+        std::memcpy(vram + offset, &value, sizeof(value));
+    }
+
+    // Colours are handled as 0xAABBGGRR, the way PSMCT32 stores them
+    inline uint32_t pack16(uint32_t rgba)
+    {
+        return ((rgba >> 3) & 0x001F) | ((rgba >> 6) & 0x03E0) | ((rgba >> 9) & 0x7C00) | ((rgba >> 16) & 0x8000);
+    }
+
+    inline uint32_t unpack16(uint32_t c, uint32_t alphaSet, uint32_t alphaClear)
+    {
+        return ((c & 0x001F) << 3) | ((c & 0x03E0) << 6) | ((c & 0x7C00) << 9) |
+               ((c & 0x8000) ? alphaSet : alphaClear) << 24;
+    }
+
+    inline uint32_t frameToRgba(uint32_t bits, uint32_t raw)
+    {
+        switch (bits)
+        {
+        case 16:
+            return unpack16(raw, 0x80, 0);
+        case 24:
+            return raw | 0x80000000; // no stored alpha reads as 1.0
+        default:
+            return raw;
+        }
+    }
+
+    inline uint32_t rgbaToFrame(uint32_t bits, uint32_t rgba)
+    {
+        switch (bits)
+        {
+        case 16:
+            return pack16(rgba);
+        case 24:
+            return rgba & 0xFFFFFF;
+        default:
+            return rgba;
+        }
+    }
+
+    inline uint32_t channel(uint32_t rgba, int shift) { return (rgba >> shift) & 0xFF; }
+
+    inline uint32_t packRgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    // Four float lanes (r, g, b, a) to 0xAABBGGRR, saturated
+    inline uint32_t packColor(__m128 color)
+    {
+        __m128i i32 = _mm_cvttps_epi32(color);
+        __m128i i16 = _mm_packs_epi32(i32, i32);
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(i16, i16)));
+    }
+
+    inline __m128 unpackColor(const Vertex& v)
+    {
+        return _mm_set_ps(v.a, v.b, v.g, v.r);
+    }
+
+    // Texture coordinates and fog as (s, t, q, fog), or (u, v, 1, fog) in texels for FST
+    inline __m128 unpackTexture(const Vertex& v, bool fst)
+    {
+        if (fst)
+        {
+            return _mm_set_ps(v.fog, 1.0f, v.v / 16.0f, v.u / 16.0f);
+        }
+        return _mm_set_ps(v.fog, v.q, v.t, v.s);
+    }
+
+    inline float lane(__m128 v, int index)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        return lanes[index];
+    }
+
+    class Sampler
+    {
+    public:
+        Sampler(const uint8_t* vram, const GSDrawState& d, const uint32_t* palette)
+            : m_vram(vram), m_d(d), m_palette(palette),
+              m_width(1 << std::min<uint32_t>(d.tw, 10)), m_height(1 << std::min<uint32_t>(d.th, 10))
+        {
+        }
+
+        int32_t width() const { return m_width; }
+        int32_t height() const { return m_height; }
+
+        uint32_t sample(float u, float v) const
+        {
+            if (!m_d.bilinear)
+            {
+                return fetch(static_cast<int32_t>(std::floor(u)), static_cast<int32_t>(std::floor(v)));
+            }
+
+            u -= 0.5f;
+            v -= 0.5f;
+            const float fu0 = std::floor(u);
+            const float fv0 = std::floor(v);
+            const int32_t u0 = static_cast<int32_t>(fu0);
+            const int32_t v0 = static_cast<int32_t>(fv0);
+            const uint32_t wu = static_cast<uint32_t>((u - fu0) * 256.0f);
+            const uint32_t wv = static_cast<uint32_t>((v - fv0) * 256.0f);
+            const uint32_t top = lerp(fetch(u0, v0), fetch(u0 + 1, v0), wu);
+            const uint32_t bottom = lerp(fetch(u0, v0 + 1), fetch(u0 + 1, v0 + 1), wu);
+            return lerp(top, bottom, wv);
+        }
+
+    private:
+        const uint8_t* m_vram;
+        const GSDrawState& m_d;
+        const uint32_t* m_palette;
+        int32_t m_width;
+        int32_t m_height;
+
+        static uint32_t lerp(uint32_t a, uint32_t b, uint32_t weight)
+        {
+            uint32_t result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                int32_t ca = static_cast<int32_t>(channel(a, shift));
+                int32_t cb = static_cast<int32_t>(channel(b, shift));
+                result |= static_cast<uint32_t>(ca + (((cb - ca) * static_cast<int32_t>(weight)) >> 8)) << shift;
+            }
+            return result;
+        }
+
+        static int32_t wrap(int32_t c, uint32_t mode, int32_t size, int32_t minimum, int32_t maximum)
+        {
+            switch (mode)
+            {
+            case 0: // REPEAT
+                return c & (size - 1);
+            case 1: // CLAMP
+                return std::clamp(c, 0, size - 1);
+            case 2: // REGION_CLAMP
+                return std::clamp(c, minimum, maximum);
+            default: // REGION_REPEAT: MINU/MAXU are a mask and a fixed part
+                return (c & minimum) | maximum;
+            }
+        }
+
+        uint32_t fetch(int32_t u, int32_t v) const
+        {
+            const GSDrawState& d = m_d;
+            u = wrap(u, d.wms, m_width, static_cast<int32_t>(d.minu), static_cast<int32_t>(d.maxu));
+            v = wrap(v, d.wmt, m_height, static_cast<int32_t>(d.minv), static_cast<int32_t>(d.maxv));
+            const uint32_t x = static_cast<uint32_t>(u) & kMaxCoordinate;
+            const uint32_t y = static_cast<uint32_t>(v) & kMaxCoordinate;
+
+            switch (d.tpsm)
+            {
+            case GSLocalMemory::PSMCT32:
+            case GSLocalMemory::PSMZ32:
+                return loadTarget(m_vram, 32, GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y));
+            case GSLocalMemory::PSMCT24:
+            case GSLocalMemory::PSMZ24:
+            {
+                uint32_t rgb = loadTarget(m_vram, 24, GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y));
+                return rgb | ((d.aem && rgb == 0) ? 0 : d.ta0) << 24;
+            }
+            case GSLocalMemory::PSMCT16:
+            case GSLocalMemory::PSMCT16S:
+            case GSLocalMemory::PSMZ16:
+            case GSLocalMemory::PSMZ16S:
+            {
+                uint32_t c = loadTarget(m_vram, 16, GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y));
+                return unpack16(c, d.ta1, (d.aem && (c & 0x7FFF) == 0) ? 0 : d.ta0);
+            }
+            case GSLocalMemory::PSMT8:
+                return m_palette[m_vram[GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y)]];
+            case GSLocalMemory::PSMT4:
+                return m_palette[GSLocalMemory::readPixel(m_vram, d.tpsm, d.tbp, d.tbw, x, y)];
+            case GSLocalMemory::PSMT8H:
+                return m_palette[loadTarget(m_vram, 32, GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y)) >> 24];
+            case GSLocalMemory::PSMT4HL:
+                return m_palette[(loadTarget(m_vram, 32, GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y)) >> 24) & 0xF];
+            case GSLocalMemory::PSMT4HH:
+                return m_palette[loadTarget(m_vram, 32, GSLocalMemory::pixelByteOffset(d.tpsm, d.tbp, d.tbw, x, y)) >> 28];
+            default:
+                return 0;
+            }
+        }
+    };
+
+    // Everything after rasterization for one pixel: texturing, fog, the tests, blending and the writes
+    class PixelPipeline
+    {
+    public:
+        PixelPipeline(uint8_t* vram, const GSDrawState& d, const uint32_t* palette)
+            : m_vram(vram), m_d(d), m_sampler(vram, d, palette),
+              m_frameBits(targetBits(d.fpsm)), m_zBits(targetBits(d.zpsm))
+        {
+            m_zMax = m_zBits == 32 ? 0xFFFFFFFFu : (1u << m_zBits) - 1;
+            m_frameMask = m_frameBits == 16 ? pack16(d.fbmsk) : (m_frameBits == 24 ? d.fbmsk & 0xFFFFFF : d.fbmsk);
+            m_zTest = d.zte && d.ztst != 1;
+        }
+
+        const Sampler& sampler() const { return m_sampler; }
+
+        void draw(int32_t x, int32_t y, uint32_t z, uint32_t color, float u, float v, uint32_t fog) const
+        {
+            const GSDrawState& d = m_d;
+            z = std::min(z, m_zMax);
+
+            bool writeZ = !d.zmsk;
+            uint32_t zOffset = 0;
+            if (m_zTest || writeZ)
+            {
+                zOffset = GSLocalMemory::pixelByteOffset(d.zpsm, d.zbp, d.fbw, x, y);
+            }
+            if (m_zTest)
+            {
+                // Larger Z is nearer
+                if (d.ztst == 0)
+                {
+                    return;
+                }
+                uint32_t stored = loadTarget(m_vram, m_zBits, zOffset);
+                if (d.ztst == 2 ? z < stored : z <= stored)
+                {
+                    return;
+                }
+            }
+
+            if (d.tme)
+            {
+                color = modulate(color, m_sampler.sample(u, v));
+            }
+            if (d.fge)
+            {
+                color = applyFog(color, fog);
+            }
+
+            bool writeFrame = true;
+            uint32_t frameMask = m_frameMask;
+            if (d.ate && !alphaTest(channel(color, 24)))
+            {
+                switch (d.afail)
+                {
+                case 0: // KEEP
+                    return;
+                case 1: // FB_ONLY
+                    writeZ = false;
+                    break;
+                case 2: // ZB_ONLY
+                    writeFrame = false;
+                    break;
+                default: // RGB_ONLY
+                    writeZ = false;
+                    frameMask |= m_frameBits == 16 ? 0x8000 : 0xFF000000;
+                    break;
+                }
+            }
+
+            if (writeFrame)
+            {
+                const uint32_t frameOffset = GSLocalMemory::pixelByteOffset(d.fpsm, d.fbp, d.fbw, x, y);
+                const bool blend = d.abe && (!d.pabe || (color & 0x80000000));
+                uint32_t stored = 0;
+                if (blend || d.date || frameMask)
+                {
+                    stored = loadTarget(m_vram, m_frameBits, frameOffset);
+                }
+                if (d.date && m_frameBits != 24)
+                {
+                    const bool destinationAlpha = (stored >> (m_frameBits - 1)) & 1;
+                    if (destinationAlpha != d.datm)
+                    {
+                        return;
+                    }
+                }
+                if (blend)
+                {
+                    color = alphaBlend(color, frameToRgba(m_frameBits, stored));
+                }
+                if (d.fba)
+                {
+                    color |= 0x80000000;
+                }
+                const uint32_t value = rgbaToFrame(m_frameBits, color);
+                storeTarget(m_vram, m_frameBits, frameOffset, (stored & frameMask) | (value & ~frameMask));
+            }
+
+            if (writeZ)
+            {
+                storeTarget(m_vram, m_zBits, zOffset, z);
+            }
+        }
+
+    private:
+        uint8_t* m_vram;
+        const GSDrawState& m_d;
+        Sampler m_sampler;
+        uint32_t m_frameBits;
+        uint32_t m_zBits;
+        uint32_t m_zMax;
+        uint32_t m_frameMask;
+        bool m_zTest;
+
+        uint32_t modulate(uint32_t f, uint32_t t) const
+        {
+            const uint32_t fa = channel(f, 24);
+            const uint32_t ta = channel(t, 24);
+            uint32_t rgb[3];
+            for (int i = 0; i < 3; i++)
+            {
+                const uint32_t fc = channel(f, i * 8);
+                const uint32_t tc = channel(t, i * 8);
+                switch (m_d.tfx)
+                {
+                case 0: // MODULATE
+                    rgb[i] = std::min<uint32_t>((fc * tc) >> 7, 255);
+                    break;
+                case 1: // DECAL
+                    rgb[i] = tc;
+                    break;
+                default: // HIGHLIGHT, HIGHLIGHT2
+                    rgb[i] = std::min<uint32_t>(((fc * tc) >> 7) + fa, 255);
+                    break;
+                }
+            }
+
+            uint32_t a = fa;
+            if (m_d.tcc)
+            {
+                switch (m_d.tfx)
+                {
+                case 0:
+                    a = std::min<uint32_t>((fa * ta) >> 7, 255);
+                    break;
+                case 2:
+                    a = std::min<uint32_t>(fa + ta, 255);
+                    break;
+                default:
+                    a = ta;
+                    break;
+                }
+            }
+            return packRgba(rgb[0], rgb[1], rgb[2], a);
+        }
+
+        uint32_t applyFog(uint32_t color, uint32_t fog) const
+        {
+            uint32_t result = color & 0xFF000000;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                const uint32_t c = channel(color, shift);
+                const uint32_t fc = channel(m_d.fogcol, shift);
+                result |= ((fog * c + (255 - fog) * fc) >> 8) << shift;
+            }
+            return result;
+        }
+
+        bool alphaTest(uint32_t a) const
+        {
+            const uint32_t ref = m_d.aref;
+            switch (m_d.atst)
+            {
+            case 0: return false;
+            case 1: return true;
+            case 2: return a < ref;
+            case 3: return a <= ref;
+            case 4: return a == ref;
+            case 5: return a >= ref;
+            case 6: return a > ref;
+            default: return a != ref;
+            }
+        }
+
+        // Cv = (A - B) * C >> 7 + D, with A/B/D picking Cs, Cd or 0 and C picking As, Ad or FIX
+        uint32_t alphaBlend(uint32_t source, uint32_t destination) const
+        {
+            const int32_t as = static_cast<int32_t>(channel(source, 24));
+            const int32_t ad = static_cast<int32_t>(channel(destination, 24));
+            const int32_t c = m_d.alphaC == 0 ? as : (m_d.alphaC == 1 ? ad : static_cast<int32_t>(m_d.alphaFix));
+
+            uint32_t result = source & 0xFF000000;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                const int32_t cs = static_cast<int32_t>(channel(source, shift));
+                const int32_t cd = static_cast<int32_t>(channel(destination, shift));
+                auto pick = [&](uint32_t selector) { return selector == 0 ? cs : (selector == 1 ? cd : 0); };
+                int32_t value = (((pick(m_d.alphaA) - pick(m_d.alphaB)) * c) >> 7) + pick(m_d.alphaD);
+                value = m_d.colclamp ? std::clamp(value, 0, 255) : (value & 0xFF);
+                result |= static_cast<uint32_t>(value) << shift;
+            }
+            return result;
+        }
+    };
+
+    // Texel coordinates from an interpolated (s, t, q, fog) or (u, v, 1, fog)
+    inline void textureCoordinates(const GSDrawState& d, const Sampler& sampler, __m128 tex, float& u, float& v)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, tex);
+        if (d.fst)
+        {
+            u = lanes[0];
+            v = lanes[1];
+        }
+        else
+        {
+            const float q = lanes[2] != 0.0f ? lanes[2] : 1.0f;
+            u = lanes[0] / q * sampler.width();
+            v = lanes[1] / q * sampler.height();
+        }
+    }
+
+    inline uint32_t fogOf(__m128 tex)
+    {
+        return static_cast<uint32_t>(std::clamp(lane(tex, 3), 0.0f, 255.0f));
+    }
+
+    // Whole blocks are 256 contiguous bytes, so fills inside them are plain vector stores
+    void fillTarget(uint8_t* vram, uint32_t psm, uint32_t bp, uint32_t bw, const Rect& r, uint32_t value)
+    {
+        const uint32_t bits = targetBits(psm);
+        const int32_t blockW = static_cast<int32_t>(GSLocalMemory::blockWidth(psm));
+        const int32_t blockH = static_cast<int32_t>(GSLocalMemory::blockHeight(psm));
+        const __m128i pattern = bits == 16 ? _mm_set1_epi16(static_cast<short>(value)) : _mm_set1_epi32(static_cast<int>(value));
+
+        for (int32_t by = r.y0 - r.y0 % blockH; by <= r.y1; by += blockH)
+        {
+            for (int32_t bx = r.x0 - r.x0 % blockW; bx <= r.x1; bx += blockW)
+            {
+                const Rect block{bx, by, bx + blockW - 1, by + blockH - 1};
+                const Rect part = block.intersect(r);
+                if (part.x0 == block.x0 && part.y0 == block.y0 && part.x1 == block.x1 && part.y1 == block.y1)
+                {
+                    const uint32_t base = GSLocalMemory::pixelByteOffset(psm, bp, bw, bx, by) & ~(GSLocalMemory::kBlockSize - 1);
+                    __m128i* dst = reinterpret_cast<__m128i*>(vram + base);
+                    for (uint32_t i = 0; i < GSLocalMemory::kBlockSize / 16; i++)
+                    {
+                        _mm_storeu_si128(dst + i, pattern);
+                    }
+                    continue;
+                }
+                for (int32_t y = part.y0; y <= part.y1; y++)
+                {
+                    for (int32_t x = part.x0; x <= part.x1; x++)
+                    {
+                        storeTarget(vram, bits, GSLocalMemory::pixelByteOffset(psm, bp, bw, x, y), value);
+                    }
+                }
+            }
+        }
+    }
+
+    void drawPoint(const PixelPipeline& pipeline, const GSDrawState& d, const Vertex& v, const Rect& r)
+    {
+        const int32_t x = roundPixel(v.x);
+        const int32_t y = roundPixel(v.y);
+        if (x < r.x0 || x > r.x1 || y < r.y0 || y > r.y1)
+        {
+            return;
+        }
+        float u = 0.0f;
+        float t = 0.0f;
+        textureCoordinates(d, pipeline.sampler(), unpackTexture(v, d.fst), u, t);
+        pipeline.draw(x, y, v.z, packRgba(v.r, v.g, v.b, v.a), u, t, v.fog);
+    }
+
+    void drawLine(const PixelPipeline& pipeline, const GSDrawState& d, const Vertex* v, const Rect& r)
+    {
+        const float x0 = v[0].x / 16.0f;
+        const float y0 = v[0].y / 16.0f;
+        const float dx = v[1].x / 16.0f - x0;
+        const float dy = v[1].y / 16.0f - y0;
+        const int32_t steps = std::max(1, static_cast<int32_t>(std::lround(std::max(std::fabs(dx), std::fabs(dy)))));
+
+        const __m128 c0 = d.iip ? unpackColor(v[0]) : unpackColor(v[1]);
+        const __m128 dc = d.iip ? _mm_sub_ps(unpackColor(v[1]), c0) : _mm_setzero_ps();
+        const __m128 t0 = unpackTexture(v[0], d.fst);
+        const __m128 dt = _mm_sub_ps(unpackTexture(v[1], d.fst), t0);
+        const double z0 = v[0].z;
+        const double dz = static_cast<double>(v[1].z) - z0;
+
+        // The last pixel is left for the next segment of a strip
+        for (int32_t i = 0; i < steps; i++)
+        {
+            const float f = static_cast<float>(i) / steps;
+            const int32_t x = static_cast<int32_t>(std::floor(x0 + dx * f + 0.5f));
+            const int32_t y = static_cast<int32_t>(std::floor(y0 + dy * f + 0.5f));
+            if (x < r.x0 || x > r.x1 || y < r.y0 || y > r.y1)
+            {
+                continue;
+            }
+            const __m128 weight = _mm_set1_ps(f);
+            const __m128 color = _mm_add_ps(c0, _mm_mul_ps(dc, weight));
+            const __m128 tex = _mm_add_ps(t0, _mm_mul_ps(dt, weight));
+            float u = 0.0f;
+            float t = 0.0f;
+            textureCoordinates(d, pipeline.sampler(), tex, u, t);
+            pipeline.draw(x, y, static_cast<uint32_t>(z0 + dz * f), packColor(color), u, t, fogOf(tex));
+        }
+    }
+
+    void drawTriangle(const PixelPipeline& pipeline, const GSDrawState& d, const Vertex* vertices, const Rect& r)
+    {
+        // Counter-clockwise in window space (y down), so every edge function is positive inside
+        const Vertex* v[3] = {&vertices[0], &vertices[1], &vertices[2]};
+        int64_t area = static_cast<int64_t>(v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) -
+                       static_cast<int64_t>(v[2]->x - v[0]->x) * (v[1]->y - v[0]->y);
+        if (area == 0)
+        {
+            return;
+        }
+        if (area < 0)
+        {
+            std::swap(v[1], v[2]);
+        }
+
+        struct Edge
+        {
+            int64_t e0;    // value at pixel (0, 0)
+            int64_t stepX; // change per pixel
+            int64_t stepY;
+            int64_t threshold; // 0 on top-left edges, which own the pixels exactly on them
+        };
+        Edge edges[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const Vertex& a = *v[i];
+            const Vertex& b = *v[(i + 1) % 3];
+            const int64_t ex = b.x - a.x;
+            const int64_t ey = b.y - a.y;
+            // E(X, Y) = (Y - Ya) * ex - (X - Xa) * ey, in 1/16 pixel units with X = x * 16
+            edges[i].e0 = -static_cast<int64_t>(a.y) * ex + static_cast<int64_t>(a.x) * ey;
+            edges[i].stepX = -16 * ey;
+            edges[i].stepY = 16 * ex;
+            const bool topLeft = ey < 0 || (ey == 0 && ex > 0);
+            edges[i].threshold = topLeft ? 0 : 1;
+        }
+
+        // Attribute planes: A(x, y) = A0 + dAdx * (x - x0) + dAdy * (y - y0)
+        const float x0 = v[0]->x / 16.0f;
+        const float y0 = v[0]->y / 16.0f;
+        const float dx1 = v[1]->x / 16.0f - x0;
+        const float dy1 = v[1]->y / 16.0f - y0;
+        const float dx2 = v[2]->x / 16.0f - x0;
+        const float dy2 = v[2]->y / 16.0f - y0;
+        const float inverse = 1.0f / (dx1 * dy2 - dx2 * dy1);
+
+        auto plane = [&](__m128 a0, __m128 a1, __m128 a2, __m128& ddx, __m128& ddy)
+        {
+            const __m128 d1 = _mm_sub_ps(a1, a0);
+            const __m128 d2 = _mm_sub_ps(a2, a0);
+            const __m128 inv = _mm_set1_ps(inverse);
+            ddx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d1, _mm_set1_ps(dy2)), _mm_mul_ps(d2, _mm_set1_ps(dy1))), inv);
+            ddy = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d2, _mm_set1_ps(dx1)), _mm_mul_ps(d1, _mm_set1_ps(dx2))), inv);
+            // Value at pixel (0, 0)
+            return _mm_sub_ps(a0, _mm_add_ps(_mm_mul_ps(ddx, _mm_set1_ps(x0)), _mm_mul_ps(ddy, _mm_set1_ps(y0))));
+        };
+
+        __m128 colorDx = _mm_setzero_ps();
+        __m128 colorDy = _mm_setzero_ps();
+        __m128 colorOrigin = unpackColor(vertices[2]); // flat shading takes the last vertex
+        if (d.iip)
+        {
+            colorOrigin = plane(unpackColor(*v[0]), unpackColor(*v[1]), unpackColor(*v[2]), colorDx, colorDy);
+        }
+        __m128 texDx;
+        __m128 texDy;
+        const __m128 texOrigin = plane(unpackTexture(*v[0], d.fst), unpackTexture(*v[1], d.fst),
+                                       unpackTexture(*v[2], d.fst), texDx, texDy);
+
+        const double z1 = static_cast<double>(v[1]->z) - v[0]->z;
+        const double z2 = static_cast<double>(v[2]->z) - v[0]->z;
+        const double zDx = (z1 * dy2 - z2 * dy1) / (static_cast<double>(dx1) * dy2 - static_cast<double>(dx2) * dy1);
+        const double zDy = (z2 * dx1 - z1 * dx2) / (static_cast<double>(dx1) * dy2 - static_cast<double>(dx2) * dy1);
+        const double zOrigin = v[0]->z - zDx * x0 - zDy * y0;
+
+        for (int32_t y = r.y0; y <= r.y1; y++)
+        {
+            // Solve each edge for the span it allows on this row
+            int64_t left = r.x0;
+            int64_t right = r.x1;
+            for (const Edge& e : edges)
+            {
+                const int64_t rowValue = e.e0 + e.stepY * y;
+                if (e.stepX > 0)
+                {
+                    left = std::max(left, ceilDiv(e.threshold - rowValue, e.stepX));
+                }
+                else if (e.stepX < 0)
+                {
+                    right = std::min(right, floorDiv(rowValue - e.threshold, -e.stepX));
+                }
+                else if (rowValue < e.threshold)
+                {
+                    right = left - 1;
+                }
+            }
+            if (left > right)
+            {
+                continue;
+            }
+
+            const __m128 fx = _mm_set1_ps(static_cast<float>(left));
+            const __m128 fy = _mm_set1_ps(static_cast<float>(y));
+            __m128 color = _mm_add_ps(colorOrigin, _mm_add_ps(_mm_mul_ps(colorDx, fx), _mm_mul_ps(colorDy, fy)));
+            __m128 tex = _mm_add_ps(texOrigin, _mm_add_ps(_mm_mul_ps(texDx, fx), _mm_mul_ps(texDy, fy)));
+            double z = zOrigin + zDx * left + zDy * y;
+            for (int64_t x = left; x <= right; x++)
+            {
+                float u = 0.0f;
+                float t = 0.0f;
+                if (d.tme)
+                {
+                    textureCoordinates(d, pipeline.sampler(), tex, u, t);
+                }
+                const uint32_t zi = static_cast<uint32_t>(std::clamp(z, 0.0, 4294967295.0));
+                pipeline.draw(static_cast<int32_t>(x), y, zi, packColor(color), u, t, d.fge ? fogOf(tex) : 0);
+                color = _mm_add_ps(color, colorDx);
+                tex = _mm_add_ps(tex, texDx);
+                z += zDx;
+            }
+        }
+    }
+
+    void drawSprite(uint8_t* vram, const PixelPipeline& pipeline, const GSRasterizer::State& state,
+                    const Vertex* v, const Rect& r)
+    {
+        const GSDrawState& d = state.draw;
+        // Sprites are flat: colour, Z and fog come from the second vertex
+        const uint32_t color = packRgba(v[1].r, v[1].g, v[1].b, v[1].a);
+
+        if (state.simpleFill)
+        {
+            fillTarget(vram, d.fpsm, d.fbp, d.fbw, r, rgbaToFrame(targetBits(d.fpsm), d.fba ? color | 0x80000000 : color));
+            if (!d.zmsk)
+            {
+                const uint32_t zBits = targetBits(d.zpsm);
+                const uint32_t zMax = zBits == 32 ? 0xFFFFFFFFu : (1u << zBits) - 1;
+                fillTarget(vram, d.zpsm, d.zbp, d.fbw, r, std::min(v[1].z, zMax));
+            }
+            return;
+        }
+
+        // Texture coordinates run from the first vertex to the second, s/u along x and t/v along y
+        const __m128 t0 = unpackTexture(v[0], d.fst);
+        const __m128 t1 = unpackTexture(v[1], d.fst);
+        const float spanX = (v[1].x - v[0].x) / 16.0f;
+        const float spanY = (v[1].y - v[0].y) / 16.0f;
+        const float du = spanX != 0.0f ? (lane(t1, 0) - lane(t0, 0)) / spanX : 0.0f;
+        const float dv = spanY != 0.0f ? (lane(t1, 1) - lane(t0, 1)) / spanY : 0.0f;
+        const float x0 = v[0].x / 16.0f;
+        const float y0 = v[0].y / 16.0f;
+        const float q = lane(t1, 2);
+
+        for (int32_t y = r.y0; y <= r.y1; y++)
+        {
+            const float tv = lane(t0, 1) + (y - y0) * dv;
+            for (int32_t x = r.x0; x <= r.x1; x++)
+            {
+                float u = 0.0f;
+                float t = 0.0f;
+                if (d.tme)
+                {
+                    const float tu = lane(t0, 0) + (x - x0) * du;
+                    textureCoordinates(d, pipeline.sampler(), _mm_set_ps(0.0f, q, tv, tu), u, t);
+                }
+                pipeline.draw(x, y, v[1].z, color, u, t, v[1].fog);
+            }
+        }
+    }
+
+    Rect primitiveBounds(PrimitiveType type, const Vertex* v)
+    {
+        switch (type)
+        {
+        case PrimitiveType::Point:
+            return {roundPixel(v[0].x), roundPixel(v[0].y), roundPixel(v[0].x), roundPixel(v[0].y)};
+        case PrimitiveType::Line:
+            return {std::min(roundPixel(v[0].x), roundPixel(v[1].x)), std::min(roundPixel(v[0].y), roundPixel(v[1].y)),
+                    std::max(roundPixel(v[0].x), roundPixel(v[1].x)), std::max(roundPixel(v[0].y), roundPixel(v[1].y))};
+        case PrimitiveType::Sprite:
+            // Pixels whose top-left corner is inside [v0, v1)
+            return {ceilPixel(std::min(v[0].x, v[1].x)), ceilPixel(std::min(v[0].y, v[1].y)),
+                    ceilPixel(std::max(v[0].x, v[1].x)) - 1, ceilPixel(std::max(v[0].y, v[1].y)) - 1};
+        default:
+            return {ceilPixel(std::min({v[0].x, v[1].x, v[2].x})), ceilPixel(std::min({v[0].y, v[1].y, v[2].y})),
+                    floorPixel(std::max({v[0].x, v[1].x, v[2].x})), floorPixel(std::max({v[0].y, v[1].y, v[2].y}))};
+        }
+    }
+}
+
+GSRasterizer::GSRasterizer()
+    : m_bins(kTilesPerRow * kTilesPerRow)
+{
+}
+
+GSRasterizer::~GSRasterizer()
+{
+    stopWorkers();
+}
+
+void GSRasterizer::attach(uint8_t* vram, GSLocalMemory::PageMask* dirtyPages)
+{
+    m_vram = vram;
+    m_dirtyPages = dirtyPages;
+}
+
+void GSRasterizer::setThreadCount(uint32_t threads)
+{
+    flush();
+    stopWorkers();
+
+    m_quit = false;
+    for (uint32_t i = 1; i < threads; i++)
+    {
+        m_workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+void GSRasterizer::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void GSRasterizer::setState(const GSDrawState& state, const uint32_t* palette)
+{
+    m_current = State();
+    m_current.draw = state;
+    m_current.hasPalette = palette != nullptr;
+    if (palette)
+    {
+        std::copy(palette, palette + 256, m_currentPalette.begin());
+    }
+
+    const GSDrawState& d = m_current.draw;
+    const uint32_t zBits = targetBits(d.zpsm);
+    m_current.simpleFill = !d.tme && !d.abe && !d.fge && (!d.ate || d.atst == 1) && !d.date &&
+                           (!d.zte || d.ztst == 1) && d.fbmsk == 0 && targetBits(d.fpsm) != 24 &&
+                           (d.zmsk || zBits != 24);
+    if (d.tme)
+    {
+        GSLocalMemory::markPages(m_current.texturePages, d.tpsm, d.tbp, d.tbw, 0, 0,
+                                 1u << std::min<uint32_t>(d.tw, 10), 1u << std::min<uint32_t>(d.th, 10));
+    }
+    m_currentQueued = false;
+}
+
+void GSRasterizer::addPrimitive(PrimitiveType type, const Vertex* vertices)
+{
+    const GSDrawState& d = m_current.draw;
+    Rect bounds = primitiveBounds(type, vertices);
+    const Rect scissor{std::max(d.scissorX0, 0), std::max(d.scissorY0, 0),
+                       std::min(d.scissorX1, kMaxCoordinate), std::min(d.scissorY1, kMaxCoordinate)};
+    bounds = bounds.intersect(scissor);
+    if (bounds.empty())
+    {
+        return;
+    }
+
+    const uint32_t width = static_cast<uint32_t>(bounds.x1 - bounds.x0 + 1);
+    const uint32_t height = static_cast<uint32_t>(bounds.y1 - bounds.y0 + 1);
+    GSLocalMemory::PageMask writes;
+    GSLocalMemory::markPages(writes, d.fpsm, d.fbp, d.fbw, bounds.x0, bounds.y0, width, height);
+    if (!d.zmsk)
+    {
+        GSLocalMemory::markPages(writes, d.zpsm, d.zbp, d.fbw, bounds.x0, bounds.y0, width, height);
+    }
+
+    // Tiles run in any order, so nothing in a batch may texture from what it draws
+    if ((m_current.texturePages & m_writePages).any() || (writes & m_readPages).any() ||
+        m_primitives.size() >= kMaxPrimitives)
+    {
+        flush();
+    }
+
+    if (!m_currentQueued)
+    {
+        m_current.palette = static_cast<uint32_t>(m_palettes.size());
+        if (m_current.hasPalette)
+        {
+            m_palettes.push_back(m_currentPalette);
+        }
+        m_states.push_back(m_current);
+        m_currentQueued = true;
+    }
+
+    Primitive primitive;
+    primitive.type = type;
+    primitive.state = static_cast<uint32_t>(m_states.size() - 1);
+    primitive.x0 = bounds.x0;
+    primitive.y0 = bounds.y0;
+    primitive.x1 = bounds.x1;
+    primitive.y1 = bounds.y1;
+    const int count = type == PrimitiveType::Triangle ? 3 : (type == PrimitiveType::Point ? 1 : 2);
+    std::copy(vertices, vertices + count, primitive.v);
+
+    const uint32_t index = static_cast<uint32_t>(m_primitives.size());
+    m_primitives.push_back(primitive);
+    for (int32_t ty = bounds.y0 >> kTileShift; ty <= bounds.y1 >> kTileShift; ty++)
+    {
+        for (int32_t tx = bounds.x0 >> kTileShift; tx <= bounds.x1 >> kTileShift; tx++)
+        {
+            std::vector<uint32_t>& bin = m_bins[ty * kTilesPerRow + tx];
+            if (bin.empty())
+            {
+                m_activeTiles.push_back(ty * kTilesPerRow + tx);
+            }
+            bin.push_back(index);
+        }
+    }
+
+    m_writePages |= writes;
+    m_readPages |= m_current.texturePages;
+    if (m_dirtyPages)
+    {
+        *m_dirtyPages |= writes;
+    }
+}
+
+void GSRasterizer::flush()
+{
+    if (m_primitives.empty())
+    {
+        return;
+    }
+
+    if (m_vram)
+    {
+        m_nextTile.store(0, std::memory_order_relaxed);
+        if (m_workers.empty())
+        {
+            drawTiles();
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_generation++;
+                m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+            }
+            m_wake.notify_all();
+            drawTiles();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]() { return m_busyWorkers == 0; });
+        }
+    }
+
+    for (uint32_t tile : m_activeTiles)
+    {
+        m_bins[tile].clear();
+    }
+    m_activeTiles.clear();
+    m_primitives.clear();
+    m_states.clear();
+    m_palettes.clear();
+    m_readPages.reset();
+    m_writePages.reset();
+    m_currentQueued = false;
+}
+
+void GSRasterizer::workerLoop()
+{
+    uint64_t seen;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        seen = m_generation;
+    }
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_quit || m_generation != seen; });
+            if (m_quit)
+            {
+                return;
+            }
+            seen = m_generation;
+        }
+
+        drawTiles();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0)
+        {
+            m_idle.notify_one();
+        }
+    }
+}
+
+void GSRasterizer::drawTiles()
+{
+    const uint32_t count = static_cast<uint32_t>(m_activeTiles.size());
+    for (uint32_t i = m_nextTile.fetch_add(1, std::memory_order_relaxed); i < count;
+         i = m_nextTile.fetch_add(1, std::memory_order_relaxed))
+    {
+        drawTile(m_activeTiles[i]);
+    }
+}
+
+void GSRasterizer::drawTile(uint32_t tile)
+{
+    const int32_t tileX = static_cast<int32_t>(tile % kTilesPerRow) * kTileSize;
+    const int32_t tileY = static_cast<int32_t>(tile / kTilesPerRow) * kTileSize;
+    const Rect tileRect{tileX, tileY, tileX + kTileSize - 1, tileY + kTileSize - 1};
+
+    for (uint32_t index : m_bins[tile])
+    {
+        const Primitive& primitive = m_primitives[index];
+        const State& state = m_states[primitive.state];
+        const Rect r = tileRect.intersect({primitive.x0, primitive.y0, primitive.x1, primitive.y1});
+        if (r.empty())
+        {
+            continue;
+        }
+
+        const uint32_t* palette = state.hasPalette ? m_palettes[state.palette].data() : nullptr;
+        const PixelPipeline pipeline(m_vram, state.draw, palette);
+        switch (primitive.type)
+        {
+        case PrimitiveType::Point:
+            drawPoint(pipeline, state.draw, primitive.v[0], r);
+            break;
+        case PrimitiveType::Line:
+            drawLine(pipeline, state.draw, primitive.v, r);
+            break;
+        case PrimitiveType::Triangle:
+            drawTriangle(pipeline, state.draw, primitive.v, r);
+            break;
+        case PrimitiveType::Sprite:
+            drawSprite(m_vram, pipeline, state, primitive.v, r);
+            break;
+        }
+    }
+}
@@ -1,12 +1,285 @@
 #include "gs_renderer.h"
+#include "gs_local_memory.h"
 #include "ps2_runtime.h"
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Kernels for wider instruction sets are compiled per function, so the library
+// still runs on CPUs without them; the best one available is picked at startup.
+#if defined(__GNUC__) || defined(__clang__)
+#define GS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define GS_TARGET(isa)
+#endif
+
+namespace
+{
+    // PS2 PSMCT32 is ABGR in a little-endian word; the host buffer holds 0xRRGGBBAA
+    inline uint32_t convertPSMCT32Pixel(uint32_t psColor)
+    {
+        uint8_t a = (psColor >> 24) & 0xFF;
+        uint8_t b = (psColor >> 16) & 0xFF;
+        uint8_t g = (psColor >> 8) & 0xFF;
+        uint8_t r = psColor & 0xFF;
+        return (r << 24) | (g << 16) | (b << 8) | a;
+    }
+
+    // PS2 PSMCT16 is ABGR5551; channels widen 5 to 8 bits by repeating their top bits
+    inline uint32_t convertPSMCT16Pixel(uint16_t psColor)
+    {
+        uint32_t r5 = psColor & 0x1F;
+        uint32_t g5 = (psColor >> 5) & 0x1F;
+        uint32_t b5 = (psColor >> 10) & 0x1F;
+        uint32_t r = (r5 << 3) | (r5 >> 2);
+        uint32_t g = (g5 << 3) | (g5 >> 2);
+        uint32_t b = (b5 << 3) | (b5 >> 2);
+        uint32_t a = (psColor & 0x8000) ? 0xFF : 0x00;
+        return (r << 24) | (g << 16) | (b << 8) | a;
+    }
+
+    void convertRowPSMCT32Scalar(const uint8_t *src, uint32_t *dst, uint32_t count)
+    {
+        for (uint32_t x = 0; x < count; ++x)
+        {
+            uint32_t psColor;
+            std::memcpy(&psColor, src + x * 4, sizeof(psColor));
+            dst[x] = convertPSMCT32Pixel(psColor);
+        }
+    }
+
+    void convertRowPSMCT16Scalar(const uint8_t *src, uint32_t *dst, uint32_t count)
+    {
+        for (uint32_t x = 0; x < count; ++x)
+        {
+            uint16_t psColor;
+            std::memcpy(&psColor, src + x * 2, sizeof(psColor));
+            dst[x] = convertPSMCT16Pixel(psColor);
+        }
+    }
+
+    // Byte-reverses every 32-bit pixel
+    GS_TARGET("ssse3")
+    void convertRowPSMCT32SSSE3(const uint8_t *src, uint32_t *dst, uint32_t count)
+    {
+        const __m128i reverse = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_shuffle_epi8(pixels, reverse));
+        }
+        convertRowPSMCT32Scalar(src + x * 4, dst + x, count - x);
+    }
+
+    GS_TARGET("avx2")
+    void convertRowPSMCT32AVX2(const uint8_t *src, uint32_t *dst, uint32_t count)
+    {
+        const __m256i reverse = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_shuffle_epi8(pixels, reverse));
+        }
+        convertRowPSMCT32Scalar(src + x * 4, dst + x, count - x);
+    }
+
+    // Four pixels zero-extended to 32-bit lanes; SSE2 only, so it also serves the SSSE3 level
+    inline __m128i expandPSMCT16x4(__m128i pixels)
+    {
+        const __m128i mask5 = _mm_set1_epi32(0x1F);
+        __m128i r = _mm_and_si128(pixels, mask5);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 5), mask5);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 10), mask5);
+        r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+        g = _mm_or_si128(_mm_slli_epi32(g, 3), _mm_srli_epi32(g, 2));
+        b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+        // Bit 15 shifted down to bit 0, then negated and masked: 0xFF when set, 0 otherwise
+        __m128i a = _mm_and_si128(_mm_sub_epi32(_mm_setzero_si128(), _mm_srli_epi32(pixels, 15)), _mm_set1_epi32(0xFF));
+        __m128i rgba = _mm_or_si128(_mm_slli_epi32(r, 24), _mm_slli_epi32(g, 16));
+        return _mm_or_si128(rgba, _mm_or_si128(_mm_slli_epi32(b, 8), a));
+    }
+
+    void convertRowPSMCT16SSE2(const uint8_t *src, uint32_t *dst, uint32_t count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), expandPSMCT16x4(_mm_unpacklo_epi16(pixels, zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 4), expandPSMCT16x4(_mm_unpackhi_epi16(pixels, zero)));
+        }
+        convertRowPSMCT16Scalar(src + x * 2, dst + x, count - x);
+    }
+
+    GS_TARGET("avx2")
+    void convertRowPSMCT16AVX2(const uint8_t *src, uint32_t *dst, uint32_t count)
+    {
+        const __m256i mask5 = _mm256_set1_epi32(0x1F);
+        const __m256i alpha = _mm256_set1_epi32(0xFF);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i pixels = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2)));
+            __m256i r = _mm256_and_si256(pixels, mask5);
+            __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 5), mask5);
+            __m256i b = _mm256_and_si256(_mm256_srli_epi32(pixels, 10), mask5);
+            r = _mm256_or_si256(_mm256_slli_epi32(r, 3), _mm256_srli_epi32(r, 2));
+            g = _mm256_or_si256(_mm256_slli_epi32(g, 3), _mm256_srli_epi32(g, 2));
+            b = _mm256_or_si256(_mm256_slli_epi32(b, 3), _mm256_srli_epi32(b, 2));
+            __m256i a = _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), _mm256_srli_epi32(pixels, 15)), alpha);
+            __m256i rgba = _mm256_or_si256(_mm256_slli_epi32(r, 24), _mm256_slli_epi32(g, 16));
+            rgba = _mm256_or_si256(rgba, _mm256_or_si256(_mm256_slli_epi32(b, 8), a));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), rgba);
+        }
+        convertRowPSMCT16Scalar(src + x * 2, dst + x, count - x);
+    }
+
+    void convertRowPSMT8Scalar(const uint8_t *src, uint32_t *dst, uint32_t count, const uint32_t *palette)
+    {
+        for (uint32_t x = 0; x < count; ++x)
+        {
+            dst[x] = palette[src[x]];
+        }
+    }
+
+    // Two pixels per byte, the first one in the low nibble
+    void convertRowPSMT4Scalar(const uint8_t *src, uint32_t *dst, uint32_t count, const uint32_t *palette)
+    {
+        for (uint32_t x = 0; x < count; ++x)
+        {
+            dst[x] = palette[(src[x / 2] >> ((x & 1) * 4)) & 0xF];
+        }
+    }
+
+    GS_TARGET("avx2")
+    void convertRowPSMT8AVX2(const uint8_t *src, uint32_t *dst, uint32_t count, const uint32_t *palette)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)));
+            __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int *>(palette), indices, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), colors);
+        }
+        convertRowPSMT8Scalar(src + x, dst + x, count - x, palette);
+    }
+
+    // Splits 16 palette entries into byte planes: planes[k] holds byte k of every entry, so a
+    // byte shuffle by 16 indices looks up that byte of 16 pixels at once
+    GS_TARGET("ssse3")
+    inline void splitPalette16(const uint32_t *palette, __m128i planes[4])
+    {
+        const __m128i transpose = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        __m128i q0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(palette)), transpose);
+        __m128i q1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(palette + 4)), transpose);
+        __m128i q2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(palette + 8)), transpose);
+        __m128i q3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(palette + 12)), transpose);
+        __m128i lo01 = _mm_unpacklo_epi32(q0, q1);
+        __m128i hi01 = _mm_unpackhi_epi32(q0, q1);
+        __m128i lo23 = _mm_unpacklo_epi32(q2, q3);
+        __m128i hi23 = _mm_unpackhi_epi32(q2, q3);
+        planes[0] = _mm_unpacklo_epi64(lo01, lo23);
+        planes[1] = _mm_unpackhi_epi64(lo01, lo23);
+        planes[2] = _mm_unpacklo_epi64(hi01, hi23);
+        planes[3] = _mm_unpackhi_epi64(hi01, hi23);
+    }
+
+    GS_TARGET("ssse3")
+    void convertRowPSMT4SSSE3(const uint8_t *src, uint32_t *dst, uint32_t count, const uint32_t *palette)
+    {
+        __m128i planes[4];
+        splitPalette16(palette, planes);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x / 2));
+            __m128i indices = _mm_unpacklo_epi8(_mm_and_si128(packed, nibble), _mm_and_si128(_mm_srli_epi16(packed, 4), nibble));
+            __m128i c0 = _mm_shuffle_epi8(planes[0], indices);
+            __m128i c1 = _mm_shuffle_epi8(planes[1], indices);
+            __m128i c2 = _mm_shuffle_epi8(planes[2], indices);
+            __m128i c3 = _mm_shuffle_epi8(planes[3], indices);
+            __m128i lo01 = _mm_unpacklo_epi8(c0, c1);
+            __m128i hi01 = _mm_unpackhi_epi8(c0, c1);
+            __m128i lo23 = _mm_unpacklo_epi8(c2, c3);
+            __m128i hi23 = _mm_unpackhi_epi8(c2, c3);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_unpacklo_epi16(lo01, lo23));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 4), _mm_unpackhi_epi16(lo01, lo23));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 8), _mm_unpacklo_epi16(hi01, hi23));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 12), _mm_unpackhi_epi16(hi01, hi23));
+        }
+        convertRowPSMT4Scalar(src + x / 2, dst + x, count - x, palette);
+    }
+
+    GSRenderer::SimdLevel detectSimdLevel()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        const bool ssse3 = (info[2] & (1 << 9)) != 0;
+        const bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+        __cpuidex(info, 7, 0);
+        const bool avx2 = osAvx && (info[1] & (1 << 5));
+#else
+        __builtin_cpu_init();
+        const bool ssse3 = __builtin_cpu_supports("ssse3");
+        const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        if (avx2)
+        {
+            return GSRenderer::SimdLevel::AVX2;
+        }
+        return ssse3 ? GSRenderer::SimdLevel::SSSE3 : GSRenderer::SimdLevel::Scalar;
+    }
+}
 
 GSRenderer::GSRenderer()
-    : m_displayWidth(0), m_displayHeight(0), m_framebufferDirty(false)
+    : m_displayWidth(0), m_displayHeight(0)
 {
+    setSimdLevel(supportedSimdLevel());
+}
+
+GSRenderer::SimdLevel GSRenderer::supportedSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+void GSRenderer::setSimdLevel(SimdLevel level)
+{
+    m_simdLevel = std::min(level, supportedSimdLevel());
+    switch (m_simdLevel)
+    {
+    case SimdLevel::AVX2:
+        m_convertRowPSMCT32 = convertRowPSMCT32AVX2;
+        m_convertRowPSMCT16 = convertRowPSMCT16AVX2;
+        m_convertRowPSMT8 = convertRowPSMT8AVX2;
+        // A 16-entry palette fits one shuffle; widening to 256 bits costs more than it saves
+        m_convertRowPSMT4 = convertRowPSMT4SSSE3;
+        break;
+    case SimdLevel::SSSE3:
+        // Without a gather instruction, 8-bit lookups stay scalar
+        m_convertRowPSMCT32 = convertRowPSMCT32SSSE3;
+        m_convertRowPSMCT16 = convertRowPSMCT16SSE2;
+        m_convertRowPSMT8 = convertRowPSMT8Scalar;
+        m_convertRowPSMT4 = convertRowPSMT4SSSE3;
+        break;
+    default:
+        m_convertRowPSMCT32 = convertRowPSMCT32Scalar;
+        m_convertRowPSMCT16 = convertRowPSMCT16Scalar;
+        m_convertRowPSMT8 = convertRowPSMT8Scalar;
+        m_convertRowPSMT4 = convertRowPSMT4Scalar;
+        break;
+    }
 }
 
 GSRenderer::~GSRenderer() = default;
@@ -16,131 +289,217 @@ bool GSRenderer::initialize(uint32_t displayWidth, uint32_t displayHeight)
     m_displayWidth = displayWidth;
     m_displayHeight = displayHeight;
 
-    // Allocate framebuffer for RGBA32 data
+    // Allocate framebuffers for RGBA32 data
     size_t pixelCount = displayWidth * displayHeight;
-    m_framebufferRGBA.resize(pixelCount, 0xFF000000); // Initialize to opaque black
+    for (std::vector<uint32_t>& frame : m_frames)
+    {
+        frame.assign(pixelCount, 0xFF000000); // Initialize to opaque black
+    }
+    m_converted.assign(pixelCount, 0xFF000000);
+    m_invalid = true;
+    m_back = 0;
+    m_front = 1;
+    m_ready.store(2, std::memory_order_relaxed);
 
     std::cout << "[GS Renderer] Initialized " << displayWidth << "x" << displayHeight 
-              << " framebuffer (" << (pixelCount * 4 / 1024) << " KB)" << std::endl;
+              << " framebuffer (3 x " << (pixelCount * 4 / 1024) << " KB)" << std::endl;
 
     return true;
 }
 
-uint32_t GSRenderer::convertPSMCT32ToRGBA(uint32_t psColor) const
+bool GSRenderer::updateFramebuffer(PS2Memory& memory, const FramebufferConfig& config)
 {
-    // PS2 PSMCT32 format: ABGR (8 bits each)
-    // PC RGBA format: RGBA (8 bits each)
-    
-    uint8_t a = (psColor >> 24) & 0xFF;
-    uint8_t b = (psColor >> 16) & 0xFF;
-    uint8_t g = (psColor >> 8) & 0xFF;
-    uint8_t r = psColor & 0xFF;
-
-    // Convert to RGBA format
-    return (r << 24) | (g << 16) | (b << 8) | a;
-}
+    if (m_converted.empty())
+    {
+        return false;
+    }
 
-uint32_t GSRenderer::convertPSMCT16ToRGBA(uint16_t psColor) const
-{
-    // PS2 PSMCT16 format: ABGR5551 (5 bits RGB, 1 bit Alpha)
-    // Extract components
-    uint8_t r = ((psColor & 0x001F) << 3) | ((psColor & 0x001F) >> 2);  // 5-bit to 8-bit
-    uint8_t g = (((psColor >> 5) & 0x001F) << 3) | (((psColor >> 5) & 0x001F) >> 2);
-    uint8_t b = (((psColor >> 10) & 0x001F) << 3) | (((psColor >> 10) & 0x001F) >> 2);
-    uint8_t a = (psColor & 0x8000) ? 0xFF : 0x00;  // 1-bit alpha
-
-    return (r << 24) | (g << 16) | (b << 8) | a;
-}
+    const uint8_t* vram = memory.getGSVRAM();
+    if (!vram)
+    {
+        return false;
+    }
 
-uint32_t GSRenderer::calculateVRAMOffset(uint32_t x, uint32_t y, uint32_t fbw, PixelFormat format) const
-{
-    // Calculate offset in VRAM based on framebuffer format
-    // FBW is in 64-pixel blocks, so multiply by 64 to get pixel width
-    uint32_t pixelWidth = fbw * 64;
+    // Primitives still queued would otherwise be missing from the frame and their pages from the dirty mask
+    memory.gsState().flush();
+
+    uint32_t displayWidth = std::min(m_displayWidth, config.width * 64);
+    uint32_t displayHeight = std::min(m_displayHeight, config.height);
+    uint32_t blockPointer = config.basePointer * GSLocalMemory::kBlocksPerPage; // FBP is in 8 KB pages
 
-    switch (format)
+    uint32_t psm = 0;
+    uint32_t bitsPerPixel = 0;
+    ConvertRowFn convertRow = nullptr;
+    ConvertIndexedRowFn convertIndexedRow = nullptr;
+    switch (config.format)
     {
     case PixelFormat::PSMCT32:
-        // 32-bit color: 4 bytes per pixel
-        return (y * pixelWidth + x) * 4;
+        psm = GSLocalMemory::PSMCT32;
+        bitsPerPixel = 32;
+        convertRow = m_convertRowPSMCT32;
+        break;
     case PixelFormat::PSMCT16:
+        psm = GSLocalMemory::PSMCT16;
+        bitsPerPixel = 16;
+        convertRow = m_convertRowPSMCT16;
+        break;
     case PixelFormat::PSMCT16S:
-        // 16-bit color: 2 bytes per pixel
-        return (y * pixelWidth + x) * 2;
+        psm = GSLocalMemory::PSMCT16S;
+        bitsPerPixel = 16;
+        convertRow = m_convertRowPSMCT16;
+        break;
     case PixelFormat::PSMT8:
-        // 8-bit indexed: 1 byte per pixel
-        return y * pixelWidth + x;
+        psm = GSLocalMemory::PSMT8;
+        bitsPerPixel = 8;
+        convertIndexedRow = m_convertRowPSMT8;
+        break;
     case PixelFormat::PSMT4:
-        // 4-bit indexed: 0.5 bytes per pixel
-        return (y * pixelWidth + x) / 2;
+        psm = GSLocalMemory::PSMT4;
+        bitsPerPixel = 4;
+        convertIndexedRow = m_convertRowPSMT4;
+        break;
     default:
-        return 0;
+        break;
     }
-}
 
-void GSRenderer::updateFramebuffer(const PS2Memory& memory, const FramebufferConfig& config)
-{
-    if (m_framebufferRGBA.empty())
+    // The palette is only converted again after a CLUT load, which then changes every pixel
+    bool paletteChanged = false;
+    if (convertIndexedRow)
     {
-        return;
+        const GSState& gs = memory.gsState();
+        const uint32_t entries = psm == GSLocalMemory::PSMT8 ? 256 : 16;
+        if (entries != m_paletteEntries || gs.clutGeneration() != m_paletteGeneration)
+        {
+            gs.readClut(m_palette.data(), entries);
+            const bool clut32 = gs.clutFormat() == GSLocalMemory::PSMCT32;
+            for (uint32_t i = 0; i < entries; ++i)
+            {
+                m_palette[i] = clut32 ? convertPSMCT32Pixel(m_palette[i]) : convertPSMCT16Pixel(static_cast<uint16_t>(m_palette[i]));
+            }
+            m_paletteEntries = entries;
+            m_paletteGeneration = gs.clutGeneration();
+            paletteChanged = true;
+        }
     }
 
-    const uint8_t* vram = memory.getGSVRAM();
-    if (!vram)
+    // A different buffer, shape or palette invalidates everything converted so far
+    const bool full = m_invalid || config != m_lastConfig || paletteChanged;
+    if (full && (displayWidth < m_displayWidth || displayHeight < m_displayHeight))
     {
-        return;
+        std::fill(m_converted.begin(), m_converted.end(), 0xFF000000);
     }
 
-    uint32_t displayWidth = std::min(m_displayWidth, config.width * 64);
-    uint32_t displayHeight = std::min(m_displayHeight, config.height);
-    uint32_t fbpOffset = config.basePointer * 2048; // FBP is in 2048-byte units
-
-    std::cout << "[GS Renderer] Updating framebuffer: FBP=0x" << std::hex << config.basePointer
-              << " FBW=" << std::dec << config.width << " (" << displayWidth << "x" << displayHeight << ")"
-              << std::endl;
-
-    // Copy framebuffer data from VRAM to host memory
-    for (uint32_t y = 0; y < displayHeight; ++y)
+    bool changed = full;
+    if (!convertRow && !convertIndexedRow)
     {
-        for (uint32_t x = 0; x < displayWidth; ++x)
+        // Unsupported format, fill with magenta (error color)
+        if (full)
         {
-            uint32_t offset = fbpOffset + calculateVRAMOffset(x, y, config.width, config.format);
-
-            // Bounds check
-            if (offset + 4 > PS2_GS_VRAM_SIZE)
+            for (uint32_t y = 0; y < displayHeight; ++y)
             {
-                continue;
+                uint32_t* dst = m_converted.data() + static_cast<size_t>(y) * m_displayWidth;
+                std::fill(dst, dst + displayWidth, 0xFF00FFFF);
             }
+        }
+    }
+    else
+    {
+        // FBP is page aligned, so each VRAM page maps onto one rectangle of the display.
+        // Unswizzle and convert only the pages written since they were last converted.
+        GSLocalMemory::PageMask& dirtyPages = memory.vramDirtyPages();
+        const uint32_t pageWidth = GSLocalMemory::pageWidth(psm);
+        const uint32_t pageHeight = GSLocalMemory::pageHeight(psm);
+        const uint32_t pagesPerRow = config.width * 64 / pageWidth;
+        m_readout.resize(static_cast<size_t>(pageWidth) * pageHeight * bitsPerPixel / 8);
 
-            uint32_t pixelIndex = y * m_displayWidth + x;
-            if (pixelIndex >= m_framebufferRGBA.size())
+        GSLocalMemory::PageMask converted;
+        for (uint32_t top = 0; top < displayHeight; top += pageHeight)
+        {
+            const uint32_t rows = std::min(pageHeight, displayHeight - top);
+            for (uint32_t left = 0; left < displayWidth; left += pageWidth)
             {
-                continue;
-            }
+                const uint32_t page = (config.basePointer + (top / pageHeight) * pagesPerRow + left / pageWidth) %
+                                      GSLocalMemory::kPageCount;
+                if (!full && !dirtyPages.test(page))
+                {
+                    continue;
+                }
 
-            // Read pixel from VRAM and convert to RGBA
-            switch (config.format)
-            {
-            case PixelFormat::PSMCT32:
-            {
-                uint32_t psColor = *reinterpret_cast<const uint32_t*>(&vram[offset]);
-                m_framebufferRGBA[pixelIndex] = convertPSMCT32ToRGBA(psColor);
-                break;
-            }
-            case PixelFormat::PSMCT16:
-            case PixelFormat::PSMCT16S:
-            {
-                uint16_t psColor = *reinterpret_cast<const uint16_t*>(&vram[offset]);
-                m_framebufferRGBA[pixelIndex] = convertPSMCT16ToRGBA(psColor);
-                break;
-            }
-            default:
-                // Unsupported format, fill with magenta (error color)
-                m_framebufferRGBA[pixelIndex] = 0xFF00FFFF;
-                break;
+                const uint32_t columns = std::min(pageWidth, displayWidth - left);
+                GSLocalMemory::readImage(vram, psm, blockPointer, config.width, left, top, columns, rows, m_readout.data());
+                for (uint32_t y = 0; y < rows; ++y)
+                {
+                    // Rows of 4-bit pixels stay whole bytes: display widths are multiples of 64
+                    const uint8_t* src = m_readout.data() + static_cast<size_t>(y) * columns * bitsPerPixel / 8;
+                    uint32_t* dst = m_converted.data() + static_cast<size_t>(top + y) * m_displayWidth + left;
+                    if (convertRow)
+                    {
+                        convertRow(src, dst, columns);
+                    }
+                    else
+                    {
+                        convertIndexedRow(src, dst, columns, m_palette.data());
+                    }
+                }
+                converted.set(page);
+                changed = true;
             }
         }
+        dirtyPages &= ~converted;
+    }
+
+    m_lastConfig = config;
+    m_invalid = false;
+    if (!changed)
+    {
+        return false;
+    }
+
+    // The back buffer holds a frame from two publishes ago, so it gets the whole image
+    std::vector<uint32_t>& framebuffer = m_frames[m_back];
+    std::copy(m_converted.begin(), m_converted.end(), framebuffer.begin());
+
+    // Hand the finished frame over and take back whichever buffer was spare
+    uint8_t spare = m_ready.exchange(m_back | kFreshFrame, std::memory_order_acq_rel);
+    m_back = spare & ~kFreshFrame;
+    return true;
+}
+
+bool GSRenderer::acquireFrame()
+{
+    if (!(m_ready.load(std::memory_order_relaxed) & kFreshFrame))
+    {
+        return false;
+    }
+
+    uint8_t ready = m_ready.exchange(m_front, std::memory_order_acq_rel);
+    m_front = ready & ~kFreshFrame;
+    return true;
+}
+
+bool GSRenderer::saveFramePPM(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "[GS Renderer] Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    file << "P6\n" << m_displayWidth << " " << m_displayHeight << "\n255\n";
+
+    std::vector<uint8_t> row(m_displayWidth * 3);
+    for (uint32_t y = 0; y < m_displayHeight; ++y)
+    {
+        for (uint32_t x = 0; x < m_displayWidth; ++x)
+        {
+            uint32_t rgba = getFramebufferRGBA()[y * m_displayWidth + x];
+            row[x * 3 + 0] = static_cast<uint8_t>(rgba >> 24);
+            row[x * 3 + 1] = static_cast<uint8_t>(rgba >> 16);
+            row[x * 3 + 2] = static_cast<uint8_t>(rgba >> 8);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
     }
 
-    m_framebufferDirty = true;
+    return static_cast<bool>(file);
 }
@@ -0,0 +1,731 @@
+#include "gs_state.h"
+#include "ps2_runtime.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+    constexpr uint64_t GS_CSR_SIGNAL = 1ull << 0;
+    constexpr uint64_t GS_CSR_FINISH = 1ull << 1;
+    constexpr uint64_t GS_IMR_SIGMSK = 1ull << 8;
+    constexpr uint64_t GS_IMR_FINISHMSK = 1ull << 9;
+
+    // TRXDIR.XDIR
+    enum TransferDirection : uint32_t
+    {
+        HOST_TO_LOCAL = 0,
+        LOCAL_TO_HOST = 1,
+        LOCAL_TO_LOCAL = 2,
+        DEACTIVATED = 3,
+    };
+
+    inline uint32_t bits(uint64_t value, uint32_t shift, uint32_t width)
+    {
+        return static_cast<uint32_t>((value >> shift) & ((1ull << width) - 1));
+    }
+
+    // Replace the bits of `current` selected by `mask` with those of `value`
+    inline uint32_t masked(uint32_t current, uint32_t value, uint32_t mask)
+    {
+        return (current & ~mask) | (value & mask);
+    }
+}
+
+GSState::GSState()
+{
+    reset();
+}
+
+void GSState::attach(uint8_t* vram, GSLocalMemory::PageMask* dirtyPages, GSRegisters* privileged)
+{
+    m_vram = vram;
+    m_dirtyPages = dirtyPages;
+    m_privileged = privileged;
+    m_rasterizer.attach(vram, dirtyPages);
+}
+
+void GSState::reset()
+{
+    m_rasterizer.flush();
+    m_regs.fill(0);
+    m_regs[PRMODECONT] = 1; // attributes come from PRIM
+    m_packedQ = 0x3F800000;
+    m_transfer = Transfer();
+    m_interruptPending = false;
+    m_vertexCount = 0;
+    m_stateDirty = true;
+    m_clut.fill(0);
+    m_cbp0 = 0;
+    m_cbp1 = 0;
+    m_clutFormat = 0;
+    m_clutOffset = 0;
+    m_clutGeneration++;
+}
+
+void GSState::writeRegister(uint32_t address, uint64_t value)
+{
+    address %= kNumRegisters;
+
+    switch (address)
+    {
+    case HWREG:
+        writeImage(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+        return;
+    case XYZF2:
+    case XYZ2:
+    case XYZF3:
+    case XYZ3:
+        m_regs[address] = value;
+        vertexKick(value, address == XYZF2 || address == XYZF3, address == XYZF2 || address == XYZ2);
+        return;
+    case RGBAQ:
+    case ST:
+    case UV:
+    case FOG:
+        // Vertex attributes, read at the next kick
+        m_regs[address] = value;
+        return;
+    case PRIM:
+        m_vertexCount = 0;
+        m_stateDirty = true;
+        break;
+    case TEX2_1:
+    case TEX2_2:
+    {
+        // TEX2 replaces only the format and CLUT fields of TEX0
+        constexpr uint64_t kTex2Mask = (0x3Full << 20) | (~0ull << 37);
+        uint64_t& tex0 = m_regs[TEX0_1 + (address - TEX2_1)];
+        tex0 = (tex0 & ~kTex2Mask) | (value & kTex2Mask);
+        loadClut(tex0);
+        m_stateDirty = true;
+        break;
+    }
+    case TEX0_1:
+    case TEX0_2:
+        loadClut(value);
+        m_stateDirty = true;
+        break;
+    case TRXDIR:
+        m_rasterizer.flush();
+        break;
+    case SIGNAL:
+        if (m_privileged)
+        {
+            // IDMSK selects which bits of ID land in SIGLBLID.SIGID
+            uint32_t id = static_cast<uint32_t>(m_privileged->siglblid);
+            id = masked(id, static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32));
+            m_privileged->siglblid = (m_privileged->siglblid & ~0xFFFFFFFFull) | id;
+            raiseInterrupt(GS_CSR_SIGNAL, GS_IMR_SIGMSK);
+        }
+        break;
+    case FINISH:
+        // Everything queued is drawn before FINISH is reported
+        m_rasterizer.flush();
+        raiseInterrupt(GS_CSR_FINISH, GS_IMR_FINISHMSK);
+        break;
+    case LABEL:
+        if (m_privileged)
+        {
+            uint32_t id = static_cast<uint32_t>(m_privileged->siglblid >> 32);
+            id = masked(id, static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32));
+            m_privileged->siglblid = (m_privileged->siglblid & 0xFFFFFFFFull) | (static_cast<uint64_t>(id) << 32);
+        }
+        break;
+    default:
+        m_stateDirty = true;
+        break;
+    }
+
+    m_regs[address] = value;
+
+    if (address == TRXDIR)
+    {
+        startTransfer();
+    }
+}
+
+void GSState::writePacked(uint32_t descriptor, const uint8_t* qword)
+{
+    uint64_t lo;
+    uint64_t hi;
+    std::memcpy(&lo, qword, sizeof(lo));
+    std::memcpy(&hi, qword + 8, sizeof(hi));
+
+    switch (descriptor & 0xF)
+    {
+    case 0x0: // PRIM
+        writeRegister(PRIM, lo & 0x7FF);
+        break;
+    case 0x1: // RGBAQ, one component per word; Q comes from the last ST
+        writeRegister(RGBAQ, bits(lo, 0, 8) | (bits(lo, 32, 8) << 8) | (bits(hi, 0, 8) << 16) |
+                                 (static_cast<uint64_t>(bits(hi, 32, 8)) << 24) |
+                                 (static_cast<uint64_t>(m_packedQ) << 32));
+        break;
+    case 0x2: // ST, with Q kept for the next RGBAQ
+        writeRegister(ST, lo);
+        m_packedQ = static_cast<uint32_t>(hi);
+        break;
+    case 0x3: // UV
+        writeRegister(UV, bits(lo, 0, 14) | (bits(lo, 32, 14) << 16));
+        break;
+    case 0x4: // XYZF2, or XYZF3 when ADC is set
+    {
+        uint64_t value = bits(lo, 0, 16) | (bits(lo, 32, 16) << 16) |
+                         (static_cast<uint64_t>(bits(hi, 4, 24)) << 32) |
+                         (static_cast<uint64_t>(bits(hi, 36, 8)) << 56);
+        writeRegister(bits(hi, 47, 1) ? XYZF3 : XYZF2, value);
+        break;
+    }
+    case 0x5: // XYZ2, or XYZ3 when ADC is set
+    {
+        uint64_t value = bits(lo, 0, 16) | (bits(lo, 32, 16) << 16) |
+                         (static_cast<uint64_t>(static_cast<uint32_t>(hi)) << 32);
+        writeRegister(bits(hi, 47, 1) ? XYZ3 : XYZ2, value);
+        break;
+    }
+    case 0xA: // FOG
+        writeRegister(FOG, static_cast<uint64_t>(bits(hi, 36, 8)) << 56);
+        break;
+    case 0xE: // A+D
+        writeRegister(static_cast<uint32_t>(hi & 0xFF), lo);
+        break;
+    case 0xF: // NOP
+        break;
+    default: // TEX0, CLAMP, XYZF3 and XYZ3 take the low doubleword as is
+        writeRegister(descriptor & 0xF, lo);
+        break;
+    }
+}
+
+void GSState::vertexKick(uint64_t xyz, bool hasFog, bool draw)
+{
+    // PRMODECONT.AC picks whether PRIM or PRMODE holds the attributes
+    const uint64_t attributes = bits(m_regs[PRMODECONT], 0, 1) ? m_regs[PRIM] : m_regs[PRMODE];
+    const uint64_t offset = m_regs[XYOFFSET_1 + bits(attributes, 9, 1)];
+    const uint64_t rgbaq = m_regs[RGBAQ];
+    const uint64_t st = m_regs[ST];
+    const uint64_t uv = m_regs[UV];
+
+    GSRasterizer::Vertex& v = m_vertices[m_vertexCount];
+    v.x = static_cast<int32_t>(bits(xyz, 0, 16)) - static_cast<int32_t>(bits(offset, 0, 16));
+    v.y = static_cast<int32_t>(bits(xyz, 16, 16)) - static_cast<int32_t>(bits(offset, 32, 16));
+    v.z = hasFog ? bits(xyz, 32, 24) : bits(xyz, 32, 32);
+    v.fog = static_cast<uint8_t>(hasFog ? bits(xyz, 56, 8) : bits(m_regs[FOG], 56, 8));
+    v.r = static_cast<uint8_t>(bits(rgbaq, 0, 8));
+    v.g = static_cast<uint8_t>(bits(rgbaq, 8, 8));
+    v.b = static_cast<uint8_t>(bits(rgbaq, 16, 8));
+    v.a = static_cast<uint8_t>(bits(rgbaq, 24, 8));
+    const uint32_t q = bits(rgbaq, 32, 32);
+    const uint32_t s = bits(st, 0, 32);
+    const uint32_t t = bits(st, 32, 32);
+    std::memcpy(&v.q, &q, sizeof(v.q));
+    std::memcpy(&v.s, &s, sizeof(v.s));
+    std::memcpy(&v.t, &t, sizeof(v.t));
+    v.u = bits(uv, 0, 14);
+    v.v = bits(uv, 16, 14);
+
+    // Vertices per primitive for each PRIM.PRIM type
+    static constexpr uint32_t kVertexCounts[8] = {1, 2, 2, 3, 3, 3, 2, 0};
+    const uint32_t type = bits(m_regs[PRIM], 0, 3);
+    if (kVertexCounts[type] == 0)
+    {
+        return;
+    }
+    if (++m_vertexCount < kVertexCounts[type])
+    {
+        return;
+    }
+
+    if (draw)
+    {
+        drawPrimitive(type);
+    }
+
+    // Keep the vertices the next primitive of a strip or fan shares
+    switch (type)
+    {
+    case 2: // line strip
+        m_vertices[0] = m_vertices[1];
+        m_vertexCount = 1;
+        break;
+    case 4: // triangle strip
+        m_vertices[0] = m_vertices[1];
+        m_vertices[1] = m_vertices[2];
+        m_vertexCount = 2;
+        break;
+    case 5: // triangle fan
+        m_vertices[1] = m_vertices[2];
+        m_vertexCount = 2;
+        break;
+    default:
+        m_vertexCount = 0;
+        break;
+    }
+}
+
+void GSState::drawPrimitive(uint32_t type)
+{
+    if (m_stateDirty)
+    {
+        const uint64_t attributes = bits(m_regs[PRMODECONT], 0, 1) ? m_regs[PRIM] : m_regs[PRMODE];
+        const GSDrawState state = drawState(attributes);
+        const bool indexed = state.tme && GSLocalMemory::transferBits(state.tpsm) <= 8;
+        if (indexed)
+        {
+            expandPalette(m_regs[TEX0_1 + bits(attributes, 9, 1)]);
+        }
+        m_rasterizer.setState(state, indexed ? m_palette.data() : nullptr);
+        m_stateDirty = false;
+    }
+
+    switch (type)
+    {
+    case 0:
+        m_rasterizer.addPrimitive(GSRasterizer::PrimitiveType::Point, m_vertices.data());
+        break;
+    case 1:
+    case 2:
+        m_rasterizer.addPrimitive(GSRasterizer::PrimitiveType::Line, m_vertices.data());
+        break;
+    case 6:
+        m_rasterizer.addPrimitive(GSRasterizer::PrimitiveType::Sprite, m_vertices.data());
+        break;
+    default:
+        m_rasterizer.addPrimitive(GSRasterizer::PrimitiveType::Triangle, m_vertices.data());
+        break;
+    }
+}
+
+GSDrawState GSState::drawState(uint64_t attributes) const
+{
+    const uint32_t context = bits(attributes, 9, 1);
+    const uint64_t frame = m_regs[FRAME_1 + context];
+    const uint64_t zbuf = m_regs[ZBUF_1 + context];
+    const uint64_t scissor = m_regs[SCISSOR_1 + context];
+    const uint64_t test = m_regs[TEST_1 + context];
+    const uint64_t alpha = m_regs[ALPHA_1 + context];
+    const uint64_t tex0 = m_regs[TEX0_1 + context];
+    const uint64_t tex1 = m_regs[TEX1_1 + context];
+    const uint64_t clamp = m_regs[CLAMP_1 + context];
+    const uint64_t texa = m_regs[TEXA];
+
+    GSDrawState d;
+    d.fbp = bits(frame, 0, 9) * GSLocalMemory::kBlocksPerPage;
+    d.fbw = bits(frame, 16, 6);
+    d.fpsm = bits(frame, 24, 6);
+    d.fbmsk = bits(frame, 32, 32);
+    d.zbp = bits(zbuf, 0, 9) * GSLocalMemory::kBlocksPerPage;
+    d.zpsm = bits(zbuf, 24, 4) | 0x30;
+    d.zmsk = bits(zbuf, 32, 1);
+
+    d.scissorX0 = static_cast<int32_t>(bits(scissor, 0, 11));
+    d.scissorX1 = static_cast<int32_t>(bits(scissor, 16, 11));
+    d.scissorY0 = static_cast<int32_t>(bits(scissor, 32, 11));
+    d.scissorY1 = static_cast<int32_t>(bits(scissor, 48, 11));
+
+    d.iip = bits(attributes, 3, 1);
+    d.tme = bits(attributes, 4, 1);
+    d.fge = bits(attributes, 5, 1);
+    d.abe = bits(attributes, 6, 1);
+    d.fst = bits(attributes, 8, 1);
+
+    d.ate = bits(test, 0, 1);
+    d.atst = bits(test, 1, 3);
+    d.aref = bits(test, 4, 8);
+    d.afail = bits(test, 12, 2);
+    d.date = bits(test, 14, 1);
+    d.datm = bits(test, 15, 1);
+    d.zte = bits(test, 16, 1);
+    d.ztst = bits(test, 17, 2);
+
+    d.alphaA = bits(alpha, 0, 2);
+    d.alphaB = bits(alpha, 2, 2);
+    d.alphaC = bits(alpha, 4, 2);
+    d.alphaD = bits(alpha, 6, 2);
+    d.alphaFix = bits(alpha, 32, 8);
+    d.pabe = bits(m_regs[PABE], 0, 1);
+    d.fba = bits(m_regs[FBA_1 + context], 0, 1);
+    d.colclamp = bits(m_regs[COLCLAMP], 0, 1);
+    d.fogcol = bits(m_regs[FOGCOL], 0, 24);
+
+    d.tbp = bits(tex0, 0, 14);
+    d.tbw = bits(tex0, 14, 6);
+    d.tpsm = bits(tex0, 20, 6);
+    d.tw = bits(tex0, 26, 4);
+    d.th = bits(tex0, 30, 4);
+    d.tcc = bits(tex0, 34, 1);
+    d.tfx = bits(tex0, 35, 2);
+    d.bilinear = bits(tex1, 5, 1); // MMAG; there is no LOD, so magnification applies throughout
+    d.wms = bits(clamp, 0, 2);
+    d.wmt = bits(clamp, 2, 2);
+    d.minu = bits(clamp, 4, 10);
+    d.maxu = bits(clamp, 14, 10);
+    d.minv = bits(clamp, 24, 10);
+    d.maxv = bits(clamp, 34, 10);
+    d.ta0 = bits(texa, 0, 8);
+    d.aem = bits(texa, 15, 1);
+    d.ta1 = bits(texa, 32, 8);
+
+    if (d.tme && !GSLocalMemory::isSupported(d.tpsm))
+    {
+        d.tme = false;
+    }
+    return d;
+}
+
+void GSState::loadClut(uint64_t tex0)
+{
+    const uint32_t psm = bits(tex0, 20, 6);
+    const uint32_t cbp = bits(tex0, 37, 14);
+    const uint32_t cld = bits(tex0, 61, 3);
+    if (!m_vram || !GSLocalMemory::isSupported(psm) || GSLocalMemory::transferBits(psm) > 8)
+    {
+        return;
+    }
+
+    // CLD: 1-3 always load (2 and 3 also latch CBP0/CBP1), 4 and 5 only when CBP differs from the latch
+    bool load = false;
+    switch (cld)
+    {
+    case 1:
+        load = true;
+        break;
+    case 2:
+        load = true;
+        m_cbp0 = cbp;
+        break;
+    case 3:
+        load = true;
+        m_cbp1 = cbp;
+        break;
+    case 4:
+        load = cbp != m_cbp0;
+        m_cbp0 = cbp;
+        break;
+    case 5:
+        load = cbp != m_cbp1;
+        m_cbp1 = cbp;
+        break;
+    default:
+        break;
+    }
+    if (!load)
+    {
+        return;
+    }
+
+    const uint32_t cpsm = bits(tex0, 51, 4); // PSMCT32, PSMCT16 or PSMCT16S
+    const bool csm2 = bits(tex0, 55, 1);
+    const bool eightBit = GSLocalMemory::transferBits(psm) == 8;
+    const uint32_t entries = eightBit ? 256 : 16;
+    const uint32_t base = eightBit ? 0 : bits(tex0, 56, 5) * 16;
+    const uint64_t texclut = m_regs[TEXCLUT];
+    const uint32_t cbw = csm2 ? bits(texclut, 0, 6) : 1;
+    const uint32_t cou = bits(texclut, 6, 6) * 16;
+    const uint32_t cov = bits(texclut, 12, 10);
+
+    // The palette may have just been drawn
+    GSLocalMemory::PageMask pages;
+    if (csm2)
+    {
+        GSLocalMemory::markPages(pages, cpsm, cbp, cbw, cou, cov, entries, 1);
+    }
+    else
+    {
+        GSLocalMemory::markPages(pages, cpsm, cbp, cbw, 0, 0, eightBit ? 16 : 8, eightBit ? 16 : 2);
+    }
+    if (m_rasterizer.pendingWrites(pages))
+    {
+        m_rasterizer.flush();
+    }
+
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        uint32_t x;
+        uint32_t y;
+        if (csm2)
+        {
+            x = cou + i;
+            y = cov;
+        }
+        else if (eightBit)
+        {
+            // CSM1 stores 8-bit palettes as 16x16 with entries 8-15 and 16-23 of every 32 swapped
+            const uint32_t position = (i & 0xE7) | ((i & 0x08) << 1) | ((i & 0x10) >> 1);
+            x = position % 16;
+            y = position / 16;
+        }
+        else
+        {
+            x = i % 8;
+            y = i / 8;
+        }
+
+        const uint32_t color = GSLocalMemory::readPixel(m_vram, cpsm, cbp, cbw, x, y);
+        if (cpsm == GSLocalMemory::PSMCT32)
+        {
+            const uint32_t slot = (base + i) & 0xFF;
+            m_clut[slot] = static_cast<uint16_t>(color);
+            m_clut[slot + 256] = static_cast<uint16_t>(color >> 16);
+        }
+        else
+        {
+            m_clut[(base + i) & 0x1FF] = static_cast<uint16_t>(color);
+        }
+    }
+
+    m_clutFormat = cpsm;
+    m_clutOffset = base;
+    m_clutGeneration++;
+}
+
+void GSState::readClut(uint32_t* entries, uint32_t count) const
+{
+    const uint32_t base = count > 16 ? 0 : m_clutOffset;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (m_clutFormat == GSLocalMemory::PSMCT32)
+        {
+            const uint32_t slot = (base + i) & 0xFF;
+            entries[i] = m_clut[slot] | (static_cast<uint32_t>(m_clut[slot + 256]) << 16);
+        }
+        else
+        {
+            entries[i] = m_clut[(base + i) & 0x1FF];
+        }
+    }
+}
+
+void GSState::expandPalette(uint64_t tex0)
+{
+    const uint32_t psm = bits(tex0, 20, 6);
+    const uint32_t cpsm = bits(tex0, 51, 4);
+    const bool eightBit = GSLocalMemory::transferBits(psm) == 8;
+    const uint32_t entries = eightBit ? 256 : 16;
+    const uint32_t base = eightBit ? 0 : bits(tex0, 56, 5) * 16;
+    const uint64_t texa = m_regs[TEXA];
+    const uint32_t ta0 = bits(texa, 0, 8);
+    const uint32_t ta1 = bits(texa, 32, 8);
+    const bool aem = bits(texa, 15, 1);
+
+    m_palette.fill(0);
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        if (cpsm == GSLocalMemory::PSMCT32)
+        {
+            const uint32_t slot = (base + i) & 0xFF;
+            m_palette[i] = m_clut[slot] | (static_cast<uint32_t>(m_clut[slot + 256]) << 16);
+        }
+        else
+        {
+            // 16-bit entries expand through TEXA like 16-bit texels
+            const uint32_t c = m_clut[(base + i) & 0x1FF];
+            const uint32_t alpha = (c & 0x8000) ? ta1 : ((aem && (c & 0x7FFF) == 0) ? 0 : ta0);
+            m_palette[i] = ((c & 0x001F) << 3) | ((c & 0x03E0) << 6) | ((c & 0x7C00) << 9) | (alpha << 24);
+        }
+    }
+}
+
+void GSState::startTransfer()
+{
+    const uint64_t bitbltbuf = m_regs[BITBLTBUF];
+    const uint64_t trxpos = m_regs[TRXPOS];
+    const uint64_t trxreg = m_regs[TRXREG];
+
+    m_transfer = Transfer();
+    switch (bits(m_regs[TRXDIR], 0, 2))
+    {
+    case HOST_TO_LOCAL:
+        m_transfer.psm = bits(bitbltbuf, 56, 6);
+        m_transfer.bp = bits(bitbltbuf, 32, 14);
+        m_transfer.bw = bits(bitbltbuf, 48, 6);
+        m_transfer.x = bits(trxpos, 32, 11);
+        m_transfer.y = bits(trxpos, 48, 11);
+        m_transfer.width = bits(trxreg, 0, 12);
+        m_transfer.height = bits(trxreg, 32, 12);
+        if (!GSLocalMemory::isSupported(m_transfer.psm))
+        {
+            std::cerr << "[GS] Unsupported transmission format 0x" << std::hex << m_transfer.psm << std::dec << std::endl;
+            break;
+        }
+        m_transfer.bits = GSLocalMemory::transferBits(m_transfer.psm);
+        m_transfer.active = m_transfer.width != 0 && m_transfer.height != 0;
+        break;
+    case LOCAL_TO_LOCAL:
+        copyLocalToLocal();
+        break;
+    case LOCAL_TO_HOST:
+        std::cerr << "[GS] Local to host transmissions are not supported" << std::endl;
+        break;
+    default:
+        break;
+    }
+}
+
+void GSState::writeImage(const uint8_t* data, size_t bytes)
+{
+    if (!m_transfer.active || !m_vram)
+    {
+        return;
+    }
+
+    Transfer& t = m_transfer;
+    const uint64_t rowBits = static_cast<uint64_t>(t.width) * t.bits;
+    if (rowBits % 8)
+    {
+        // Odd 4-bit widths: rows don't start on a byte, so go a pixel at a time
+        writeTransferPixels(data, bytes);
+        return;
+    }
+
+    const size_t rowBytes = rowBits / 8;
+
+    // Complete the row left over from the last call
+    if (!t.partialRow.empty())
+    {
+        size_t take = std::min(rowBytes - t.partialRow.size(), bytes);
+        t.partialRow.insert(t.partialRow.end(), data, data + take);
+        data += take;
+        bytes -= take;
+        if (t.partialRow.size() < rowBytes)
+        {
+            return;
+        }
+        writeTransferRows(t.partialRow.data(), 1);
+        t.partialRow.clear();
+    }
+
+    // Then every whole row in one go
+    uint32_t rowsLeft = t.height - static_cast<uint32_t>(t.pixelsDone / t.width);
+    uint32_t rows = static_cast<uint32_t>(std::min<size_t>(bytes / rowBytes, rowsLeft));
+    if (rows)
+    {
+        writeTransferRows(data, rows);
+        data += rows * rowBytes;
+        bytes -= rows * rowBytes;
+    }
+
+    if (t.pixelsDone >= static_cast<uint64_t>(t.width) * t.height)
+    {
+        // Anything past the end of the rectangle is dropped, as the GS does
+        t.active = false;
+        return;
+    }
+    t.partialRow.assign(data, data + bytes);
+}
+
+void GSState::writeTransferRows(const uint8_t* src, uint32_t rows)
+{
+    Transfer& t = m_transfer;
+    const uint32_t row = static_cast<uint32_t>(t.pixelsDone / t.width);
+    GSLocalMemory::writeImage(m_vram, t.psm, t.bp, t.bw, t.x, t.y + row, t.width, rows, src);
+    if (m_dirtyPages)
+    {
+        GSLocalMemory::markPages(*m_dirtyPages, t.psm, t.bp, t.bw, t.x, t.y + row, t.width, rows);
+    }
+    t.pixelsDone += static_cast<uint64_t>(t.width) * rows;
+}
+
+void GSState::writeTransferPixels(const uint8_t* src, size_t bytes)
+{
+    Transfer& t = m_transfer;
+    const uint64_t total = static_cast<uint64_t>(t.width) * t.height;
+    const uint32_t firstRow = static_cast<uint32_t>(t.pixelsDone / t.width);
+    for (size_t i = 0; i < bytes * 2 && t.pixelsDone < total; i++, t.pixelsDone++)
+    {
+        uint32_t value = (src[i / 2] >> ((i & 1) * 4)) & 0xF;
+        uint32_t x = t.x + static_cast<uint32_t>(t.pixelsDone % t.width);
+        uint32_t y = t.y + static_cast<uint32_t>(t.pixelsDone / t.width);
+        GSLocalMemory::writePixel(m_vram, t.psm, t.bp, t.bw, x, y, value);
+    }
+
+    if (m_dirtyPages)
+    {
+        const uint32_t lastRow = static_cast<uint32_t>((t.pixelsDone - 1) / t.width);
+        GSLocalMemory::markPages(*m_dirtyPages, t.psm, t.bp, t.bw, t.x, t.y + firstRow, t.width,
+                                 lastRow - firstRow + 1);
+    }
+    t.active = t.pixelsDone < total;
+}
+
+void GSState::copyLocalToLocal()
+{
+    if (!m_vram)
+    {
+        return;
+    }
+
+    const uint64_t bitbltbuf = m_regs[BITBLTBUF];
+    const uint64_t trxpos = m_regs[TRXPOS];
+    const uint64_t trxreg = m_regs[TRXREG];
+    const uint32_t sbp = bits(bitbltbuf, 0, 14);
+    const uint32_t sbw = bits(bitbltbuf, 16, 6);
+    const uint32_t spsm = bits(bitbltbuf, 24, 6);
+    const uint32_t dbp = bits(bitbltbuf, 32, 14);
+    const uint32_t dbw = bits(bitbltbuf, 48, 6);
+    const uint32_t dpsm = bits(bitbltbuf, 56, 6);
+    const uint32_t sx = bits(trxpos, 0, 11);
+    const uint32_t sy = bits(trxpos, 16, 11);
+    const uint32_t dx = bits(trxpos, 32, 11);
+    const uint32_t dy = bits(trxpos, 48, 11);
+    const uint32_t width = bits(trxreg, 0, 12);
+    const uint32_t height = bits(trxreg, 32, 12);
+
+    if (!GSLocalMemory::isSupported(spsm) || !GSLocalMemory::isSupported(dpsm) || !width || !height)
+    {
+        return;
+    }
+
+    // The whole source is read before anything is written, so overlapping copies
+    // come out as if TRXPOS.DIR had picked the right order
+    if (GSLocalMemory::transferBits(spsm) == GSLocalMemory::transferBits(dpsm))
+    {
+        std::vector<uint8_t> pixels((static_cast<size_t>(width) * height * GSLocalMemory::transferBits(spsm) + 7) / 8);
+        GSLocalMemory::readImage(m_vram, spsm, sbp, sbw, sx, sy, width, height, pixels.data());
+        GSLocalMemory::writeImage(m_vram, dpsm, dbp, dbw, dx, dy, width, height, pixels.data());
+    }
+    else
+    {
+        std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                pixels[static_cast<size_t>(y) * width + x] = GSLocalMemory::readPixel(m_vram, spsm, sbp, sbw, sx + x, sy + y);
+            }
+        }
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                GSLocalMemory::writePixel(m_vram, dpsm, dbp, dbw, dx + x, dy + y, pixels[static_cast<size_t>(y) * width + x]);
+            }
+        }
+    }
+
+    if (m_dirtyPages)
+    {
+        GSLocalMemory::markPages(*m_dirtyPages, dpsm, dbp, dbw, dx, dy, width, height);
+    }
+}
+
+void GSState::raiseInterrupt(uint64_t csrBit, uint64_t imrBit)
+{
+    if (!m_privileged)
+    {
+        return;
+    }
+
+    m_privileged->csr |= csrBit;
+    if (!(m_privileged->imr & imrBit))
+    {
+        m_interruptPending = true;
+    }
+}
+
+bool GSState::takeInterrupt()
+{
+    return std::exchange(m_interruptPending, false);
+}
@@ -0,0 +1,188 @@
+#include "ps2_alarms.h"
+#include <algorithm>
+
+static_assert(PS2AlarmService::kMaxAlarms == 64, "alarm ids pack the pool index into the low 6 bits");
+
+PS2AlarmService::PS2AlarmService()
+{
+    reset(0);
+}
+
+void PS2AlarmService::reset(uint64_t now)
+{
+    for (Node &node : m_nodes)
+    {
+        node = Node{};
+    }
+    m_level0.fill(kNil);
+    m_level1.fill(kNil);
+    m_level2.fill(kNil);
+    m_now = now;
+    m_active = 0;
+}
+
+int PS2AlarmService::add(uint64_t now, uint16_t ticks, uint32_t handler, uint32_t arg, uint32_t gp)
+{
+    auto it = std::find_if(m_nodes.begin(), m_nodes.end(), [](const Node &node)
+                           { return !node.active; });
+    if (it == m_nodes.end())
+    {
+        return -1;
+    }
+
+    int index = static_cast<int>(it - m_nodes.begin());
+    Node &node = *it;
+    // The wheel only moves at safe points, so count from the caller's time when it is ahead.
+    // A zero-length alarm still fires on the next tick, never inside SetAlarm itself.
+    node.expire = std::max(now, m_now) + std::max<uint16_t>(ticks, 1);
+    node.handler = handler;
+    node.arg = arg;
+    node.gp = gp;
+    node.ticks = ticks;
+    node.active = true;
+    insert(index);
+    m_active++;
+    return makeId(index);
+}
+
+bool PS2AlarmService::cancel(int id)
+{
+    if (id < 0)
+    {
+        return false;
+    }
+
+    int index = id & (kMaxAlarms - 1);
+    Node &node = m_nodes[index];
+    if (!node.active || makeId(index) != id)
+    {
+        return false;
+    }
+
+    unlink(index);
+    node.active = false;
+    node.generation++;
+    m_active--;
+    return true;
+}
+
+void PS2AlarmService::advance(uint64_t now, std::vector<Expired> &expired)
+{
+    while (m_now < now)
+    {
+        if (m_active == 0)
+        {
+            m_now = now;
+            return;
+        }
+
+        uint64_t tick = ++m_now;
+        if ((tick & ((1ull << (kLevel0Bits + kLevelBits)) - 1)) == 0)
+        {
+            cascade(m_level2[(tick >> (kLevel0Bits + kLevelBits)) & (kLevelSlots - 1)]);
+        }
+        if ((tick & (kLevel0Slots - 1)) == 0)
+        {
+            cascade(m_level1[(tick >> kLevel0Bits) & (kLevelSlots - 1)]);
+        }
+
+        int &head = m_level0[tick & (kLevel0Slots - 1)];
+        while (head != kNil)
+        {
+            int index = head;
+            Node &node = m_nodes[index];
+            expired.push_back({makeId(index), node.handler, node.arg, node.gp, node.ticks});
+            unlink(index);
+            node.active = false;
+            node.generation++;
+            m_active--;
+        }
+    }
+}
+
+std::optional<uint64_t> PS2AlarmService::nextExpiry() const
+{
+    std::optional<uint64_t> earliest;
+    for (const Node &node : m_nodes)
+    {
+        if (node.active && (!earliest || node.expire < *earliest))
+        {
+            earliest = node.expire;
+        }
+    }
+    return earliest;
+}
+
+void PS2AlarmService::insert(int index)
+{
+    Node &node = m_nodes[index];
+    const uint64_t expire = node.expire;
+    const int level1Shift = kLevel0Bits;
+    const int level2Shift = kLevel0Bits + kLevelBits;
+
+    // Each level only takes expiries its slots reach before wrapping around
+    int *head;
+    if (expire - m_now < kLevel0Slots)
+    {
+        head = &m_level0[expire & (kLevel0Slots - 1)];
+    }
+    else if ((expire >> level1Shift) - (m_now >> level1Shift) < kLevelSlots)
+    {
+        head = &m_level1[(expire >> level1Shift) & (kLevelSlots - 1)];
+    }
+    else if ((expire >> level2Shift) - (m_now >> level2Shift) < kLevelSlots)
+    {
+        head = &m_level2[(expire >> level2Shift) & (kLevelSlots - 1)];
+    }
+    else
+    {
+        // Past the end of the wheel: park in the last slot and re-file on cascade
+        head = &m_level2[((m_now >> level2Shift) + kLevelSlots - 1) & (kLevelSlots - 1)];
+    }
+
+    node.head = head;
+    node.prev = kNil;
+    node.next = *head;
+    if (*head != kNil)
+    {
+        m_nodes[*head].prev = index;
+    }
+    *head = index;
+}
+
+void PS2AlarmService::unlink(int index)
+{
+    Node &node = m_nodes[index];
+    if (node.prev != kNil)
+    {
+        m_nodes[node.prev].next = node.next;
+    }
+    else if (node.head)
+    {
+        *node.head = node.next;
+    }
+    if (node.next != kNil)
+    {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.prev = kNil;
+    node.next = kNil;
+    node.head = nullptr;
+}
+
+void PS2AlarmService::cascade(int &head)
+{
+    int index = head;
+    head = kNil;
+    while (index != kNil)
+    {
+        int next = m_nodes[index].next;
+        insert(index);
+        index = next;
+    }
+}
+
+int PS2AlarmService::makeId(int index) const
+{
+    return ((m_nodes[index].generation & 0x7FFF) << 6) | index;
+}
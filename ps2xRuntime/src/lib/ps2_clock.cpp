@@ -0,0 +1,118 @@
+#include "ps2_clock.h"
+
+PS2Clock::PS2Clock()
+{
+    reset();
+}
+
+void PS2Clock::reset()
+{
+    m_start = HostClock::now();
+    m_skipped = HostClock::duration::zero();
+    m_segmentStart = HostClock::duration::zero();
+    m_segmentHsync = 0;
+    m_segmentEdge = 0;
+}
+
+void PS2Clock::setVideoMode(VideoMode mode)
+{
+    if (mode == m_mode)
+    {
+        return;
+    }
+
+    uint64_t hsync = hsyncCount();
+    uint64_t edge = vblankEdges();
+    m_segmentStart = elapsed();
+    m_segmentHsync = hsync;
+    // Close a blank period in progress so the new standard starts on a fresh field
+    m_segmentEdge = (edge + 1) & ~1ull;
+    m_mode = mode;
+}
+
+uint64_t PS2Clock::hsyncCount() const
+{
+    return m_segmentHsync + static_cast<uint64_t>(segmentSeconds() * hsyncHz());
+}
+
+PS2Clock::HostClock::time_point PS2Clock::timeOfHsync(uint64_t hsync) const
+{
+    if (hsync <= m_segmentHsync)
+    {
+        return timeOfSegmentOffset(0.0);
+    }
+    return timeOfSegmentOffset(static_cast<double>(hsync - m_segmentHsync) / hsyncHz());
+}
+
+uint64_t PS2Clock::vblankEdges() const
+{
+    const double fieldHalfLines = halfLinesPerField();
+    const double halfLines = segmentSeconds() * hsyncHz() * 2.0;
+    const uint64_t field = static_cast<uint64_t>(halfLines / fieldHalfLines);
+    const double withinField = halfLines - static_cast<double>(field) * fieldHalfLines;
+    const bool inBlank = withinField >= fieldHalfLines - 2.0 * blankLines();
+    return m_segmentEdge + field * 2 + (inBlank ? 1 : 0);
+}
+
+PS2Clock::HostClock::time_point PS2Clock::timeOfVblankEdge(uint64_t edge) const
+{
+    if (edge < m_segmentEdge)
+    {
+        return timeOfSegmentOffset(0.0);
+    }
+
+    const uint64_t local = edge - m_segmentEdge;
+    const double field = static_cast<double>(local / 2);
+    const double fieldHalfLines = halfLinesPerField();
+    // VBLANK_START sits blankLines() before the end of its field, VBLANK_END on the boundary
+    double halfLines = (field + 1.0) * fieldHalfLines;
+    if (local % 2 == 0)
+    {
+        halfLines -= 2.0 * blankLines();
+    }
+    return timeOfSegmentOffset(halfLines / (2.0 * hsyncHz()));
+}
+
+uint64_t PS2Clock::cycles(uint64_t hz) const
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed()).count();
+    // Whole seconds and the remainder separately, so the product stays exact and in range
+    uint64_t seconds = static_cast<uint64_t>(ns) / 1000000000ull;
+    uint64_t nanos = static_cast<uint64_t>(ns) % 1000000000ull;
+    return seconds * hz + nanos * hz / 1000000000ull;
+}
+
+PS2Clock::HostClock::time_point PS2Clock::timeOfCycles(uint64_t hz, uint64_t cycle) const
+{
+    // Rounded up, so cycles() has reached `cycle` by the returned time
+    uint64_t seconds = cycle / hz;
+    uint64_t nanos = ((cycle % hz) * 1000000000ull + hz - 1) / hz;
+    return m_start - m_skipped + std::chrono::seconds(seconds) + std::chrono::nanoseconds(nanos);
+}
+
+void PS2Clock::skipTo(HostClock::time_point when)
+{
+    HostClock::time_point now = HostClock::now();
+    if (when > now)
+    {
+        m_skipped += when - now;
+    }
+}
+
+PS2Clock::HostClock::duration PS2Clock::elapsed() const
+{
+    return HostClock::now() + m_skipped - m_start;
+}
+
+double PS2Clock::segmentSeconds() const
+{
+    return std::chrono::duration<double>(elapsed() - m_segmentStart).count();
+}
+
+PS2Clock::HostClock::time_point PS2Clock::timeOfSegmentOffset(double seconds) const
+{
+    std::chrono::duration<double> offset(seconds);
+    // Pad past float rounding so the counts above have reached the event by the returned time
+    return m_start - m_skipped + m_segmentStart + std::chrono::ceil<HostClock::duration>(offset) +
+           std::chrono::microseconds(1);
+}
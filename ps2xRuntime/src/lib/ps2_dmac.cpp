@@ -0,0 +1,875 @@
+#include "ps2_dmac.h"
+#include "ps2_interrupts.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    constexpr uint32_t kChannelBases[PS2Dmac::kNumChannels] = {
+        0x10008000, // VIF0
+        0x10009000, // VIF1
+        0x1000A000, // GIF
+        0x1000B000, // fromIPU
+        0x1000B400, // toIPU
+        0x1000C000, // SIF0
+        0x1000C400, // SIF1
+        0x1000C800, // SIF2
+        0x1000D000, // fromSPR
+        0x1000D400, // toSPR
+    };
+
+    const char *const kChannelNames[PS2Dmac::kNumChannels] = {
+        "VIF0", "VIF1", "GIF", "fromIPU", "toIPU", "SIF0", "SIF1", "SIF2", "fromSPR", "toSPR",
+    };
+
+    constexpr uint32_t kScratchpadSize = 0x4000;
+    constexpr uint32_t kQword = 16;
+
+    // Source chain tag IDs; destination chains use CNTS (0), CNT (1) and END (7)
+    enum TagId : uint32_t
+    {
+        TAG_REFE = 0,
+        TAG_CNT = 1,
+        TAG_NEXT = 2,
+        TAG_REF = 3,
+        TAG_REFS = 4,
+        TAG_CALL = 5,
+        TAG_RET = 6,
+        TAG_END = 7,
+    };
+
+    constexpr uint32_t kCtrlDmae = 0x1;
+    constexpr uint32_t kModeChain = 1;
+    constexpr uint32_t kModeInterleave = 2;
+
+    bool fromPeripheral(int channel, uint32_t chcr)
+    {
+        switch (channel)
+        {
+        case PS2Dmac::IPU_FROM:
+        case PS2Dmac::SIF0:
+        case PS2Dmac::SPR_FROM:
+            return true;
+        case PS2Dmac::VIF1:
+        case PS2Dmac::SIF2:
+            return (chcr & PS2Dmac::CHCR_DIR) == 0;
+        default:
+            return false;
+        }
+    }
+}
+
+PS2Dmac::PS2Dmac(PS2InterruptController &interrupts)
+    : m_interrupts(interrupts)
+{
+}
+
+PS2Dmac::~PS2Dmac()
+{
+    stopWorker();
+}
+
+void PS2Dmac::attach(uint8_t *rdram, uint32_t ramSize, uint8_t *scratchpad)
+{
+    waitIdle();
+    m_rdram = rdram;
+    m_ramSize = ramSize;
+    m_scratchpad = scratchpad;
+}
+
+void PS2Dmac::setSink(int channel, Sink sink)
+{
+    waitIdle();
+    if (channel >= 0 && channel < kNumChannels)
+    {
+        m_sinks[channel] = std::move(sink);
+    }
+}
+
+void PS2Dmac::setThreaded(bool threaded)
+{
+    waitIdle();
+    if (!threaded)
+    {
+        stopWorker();
+    }
+    m_threaded = threaded;
+}
+
+void PS2Dmac::reset()
+{
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_parked.clear();
+        m_finished.clear();
+        m_finishedPending.store(false, std::memory_order_relaxed);
+    }
+    m_channels.fill(Registers{});
+    m_ctrl = kCtrlDmae; // the BIOS enables the DMAC before anything runs
+    m_pcr = 0;
+    m_sqwc = 0;
+    m_rbsr = 0;
+    m_rbor = 0;
+    m_stadr = 0;
+    m_enable = 0;
+    m_busy = 0;
+    m_ringWrite = 0;
+    m_ringWriteKnown = false;
+    m_reportedUnsupported = 0;
+}
+
+int PS2Dmac::channelIndex(uint32_t base)
+{
+    for (int i = 0; i < kNumChannels; i++)
+    {
+        if (kChannelBases[i] == base)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool PS2Dmac::isRegister(uint32_t address)
+{
+    switch (address)
+    {
+    case D_CTRL:
+    case D_PCR:
+    case D_SQWC:
+    case D_RBSR:
+    case D_RBOR:
+    case D_STADR:
+    case D_ENABLER:
+    case D_ENABLEW:
+        return true;
+    default:
+        break;
+    }
+
+    if (channelIndex(address & ~0xFFu) < 0)
+    {
+        return false;
+    }
+    switch (address & 0xFF)
+    {
+    case CHCR:
+    case MADR:
+    case QWC:
+    case TADR:
+    case ASR0:
+    case ASR1:
+    case SADR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint32_t PS2Dmac::read(uint32_t address)
+{
+    update();
+
+    switch (address)
+    {
+    case D_CTRL:
+        return m_ctrl;
+    case D_PCR:
+        return m_pcr;
+    case D_SQWC:
+        return m_sqwc;
+    case D_RBSR:
+        return m_rbsr;
+    case D_RBOR:
+        return m_rbor;
+    case D_STADR:
+        return m_stadr;
+    case D_ENABLER:
+    case D_ENABLEW:
+        return m_enable;
+    default:
+        break;
+    }
+
+    int channel = channelIndex(address & ~0xFFu);
+    if (channel < 0)
+    {
+        return 0;
+    }
+    const Registers &r = m_channels[channel];
+    switch (address & 0xFF)
+    {
+    case CHCR:
+        return r.chcr;
+    case MADR:
+        return r.madr;
+    case QWC:
+        return r.qwc;
+    case TADR:
+        return r.tadr;
+    case ASR0:
+        return r.asr[0];
+    case ASR1:
+        return r.asr[1];
+    case SADR:
+        return r.sadr;
+    default:
+        return 0;
+    }
+}
+
+void PS2Dmac::write(uint32_t address, uint32_t value)
+{
+    update();
+
+    switch (address)
+    {
+    case D_CTRL:
+        m_ctrl = value;
+        if (m_ctrl & kCtrlDmae)
+        {
+            // Channels started while the DMAC was disabled begin now
+            for (int i = 0; i < kNumChannels; i++)
+            {
+                if ((m_channels[i].chcr & CHCR_STR) && !busy(i))
+                {
+                    start(i);
+                }
+            }
+        }
+        return;
+    case D_PCR:
+        m_pcr = value;
+        return;
+    case D_SQWC:
+        m_sqwc = value;
+        return;
+    case D_RBSR:
+        m_rbsr = value;
+        return;
+    case D_RBOR:
+        m_rbor = value;
+        return;
+    case D_STADR:
+        m_stadr = value;
+        return;
+    case D_ENABLEW:
+        m_enable = value;
+        return;
+    case D_ENABLER:
+        return;
+    default:
+        break;
+    }
+
+    int channel = channelIndex(address & ~0xFFu);
+    if (channel < 0)
+    {
+        return;
+    }
+    const uint32_t offset = address & 0xFF;
+
+    if (busy(channel))
+    {
+        if (offset == CHCR && (value & CHCR_STR))
+        {
+            return; // already running
+        }
+
+        // Stopping a drain that is waiting on the MFIFO hands it back as it stands.
+        // Anything else waits for the running transfer to finish.
+        bool wasParked = false;
+        Transfer parked;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = std::find_if(m_parked.begin(), m_parked.end(),
+                                   [channel](const Transfer &t) { return t.channel == channel; });
+            if (it != m_parked.end() && offset == CHCR)
+            {
+                parked = *it;
+                parked.parked = false;
+                parked.dstat = 0;
+                parked.intc = 0;
+                m_parked.erase(it);
+                wasParked = true;
+            }
+        }
+        if (wasParked)
+        {
+            finish(parked);
+        }
+        else
+        {
+            waitIdle();
+        }
+    }
+
+    Registers &r = m_channels[channel];
+    switch (offset)
+    {
+    case CHCR:
+        r.chcr = value;
+        if ((value & CHCR_STR) && (m_ctrl & kCtrlDmae))
+        {
+            start(channel);
+        }
+        break;
+    case MADR:
+        r.madr = value & ~0xFu;
+        break;
+    case QWC:
+        r.qwc = value & 0xFFFF;
+        break;
+    case TADR:
+        r.tadr = value & ~0xFu;
+        break;
+    case ASR0:
+        r.asr[0] = value & ~0xFu;
+        break;
+    case ASR1:
+        r.asr[1] = value & ~0xFu;
+        break;
+    case SADR:
+        r.sadr = value & (kScratchpadSize - kQword);
+        break;
+    default:
+        break;
+    }
+}
+
+void PS2Dmac::start(int channel)
+{
+    m_startCount.fetch_add(1, std::memory_order_relaxed);
+    m_busy |= 1u << channel;
+
+    Transfer transfer;
+    transfer.channel = channel;
+    transfer.regs = m_channels[channel];
+    transfer.ctrl = m_ctrl;
+    transfer.sqwc = m_sqwc;
+    transfer.rbor = m_rbor;
+    transfer.rbsr = m_rbsr;
+
+    if (!m_threaded)
+    {
+        std::deque<Transfer> pending{transfer};
+        while (!pending.empty())
+        {
+            Transfer current = pending.front();
+            pending.pop_front();
+            run(current);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (current.parked)
+            {
+                m_parked.push_back(current);
+            }
+            else if (current.channel == SPR_FROM && m_ringWriteKnown)
+            {
+                for (Transfer &parked : m_parked)
+                {
+                    parked.parked = false;
+                    parked.dstat = 0;
+                    parked.intc = 0;
+                    pending.push_back(parked);
+                }
+                m_parked.clear();
+            }
+            m_finished.push_back(current);
+        }
+        m_finishedPending.store(true, std::memory_order_release);
+        update();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_worker.joinable())
+        {
+            m_quit = false;
+            m_worker = std::thread([this]() { workerLoop(); });
+        }
+        m_queue.push_back(transfer);
+    }
+    m_wake.notify_one();
+}
+
+void PS2Dmac::finish(const Transfer &transfer)
+{
+    for (int bit = 0; bit < 16; bit++)
+    {
+        if (transfer.dstat & (1u << bit))
+        {
+            m_interrupts.raiseDmac(bit);
+        }
+    }
+    for (int cause = 0; cause < PS2InterruptController::kNumIntcCauses; cause++)
+    {
+        if (transfer.intc & (1u << cause))
+        {
+            m_interrupts.raiseIntc(cause);
+        }
+    }
+
+    // A parked drain only reports MEIS; the channel stays busy
+    if (transfer.parked)
+    {
+        return;
+    }
+
+    Registers &r = m_channels[transfer.channel];
+    r = transfer.regs;
+    r.chcr &= ~CHCR_STR;
+    m_busy &= ~(1u << transfer.channel);
+    m_interrupts.raiseDmac(transfer.channel);
+}
+
+void PS2Dmac::update()
+{
+    if (!m_finishedPending.exchange(false, std::memory_order_acquire))
+    {
+        return;
+    }
+
+    std::vector<Transfer> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+    for (const Transfer &transfer : finished)
+    {
+        finish(transfer);
+    }
+}
+
+void PS2Dmac::waitIdle()
+{
+    if (m_busy == 0)
+    {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_queue.empty() && !m_running; });
+    }
+    update();
+}
+
+void PS2Dmac::stopWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable())
+    {
+        m_worker.join();
+    }
+}
+
+void PS2Dmac::workerLoop()
+{
+    for (;;)
+    {
+        Transfer transfer;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+            if (m_quit)
+            {
+                return;
+            }
+            transfer = m_queue.front();
+            m_queue.pop_front();
+            m_running = true;
+        }
+
+        run(transfer);
+
+        bool notify = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+            if (transfer.parked)
+            {
+                m_parked.push_back(transfer);
+            }
+            else if (transfer.channel == SPR_FROM && m_ringWriteKnown)
+            {
+                // fromSPR refilled the MFIFO; parked drains go again ahead of anything newer
+                for (auto it = m_parked.rbegin(); it != m_parked.rend(); ++it)
+                {
+                    it->parked = false;
+                    it->dstat = 0;
+                    it->intc = 0;
+                    m_queue.push_front(*it);
+                }
+                m_parked.clear();
+            }
+            m_finished.push_back(transfer);
+            notify = !m_finishedPending.exchange(true, std::memory_order_release);
+            if (m_queue.empty())
+            {
+                m_idle.notify_all();
+            }
+        }
+
+        if (notify && m_notifier)
+        {
+            m_notifier();
+        }
+    }
+}
+
+bool PS2Dmac::drainsMfifo(const Transfer &transfer) const
+{
+    const uint32_t mfd = (transfer.ctrl >> 2) & 3;
+    return (mfd == 2 && transfer.channel == VIF1) || (mfd == 3 && transfer.channel == GIF);
+}
+
+uint8_t *PS2Dmac::pointer(uint32_t address, uint32_t &qwcAvailable) const
+{
+    if (address & 0x80000000u) // SPR bit: scratchpad
+    {
+        const uint32_t offset = address & (kScratchpadSize - kQword);
+        qwcAvailable = (kScratchpadSize - offset) / kQword;
+        return m_scratchpad + offset;
+    }
+
+    const uint32_t physical = address & 0x1FFFFFF0u;
+    if (!m_rdram || physical >= m_ramSize)
+    {
+        qwcAvailable = 0;
+        return nullptr;
+    }
+    qwcAvailable = (m_ramSize - physical) / kQword;
+    return m_rdram + physical;
+}
+
+bool PS2Dmac::toPeripheral(Transfer &transfer, uint32_t address, uint32_t qwc, bool ring)
+{
+    Registers &r = transfer.regs;
+    const Sink &sink = m_sinks[transfer.channel];
+    if (!sink && transfer.channel != SPR_TO && !(m_reportedUnsupported & (1u << transfer.channel)))
+    {
+        m_reportedUnsupported |= 1u << transfer.channel;
+        std::cerr << "[DMAC] nothing is attached to " << kChannelNames[transfer.channel]
+                  << ", its data is dropped" << std::endl;
+    }
+
+    while (qwc > 0)
+    {
+        if (ring)
+        {
+            address = (address & transfer.rbsr) | transfer.rbor;
+        }
+        if (transfer.channel == SPR_TO)
+        {
+            address &= ~0x80000000u;
+        }
+
+        uint32_t available = 0;
+        const uint8_t *data = pointer(address, available);
+        if (!data)
+        {
+            transfer.dstat |= 1u << kBusErrorInterrupt;
+            return false;
+        }
+        if (ring)
+        {
+            available = std::min(available, (transfer.rbor + transfer.rbsr + kQword - address) / kQword);
+        }
+        uint32_t count = std::min(qwc, available);
+
+        if (transfer.channel == SPR_TO)
+        {
+            for (uint32_t done = 0; done < count;)
+            {
+                const uint32_t offset = r.sadr & (kScratchpadSize - kQword);
+                const uint32_t chunk = std::min(count - done, (kScratchpadSize - offset) / kQword);
+                std::memcpy(m_scratchpad + offset, data + done * kQword, chunk * kQword);
+                r.sadr = (offset + chunk * kQword) & (kScratchpadSize - kQword);
+                done += chunk;
+            }
+        }
+        else if (sink)
+        {
+            transfer.intc |= sink(data, count);
+        }
+
+        address += count * kQword;
+        qwc -= count;
+    }
+    r.madr = address;
+    return true;
+}
+
+bool PS2Dmac::transferSpr(Transfer &transfer, uint32_t address, uint32_t qwc, bool ring)
+{
+    Registers &r = transfer.regs;
+    while (qwc > 0)
+    {
+        address = ring ? ((address & transfer.rbsr) | transfer.rbor) : (address & ~0x80000000u);
+
+        uint32_t available = 0;
+        uint8_t *data = pointer(address, available);
+        if (!data)
+        {
+            transfer.dstat |= 1u << kBusErrorInterrupt;
+            return false;
+        }
+        if (ring)
+        {
+            available = std::min(available, (transfer.rbor + transfer.rbsr + kQword - address) / kQword);
+        }
+        const uint32_t offset = r.sadr & (kScratchpadSize - kQword);
+        const uint32_t count = std::min({qwc, available, (kScratchpadSize - offset) / kQword});
+
+        std::memcpy(data, m_scratchpad + offset, count * kQword);
+        r.sadr = (offset + count * kQword) & (kScratchpadSize - kQword);
+        address += count * kQword;
+        qwc -= count;
+    }
+    r.madr = address;
+    return true;
+}
+
+bool PS2Dmac::sourceChain(Transfer &transfer)
+{
+    Registers &r = transfer.regs;
+    const bool mfifo = drainsMfifo(transfer);
+    uint32_t asp = (r.chcr & CHCR_ASP) >> 4;
+
+    // Data left over from the previous tag goes first; REFE and END tags had nothing after them
+    if (r.qwc > 0)
+    {
+        const uint32_t qwc = r.qwc;
+        r.qwc = 0;
+        if (!toPeripheral(transfer, r.madr, qwc, mfifo))
+        {
+            return false;
+        }
+        const uint32_t id = (r.chcr >> 28) & 7;
+        if (id == TAG_REFE || id == TAG_END)
+        {
+            return true;
+        }
+    }
+
+    for (;;)
+    {
+        if (mfifo)
+        {
+            r.tadr = (r.tadr & transfer.rbsr) | transfer.rbor;
+            if (m_ringWriteKnown && r.tadr == ((m_ringWrite & transfer.rbsr) | transfer.rbor))
+            {
+                transfer.parked = true;
+                transfer.dstat |= 1u << kMfifoEmptyInterrupt;
+                break;
+            }
+        }
+
+        uint32_t available = 0;
+        const uint8_t *tagData = pointer(r.tadr, available);
+        if (!tagData)
+        {
+            transfer.dstat |= 1u << kBusErrorInterrupt;
+            return false;
+        }
+        uint64_t tag = 0;
+        std::memcpy(&tag, tagData, sizeof(tag));
+        r.chcr = (r.chcr & 0xFFFF) | (static_cast<uint32_t>(tag) & 0xFFFF0000u);
+
+        const uint32_t qwc = static_cast<uint32_t>(tag & 0xFFFF);
+        const uint32_t id = static_cast<uint32_t>(tag >> 28) & 7;
+        const uint32_t address = static_cast<uint32_t>(tag >> 32) & ~0xFu;
+        const bool irq = (tag >> 31) & 1;
+
+        // With TTE the VIF gets the tag too. Its lower half reads as two NOPs.
+        if ((r.chcr & CHCR_TTE) && (transfer.channel == VIF0 || transfer.channel == VIF1) && m_sinks[transfer.channel])
+        {
+            alignas(16) uint8_t qword[16] = {};
+            std::memcpy(qword + 8, tagData + 8, 8);
+            transfer.intc |= m_sinks[transfer.channel](qword, 1);
+        }
+
+        bool end = false;
+        bool ring = mfifo;
+        switch (id)
+        {
+        case TAG_REFE:
+            r.madr = address;
+            r.tadr += kQword;
+            ring = false;
+            end = true;
+            break;
+        case TAG_CNT:
+            r.madr = r.tadr + kQword;
+            r.tadr = r.madr + qwc * kQword;
+            break;
+        case TAG_NEXT:
+            r.madr = r.tadr + kQword;
+            r.tadr = address;
+            break;
+        case TAG_REF:
+        case TAG_REFS:
+            r.madr = address;
+            r.tadr += kQword;
+            ring = false;
+            break;
+        case TAG_CALL:
+            r.madr = r.tadr + kQword;
+            if (asp >= 2)
+            {
+                transfer.dstat |= 1u << kBusErrorInterrupt;
+                end = true;
+                break;
+            }
+            r.asr[asp++] = r.madr + qwc * kQword;
+            r.tadr = address;
+            break;
+        case TAG_RET:
+            r.madr = r.tadr + kQword;
+            if (asp > 0)
+            {
+                r.tadr = r.asr[--asp];
+            }
+            else
+            {
+                end = true;
+            }
+            break;
+        default: // TAG_END
+            r.madr = r.tadr + kQword;
+            end = true;
+            break;
+        }
+
+        if (!toPeripheral(transfer, r.madr, qwc, ring))
+        {
+            return false;
+        }
+        if (end || ((r.chcr & CHCR_TIE) && irq))
+        {
+            break;
+        }
+    }
+
+    r.chcr = (r.chcr & ~CHCR_ASP) | (asp << 4);
+    return true;
+}
+
+bool PS2Dmac::destinationChain(Transfer &transfer)
+{
+    Registers &r = transfer.regs;
+    const bool ring = ((transfer.ctrl >> 2) & 3) >= 2;
+
+    for (;;)
+    {
+        // The tags come in with the data, from scratchpad at SADR
+        const uint32_t offset = r.sadr & (kScratchpadSize - kQword);
+        uint64_t tag = 0;
+        std::memcpy(&tag, m_scratchpad + offset, sizeof(tag));
+        r.sadr = (offset + kQword) & (kScratchpadSize - kQword);
+        r.chcr = (r.chcr & 0xFFFF) | (static_cast<uint32_t>(tag) & 0xFFFF0000u);
+
+        const uint32_t qwc = static_cast<uint32_t>(tag & 0xFFFF);
+        const uint32_t id = static_cast<uint32_t>(tag >> 28) & 7;
+        const bool irq = (tag >> 31) & 1;
+        r.madr = static_cast<uint32_t>(tag >> 32) & ~0xFu;
+
+        if (!transferSpr(transfer, r.madr, qwc, ring))
+        {
+            return false;
+        }
+        if (id == TAG_END || ((r.chcr & CHCR_TIE) && irq))
+        {
+            return true;
+        }
+    }
+}
+
+bool PS2Dmac::interleave(Transfer &transfer)
+{
+    // D_SQWC: TQWC qwords are moved, then SQWC qwords of memory are skipped
+    Registers &r = transfer.regs;
+    const uint32_t skip = transfer.sqwc & 0xFF;
+    uint32_t block = (transfer.sqwc >> 16) & 0xFF;
+    if (block == 0)
+    {
+        block = r.qwc;
+    }
+
+    while (r.qwc > 0)
+    {
+        const uint32_t count = std::min(block, r.qwc);
+        r.qwc -= count;
+        bool ok = transfer.channel == SPR_TO ? toPeripheral(transfer, r.madr, count, false)
+                                             : transferSpr(transfer, r.madr, count, false);
+        if (!ok)
+        {
+            return false;
+        }
+        if (r.qwc > 0)
+        {
+            r.madr += skip * kQword;
+        }
+    }
+    return true;
+}
+
+void PS2Dmac::run(Transfer &transfer)
+{
+    Registers &r = transfer.regs;
+    const uint32_t mode = (r.chcr & CHCR_MOD) >> 2;
+    const bool spr = transfer.channel == SPR_FROM || transfer.channel == SPR_TO;
+
+    if (fromPeripheral(transfer.channel, r.chcr) && transfer.channel != SPR_FROM)
+    {
+        // IPU and SIF are not emulated, so there is never anything to receive
+        if (!(m_reportedUnsupported & (1u << transfer.channel)))
+        {
+            m_reportedUnsupported |= 1u << transfer.channel;
+            std::cerr << "[DMAC] " << kChannelNames[transfer.channel]
+                      << " has no data source, its transfers finish empty" << std::endl;
+        }
+        r.qwc = 0;
+        return;
+    }
+
+    bool ok = true;
+    if (mode == kModeChain && transfer.channel == SPR_FROM)
+    {
+        ok = destinationChain(transfer);
+    }
+    else if (mode == kModeChain)
+    {
+        ok = sourceChain(transfer);
+    }
+    else if (mode == kModeInterleave && spr)
+    {
+        ok = interleave(transfer);
+    }
+    else
+    {
+        const uint32_t qwc = r.qwc;
+        r.qwc = 0;
+        if (transfer.channel == SPR_FROM)
+        {
+            ok = transferSpr(transfer, r.madr, qwc, ((transfer.ctrl >> 2) & 3) >= 2);
+        }
+        else
+        {
+            ok = toPeripheral(transfer, r.madr, qwc, false);
+        }
+    }
+
+    if (ok && transfer.channel == SPR_FROM && ((transfer.ctrl >> 2) & 3) >= 2)
+    {
+        m_ringWrite = r.madr;
+        m_ringWriteKnown = true;
+    }
+}
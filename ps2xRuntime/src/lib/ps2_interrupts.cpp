@@ -0,0 +1,179 @@
+#include "ps2_interrupts.h"
+#include <algorithm>
+
+PS2InterruptController::PS2InterruptController()
+{
+    reset();
+}
+
+void PS2InterruptController::reset()
+{
+    m_intcStat = 0;
+    m_intcMask = 0;
+    m_dmacStat = 0;
+    m_nextHandlerId = 1;
+    for (auto &chain : m_intcHandlers)
+    {
+        chain.clear();
+    }
+    for (auto &chain : m_dmacHandlers)
+    {
+        chain.clear();
+    }
+}
+
+bool PS2InterruptController::isRegister(uint32_t address)
+{
+    return address == INTC_STAT || address == INTC_MASK || address == D_STAT;
+}
+
+uint32_t PS2InterruptController::read(uint32_t address) const
+{
+    switch (address)
+    {
+    case INTC_STAT:
+        return m_intcStat;
+    case INTC_MASK:
+        return m_intcMask;
+    case D_STAT:
+        return m_dmacStat;
+    default:
+        return 0;
+    }
+}
+
+void PS2InterruptController::write(uint32_t address, uint32_t value)
+{
+    switch (address)
+    {
+    case INTC_STAT:
+        // Writing 1 acknowledges
+        m_intcStat &= ~value;
+        break;
+    case INTC_MASK:
+        // Writing 1 flips the mask bit
+        m_intcMask ^= value & ((1u << kNumIntcCauses) - 1);
+        break;
+    case D_STAT:
+        // Status bits are acknowledged by writing 1, mask bits flipped by writing 1
+        m_dmacStat = (m_dmacStat & ~(value & 0xFFFF)) ^ (value & 0xFFFF0000);
+        break;
+    default:
+        break;
+    }
+}
+
+void PS2InterruptController::raiseIntc(int cause)
+{
+    if (cause >= 0 && cause < kNumIntcCauses)
+    {
+        m_intcStat |= 1u << cause;
+    }
+}
+
+void PS2InterruptController::raiseDmac(int channel)
+{
+    if (channel >= 0 && channel < kNumDmacChannels)
+    {
+        m_dmacStat |= 1u << channel;
+    }
+}
+
+bool PS2InterruptController::pending() const
+{
+    return (m_intcStat & m_intcMask) != 0 || (m_dmacStat & (m_dmacStat >> 16) & 0xFFFF) != 0;
+}
+
+uint32_t PS2InterruptController::takeIntc()
+{
+    uint32_t bits = m_intcStat & m_intcMask;
+    m_intcStat &= ~bits;
+    return bits;
+}
+
+uint32_t PS2InterruptController::takeDmac()
+{
+    uint32_t bits = m_dmacStat & (m_dmacStat >> 16) & 0xFFFF;
+    m_dmacStat &= ~bits;
+    return bits;
+}
+
+bool PS2InterruptController::setIntcEnabled(int cause, bool enabled)
+{
+    if (cause < 0 || cause >= kNumIntcCauses)
+    {
+        return false;
+    }
+
+    uint32_t bit = 1u << cause;
+    bool changed = ((m_intcMask & bit) != 0) != enabled;
+    m_intcMask = enabled ? (m_intcMask | bit) : (m_intcMask & ~bit);
+    return changed;
+}
+
+bool PS2InterruptController::setDmacEnabled(int channel, bool enabled)
+{
+    if (channel < 0 || channel >= kNumDmacChannels)
+    {
+        return false;
+    }
+
+    uint32_t bit = 1u << (channel + 16);
+    bool changed = ((m_dmacStat & bit) != 0) != enabled;
+    m_dmacStat = enabled ? (m_dmacStat | bit) : (m_dmacStat & ~bit);
+    return changed;
+}
+
+int PS2InterruptController::addIntcHandler(int cause, uint32_t func, bool atHead, uint32_t arg, uint32_t gp)
+{
+    if (cause < 0 || cause >= kNumIntcCauses)
+    {
+        return -1;
+    }
+    return addHandler(m_intcHandlers[cause], func, atHead, arg, gp);
+}
+
+int PS2InterruptController::addDmacHandler(int channel, uint32_t func, bool atHead, uint32_t arg, uint32_t gp)
+{
+    if (channel < 0 || channel >= kNumDmacChannels)
+    {
+        return -1;
+    }
+    return addHandler(m_dmacHandlers[channel], func, atHead, arg, gp);
+}
+
+bool PS2InterruptController::removeIntcHandler(int cause, int id)
+{
+    return cause >= 0 && cause < kNumIntcCauses && removeHandler(m_intcHandlers[cause], id);
+}
+
+bool PS2InterruptController::removeDmacHandler(int channel, int id)
+{
+    return channel >= 0 && channel < kNumDmacChannels && removeHandler(m_dmacHandlers[channel], id);
+}
+
+int PS2InterruptController::addHandler(std::vector<Handler> &chain, uint32_t func, bool atHead, uint32_t arg, uint32_t gp)
+{
+    Handler handler{m_nextHandlerId++, func, arg, gp};
+    if (atHead)
+    {
+        chain.insert(chain.begin(), handler);
+    }
+    else
+    {
+        chain.push_back(handler);
+    }
+    return handler.id;
+}
+
+bool PS2InterruptController::removeHandler(std::vector<Handler> &chain, int id)
+{
+    auto it = std::find_if(chain.begin(), chain.end(), [id](const Handler &handler)
+                           { return handler.id == id; });
+    if (it == chain.end())
+    {
+        return false;
+    }
+    chain.erase(it);
+    return true;
+}
@@ -22,6 +22,13 @@ namespace
         ++count;
     }
 
+    constexpr uint32_t kGsCsr = PS2_GS_PRIV_REG_BASE + 0x1000;
+    constexpr uint32_t kGifFifo = 0x10006000;
+    constexpr uint32_t kVif0Fifo = 0x10004000;
+    constexpr uint32_t kVif1Fifo = 0x10005000;
+    // VU0 and VU1 micro/data memory, 0x11000000-0x1100FFFF
+    constexpr uint32_t kVuMemorySize = PS2_VU1_DATA_BASE + PS2_VU1_DATA_SIZE - PS2_VU0_CODE_BASE;
+
     constexpr uint32_t kSchedulerBase = 0x00363a10;
     constexpr uint32_t kSchedulerSpan = 0x00000420;
     static int g_schedWriteLogCount = 0;
@@ -42,6 +49,33 @@ namespace
     }
 }
 
+void PS2Memory::writeGsCsr(uint64_t value)
+{
+    waitIdle();
+    // SIGNAL, FINISH, HSINT, VSINT and EDWINT are acknowledged by writing 1; the rest is status
+    m_gs.csr &= ~(value & 0x1F);
+}
+
+void PS2Memory::gifTransfer(GSGif::Path path, const uint8_t *data, uint32_t qwc)
+{
+    waitIdle();
+    std::lock_guard<std::mutex> lock(m_gifMutex);
+    m_gif.transfer(path, data, qwc);
+    if (m_gsState.takeInterrupt())
+    {
+        m_interrupts.raiseIntc(PS2InterruptController::INTC_GS);
+    }
+}
+
+void PS2Memory::noteDisplayWrite(const uint64_t *reg)
+{
+    // Games flip buffers by rewriting DISPFB1, so the frame it now points at is complete
+    if (reg == &m_gs.dispfb1 || reg == &m_gs.display1)
+    {
+        m_displayChanged = true;
+    }
+}
+
 uint64_t *PS2Memory::gsRegPtr(GSRegisters &gs, uint32_t addr)
 {
     uint32_t off = addr - PS2_GS_PRIV_REG_BASE;
@@ -90,21 +124,18 @@ uint64_t *PS2Memory::gsRegPtr(GSRegisters &gs, uint32_t addr)
     }
 }
 
-// Helpers for GS VRAM addressing (PSMCT32 only in this minimal path).
-static inline uint32_t gs_vram_offset(uint32_t basePage, uint32_t x, uint32_t y, uint32_t fbw)
-{
-    // basePage is in 2048-byte units; fbw is in blocks of 64 pixels.
-    uint32_t strideBytes = fbw * 64 * 4;
-    return basePage * 2048 + y * strideBytes + x * 4;
-}
-
 PS2Memory::PS2Memory()
-    : m_rdram(nullptr), m_scratchpad(nullptr), m_gsvram(nullptr), m_seenGifCopy(false)
+    : m_rdram(nullptr), m_scratchpad(nullptr), m_gsvram(nullptr)
 {
 }
 
 PS2Memory::~PS2Memory()
 {
+    // The DMAC worker and VU1 may still be reading RAM or feeding the GS
+    m_dmac.reset();
+    m_vu0.reset();
+    m_vu1.reset();
+
     if (m_rdram)
     {
         delete[] m_rdram;
@@ -122,6 +153,12 @@ PS2Memory::~PS2Memory()
         delete[] m_gsvram;
         m_gsvram = nullptr;
     }
+
+    if (m_vuMemory)
+    {
+        delete[] m_vuMemory;
+        m_vuMemory = nullptr;
+    }
 }
 
 bool PS2Memory::initialize() { return initialize(PS2_RAM_SIZE); }
@@ -148,9 +185,12 @@ bool PS2Memory::initialize(size_t ramSize)
 
         // Initialize I/O registers
         m_ioRegisters.clear();
+        m_timers.reset();
+        m_interrupts.reset();
 
-        // Initialize GS registers
+        // Initialize GS registers. IMR comes out of reset with every GS interrupt masked.
         memset(&m_gs, 0, sizeof(m_gs));
+        m_gs.imr = 0xFF00;
 
         // Allocate GS VRAM (4MB)
         m_gsvram = new uint8_t[PS2_GS_VRAM_SIZE];
@@ -163,13 +203,64 @@ bool PS2Memory::initialize(size_t ramSize)
             return false;
         }
         std::memset(m_gsvram, 0, PS2_GS_VRAM_SIZE);
-
-        // Initialize VIF registers
-        memset(vif0_regs, 0, sizeof(vif0_regs));
-        memset(vif1_regs, 0, sizeof(vif1_regs));
-
-        // Initialize DMA registers
-        memset(dma_regs, 0, sizeof(dma_regs));
+        m_gsState.attach(m_gsvram, &m_vramDirtyPages, &m_gs);
+        m_gsState.reset();
+        m_gif.reset();
+
+        // VU memory (VU0 4KB + 4KB, VU1 16KB + 16KB) and the VIFs that fill it
+        m_vuMemory = new uint8_t[kVuMemorySize];
+        std::memset(m_vuMemory, 0, kVuMemorySize);
+        m_vif0.reset();
+        m_vif1.reset();
+        m_vif0.attach(getVUCode(0), PS2_VU0_CODE_SIZE, getVUData(0), PS2_VU0_DATA_SIZE);
+        m_vif1.attach(getVUCode(1), PS2_VU1_CODE_SIZE, getVUData(1), PS2_VU1_DATA_SIZE);
+        m_vif1.setDirectHandler([this](const uint8_t *data, uint32_t qwc)
+                                {
+                                    std::lock_guard<std::mutex> lock(m_gifMutex);
+                                    m_gif.transfer(GSGif::PATH2, data, qwc);
+                                    return m_gsState.takeInterrupt() ? 1u << PS2InterruptController::INTC_GS : 0u; });
+
+        // VIF0 MSCAL runs VU0 microprograms in place; VU0 has no XGKICK
+        m_vu0.reset();
+        m_vu0.setThreaded(false);
+        m_vu0.attach(getVUCode(0), PS2_VU0_CODE_SIZE, getVUData(0), PS2_VU0_DATA_SIZE);
+        m_vif0.setCodeWriteHandler([this]()
+                                   { m_vu0.invalidateMicroprograms(); });
+        m_vif0.setMicroprogramHandler([this](uint32_t address, bool resume)
+                                      { m_vu0.start(address, resume, m_vif0.regs().itop, 0); });
+
+        // VIF1 MSCAL runs VU1 microprograms, whose XGKICKs feed PATH1
+        m_vu1.reset();
+        m_vu1.attach(getVUCode(1), PS2_VU1_CODE_SIZE, getVUData(1), PS2_VU1_DATA_SIZE);
+        m_vu1.setKickHandler([this](const uint8_t *data, uint32_t qwc)
+                             {
+                                 std::lock_guard<std::mutex> lock(m_gifMutex);
+                                 m_gif.transfer(GSGif::PATH1, data, qwc);
+                                 return m_gsState.takeInterrupt() ? 1u << PS2InterruptController::INTC_GS : 0u; });
+        m_vif1.setVuSyncHandler([this]()
+                                { m_vu1.waitIdle(); });
+        m_vif1.setCodeWriteHandler([this]()
+                                   { m_vu1.invalidateMicroprograms(); });
+        m_vif1.setMicroprogramHandler([this](uint32_t address, bool resume)
+                                      { m_vu1.start(address, resume, m_vif1.regs().itop, m_vif1.regs().top); });
+
+        // GIF DMA carries PATH3 packets, VIF DMA carries VIF codes
+        m_dmac.reset();
+        m_dmac.attach(m_rdram, static_cast<uint32_t>(ramSize), m_scratchpad);
+        m_dmac.setSink(PS2Dmac::GIF, [this](const uint8_t *data, uint32_t qwc)
+                       {
+                           std::lock_guard<std::mutex> lock(m_gifMutex);
+                           m_gif.transfer(GSGif::PATH3, data, qwc);
+                           m_gifCopyCount.fetch_add(1, std::memory_order_relaxed);
+                           return m_gsState.takeInterrupt() ? 1u << PS2InterruptController::INTC_GS : 0u; });
+        m_dmac.setSink(PS2Dmac::VIF0, [this](const uint8_t *data, uint32_t qwc)
+                       {
+                           m_vifWriteCount.fetch_add(1, std::memory_order_relaxed);
+                           return m_vif0.transfer(data, qwc); });
+        m_dmac.setSink(PS2Dmac::VIF1, [this](const uint8_t *data, uint32_t qwc)
+                       {
+                           m_vifWriteCount.fetch_add(1, std::memory_order_relaxed);
+                           return m_vif1.transfer(data, qwc); });
 
         m_tlbEntries.clear();
 
@@ -187,6 +278,36 @@ bool PS2Memory::isScratchpad(uint32_t address) const
            address < PS2_SCRATCHPAD_BASE + PS2_SCRATCHPAD_SIZE;
 }
 
+uint8_t *PS2Memory::vuMemoryPtr(uint32_t address)
+{
+    const uint32_t physAddr = address & 0x1FFFFFFF;
+    if (physAddr < PS2_VU0_CODE_BASE || physAddr >= PS2_VU0_CODE_BASE + kVuMemorySize || !m_vuMemory)
+    {
+        return nullptr;
+    }
+    // VIF DMA writes VU memory on the worker
+    waitIdle();
+    return m_vuMemory + (physAddr - PS2_VU0_CODE_BASE);
+}
+
+uint8_t *PS2Memory::vuMemoryWritePtr(uint32_t address)
+{
+    uint8_t *vu = vuMemoryPtr(address);
+    if (vu)
+    {
+        const uint32_t physAddr = address & 0x1FFFFFFF;
+        if (physAddr < PS2_VU0_CODE_BASE + PS2_VU0_CODE_SIZE)
+        {
+            m_vu0.invalidateMicroprograms();
+        }
+        else if (physAddr >= PS2_VU1_CODE_BASE && physAddr < PS2_VU1_CODE_BASE + PS2_VU1_CODE_SIZE)
+        {
+            m_vu1.invalidateMicroprograms();
+        }
+    }
+    return vu;
+}
+
 uint32_t PS2Memory::translateAddress(uint32_t virtualAddress) const
 {
     if (isScratchpad(virtualAddress))
@@ -238,8 +359,13 @@ uint8_t PS2Memory::read8(uint32_t address)
     {
         return m_scratchpad[address - PS2_SCRATCHPAD_BASE];
     }
+    if (uint8_t *vu = vuMemoryPtr(address))
+    {
+        return *vu;
+    }
     if (isGsPrivReg(address))
     {
+        waitIdle();
         uint64_t *reg = gsRegPtr(m_gs, address);
         uint32_t off = address & 7;
         uint64_t val = reg ? *reg : 0;
@@ -259,8 +385,13 @@ uint16_t PS2Memory::read16(uint32_t address)
     {
         return *reinterpret_cast<uint16_t *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]);
     }
+    if (uint8_t *vu = vuMemoryPtr(address))
+    {
+        return *reinterpret_cast<uint16_t *>(vu);
+    }
     if (isGsPrivReg(address))
     {
+        waitIdle();
         uint64_t *reg = gsRegPtr(m_gs, address);
         uint32_t off = address & 7;
         uint64_t val = reg ? *reg : 0;
@@ -280,6 +411,10 @@ uint32_t PS2Memory::read32(uint32_t address)
     {
         return *reinterpret_cast<uint32_t *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]);
     }
+    if (uint8_t *vu = vuMemoryPtr(address))
+    {
+        return *reinterpret_cast<uint32_t *>(vu);
+    }
 
     if (address >= 0x10000000 && address < 0x10010000)
     {
@@ -288,6 +423,7 @@ uint32_t PS2Memory::read32(uint32_t address)
 
     if (isGsPrivReg(address))
     {
+        waitIdle();
         uint64_t *reg = gsRegPtr(m_gs, address);
         uint32_t off = address & 7;
         uint64_t val = reg ? *reg : 0;
@@ -308,9 +444,14 @@ uint64_t PS2Memory::read64(uint32_t address)
     {
         return *reinterpret_cast<uint64_t *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]);
     }
+    if (uint8_t *vu = vuMemoryPtr(address))
+    {
+        return *reinterpret_cast<uint64_t *>(vu);
+    }
 
     if (isGsPrivReg(address))
     {
+        waitIdle();
         uint64_t *reg = gsRegPtr(m_gs, address);
         return reg ? *reg : 0;
     }
@@ -330,6 +471,10 @@ __m128i PS2Memory::read128(uint32_t address)
     {
         return _mm_loadu_si128(reinterpret_cast<const __m128i *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]));
     }
+    if (uint8_t *vu = vuMemoryPtr(address))
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(vu));
+    }
     return _mm_setzero_si128();
 }
 
@@ -347,6 +492,10 @@ void PS2Memory::write8(uint32_t address, uint8_t value)
     {
         m_scratchpad[address - PS2_SCRATCHPAD_BASE] = value;
     }
+    else if (uint8_t *vu = vuMemoryWritePtr(address))
+    {
+        *vu = value;
+    }
 }
 
 void PS2Memory::write16(uint32_t address, uint16_t value)
@@ -363,6 +512,10 @@ void PS2Memory::write16(uint32_t address, uint16_t value)
     {
         *reinterpret_cast<uint16_t *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]) = value;
     }
+    else if (uint8_t *vu = vuMemoryWritePtr(address))
+    {
+        *reinterpret_cast<uint16_t *>(vu) = value;
+    }
 }
 
 void PS2Memory::write32(uint32_t address, uint32_t value)
@@ -375,8 +528,15 @@ void PS2Memory::write32(uint32_t address, uint32_t value)
         return;
     }
 
+    if (address == kGsCsr)
+    {
+        writeGsCsr(value);
+        return;
+    }
+
     if (isGsPrivReg(address))
     {
+        waitIdle();
         uint64_t *reg = gsRegPtr(m_gs, address);
         if (reg)
         {
@@ -384,6 +544,7 @@ void PS2Memory::write32(uint32_t address, uint32_t value)
             uint64_t mask = 0xFFFFFFFFULL << (off * 8);
             *reg = (*reg & ~mask) | ((uint64_t)value << (off * 8));
             logGsWrite(address, *reg);
+            noteDisplayWrite(reg);
         }
         return;
     }
@@ -399,19 +560,31 @@ void PS2Memory::write32(uint32_t address, uint32_t value)
     {
         *reinterpret_cast<uint32_t *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]) = value;
     }
+    else if (uint8_t *vu = vuMemoryWritePtr(address))
+    {
+        *reinterpret_cast<uint32_t *>(vu) = value;
+    }
 }
 
 void PS2Memory::write64(uint32_t address, uint64_t value)
 {
     uint32_t physAddr = translateAddress(address);
 
+    if (address == kGsCsr)
+    {
+        writeGsCsr(value);
+        return;
+    }
+
     if (isGsPrivReg(address))
     {
+        waitIdle();
         uint64_t *reg = gsRegPtr(m_gs, address);
         if (reg)
         {
             *reg = value;
             logGsWrite(address, value);
+            noteDisplayWrite(reg);
         }
         return;
     }
@@ -427,6 +600,10 @@ void PS2Memory::write64(uint32_t address, uint64_t value)
     {
         *reinterpret_cast<uint64_t *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]) = value;
     }
+    else if (uint8_t *vu = vuMemoryWritePtr(address))
+    {
+        *reinterpret_cast<uint64_t *>(vu) = value;
+    }
 }
 
 void PS2Memory::write128(uint32_t address, __m128i value)
@@ -442,9 +619,35 @@ void PS2Memory::write128(uint32_t address, __m128i value)
     {
         _mm_storeu_si128(reinterpret_cast<__m128i *>(&m_scratchpad[address - PS2_SCRATCHPAD_BASE]), value);
     }
+    else if (uint8_t *vu = vuMemoryWritePtr(address))
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(vu), value);
+    }
     else if (physAddr < PS2_GS_VRAM_SIZE)
     {
         _mm_storeu_si128(reinterpret_cast<__m128i *>(&m_gsvram[physAddr]), value);
+        m_vramDirtyPages.set(physAddr / GSLocalMemory::kPageSize);
+    }
+    else if (physAddr == kGifFifo)
+    {
+        alignas(16) uint8_t qword[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(qword), value);
+        gifTransfer(GSGif::PATH3, qword, 1);
+    }
+    else if (physAddr == kVif0Fifo || physAddr == kVif1Fifo)
+    {
+        alignas(16) uint8_t qword[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(qword), value);
+        waitIdle();
+        m_vifWriteCount.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t causes = (physAddr == kVif0Fifo ? m_vif0 : m_vif1).transfer(qword, 1);
+        for (int cause = 0; cause < 32; cause++)
+        {
+            if (causes & (1u << cause))
+            {
+                m_interrupts.raiseIntc(cause);
+            }
+        }
     }
     else
     {
@@ -457,91 +660,31 @@ void PS2Memory::write128(uint32_t address, __m128i value)
 
 bool PS2Memory::writeIORegister(uint32_t address, uint32_t value)
 {
-    m_ioRegisters[address] = value;
-
-    if (address >= 0x10000000 && address < 0x10010000)
+    if (PS2Timers::isTimerRegister(address))
     {
-        // DMA channel control registers
-        if (address >= 0x10008000 && address < 0x1000F000)
-        {
-            if ((address & 0xFF) == 0x00)
-            { // CHCR register
-                if (value & 0x100)
-                { // STR bit set
-                    uint32_t channelBase = address & ~0xFF;
-                    uint32_t madr = m_ioRegisters[channelBase + 0x10];
-                    uint32_t qwc = m_ioRegisters[channelBase + 0x20] & 0xFFFF;
-
-                    std::cout << "DMA Start - Channel: " << std::hex << ((channelBase >> 8) & 0xF)
-                              << ", MADR: " << madr
-                              << ", QWC: " << qwc << std::dec << std::endl;
-
-                    // Minimal GIF (channel 2) and VIF1 (channel 1) image transfer: copy from EE memory to GS VRAM.
-                    // Only handles simple linear IMAGE transfers; treats destination as current DISPFBUF1 FBP.
-                    if ((channelBase == 0x1000A000 || channelBase == 0x10009000) && m_gsvram)
-                    {
-                        auto doCopy = [&](uint32_t srcAddr, uint32_t qwCount)
-                        {
-                            uint32_t bytes = qwCount * 16;
-                            uint32_t src = translateAddress(srcAddr);
-                            uint32_t basePage = static_cast<uint32_t>(m_gs.dispfb1 & 0x1FF);
-                            uint32_t dest = basePage * 2048;
-                            std::cout << "[GIF] ch=" << ((channelBase == 0x1000A000) ? 2 : 1)
-                                      << " IMAGE copy bytes=" << bytes
-                                      << " src=0x" << std::hex << srcAddr
-                                      << " phys=0x" << src
-                                      << " fbp=0x" << basePage
-                                      << " dest=0x" << dest << std::dec << std::endl;
-
-                            if (src + bytes > PS2_RAM_SIZE)
-                            {
-                                bytes = std::min<uint32_t>(bytes, PS2_RAM_SIZE - src);
-                            }
-                            std::memcpy(m_gsvram + dest, m_rdram + src, bytes);
-                            m_seenGifCopy = true;
-                            m_gifCopyCount.fetch_add(1, std::memory_order_relaxed);
-                        };
-
-                        if (qwc > 0)
-                        {
-                            doCopy(madr, qwc);
-                        }
-                        else
-                        {
-                            // Simple DMA chain walker for one tag from TADR (REF/NEXT).
-                            uint32_t tadr = m_ioRegisters[channelBase + 0x30];
-                            uint32_t physTag = translateAddress(tadr);
-                            if (physTag + 16 <= PS2_RAM_SIZE)
-                            {
-                                const uint8_t *tp = m_rdram + physTag;
-                                uint64_t tag = *reinterpret_cast<const uint64_t *>(tp);
-                                uint16_t tagQwc = static_cast<uint16_t>(tag & 0xFFFF);
-                                uint32_t id = static_cast<uint32_t>((tag >> 28) & 0x7);
-                                uint32_t addr = static_cast<uint32_t>((tag >> 32) & 0x7FFFFFF);
-                                std::cout << "[DMA chain] ch=" << ((channelBase == 0x1000A000) ? 2 : 1)
-                                          << " tag id=0x" << std::hex << id
-                                          << " qwc=" << tagQwc
-                                          << " addr=0x" << addr
-                                          << " raw=0x" << tag << std::dec << std::endl;
-                                if (id == 0 || id == 1 || id == 2)
-                                {
-                                    doCopy(addr, tagQwc);
-                                }
-                            }
-                        }
-                        m_ioRegisters[address] &= ~0x100;
-                    }
-                }
-            }
-        }
-
-        if (address >= 0x10000200 && address < 0x10000300)
-        {
-            std::cout << "Interrupt register write: " << std::hex << address << " = " << value << std::dec << std::endl;
-            return true;
-        }
+        m_timers.write(address, value);
+        return true;
+    }
+    if (PS2InterruptController::isRegister(address))
+    {
+        m_interrupts.write(address, value);
+        return true;
+    }
+    if (PS2Dmac::isRegister(address))
+    {
+        m_dmac.write(address, value);
+        return true;
+    }
+    if (m_vif0.isRegister(address) || m_vif1.isRegister(address))
+    {
+        waitIdle();
+        (m_vif0.isRegister(address) ? m_vif0 : m_vif1).write(address, value);
+        return true;
     }
-    else if (address >= 0x12000000 && address < 0x12001000)
+
+    m_ioRegisters[address] = value;
+
+    if (address >= 0x12000000 && address < 0x12001000)
     {
         // GS registers
         std::cout << "GS register write: " << std::hex << address << " = " << value << std::dec << std::endl;
@@ -554,43 +697,30 @@ bool PS2Memory::writeIORegister(uint32_t address, uint32_t value)
 
 uint32_t PS2Memory::readIORegister(uint32_t address)
 {
-    auto it = m_ioRegisters.find(address);
-    if (it != m_ioRegisters.end())
+    if (PS2Timers::isTimerRegister(address))
     {
-        return it->second;
+        return m_timers.read(address);
     }
-
-    if (address >= 0x10000000 && address < 0x10010000)
+    if (PS2InterruptController::isRegister(address))
     {
-        // Timer registers
-        if (address >= 0x10000000 && address < 0x10000100)
-        {
-            if ((address & 0xF) == 0x00)
-            {                            // COUNT registers
-                uint32_t timerCount = 0; // Should calculate based on elapsed time
-                std::cout << "Timer COUNT read: " << std::hex << address << " = " << timerCount << std::dec << std::endl;
-                return timerCount;
-            }
-        }
-
-        // DMA status registers
-        if (address >= 0x10008000 && address < 0x1000F000)
-        {
-            if ((address & 0xFF) == 0x00)
-            {                                                             // CHCR registers
-                uint32_t channelStatus = m_ioRegisters[address] & ~0x100; // Clear busy bit
-                std::cout << "DMA status read: " << std::hex << address << " = " << channelStatus << std::dec << std::endl;
-                return channelStatus;
-            }
-        }
+        // Transfers that finished since the last look raise their D_STAT bits first
+        m_dmac.update();
+        return m_interrupts.read(address);
+    }
+    if (PS2Dmac::isRegister(address))
+    {
+        return m_dmac.read(address);
+    }
+    if (m_vif0.isRegister(address) || m_vif1.isRegister(address))
+    {
+        waitIdle();
+        return (m_vif0.isRegister(address) ? m_vif0 : m_vif1).read(address);
+    }
 
-        // Interrupt status registers
-        if (address >= 0x10000200 && address < 0x10000300)
-        {
-            std::cout << "Interrupt status read: " << std::hex << address << std::dec << std::endl;
-            // Should calculate based on pending interrupts
-            return 0;
-        }
+    auto it = m_ioRegisters.find(address);
+    if (it != m_ioRegisters.end())
+    {
+        return it->second;
     }
 
     return 0;
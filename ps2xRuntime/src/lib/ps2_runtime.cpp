@@ -1,5 +1,6 @@
 #include "ps2_runtime.h"
 #include "gs_renderer.h"
+#include "gs_local_memory.h"
 #include "ps2_syscalls.h"
 #include "ps2_runtime_macros.h"
 #include <iostream>
@@ -9,7 +10,10 @@
 #include <atomic>
 #include <thread>
 #include <unordered_map>
+#include <cstdio>
+#ifndef PS2X_NO_RAYLIB
 #include "raylib.h"
+#endif
 
 #define ELF_MAGIC 0x464C457F // "\x7FELF" in little endian
 #define ET_EXEC 2            // Executable file
@@ -58,21 +62,21 @@ static constexpr int FB_HEIGHT = 448;
 
 std::atomic<int> g_activeThreads{0};
 
-static void UploadFrame(Texture2D &tex, PS2Runtime *rt)
+// Converts the displayed framebuffer and publishes it to the presenter. Guest thread only.
+static void PublishFrame(PS2Runtime *rt)
 {
     const GSRegisters &gs = rt->memory().gs();
     GSRenderer &renderer = rt->renderer();
 
-    // DISPFBUF1 fields: FBP (bits 0-8) * 2048 bytes, FBW (bits 10-15) blocks of 64 pixels, PSM (bits 16-20)
+    // DISPFB1 fields: FBP (bits 0-8) in 8 KB pages, FBW (bits 9-14) blocks of 64 pixels, PSM (bits 15-19)
     uint32_t dispfb = static_cast<uint32_t>(gs.dispfb1 & 0xFFFFFFFFULL);
     uint32_t fbp = dispfb & 0x1FF;
-    uint32_t fbw = (dispfb >> 10) & 0x3F;
-    uint32_t psm = (dispfb >> 16) & 0x1F;
+    uint32_t fbw = (dispfb >> 9) & 0x3F;
+    uint32_t psm = (dispfb >> 15) & 0x1F;
 
-    // DISPLAY1 fields: DX,DY not used here; DW,DH are width/height minus 1 (11 bits each)
+    // DISPLAY1 fields: DX,DY and DW not used here; DH (bits 44-54) is the height minus 1
     uint64_t display64 = gs.display1;
-    uint32_t dw = static_cast<uint32_t>((display64 >> 23) & 0x7FF);
-    uint32_t dh = static_cast<uint32_t>((display64 >> 34) & 0x7FF);
+    uint32_t dh = static_cast<uint32_t>((display64 >> 44) & 0x7FF);
 
     GSRenderer::FramebufferConfig config;
     config.basePointer = fbp;
@@ -82,20 +86,16 @@ static void UploadFrame(Texture2D &tex, PS2Runtime *rt)
     // Map PS2 PSM to Renderer PixelFormat
     switch (psm)
     {
-    case 0: config.format = GSRenderer::PixelFormat::PSMCT32; break;
-    case 2: config.format = GSRenderer::PixelFormat::PSMCT16; break;
+    case GSLocalMemory::PSMCT32: config.format = GSRenderer::PixelFormat::PSMCT32; break;
+    case GSLocalMemory::PSMCT16: config.format = GSRenderer::PixelFormat::PSMCT16; break;
+    case GSLocalMemory::PSMCT16S: config.format = GSRenderer::PixelFormat::PSMCT16S; break;
+    case GSLocalMemory::PSMT8: config.format = GSRenderer::PixelFormat::PSMT8; break;
+    case GSLocalMemory::PSMT4: config.format = GSRenderer::PixelFormat::PSMT4; break;
     default: config.format = GSRenderer::PixelFormat::PSMCT32; break;
     }
 
     // Update renderer's internal buffer
     renderer.updateFramebuffer(rt->memory(), config);
-
-    // If dirty, update the Raylib texture
-    if (renderer.isFramebufferDirty())
-    {
-        UpdateTexture(tex, renderer.getFramebufferRGBA().data());
-        renderer.clearFramebufferDirty();
-    }
 }
 
 PS2Runtime::PS2Runtime()
@@ -120,17 +120,62 @@ bool PS2Runtime::initialize(const char *title)
         return false;
     }
 
+    // The guest and the presenter keep a core each busy, so draw with about half of the rest
+    uint32_t rasterizerThreads = m_rasterizerThreads;
+    if (rasterizerThreads == 0)
+    {
+        rasterizerThreads = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+    }
+    m_memory.gsState().setRasterizerThreads(rasterizerThreads);
+
     if (!m_renderer.initialize(FB_WIDTH, FB_HEIGHT))
     {
         std::cerr << "Failed to initialize GS Renderer" << std::endl;
         return false;
     }
 
-    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
-    InitWindow(FB_WIDTH, FB_HEIGHT, title);
-    SetTargetFPS(60);
+    if (m_headless)
+    {
+        if (m_pacing == FramePacing::HostVsync)
+        {
+            std::cerr << "Headless mode has no host vsync, using realtime pacing" << std::endl;
+            m_pacing = FramePacing::Realtime;
+        }
+
+        if (!m_headless->dumpDirectory.empty())
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(m_headless->dumpDirectory, ec);
+            if (ec)
+            {
+                std::cerr << "Failed to create frame dump directory " << m_headless->dumpDirectory << ": " << ec.message() << std::endl;
+                return false;
+            }
+        }
+
+        std::cout << "Running headless (" << title << ")" << std::endl;
+        return true;
+    }
+
+#ifdef PS2X_NO_RAYLIB
+    std::cerr << "Runtime was built without raylib, only headless mode is available" << std::endl;
+    return false;
+#else
+    if (m_pacing == FramePacing::HostVsync)
+    {
+        // Presentation blocks on the display's vsync, which in turn drives guest VBLANK
+        SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
+        InitWindow(FB_WIDTH, FB_HEIGHT, title);
+    }
+    else
+    {
+        SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+        InitWindow(FB_WIDTH, FB_HEIGHT, title);
+        SetTargetFPS(60);
+    }
 
     return true;
+#endif
 }
 
 bool PS2Runtime::loadELF(const std::string &elfPath)
@@ -215,6 +260,11 @@ void PS2Runtime::registerFunction(uint32_t address, RecompiledFunction func)
     m_functionTable[address] = func;
 }
 
+void PS2Runtime::registerVuMicroprogram(const PS2VuMicroprogram &program)
+{
+    (program.unit == 0 ? m_memory.vu0() : m_memory.vu1()).addMicroprogram(program);
+}
+
 bool PS2Runtime::hasFunction(uint32_t address) const
 {
     return m_functionTable.find(address) != m_functionTable.end();
@@ -248,18 +298,43 @@ void PS2Runtime::SignalException(R5900Context *ctx, PS2Exception exception)
 
 void PS2Runtime::executeVU0Microprogram(uint8_t *rdram, R5900Context *ctx, uint32_t address)
 {
-    static std::unordered_map<uint32_t, int> seen;
-    int &count = seen[address];
-    if (count < 3)
+    // VIF0 DMA may still be loading VU0 memory
+    m_memory.waitIdle();
+
+    // Macro mode keeps VU0's registers in the EE context; micro mode runs on the same ones
+    PS2VectorUnit &vu0 = m_memory.vu0();
+    PS2VectorUnit::Registers &regs = vu0.registers();
+    for (int i = 1; i < 32; i++)
+    {
+        _mm_store_ps(regs.vf[i], ctx->vu0_vf[i]);
+    }
+    _mm_store_ps(regs.acc, ctx->vu0_acc);
+    std::memcpy(regs.vi, ctx->vi, sizeof(regs.vi));
+    regs.vi[0] = 0;
+    regs.q = ctx->vu0_q;
+    regs.p = ctx->vu0_p;
+    regs.i = ctx->vu0_i;
+    regs.r = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_castps_si128(ctx->vu0_r)));
+    regs.status = ctx->vu0_status;
+    regs.mac = ctx->vu0_mac_flags;
+    regs.clip = ctx->vu0_clip_flags;
+
+    vu0.start(address, false, ctx->vu0_itop, 0);
+
+    for (int i = 1; i < 32; i++)
     {
-        std::cout << "[VU0] microprogram @0x" << std::hex << address
-                  << " pc=0x" << ctx->pc
-                  << std::dec << std::endl;
+        ctx->vu0_vf[i] = _mm_load_ps(regs.vf[i]);
     }
-    ++count;
-    ctx->vu0_clip_flags = 0;
-    ctx->vu0_status = 0;
-    ctx->vu0_q = 1.0f;
+    ctx->vu0_acc = _mm_load_ps(regs.acc);
+    std::memcpy(ctx->vi, regs.vi, sizeof(regs.vi));
+    ctx->vu0_q = regs.q;
+    ctx->vu0_p = regs.p;
+    ctx->vu0_i = regs.i;
+    ctx->vu0_r = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(regs.r)));
+    ctx->vu0_status = static_cast<uint16_t>(regs.status);
+    ctx->vu0_mac_flags = regs.mac;
+    ctx->vu0_clip_flags = regs.clip;
+    ctx->vu0_tpc = regs.pc;
 }
 
 void PS2Runtime::vu0StartMicroProgram(uint8_t *rdram, R5900Context *ctx, uint32_t address)
@@ -269,8 +344,13 @@ void PS2Runtime::vu0StartMicroProgram(uint8_t *rdram, R5900Context *ctx, uint32_
 
 void PS2Runtime::handleSyscall(uint8_t *rdram, R5900Context *ctx)
 {
-    // PS2 syscall number is in $v1 (register 3)
+    // PS2 syscall number is in $v1 (register 3). The SDK issues the interrupt-context
+    // variants with the number negated.
     uint32_t syscallNum = GPR_U32(ctx, 3);
+    if (static_cast<int32_t>(syscallNum) < 0)
+    {
+        syscallNum = 0u - syscallNum;
+    }
     
     static int logCount = 0;
     if (logCount < 20)
@@ -281,6 +361,9 @@ void PS2Runtime::handleSyscall(uint8_t *rdram, R5900Context *ctx)
         ++logCount;
     }
 
+    // Syscalls are where interrupts that came due while guest code ran get delivered
+    m_scheduler.safePoint();
+
     switch (syscallNum)
     {
     case 2:  // SetGsCrt
@@ -293,6 +376,18 @@ void PS2Runtime::handleSyscall(uint8_t *rdram, R5900Context *ctx)
     case 7:  // ExecPS2 / SleepThread
         ps2_syscalls::SleepThread(rdram, ctx, this);
         break;
+    case 16: // AddIntcHandler
+        ps2_syscalls::AddIntcHandler(rdram, ctx, this);
+        break;
+    case 17: // RemoveIntcHandler
+        ps2_syscalls::RemoveIntcHandler(rdram, ctx, this);
+        break;
+    case 18: // AddDmacHandler
+        ps2_syscalls::AddDmacHandler(rdram, ctx, this);
+        break;
+    case 19: // RemoveDmacHandler
+        ps2_syscalls::RemoveDmacHandler(rdram, ctx, this);
+        break;
     case 20: // _EnableIntc
         ps2_syscalls::EnableIntc(rdram, ctx, this);
         break;
@@ -308,6 +403,27 @@ void PS2Runtime::handleSyscall(uint8_t *rdram, R5900Context *ctx)
     case 24: // _SetAlarm
         ps2_syscalls::SetAlarm(rdram, ctx, this);
         break;
+    case 25: // _ReleaseAlarm
+        ps2_syscalls::CancelAlarm(rdram, ctx, this);
+        break;
+    case 26: // _iEnableIntc
+        ps2_syscalls::iEnableIntc(rdram, ctx, this);
+        break;
+    case 27: // _iDisableIntc
+        ps2_syscalls::iDisableIntc(rdram, ctx, this);
+        break;
+    case 28: // _iEnableDmac
+        ps2_syscalls::iEnableDmac(rdram, ctx, this);
+        break;
+    case 29: // _iDisableDmac
+        ps2_syscalls::iDisableDmac(rdram, ctx, this);
+        break;
+    case 30: // _iSetAlarm
+        ps2_syscalls::iSetAlarm(rdram, ctx, this);
+        break;
+    case 31: // _iReleaseAlarm
+        ps2_syscalls::iCancelAlarm(rdram, ctx, this);
+        break;
     case 32: // CreateThread
         ps2_syscalls::CreateThread(rdram, ctx, this);
         break;
@@ -350,6 +466,12 @@ void PS2Runtime::handleSyscall(uint8_t *rdram, R5900Context *ctx)
     case 52: // iWakeupThread
         ps2_syscalls::iWakeupThread(rdram, ctx, this);
         break;
+    case 53: // CancelWakeupThread
+        ps2_syscalls::CancelWakeupThread(rdram, ctx, this);
+        break;
+    case 54: // iCancelWakeupThread
+        ps2_syscalls::iCancelWakeupThread(rdram, ctx, this);
+        break;
     case 55: // SuspendThread
         ps2_syscalls::SuspendThread(rdram, ctx, this);
         break;
@@ -464,27 +586,297 @@ void PS2Runtime::HandleIntegerOverflow(R5900Context *ctx)
     m_cpuContext.pc = 0x80000000;
 }
 
-void PS2Runtime::run()
+int32_t PS2Runtime::callGuestHandler(uint32_t handler, uint32_t gp, uint32_t a0, uint32_t a1, uint32_t a2)
 {
-    RecompiledFunction entryPoint = lookupFunction(m_cpuContext.pc);
+    if (!hasFunction(handler))
+    {
+        static int logCount = 0;
+        if (logCount < 16)
+        {
+            std::cerr << "[Interrupt] handler 0x" << std::hex << handler << std::dec << " is not registered" << std::endl;
+            ++logCount;
+        }
+        return 0;
+    }
+
+    // Start from the interrupted thread's state, then switch to the kernel stack
+    const PS2Scheduler::Thread *current = m_scheduler.thread(PS2Scheduler::kSelfThreadId);
+    R5900Context handlerCtx = current ? *current->context : m_cpuContext;
+    R5900Context *ctx = &handlerCtx;
+    SET_GPR_U32(ctx, 29, PS2_INTERRUPT_STACK_TOP - 0x10);
+    if (gp)
+    {
+        SET_GPR_U32(ctx, 28, gp);
+    }
+    SET_GPR_U32(ctx, 4, a0);
+    SET_GPR_U32(ctx, 5, a1);
+    SET_GPR_U32(ctx, 6, a2);
+    SET_GPR_U32(ctx, 31, 0);
+    ctx->pc = handler;
 
+    try
+    {
+        lookupFunction(handler)(m_memory.getRDRAM(), ctx, this);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[Interrupt] handler 0x" << std::hex << handler << std::dec << " exception: " << e.what() << std::endl;
+    }
+    return GPR_S32(ctx, 2);
+}
+
+std::chrono::steady_clock::time_point PS2Runtime::serviceVblank()
+{
+    if (m_pacing == FramePacing::HostVsync)
+    {
+        if (m_hostVblankEnd && m_clock.hsyncCount() >= *m_hostVblankEnd)
+        {
+            m_hostVblankEnd.reset();
+            vblankEnd();
+        }
+        return m_hostVblankEnd ? m_clock.timeOfHsync(*m_hostVblankEnd) : std::chrono::steady_clock::time_point::max();
+    }
+
+    uint64_t edges = m_clock.vblankEdges();
+    // After a long stall only the latest field is worth replaying
+    if (edges > m_vblankEdgesSeen + 2)
+    {
+        m_vblankEdgesSeen = (edges - 2) & ~1ull;
+    }
+    for (; m_vblankEdgesSeen < edges; m_vblankEdgesSeen++)
+    {
+        if (m_vblankEdgesSeen % 2 == 0)
+        {
+            vblankStart();
+        }
+        else
+        {
+            vblankEnd();
+        }
+    }
+    return m_clock.timeOfVblankEdge(m_vblankEdgesSeen);
+}
+
+void PS2Runtime::hostVsync()
+{
+    if (m_hostVblankEnd)
+    {
+        vblankEnd();
+    }
+    vblankStart();
+    m_hostVblankEnd = m_clock.hsyncCount() + m_clock.blankLines();
+}
+
+void PS2Runtime::vblankStart()
+{
+    constexpr uint64_t GS_CSR_VSINT = 1ull << 3;
+    constexpr uint64_t GS_CSR_FIELD = 1ull << 13;
+    constexpr uint64_t GS_IMR_VSMSK = 1ull << 11;
+
+    GSRegisters &gs = m_memory.gs();
+    gs.csr = (gs.csr | GS_CSR_VSINT) ^ GS_CSR_FIELD;
+    m_memory.interrupts().raiseIntc(PS2InterruptController::INTC_VBLANK_START);
+    if (!(gs.imr & GS_IMR_VSMSK))
+    {
+        m_memory.interrupts().raiseIntc(PS2InterruptController::INTC_GS);
+    }
+
+    // A DISPFB flip during this field already published the frame on display
+    if (!m_framePublished)
+    {
+        PublishFrame(this);
+    }
+    m_framePublished = false;
+
+    if (m_headless)
+    {
+        presentHeadlessFrame();
+    }
+}
+
+void PS2Runtime::vblankEnd()
+{
+    m_memory.interrupts().raiseIntc(PS2InterruptController::INTC_VBLANK_END);
+}
+
+void PS2Runtime::presentHeadlessFrame()
+{
+    const uint64_t maxFrames = m_headless->maxFrames;
+    uint64_t frame = m_presentedFrames.load(std::memory_order_relaxed);
+    if (maxFrames && frame >= maxFrames)
+    {
+        return;
+    }
+
+    // Same thread as the publisher, so this is exactly the frame on display at this VBLANK
+    m_renderer.acquireFrame();
+    frame++;
+
+    if (!m_headless->dumpDirectory.empty())
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.ppm", static_cast<unsigned long long>(frame));
+        m_renderer.saveFramePPM((std::filesystem::path(m_headless->dumpDirectory) / name).string());
+    }
+
+    m_presentedFrames.store(frame, std::memory_order_relaxed);
+    if (maxFrames && frame >= maxFrames)
+    {
+        m_scheduler.stop();
+    }
+}
+
+void PS2Runtime::dispatchInterrupts()
+{
+    PS2InterruptController &controller = m_memory.interrupts();
+    if (!controller.pending())
+    {
+        return;
+    }
+
+    // Chains are copied because a handler may add or remove handlers. A negative return ends the chain.
+    // int handler(int cause, void *arg, void *addr)
+    uint32_t intc = controller.takeIntc();
+    for (int cause = 0; cause < PS2InterruptController::kNumIntcCauses; cause++)
+    {
+        if (!(intc & (1u << cause)))
+        {
+            continue;
+        }
+        std::vector<PS2InterruptController::Handler> chain = controller.intcHandlers(cause);
+        for (const PS2InterruptController::Handler &handler : chain)
+        {
+            if (callGuestHandler(handler.func, handler.gp, static_cast<uint32_t>(cause), handler.arg, 0) < 0)
+            {
+                break;
+            }
+        }
+    }
+
+    // int handler(int channel, void *arg, void *addr)
+    uint32_t dmac = controller.takeDmac();
+    for (int channel = 0; channel < PS2InterruptController::kNumDmacChannels; channel++)
+    {
+        if (!(dmac & (1u << channel)))
+        {
+            continue;
+        }
+        std::vector<PS2InterruptController::Handler> chain = controller.dmacHandlers(channel);
+        for (const PS2InterruptController::Handler &handler : chain)
+        {
+            if (callGuestHandler(handler.func, handler.gp, static_cast<uint32_t>(channel), handler.arg, 0) < 0)
+            {
+                break;
+            }
+        }
+    }
+}
+
+void PS2Runtime::loopSafePointSlow()
+{
+    m_loopBudget = kLoopSafePointInterval;
+    m_scheduler.safePoint();
+}
+
+uint32_t PS2Runtime::readCop0Count(R5900Context *ctx)
+{
+    ctx->cop0_count = m_countBase + static_cast<uint32_t>(m_clock.eeCycles() - m_countEpoch);
+    return ctx->cop0_count;
+}
+
+void PS2Runtime::writeCop0Count(R5900Context *ctx, uint32_t value)
+{
+    m_countEpoch = m_clock.eeCycles();
+    m_countBase = value;
+    ctx->cop0_count = value;
+}
+
+std::chrono::steady_clock::time_point PS2Runtime::serviceTimers()
+{
+    std::vector<PS2AlarmService::Expired> expired;
+    m_alarms.advance(m_clock.hsyncCount(), expired);
+
+    // void handler(int id, u16 time, void *arg)
+    for (const PS2AlarmService::Expired &alarm : expired)
+    {
+        callGuestHandler(alarm.handler, alarm.gp, static_cast<uint32_t>(alarm.id), alarm.ticks, alarm.arg);
+    }
+
+    if (m_memory.takeDisplayChanged())
+    {
+        PublishFrame(this);
+        m_framePublished = true;
+    }
+
+    std::chrono::steady_clock::time_point deadline = serviceVblank();
+
+    m_memory.dmac().update();
+    m_memory.vu1().update();
+
+    uint32_t timerInterrupts = m_memory.timers().pollInterrupts();
+    for (int i = 0; i < PS2Timers::kNumTimers; i++)
+    {
+        if (timerInterrupts & (1u << i))
+        {
+            m_memory.interrupts().raiseIntc(PS2InterruptController::INTC_TIM0 + i);
+        }
+    }
+    dispatchInterrupts();
+
+    if (std::optional<uint64_t> next = m_alarms.nextExpiry())
+    {
+        deadline = std::min(deadline, m_clock.timeOfHsync(*next));
+    }
+    if (auto timer = m_memory.timers().nextInterruptTime())
+    {
+        deadline = std::min(deadline, *timer);
+    }
+    return deadline;
+}
+
+void PS2Runtime::run()
+{
     m_cpuContext.r[4] = _mm_set1_epi32(0);           // A0 = 0 (argc)
     m_cpuContext.r[5] = _mm_set1_epi32(0);           // A1 = 0 (argv)
     m_cpuContext.r[29] = _mm_set1_epi32(0x02000000); // SP = top of RAM
 
     std::cout << "Starting execution at address 0x" << std::hex << m_cpuContext.pc << std::dec << std::endl;
 
-    Image blank = GenImageColor(FB_WIDTH, FB_HEIGHT, BLACK);
-    Texture2D frameTex = LoadTextureFromImage(blank);
-    UnloadImage(blank);
-
     g_activeThreads.store(1, std::memory_order_relaxed);
 
-    std::thread gameThread([&, entryPoint]()
+    m_clock.reset();
+    m_alarms.reset(0);
+    m_memory.timers().reset();
+    m_memory.timers().attachClock(&m_clock);
+    m_countEpoch = 0;
+    m_countBase = 0;
+    m_vblankEdgesSeen = 0;
+    m_hostVblankEnd.reset();
+    m_presentedFrames.store(0, std::memory_order_relaxed);
+    m_framePublished = false;
+    m_scheduler.setTimerService([this]()
+                                { return serviceTimers(); });
+    // DMA transfers finish on the DMAC worker; the guest thread applies them at its next safe point
+    m_memory.dmac().setCompletionNotifier([this]()
+                                          { m_scheduler.post([this]()
+                                                             { m_memory.dmac().update(); }); });
+    m_memory.vu1().setCompletionNotifier([this]()
+                                         { m_scheduler.post([this]()
+                                                            { m_memory.vu1().update(); }); });
+    if (m_pacing == FramePacing::Unthrottled)
+    {
+        m_scheduler.setIdleSkip([this](std::chrono::steady_clock::time_point deadline)
+                                { m_clock.skipTo(deadline); });
+    }
+
+    const auto hostStart = std::chrono::steady_clock::now();
+
+    // Every guest thread runs on this host thread; the scheduler returns once they are all dormant
+    std::thread gameThread([&]()
     {
         try
         {
-            entryPoint(m_memory.getRDRAM(), &m_cpuContext, this);
+            m_scheduler.run(this, m_memory.getRDRAM(), &m_cpuContext, m_cpuContext.pc);
         }
         catch (const std::exception &e)
         {
@@ -493,26 +885,84 @@ void PS2Runtime::run()
         g_activeThreads.fetch_sub(1, std::memory_order_relaxed);
     });
 
+    if (m_headless)
+    {
+        runHeadless();
+    }
+    else
+    {
+        runWindowed();
+    }
+
+    m_scheduler.stop();
+    if (gameThread.joinable())
+    {
+        gameThread.join();
+    }
+
+    if (m_headless)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+        uint64_t frames = presentedFrames();
+        std::cout << "Headless run finished: " << frames << " frames in " << seconds << " s ("
+                  << (seconds > 0.0 ? frames / seconds : 0.0) << " fps)" << std::endl;
+    }
+}
+
+void PS2Runtime::runWindowed()
+{
+#ifndef PS2X_NO_RAYLIB
+    Image blank = GenImageColor(FB_WIDTH, FB_HEIGHT, BLACK);
+    Texture2D frameTex = LoadTextureFromImage(blank);
+    UnloadImage(blank);
+
     while (g_activeThreads.load(std::memory_order_relaxed) > 0)
     {
-        UploadFrame(frameTex, this);
+        // Only frames the guest published since the last pass are uploaded
+        if (m_renderer.acquireFrame())
+        {
+            UpdateTexture(frameTex, m_renderer.getFramebufferRGBA().data());
+        }
 
         BeginDrawing();
         ClearBackground(BLACK);
         DrawTexture(frameTex, 0, 0, WHITE);
         EndDrawing();
 
+        if (m_pacing == FramePacing::HostVsync)
+        {
+            m_scheduler.post([this]()
+                             { hostVsync(); });
+        }
+
         if (WindowShouldClose())
         {
             break;
         }
     }
 
-    if (gameThread.joinable())
-    {
-        gameThread.join();
-    }
-    
     UnloadTexture(frameTex);
     CloseWindow();
+#endif
+}
+
+void PS2Runtime::runHeadless()
+{
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t maxFrames = m_headless->maxFrames;
+    const double maxSeconds = m_headless->maxSeconds;
+
+    // Frames are presented from guest VBLANK; this thread only enforces the limits
+    while (g_activeThreads.load(std::memory_order_relaxed) > 0)
+    {
+        if (maxFrames && presentedFrames() >= maxFrames)
+        {
+            break;
+        }
+        if (maxSeconds > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= maxSeconds)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
 }
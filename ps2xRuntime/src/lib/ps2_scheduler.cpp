@@ -0,0 +1,853 @@
+#include "ps2_scheduler.h"
+#include "ps2_runtime.h"
+#include "ps2_runtime_macros.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <ucontext.h>
+#endif
+
+namespace
+{
+    // Matches the default host thread stack the runtime used to give each guest thread
+    constexpr size_t kFiberStackSize = 8 * 1024 * 1024;
+    constexpr int kMainThreadPriority = 1;
+
+    thread_local PS2Scheduler *t_scheduler = nullptr;
+}
+
+struct PS2Scheduler::Fiber
+{
+    bool started = false; // Has run guest code, so its stack may hold frames to unwind
+
+#ifdef _WIN32
+    void *handle = nullptr;
+    bool converted = false; // Created by ConvertThreadToFiber, owned by the host thread
+
+    ~Fiber()
+    {
+        if (handle && !converted)
+        {
+            DeleteFiber(handle);
+        }
+    }
+#else
+    ucontext_t context{};
+    std::unique_ptr<uint8_t[]> stack;
+#endif
+};
+
+PS2Scheduler::Thread::Thread() = default;
+PS2Scheduler::Thread::~Thread() = default;
+
+PS2Scheduler::PS2Scheduler() = default;
+PS2Scheduler::~PS2Scheduler() = default;
+
+void PS2Scheduler::run(PS2Runtime *runtime, uint8_t *rdram, R5900Context *mainContext, uint32_t entry)
+{
+    m_runtime = runtime;
+    m_rdram = rdram;
+    m_stopping = false;
+    t_scheduler = this;
+
+    auto mainThread = std::make_unique<Thread>();
+    mainThread->id = kMainThreadId;
+    mainThread->params.entry = entry;
+    mainThread->params.priority = kMainThreadPriority;
+    mainThread->priority = kMainThreadPriority;
+    mainThread->context = mainContext;
+    m_threads[kMainThreadId] = std::move(mainThread);
+
+    Thread &main = *m_threads[kMainThreadId];
+    prepareFiber(main);
+    main.state = ThreadState::Ready;
+    enqueueReady(main);
+
+    m_schedulerFiber = std::make_unique<Fiber>();
+#ifdef _WIN32
+    m_schedulerFiber->handle = ConvertThreadToFiber(nullptr);
+    m_schedulerFiber->converted = true;
+    if (!m_schedulerFiber->handle)
+    {
+        // The host thread is already a fiber
+        m_schedulerFiber->handle = GetCurrentFiber();
+        m_schedulerFiber->converted = false;
+    }
+#endif
+
+    bool reportedIdle = false;
+    while (!m_stopping.load(std::memory_order_acquire))
+    {
+        safePoint();
+        unwindAbandonedFibers();
+        reclaimFinishedThreads();
+
+        int next = popReady();
+        if (next == 0)
+        {
+            if (!hasLiveThreads())
+            {
+                break;
+            }
+
+            if (!reportedIdle)
+            {
+                std::cout << "[Scheduler] all threads are waiting, idling until an event arrives" << std::endl;
+                reportedIdle = true;
+            }
+
+            if (m_idleSkip && m_nextDeadline != std::chrono::steady_clock::time_point::max())
+            {
+                m_idleSkip(m_nextDeadline);
+                continue;
+            }
+
+            // Sleep until a host event arrives or the next timer is due
+            std::unique_lock<std::mutex> lock(m_hostMutex);
+            auto woken = [this]()
+            { return !m_hostEvents.empty() || m_stopping.load(std::memory_order_acquire); };
+            if (m_nextDeadline == std::chrono::steady_clock::time_point::max())
+            {
+                m_hostWake.wait(lock, woken);
+            }
+            else
+            {
+                m_hostWake.wait_until(lock, m_nextDeadline, woken);
+            }
+            continue;
+        }
+
+        switchToThread(*m_threads[next]);
+    }
+
+    // After stop() the threads still blocked or ready are unwound like terminated ones
+    for (const std::unique_ptr<Thread> &thread : m_threads)
+    {
+        if (thread && thread->fiber && thread->fiber->started && thread->state != ThreadState::Dormant)
+        {
+            m_abandonedFibers.push_back(std::move(thread->fiber));
+            thread->state = ThreadState::Dormant;
+        }
+    }
+    unwindAbandonedFibers();
+    reclaimFinishedThreads();
+
+#ifdef _WIN32
+    if (m_schedulerFiber->converted)
+    {
+        ConvertFiberToThread();
+    }
+#endif
+    m_schedulerFiber.reset();
+    t_scheduler = nullptr;
+}
+
+void PS2Scheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_hostMutex);
+        m_stopping.store(true, std::memory_order_release);
+    }
+    m_hostWake.notify_all();
+}
+
+int PS2Scheduler::createThread(const ThreadParams &params)
+{
+    if (params.entry == 0 || params.priority >= kPriorityLevels)
+    {
+        return -1;
+    }
+
+    int id = allocateThreadId();
+    if (id < 0)
+    {
+        return -1;
+    }
+
+    auto thread = std::make_unique<Thread>();
+    thread->id = id;
+    thread->state = ThreadState::Dormant;
+    thread->params = params;
+    thread->priority = static_cast<int>(params.priority);
+    m_threads[id] = std::move(thread);
+    return id;
+}
+
+int PS2Scheduler::deleteThread(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread || thread->state != ThreadState::Dormant || thread->id == m_current)
+    {
+        return -1;
+    }
+
+    m_threads[thread->id].reset();
+    return 0;
+}
+
+int PS2Scheduler::startThread(int tid, uint32_t arg, const R5900Context &creator)
+{
+    Thread *thread = lookup(tid);
+    if (!thread || thread->state != ThreadState::Dormant)
+    {
+        return -1;
+    }
+
+    if (!thread->context)
+    {
+        thread->ownedContext = std::make_unique<R5900Context>();
+        thread->context = thread->ownedContext.get();
+    }
+
+    // New threads inherit the creator's CPU state, then get their own stack, gp and argument
+    R5900Context *ctx = thread->context;
+    *ctx = creator;
+    if (thread->params.stack && thread->params.stackSize)
+    {
+        SET_GPR_U32(ctx, 29, thread->params.stack + thread->params.stackSize);
+    }
+    if (thread->params.gp)
+    {
+        SET_GPR_U32(ctx, 28, thread->params.gp);
+    }
+    SET_GPR_U32(ctx, 4, arg);
+    SET_GPR_U32(ctx, 31, 0);
+    ctx->pc = thread->params.entry;
+
+    thread->arg = arg;
+    thread->priority = static_cast<int>(thread->params.priority);
+    thread->waitType = WaitType::None;
+    thread->wakeupCount = 0;
+    thread->deleteOnExit = false;
+
+    prepareFiber(*thread);
+    thread->state = ThreadState::Ready;
+    enqueueReady(*thread);
+    preemptIfNeeded();
+    return 0;
+}
+
+void PS2Scheduler::exitThread(bool deleteAfterExit)
+{
+    Thread *thread = lookup(m_current);
+    if (thread)
+    {
+        thread->deleteOnExit = deleteAfterExit;
+    }
+
+    // Unwinds the guest call stack back to fiberMain
+    throw ThreadExit{};
+}
+
+int PS2Scheduler::terminateThread(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread || thread->id == m_current || thread->state == ThreadState::Dormant)
+    {
+        return -1;
+    }
+
+    if (thread->state == ThreadState::Ready)
+    {
+        removeReady(*thread);
+    }
+
+    // The thread stopped mid-stack, so its fiber is handed to the scheduler to unwind
+    // and startThread builds a fresh one
+    if (thread->fiber && thread->fiber->started)
+    {
+        m_abandonedFibers.push_back(std::move(thread->fiber));
+    }
+    thread->state = ThreadState::Dormant;
+    thread->waitType = WaitType::None;
+    return 0;
+}
+
+int PS2Scheduler::suspendThread(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread || thread->id == m_current)
+    {
+        return -1;
+    }
+
+    switch (thread->state)
+    {
+    case ThreadState::Ready:
+        removeReady(*thread);
+        thread->state = ThreadState::Suspended;
+        return 0;
+    case ThreadState::Waiting:
+        thread->state = ThreadState::WaitSuspended;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+int PS2Scheduler::resumeThread(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread)
+    {
+        return -1;
+    }
+
+    switch (thread->state)
+    {
+    case ThreadState::Suspended:
+        thread->state = ThreadState::Ready;
+        enqueueReady(*thread);
+        preemptIfNeeded();
+        return 0;
+    case ThreadState::WaitSuspended:
+        thread->state = ThreadState::Waiting;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+int PS2Scheduler::changePriority(int tid, int priority)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread || priority < 0 || priority >= kPriorityLevels)
+    {
+        return -1;
+    }
+
+    if (thread->state == ThreadState::Ready)
+    {
+        removeReady(*thread);
+        thread->priority = priority;
+        enqueueReady(*thread);
+    }
+    else
+    {
+        thread->priority = priority;
+    }
+
+    preemptIfNeeded();
+    return 0;
+}
+
+int PS2Scheduler::rotateReadyQueue(int priority)
+{
+    if (priority < 0 || priority >= kPriorityLevels)
+    {
+        return -1;
+    }
+
+    Thread *current = lookup(m_current);
+    if (current && current->priority == priority && !inInterrupt())
+    {
+        if (!m_readyQueues[priority].empty())
+        {
+            current->state = ThreadState::Ready;
+            enqueueReady(*current);
+            switchToScheduler();
+        }
+        return 0;
+    }
+
+    auto &queue = m_readyQueues[priority];
+    if (queue.size() > 1)
+    {
+        queue.push_back(queue.front());
+        queue.pop_front();
+    }
+    return 0;
+}
+
+int PS2Scheduler::releaseWait(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread || (thread->state != ThreadState::Waiting && thread->state != ThreadState::WaitSuspended))
+    {
+        return -1;
+    }
+
+    wake(thread->id, thread->waitType, thread->waitId, -1);
+    return 0;
+}
+
+void PS2Scheduler::yield()
+{
+    Thread *current = lookup(m_current);
+    if (!current || inInterrupt())
+    {
+        return;
+    }
+
+    int best = highestReadyPriority();
+    if (best < 0 || best > current->priority)
+    {
+        return;
+    }
+
+    current->state = ThreadState::Ready;
+    enqueueReady(*current);
+    switchToScheduler();
+}
+
+int PS2Scheduler::sleep()
+{
+    Thread *current = lookup(m_current);
+    if (!current)
+    {
+        return -1;
+    }
+
+    if (current->wakeupCount > 0)
+    {
+        current->wakeupCount--;
+        return 0;
+    }
+
+    return wait(WaitType::Sleep, 0);
+}
+
+int PS2Scheduler::wakeup(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread || thread->state == ThreadState::Dormant)
+    {
+        return -1;
+    }
+
+    if (thread->id == m_current)
+    {
+        // Handlers run on the interrupted thread, often right before its SleepThread,
+        // so iWakeupThread on it has to be counted rather than refused
+        if (!inInterrupt())
+        {
+            return -1;
+        }
+        thread->wakeupCount++;
+        return 0;
+    }
+
+    if (!wake(thread->id, WaitType::Sleep, 0, 0))
+    {
+        thread->wakeupCount++;
+    }
+    return 0;
+}
+
+int PS2Scheduler::cancelWakeup(int tid)
+{
+    Thread *thread = lookup(resolveThreadId(tid));
+    if (!thread)
+    {
+        return -1;
+    }
+
+    int count = static_cast<int>(thread->wakeupCount);
+    thread->wakeupCount = 0;
+    return count;
+}
+
+int PS2Scheduler::wait(WaitType type, int waitId)
+{
+    Thread *current = lookup(m_current);
+    if (!current || inInterrupt())
+    {
+        return -1;
+    }
+
+    current->state = ThreadState::Waiting;
+    current->waitType = type;
+    current->waitId = waitId;
+    current->waitResult = 0;
+    switchToScheduler();
+
+    current->waitType = WaitType::None;
+    return current->waitResult;
+}
+
+bool PS2Scheduler::wake(int tid, WaitType type, int waitId, int result)
+{
+    Thread *thread = lookup(tid);
+    if (!thread || thread->waitType != type || thread->waitId != waitId)
+    {
+        return false;
+    }
+
+    if (thread->state == ThreadState::Waiting)
+    {
+        thread->state = ThreadState::Ready;
+        enqueueReady(*thread);
+    }
+    else if (thread->state == ThreadState::WaitSuspended)
+    {
+        thread->state = ThreadState::Suspended;
+    }
+    else
+    {
+        return false;
+    }
+
+    thread->waitType = WaitType::None;
+    thread->waitResult = result;
+    preemptIfNeeded();
+    return true;
+}
+
+const PS2Scheduler::Thread *PS2Scheduler::thread(int tid) const
+{
+    return lookup(resolveThreadId(tid));
+}
+
+uint32_t PS2Scheduler::threadStatus(const Thread &thread) const
+{
+    switch (thread.state)
+    {
+    case ThreadState::Running:
+        return PS2_THS_RUN;
+    case ThreadState::Ready:
+        return PS2_THS_READY;
+    case ThreadState::Waiting:
+        return PS2_THS_WAIT;
+    case ThreadState::Suspended:
+        return PS2_THS_SUSPEND;
+    case ThreadState::WaitSuspended:
+        return PS2_THS_WAITSUSPEND;
+    default:
+        return PS2_THS_DORMANT;
+    }
+}
+
+void PS2Scheduler::beginInterrupt()
+{
+    m_interruptDepth++;
+}
+
+void PS2Scheduler::endInterrupt()
+{
+    if (--m_interruptDepth == 0 && m_preemptPending)
+    {
+        m_preemptPending = false;
+        preemptIfNeeded();
+    }
+}
+
+void PS2Scheduler::post(std::function<void()> event)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_hostMutex);
+        m_hostEvents.push_back(std::move(event));
+    }
+    m_hostWake.notify_one();
+}
+
+void PS2Scheduler::setTimerService(TimerService service)
+{
+    m_timerService = std::move(service);
+}
+
+void PS2Scheduler::setIdleSkip(IdleSkip skip)
+{
+    m_idleSkip = std::move(skip);
+}
+
+void PS2Scheduler::safePoint()
+{
+    if (inInterrupt())
+    {
+        return;
+    }
+
+    if (m_current != 0 && m_stopping.load(std::memory_order_acquire))
+    {
+        // A thread spinning on safe points never returns to the scheduler loop on its
+        // own, so it is unwound like ExitThread once a stop is requested
+        throw ThreadExit{};
+    }
+
+    std::vector<std::function<void()>> events;
+    {
+        std::lock_guard<std::mutex> lock(m_hostMutex);
+        events.swap(m_hostEvents);
+    }
+
+    // Host events and timers behave like interrupts: any thread they wake is switched to afterwards
+    beginInterrupt();
+    for (auto &event : events)
+    {
+        event();
+    }
+    if (m_timerService)
+    {
+        m_nextDeadline = m_timerService();
+    }
+    endInterrupt();
+}
+
+PS2Scheduler::Thread *PS2Scheduler::lookup(int tid) const
+{
+    if (tid <= 0 || tid >= kMaxThreads)
+    {
+        return nullptr;
+    }
+    return m_threads[tid].get();
+}
+
+int PS2Scheduler::allocateThreadId() const
+{
+    for (int id = kMainThreadId + 1; id < kMaxThreads; id++)
+    {
+        if (!m_threads[id])
+        {
+            return id;
+        }
+    }
+    return -1;
+}
+
+void PS2Scheduler::enqueueReady(Thread &thread, bool front)
+{
+    auto &queue = m_readyQueues[thread.priority];
+    if (front)
+    {
+        queue.push_front(thread.id);
+    }
+    else
+    {
+        queue.push_back(thread.id);
+    }
+    m_readyMask[thread.priority >> 6] |= 1ull << (thread.priority & 63);
+}
+
+void PS2Scheduler::removeReady(Thread &thread)
+{
+    auto &queue = m_readyQueues[thread.priority];
+    queue.erase(std::remove(queue.begin(), queue.end(), thread.id), queue.end());
+    if (queue.empty())
+    {
+        m_readyMask[thread.priority >> 6] &= ~(1ull << (thread.priority & 63));
+    }
+}
+
+int PS2Scheduler::highestReadyPriority() const
+{
+    if (m_readyMask[0])
+    {
+        return std::countr_zero(m_readyMask[0]);
+    }
+    if (m_readyMask[1])
+    {
+        return 64 + std::countr_zero(m_readyMask[1]);
+    }
+    return -1;
+}
+
+int PS2Scheduler::popReady()
+{
+    int priority = highestReadyPriority();
+    if (priority < 0)
+    {
+        return 0;
+    }
+
+    auto &queue = m_readyQueues[priority];
+    int id = queue.front();
+    queue.pop_front();
+    if (queue.empty())
+    {
+        m_readyMask[priority >> 6] &= ~(1ull << (priority & 63));
+    }
+    return id;
+}
+
+bool PS2Scheduler::hasLiveThreads() const
+{
+    return std::any_of(m_threads.begin(), m_threads.end(), [](const std::unique_ptr<Thread> &thread)
+                       { return thread && thread->state != ThreadState::Free && thread->state != ThreadState::Dormant; });
+}
+
+void PS2Scheduler::prepareFiber(Thread &thread)
+{
+#ifdef _WIN32
+    thread.fiber = std::make_unique<Fiber>();
+    thread.fiber->handle = CreateFiber(kFiberStackSize, [](LPVOID)
+                                         { fiberMain(); }, nullptr);
+    if (!thread.fiber->handle)
+    {
+        std::cerr << "[Scheduler] CreateFiber failed for thread " << thread.id << std::endl;
+        std::abort();
+    }
+#else
+    if (!thread.fiber)
+    {
+        thread.fiber = std::make_unique<Fiber>();
+    }
+    if (!thread.fiber->stack)
+    {
+        // Left uninitialized so the host only commits the pages the thread touches
+        thread.fiber->stack.reset(new uint8_t[kFiberStackSize]);
+    }
+
+    getcontext(&thread.fiber->context);
+    thread.fiber->context.uc_stack.ss_sp = thread.fiber->stack.get();
+    thread.fiber->context.uc_stack.ss_size = kFiberStackSize;
+    thread.fiber->context.uc_link = nullptr;
+    makecontext(&thread.fiber->context, &PS2Scheduler::fiberMain, 0);
+#endif
+}
+
+void PS2Scheduler::switchToThread(Thread &thread)
+{
+    m_current = thread.id;
+    thread.state = ThreadState::Running;
+    thread.fiber->started = true;
+
+#ifdef _WIN32
+    SwitchToFiber(thread.fiber->handle);
+#else
+    swapcontext(&m_schedulerFiber->context, &thread.fiber->context);
+#endif
+
+    m_current = 0;
+}
+
+void PS2Scheduler::switchToScheduler()
+{
+    Thread &thread = *m_threads[m_current];
+
+#ifdef _WIN32
+    (void)thread;
+    SwitchToFiber(m_schedulerFiber->handle);
+#else
+    swapcontext(&thread.fiber->context, &m_schedulerFiber->context);
+#endif
+
+    if (m_unwinding)
+    {
+        // Resumed only to unwind; fiberMain hands the fiber back once the stack is gone
+        throw ThreadExit{};
+    }
+}
+
+void PS2Scheduler::preemptIfNeeded()
+{
+    Thread *current = lookup(m_current);
+    if (!current)
+    {
+        // Called from the scheduler loop, which picks the best thread next anyway
+        return;
+    }
+
+    if (inInterrupt())
+    {
+        m_preemptPending = true;
+        return;
+    }
+
+    int best = highestReadyPriority();
+    if (best < 0 || best >= current->priority)
+    {
+        return;
+    }
+
+    // A preempted thread keeps its place at the head of its priority level
+    current->state = ThreadState::Ready;
+    enqueueReady(*current, true);
+    switchToScheduler();
+}
+
+void PS2Scheduler::reclaimFinishedThreads()
+{
+    for (int id : m_finishedThreads)
+    {
+        Thread *thread = lookup(id);
+        if (thread && thread->state == ThreadState::Dormant && thread->deleteOnExit)
+        {
+            m_threads[id].reset();
+        }
+    }
+    m_finishedThreads.clear();
+}
+
+void PS2Scheduler::unwindAbandonedFibers()
+{
+    while (!m_abandonedFibers.empty())
+    {
+        std::unique_ptr<Fiber> fiber = std::move(m_abandonedFibers.back());
+        m_abandonedFibers.pop_back();
+
+        m_unwinding = fiber.get();
+#ifdef _WIN32
+        SwitchToFiber(fiber->handle);
+#else
+        swapcontext(&m_schedulerFiber->context, &fiber->context);
+#endif
+        m_unwinding = nullptr;
+    }
+}
+
+void PS2Scheduler::finishUnwind()
+{
+    // The thread may already be restarted or deleted, so only the fiber is touched here
+#ifdef _WIN32
+    SwitchToFiber(m_schedulerFiber->handle);
+#else
+    swapcontext(&m_unwinding->context, &m_schedulerFiber->context);
+#endif
+
+    // An unwound fiber is destroyed, never resumed
+    std::abort();
+}
+
+void PS2Scheduler::finishCurrentThread()
+{
+    Thread &thread = *m_threads[m_current];
+    thread.state = ThreadState::Dormant;
+    thread.waitType = WaitType::None;
+    m_finishedThreads.push_back(thread.id);
+
+    switchToScheduler();
+
+    // A dormant thread is only ever restarted on a fresh fiber
+    std::abort();
+}
+
+void PS2Scheduler::fiberMain()
+{
+    PS2Scheduler *self = t_scheduler;
+    Thread &thread = *self->m_threads[self->m_current];
+
+    std::cout << "[Scheduler] thread " << thread.id << " started at 0x" << std::hex << thread.params.entry
+              << " sp=0x" << GPR_U32(thread.context, 29)
+              << " gp=0x" << GPR_U32(thread.context, 28)
+              << " arg=0x" << thread.arg << std::dec << std::endl;
+
+    try
+    {
+        PS2Runtime::RecompiledFunction func = self->m_runtime->lookupFunction(thread.params.entry);
+        func(self->m_rdram, thread.context, self->m_runtime);
+    }
+    catch (const ThreadExit &)
+    {
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[Scheduler] thread " << thread.id << " exception: " << e.what() << std::endl;
+    }
+
+    if (self->m_unwinding)
+    {
+        self->finishUnwind();
+    }
+
+    std::cout << "[Scheduler] thread " << thread.id << " exited (pc=0x"
+              << std::hex << thread.context->pc << std::dec << ")" << std::endl;
+
+    self->finishCurrentThread();
+}
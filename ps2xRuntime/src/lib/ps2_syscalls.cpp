@@ -9,6 +9,9 @@
 #include <cstdlib>
 #include <cmath>
 #include <vector>
+#include <array>
+#include <deque>
+#include <algorithm>
 #include <unordered_map>
 #include <thread>
 #include <condition_variable>
@@ -20,33 +23,137 @@
 std::unordered_map<int, FILE *> g_fileDescriptors;
 int g_nextFd = 3; // Start after stdin, stdout, stderr
 
-struct ThreadInfo
+constexpr int PS2_MAX_SEMAS = 256; // Matches the EE kernel's semaphore table
+
+// Counts are atomic so signal and poll stay wait-free while nobody is blocked;
+// the waiter queue is only touched from guest threads, which the scheduler serializes.
+struct SemaInfo
 {
-    uint32_t entry = 0;
-    uint32_t stack = 0;
-    uint32_t stackSize = 0;
-    uint32_t gp = 0;
-    uint32_t priority = 0;
+    std::atomic<bool> used{false};
+    std::atomic<int> count{0};
+    std::atomic<int> waiterCount{0};
+    int maxCount = 0;
+    int initCount = 0;
     uint32_t attr = 0;
     uint32_t option = 0;
-    uint32_t arg = 0;
-    bool started = false;
+    std::deque<int> waiters; // Thread ids blocked in WaitSema, oldest first
 };
 
-struct SemaInfo
+static std::array<SemaInfo, PS2_MAX_SEMAS> g_semas; // Indexed by id; id 0 is never handed out
+
+static SemaInfo *lookupSema(int sid)
 {
-    int count = 0;
-    int maxCount = 0;
-    std::mutex m;
-    std::condition_variable cv;
+    if (sid <= 0 || sid >= PS2_MAX_SEMAS || !g_semas[sid].used.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+    return &g_semas[sid];
+}
+
+static int allocateSema()
+{
+    for (int id = 1; id < PS2_MAX_SEMAS; id++)
+    {
+        if (!g_semas[id].used.load(std::memory_order_acquire))
+        {
+            return id;
+        }
+    }
+    return -1;
+}
+
+static bool acquireSemaCount(SemaInfo &sema)
+{
+    int count = sema.count.load(std::memory_order_acquire);
+    while (count > 0)
+    {
+        if (sema.count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void releaseSemaCount(SemaInfo &sema)
+{
+    int count = sema.count.load(std::memory_order_acquire);
+    while (count < sema.maxCount)
+    {
+        if (sema.count.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+}
+
+// EventFlagParam attr and WaitEventFlag mode bits
+constexpr uint32_t PS2_WEF_MULTI = 0x02; // More than one thread may wait at once
+constexpr uint32_t PS2_WEF_OR = 0x01;    // Any requested bit satisfies the wait, instead of all of them
+constexpr uint32_t PS2_WEF_CLEAR = 0x10; // Clear the requested bits when the wait is satisfied
+
+struct EventFlagWaiter
+{
+    int tid = 0;
+    uint32_t bits = 0;
+    uint32_t mode = 0;
+    uint32_t resBitsAddr = 0;
+};
+
+struct EventFlagInfo
+{
+    uint32_t attr = 0;
+    uint32_t option = 0;
+    uint32_t initBits = 0;
+    uint32_t bits = 0;
+    std::deque<EventFlagWaiter> waiters; // In arrival order
 };
 
-static std::unordered_map<int, ThreadInfo> g_threads;
-static int g_nextThreadId = 2; // Reserve 1 for the main thread
-static thread_local int g_currentThreadId = 1;
+static std::unordered_map<int, std::shared_ptr<EventFlagInfo>> g_eventFlags;
+static int g_nextEventFlagId = 1;
 
-static std::unordered_map<int, std::shared_ptr<SemaInfo>> g_semas;
-static int g_nextSemaId = 1;
+static void storeEventFlagBits(uint8_t *rdram, uint32_t resBitsAddr, uint32_t bits)
+{
+    uint32_t *resBits = resBitsAddr ? reinterpret_cast<uint32_t *>(getMemPtr(rdram, resBitsAddr)) : nullptr;
+    if (resBits)
+    {
+        *resBits = bits;
+    }
+}
+
+static bool eventFlagSatisfied(uint32_t current, uint32_t bits, uint32_t mode)
+{
+    return (mode & PS2_WEF_OR) ? (current & bits) != 0 : (current & bits) == bits;
+}
+
+// Drops waiters that are no longer blocked on the flag, such as threads terminated mid-wait
+static void pruneEventFlagWaiters(EventFlagInfo &flag, const PS2Scheduler &scheduler, int eid)
+{
+    auto &waiters = flag.waiters;
+    waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [&scheduler, eid](const EventFlagWaiter &waiter)
+                                 {
+                                     const PS2Scheduler::Thread *thread = scheduler.thread(waiter.tid);
+                                     return !thread || thread->waitType != PS2Scheduler::WaitType::EventFlag ||
+                                            thread->waitId != eid;
+                                 }),
+                  waiters.end());
+}
+
+// Takes the wait without blocking if the flag already satisfies it
+static bool pollEventFlag(EventFlagInfo &flag, uint8_t *rdram, uint32_t bits, uint32_t mode, uint32_t resBitsAddr)
+{
+    if (!eventFlagSatisfied(flag.bits, bits, mode))
+    {
+        return false;
+    }
+
+    storeEventFlagBits(rdram, resBitsAddr, flag.bits);
+    if (mode & PS2_WEF_CLEAR)
+    {
+        flag.bits &= ~bits;
+    }
+    return true;
+}
 extern std::atomic<int> g_activeThreads;
 
 int allocatePs2Fd(FILE *file)
@@ -164,24 +271,32 @@ namespace ps2_syscalls
             return;
         }
 
-        ThreadInfo info{};
-        info.attr = param[0];
-        info.entry = param[1];
-        info.stack = param[2];
-        info.stackSize = param[3];
-        info.gp = param[5];       // Often gp is at offset 20
-        info.priority = param[4]; // Commonly priority/init attr slot
-        info.option = param[6];
+        // ThreadParam: status(0), func(1), stack(2), stack_size(3), gp_reg(4),
+        // initial_priority(5), current_priority(6), attr(7), option(8)
+        PS2Scheduler::ThreadParams params;
+        params.entry = param[1];
+        params.stack = param[2];
+        params.stackSize = param[3];
+        params.gp = param[4];
+        params.priority = param[5];
+        params.attr = param[7];
+        params.option = param[8];
 
-        int id = g_nextThreadId++;
-        g_threads[id] = info;
+        int id = runtime->scheduler().createThread(params);
+        if (id < 0)
+        {
+            std::cerr << "CreateThread error: entry=0x" << std::hex << params.entry << std::dec
+                      << " prio=" << params.priority << " rejected" << std::endl;
+            setReturnS32(ctx, -1);
+            return;
+        }
 
         std::cout << "[CreateThread] id=" << id
-                  << " entry=0x" << std::hex << info.entry
-                  << " stack=0x" << info.stack
-                  << " size=0x" << info.stackSize
-                  << " gp=0x" << info.gp
-                  << " prio=" << std::dec << info.priority << std::endl;
+                  << " entry=0x" << std::hex << params.entry
+                  << " stack=0x" << params.stack
+                  << " size=0x" << params.stackSize
+                  << " gp=0x" << params.gp
+                  << " prio=" << std::dec << params.priority << std::endl;
 
         setReturnS32(ctx, id);
     }
@@ -189,8 +304,7 @@ namespace ps2_syscalls
     void DeleteThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int tid = static_cast<int>(getRegU32(ctx, 4)); // $a0
-        g_threads.erase(tid);
-        setReturnS32(ctx, 0);
+        setReturnS32(ctx, runtime->scheduler().deleteThread(tid) == 0 ? 0 : -1);
     }
 
     void StartThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -198,106 +312,69 @@ namespace ps2_syscalls
         int tid = static_cast<int>(getRegU32(ctx, 4)); // $a0 = thread id
         uint32_t arg = getRegU32(ctx, 5);              // $a1 = user arg
 
-        auto it = g_threads.find(tid);
-        if (it == g_threads.end())
+        PS2Scheduler &scheduler = runtime->scheduler();
+        const PS2Scheduler::Thread *thread = scheduler.thread(tid);
+        if (!thread || tid == PS2Scheduler::kSelfThreadId)
         {
             std::cerr << "StartThread error: unknown thread id " << tid << std::endl;
             setReturnS32(ctx, -1);
             return;
         }
 
-        ThreadInfo &info = it->second;
-        if (info.started)
-        {
-            setReturnS32(ctx, 0);
-            return;
-        }
-
-        info.started = true;
-        info.arg = arg;
-
-        if (!runtime->hasFunction(info.entry))
+        uint32_t entry = thread->params.entry;
+        if (!runtime->hasFunction(entry))
         {
-            std::cerr << "[StartThread] entry 0x" << std::hex << info.entry << std::dec << " is not registered" << std::endl;
+            std::cerr << "[StartThread] entry 0x" << std::hex << entry << std::dec << " is not registered" << std::endl;
             setReturnS32(ctx, -1);
             return;
         }
 
         // TODO check later skip audio threads to avoid runaway recursion/stack overflows.
-        if (info.entry == 0x2f42a0 || info.entry == 0x2f4258)
+        if (entry == 0x2f42a0 || entry == 0x2f4258)
         {
             std::cout << "[StartThread] id=" << tid
-                      << " entry=0x" << std::hex << info.entry << std::dec
+                      << " entry=0x" << std::hex << entry << std::dec
                       << " skipped (audio thread stub)" << std::endl;
             setReturnS32(ctx, 0);
             return;
         }
 
-        // Spawn a host thread to simulate PS2 thread execution.
-        g_activeThreads.fetch_add(1, std::memory_order_relaxed);
-        std::thread([=]() mutable
-                    {
-            R5900Context threadCtxCopy = *ctx; // Copy current CPU state to simulate a new thread context
-            R5900Context *threadCtx = &threadCtxCopy;
-
-            if (info.stack && info.stackSize)
-            {
-                SET_GPR_U32(threadCtx, 29, info.stack + info.stackSize); // SP at top of stack
-            }
-            if (info.gp)
-            {
-                SET_GPR_U32(threadCtx, 28, info.gp);
-            }
-
-            SET_GPR_U32(threadCtx, 4, info.arg);
-            threadCtx->pc = info.entry;
-
-            PS2Runtime::RecompiledFunction func = runtime->lookupFunction(info.entry);
-            g_currentThreadId = tid;
-
-            std::cout << "[StartThread] id=" << tid
-                      << " entry=0x" << std::hex << info.entry
-                      << " sp=0x" << GPR_U32(threadCtx, 29)
-                      << " gp=0x" << GPR_U32(threadCtx, 28)
-                      << " arg=0x" << info.arg << std::dec << std::endl;
-
-            try
-            {
-                func(rdram, threadCtx, runtime);
-            }
-            catch (const std::exception &e)
-            {
-                std::cerr << "[StartThread] id=" << tid << " exception: " << e.what() << std::endl;
-            }
-
-            std::cout << "[StartThread] id=" << tid << " returned (pc=0x"
-                      << std::hex << threadCtx->pc << std::dec << ")" << std::endl;
-
-            g_activeThreads.fetch_sub(1, std::memory_order_relaxed); })
-            .detach();
-
-        // for now report success to the caller.
+        // Set the result first: a higher priority thread runs before StartThread returns
         setReturnS32(ctx, 0);
+        if (scheduler.startThread(tid, arg, *ctx) < 0)
+        {
+            setReturnS32(ctx, -1);
+        }
     }
 
     void ExitThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         std::cout << "PS2 ExitThread: Thread is exiting (PC=0x" << std::hex << ctx->pc << std::dec << ")" << std::endl;
-        setReturnS32(ctx, 0);
+
+        PS2Scheduler &scheduler = runtime->scheduler();
+        if (scheduler.currentThreadId() == 0 || scheduler.inInterrupt())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+        scheduler.exitThread(false);
     }
 
     void ExitDeleteThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        int tid = static_cast<int>(getRegU32(ctx, 4));
-        g_threads.erase(tid);
-        setReturnS32(ctx, 0);
+        PS2Scheduler &scheduler = runtime->scheduler();
+        if (scheduler.currentThreadId() == 0 || scheduler.inInterrupt())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+        scheduler.exitThread(true);
     }
 
     void TerminateThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int tid = static_cast<int>(getRegU32(ctx, 4));
-        g_threads.erase(tid);
-        setReturnS32(ctx, 0);
+        setReturnS32(ctx, runtime->scheduler().terminateThread(tid) == 0 ? tid : -1);
     }
 
     void SuspendThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -309,33 +386,69 @@ namespace ps2_syscalls
             std::cout << "[SuspendThread] tid=" << tid << std::endl;
             ++logCount;
         }
-        setReturnS32(ctx, 0);
+        setReturnS32(ctx, runtime->scheduler().suspendThread(tid) == 0 ? tid : -1);
     }
 
     void ResumeThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int tid = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, tid);
+        if (runtime->scheduler().resumeThread(tid) < 0)
+        {
+            setReturnS32(ctx, -1);
+        }
     }
 
     void GetThreadId(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, g_currentThreadId);
+        setReturnS32(ctx, runtime->scheduler().currentThreadId());
     }
 
     void ReferThreadStatus(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int tid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t statusAddr = getRegU32(ctx, 5);
+
+        PS2Scheduler &scheduler = runtime->scheduler();
+        const PS2Scheduler::Thread *thread = scheduler.thread(tid);
+        if (!thread)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        uint32_t status = scheduler.threadStatus(*thread);
+        uint32_t *out = reinterpret_cast<uint32_t *>(getMemPtr(rdram, statusAddr));
+        if (out)
+        {
+            // ThreadStatus: ThreadParam followed by waitType, waitId and wakeupCount
+            out[0] = status;
+            out[1] = thread->params.entry;
+            out[2] = thread->params.stack;
+            out[3] = thread->params.stackSize;
+            out[4] = thread->params.gp;
+            out[5] = thread->params.priority;
+            out[6] = static_cast<uint32_t>(thread->priority);
+            out[7] = thread->params.attr;
+            out[8] = thread->params.option;
+            out[9] = static_cast<uint32_t>(thread->waitType);
+            out[10] = static_cast<uint32_t>(thread->waitId);
+            out[11] = thread->wakeupCount;
+        }
+        setReturnS32(ctx, static_cast<int32_t>(status));
     }
 
     void SleepThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         static int logCount = 0;
+        PS2Scheduler &scheduler = runtime->scheduler();
         if (logCount < 16)
         {
-            std::cout << "[SleepThread] tid=" << g_currentThreadId << std::endl;
+            std::cout << "[SleepThread] tid=" << scheduler.currentThreadId() << std::endl;
             ++logCount;
         }
-        setReturnS32(ctx, 0);
+        // Blocks in the scheduler, so an idle main loop costs no host CPU
+        setReturnS32(ctx, scheduler.sleep());
     }
 
     void WakeupThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -347,31 +460,40 @@ namespace ps2_syscalls
             std::cout << "[WakeupThread] tid=" << tid << std::endl;
             ++logCount;
         }
-        setReturnS32(ctx, 0);
+        // The woken thread may run before this returns, so set the result first
+        setReturnS32(ctx, tid);
+        if (runtime->scheduler().wakeup(tid) < 0)
+        {
+            setReturnS32(ctx, -1);
+        }
     }
 
     void iWakeupThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        static int logCount = 0;
         int tid = static_cast<int>(getRegU32(ctx, 4));
-        if (logCount < 32)
-        {
-            std::cout << "[iWakeupThread] tid=" << tid << std::endl;
-            ++logCount;
-        }
-        setReturnS32(ctx, 0);
+        setReturnS32(ctx, runtime->scheduler().wakeup(tid) == 0 ? tid : -1);
+    }
+
+    void CancelWakeupThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        int tid = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, runtime->scheduler().cancelWakeup(tid));
+    }
+
+    void iCancelWakeupThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        CancelWakeupThread(rdram, ctx, runtime);
     }
 
     void ChangeThreadPriority(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int tid = static_cast<int>(getRegU32(ctx, 4));
         int newPrio = static_cast<int>(getRegU32(ctx, 5));
-        auto it = g_threads.find(tid);
-        if (it != g_threads.end())
+        setReturnS32(ctx, 0);
+        if (runtime->scheduler().changePriority(tid, newPrio) < 0)
         {
-            it->second.priority = newPrio;
+            setReturnS32(ctx, -1);
         }
-        setReturnS32(ctx, 0);
     }
 
     void RotateThreadReadyQueue(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -383,22 +505,28 @@ namespace ps2_syscalls
             std::cout << "[RotateThreadReadyQueue] prio=" << prio << std::endl;
             ++logCount;
         }
-        if (prio >= 128)
+        if (prio < 0 || prio >= PS2Scheduler::kPriorityLevels)
         {
             setReturnS32(ctx, -1);
             return;
         }
         setReturnS32(ctx, 0);
+        runtime->scheduler().rotateReadyQueue(prio);
     }
 
     void ReleaseWaitThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int tid = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, tid);
+        if (runtime->scheduler().releaseWait(tid) < 0)
+        {
+            setReturnS32(ctx, -1);
+        }
     }
 
     void iReleaseWaitThread(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        ReleaseWaitThread(rdram, ctx, runtime);
     }
 
     void CreateSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -407,11 +535,15 @@ namespace ps2_syscalls
         const uint32_t *param = reinterpret_cast<const uint32_t *>(getConstMemPtr(rdram, paramAddr));
         int init = 0;
         int max = 1;
+        uint32_t attr = 0;
+        uint32_t option = 0;
         if (param)
         {
-            // sceSemaParam layout commonly: attr(0), option(1), initCount(2), maxCount(3)
+            // SemaParam: count(0), max_count(1), init_count(2), wait_threads(3), attr(4), option(5)
+            max = static_cast<int>(param[1]);
             init = static_cast<int>(param[2]);
-            max = static_cast<int>(param[3]);
+            attr = param[4];
+            option = param[5];
         }
         if (max <= 0)
         {
@@ -422,11 +554,24 @@ namespace ps2_syscalls
             init = max;
         }
 
-        int id = g_nextSemaId++;
-        auto info = std::make_shared<SemaInfo>();
-        info->count = init;
-        info->maxCount = max;
-        g_semas.emplace(id, info);
+        int id = allocateSema();
+        if (id < 0)
+        {
+            std::cerr << "CreateSema error: all " << PS2_MAX_SEMAS << " semaphores are in use" << std::endl;
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        SemaInfo &sema = g_semas[id];
+        sema.maxCount = max;
+        sema.initCount = init;
+        sema.attr = attr;
+        sema.option = option;
+        sema.waiters.clear();
+        sema.waiterCount.store(0, std::memory_order_relaxed);
+        sema.count.store(init, std::memory_order_relaxed);
+        sema.used.store(true, std::memory_order_release);
+
         std::cout << "[CreateSema] id=" << id << " init=" << init << " max=" << max << std::endl;
         setReturnS32(ctx, id);
     }
@@ -434,25 +579,57 @@ namespace ps2_syscalls
     void DeleteSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int sid = static_cast<int>(getRegU32(ctx, 4));
-        g_semas.erase(sid);
-        setReturnS32(ctx, 0);
+        SemaInfo *sema = lookupSema(sid);
+        if (!sema)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        sema->used.store(false, std::memory_order_release);
+        setReturnS32(ctx, sid);
+
+        // Waiters see the deletion as a failed WaitSema
+        std::deque<int> waiters;
+        waiters.swap(sema->waiters);
+        sema->waiterCount.store(0, std::memory_order_release);
+        for (int tid : waiters)
+        {
+            runtime->scheduler().wake(tid, PS2Scheduler::WaitType::Sema, sid, -1);
+        }
     }
 
     void SignalSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int sid = static_cast<int>(getRegU32(ctx, 4));
-        auto it = g_semas.find(sid);
-        if (it != g_semas.end())
+        SemaInfo *sema = lookupSema(sid);
+        if (!sema)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        setReturnS32(ctx, sid);
+        if (sema->waiterCount.load(std::memory_order_acquire) == 0)
+        {
+            releaseSemaCount(*sema);
+            return;
+        }
+
+        // Hand the count straight to the oldest waiter; skip ones that were released or terminated
+        PS2Scheduler &scheduler = runtime->scheduler();
+        while (!sema->waiters.empty())
         {
-            auto sema = it->second;
-            std::lock_guard<std::mutex> lock(sema->m);
-            if (sema->count < sema->maxCount)
+            int tid = sema->waiters.front();
+            sema->waiters.pop_front();
+            sema->waiterCount.fetch_sub(1, std::memory_order_release);
+            if (scheduler.wake(tid, PS2Scheduler::WaitType::Sema, sid, sid))
             {
-                sema->count++;
+                return;
             }
-            sema->cv.notify_one();
         }
-        setReturnS32(ctx, 0);
+
+        releaseSemaCount(*sema);
     }
 
     void iSignalSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -463,52 +640,47 @@ namespace ps2_syscalls
     void WaitSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int sid = static_cast<int>(getRegU32(ctx, 4));
-        auto it = g_semas.find(sid);
-        if (it != g_semas.end())
+        SemaInfo *sema = lookupSema(sid);
+        if (!sema)
         {
-            auto sema = it->second;
-            std::unique_lock<std::mutex> lock(sema->m);
-            static int globalLog = 0;
-            if (globalLog < 5)
-            {
-                std::cout << "[WaitSema] sid=" << sid << " count=" << sema->count << std::endl;
-                ++globalLog;
-            }
-            if (sema->count == 0)
-            {
-                static thread_local int logCount = 0;
-                if (logCount < 3)
-                {
-                    std::cout << "[WaitSema] sid=" << sid << " blocking until signaled" << std::endl;
-                    ++logCount;
-                }
-                sema->cv.wait(lock, [&]()
-                              { return sema->count > 0; });
-            }
-            if (sema->count > 0)
-            {
-                sema->count--;
-            }
+            setReturnS32(ctx, -1);
+            return;
         }
-        setReturnS32(ctx, 0);
+
+        if (acquireSemaCount(*sema))
+        {
+            setReturnS32(ctx, sid);
+            return;
+        }
+
+        static int logCount = 0;
+        if (logCount < 3)
+        {
+            std::cout << "[WaitSema] sid=" << sid << " blocking until signaled" << std::endl;
+            ++logCount;
+        }
+
+        PS2Scheduler &scheduler = runtime->scheduler();
+        int tid = scheduler.currentThreadId();
+        sema->waiters.push_back(tid);
+        sema->waiterCount.fetch_add(1, std::memory_order_release);
+        int result = scheduler.wait(PS2Scheduler::WaitType::Sema, sid);
+        if (result < 0)
+        {
+            // Released, deleted, or called where blocking is impossible
+            auto &waiters = sema->waiters;
+            auto removed = std::remove(waiters.begin(), waiters.end(), tid);
+            sema->waiterCount.fetch_sub(static_cast<int>(waiters.end() - removed), std::memory_order_release);
+            waiters.erase(removed, waiters.end());
+        }
+        setReturnS32(ctx, result < 0 ? -1 : sid);
     }
 
     void PollSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int sid = static_cast<int>(getRegU32(ctx, 4));
-        auto it = g_semas.find(sid);
-        if (it != g_semas.end())
-        {
-            auto sema = it->second;
-            std::lock_guard<std::mutex> lock(sema->m);
-            if (sema->count > 0)
-            {
-                sema->count--;
-                setReturnS32(ctx, 0);
-                return;
-            }
-        }
-        setReturnS32(ctx, 0);
+        SemaInfo *sema = lookupSema(sid);
+        setReturnS32(ctx, sema && acquireSemaCount(*sema) ? sid : -1);
     }
 
     void iPollSema(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -518,7 +690,25 @@ namespace ps2_syscalls
 
     void ReferSemaStatus(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int sid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t statusAddr = getRegU32(ctx, 5);
+        SemaInfo *sema = lookupSema(sid);
+        if (!sema)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        if (uint32_t *out = reinterpret_cast<uint32_t *>(getMemPtr(rdram, statusAddr)))
+        {
+            out[0] = static_cast<uint32_t>(sema->count.load(std::memory_order_acquire));
+            out[1] = static_cast<uint32_t>(sema->maxCount);
+            out[2] = static_cast<uint32_t>(sema->initCount);
+            out[3] = static_cast<uint32_t>(sema->waiterCount.load(std::memory_order_acquire));
+            out[4] = sema->attr;
+            out[5] = sema->option;
+        }
+        setReturnS32(ctx, sid);
     }
 
     void iReferSemaStatus(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -528,85 +718,236 @@ namespace ps2_syscalls
 
     void CreateEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        uint32_t paramAddr = getRegU32(ctx, 4); // $a0
+        const uint32_t *param = reinterpret_cast<const uint32_t *>(getConstMemPtr(rdram, paramAddr));
+        if (!param)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        // EventFlagParam: attr(0), option(1), initBits(2)
+        auto info = std::make_shared<EventFlagInfo>();
+        info->attr = param[0];
+        info->option = param[1];
+        info->initBits = param[2];
+        info->bits = param[2];
+
+        int id = g_nextEventFlagId++;
+        g_eventFlags.emplace(id, info);
+        std::cout << "[CreateEventFlag] id=" << id << " attr=0x" << std::hex << info->attr
+                  << " init=0x" << info->initBits << std::dec << std::endl;
+        setReturnS32(ctx, id);
     }
 
     void DeleteEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        int eid = static_cast<int>(getRegU32(ctx, 4));
+        auto it = g_eventFlags.find(eid);
+        if (it == g_eventFlags.end())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        auto flag = it->second;
+        g_eventFlags.erase(it);
+        setReturnS32(ctx, eid);
+
+        std::deque<EventFlagWaiter> waiters;
+        waiters.swap(flag->waiters);
+        for (const EventFlagWaiter &waiter : waiters)
+        {
+            runtime->scheduler().wake(waiter.tid, PS2Scheduler::WaitType::EventFlag, eid, -1);
+        }
     }
 
     void SetEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        int eid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t bits = getRegU32(ctx, 5);
+        auto it = g_eventFlags.find(eid);
+        if (it == g_eventFlags.end())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        auto flag = it->second;
+        flag->bits |= bits;
+        setReturnS32(ctx, eid);
+
+        // Settle the flag before waking anyone, since a woken thread may run right away
+        PS2Scheduler &scheduler = runtime->scheduler();
+        pruneEventFlagWaiters(*flag, scheduler, eid);
+        std::vector<int> woken;
+        for (auto waiter = flag->waiters.begin(); waiter != flag->waiters.end();)
+        {
+            if (!eventFlagSatisfied(flag->bits, waiter->bits, waiter->mode))
+            {
+                ++waiter;
+                continue;
+            }
+
+            storeEventFlagBits(rdram, waiter->resBitsAddr, flag->bits);
+            if (waiter->mode & PS2_WEF_CLEAR)
+            {
+                flag->bits &= ~waiter->bits;
+            }
+            woken.push_back(waiter->tid);
+            waiter = flag->waiters.erase(waiter);
+        }
+
+        for (int tid : woken)
+        {
+            scheduler.wake(tid, PS2Scheduler::WaitType::EventFlag, eid, 0);
+        }
     }
 
     void iSetEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        SetEventFlag(rdram, ctx, runtime);
     }
 
     void ClearEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        int eid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t bits = getRegU32(ctx, 5);
+        auto it = g_eventFlags.find(eid);
+        if (it == g_eventFlags.end())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        // Bits that are zero in the pattern are cleared
+        it->second->bits &= bits;
+        setReturnS32(ctx, eid);
     }
 
     void iClearEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        ClearEventFlag(rdram, ctx, runtime);
     }
 
     void WaitEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        int eid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t bits = getRegU32(ctx, 5);
+        uint32_t mode = getRegU32(ctx, 6);
+        uint32_t resBitsAddr = getRegU32(ctx, 7);
+
+        auto it = g_eventFlags.find(eid);
+        if (it == g_eventFlags.end() || bits == 0)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        auto flag = it->second;
+        if (pollEventFlag(*flag, rdram, bits, mode, resBitsAddr))
+        {
+            setReturnS32(ctx, 0);
+            return;
+        }
+
+        // A waiter that was terminated or deleted must not keep a single-waiter flag busy
+        PS2Scheduler &scheduler = runtime->scheduler();
+        pruneEventFlagWaiters(*flag, scheduler, eid);
+        if (!(flag->attr & PS2_WEF_MULTI) && !flag->waiters.empty())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        int tid = scheduler.currentThreadId();
+        flag->waiters.push_back({tid, bits, mode, resBitsAddr});
+        int result = scheduler.wait(PS2Scheduler::WaitType::EventFlag, eid);
+        if (result < 0)
+        {
+            // Released, deleted, or called where blocking is impossible
+            auto &waiters = flag->waiters;
+            waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [tid](const EventFlagWaiter &waiter)
+                                         { return waiter.tid == tid; }),
+                          waiters.end());
+        }
+        setReturnS32(ctx, result < 0 ? -1 : 0);
     }
 
     void PollEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        int eid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t bits = getRegU32(ctx, 5);
+        uint32_t mode = getRegU32(ctx, 6);
+        uint32_t resBitsAddr = getRegU32(ctx, 7);
+
+        auto it = g_eventFlags.find(eid);
+        if (it == g_eventFlags.end() || bits == 0)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        setReturnS32(ctx, pollEventFlag(*it->second, rdram, bits, mode, resBitsAddr) ? 0 : -1);
     }
 
     void iPollEventFlag(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        PollEventFlag(rdram, ctx, runtime);
     }
 
     void ReferEventFlagStatus(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        int eid = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t statusAddr = getRegU32(ctx, 5);
+        auto it = g_eventFlags.find(eid);
+        if (it == g_eventFlags.end())
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        EventFlagInfo &flag = *it->second;
+        pruneEventFlagWaiters(flag, runtime->scheduler(), eid);
+        if (uint32_t *out = reinterpret_cast<uint32_t *>(getMemPtr(rdram, statusAddr)))
+        {
+            // EventFlagStatus: attr(0), option(1), initBits(2), currBits(3), numThreads(4)
+            out[0] = flag.attr;
+            out[1] = flag.option;
+            out[2] = flag.initBits;
+            out[3] = flag.bits;
+            out[4] = static_cast<uint32_t>(flag.waiters.size());
+        }
+        setReturnS32(ctx, eid);
     }
 
     void iReferEventFlagStatus(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO
+        ReferEventFlagStatus(rdram, ctx, runtime);
     }
 
-    // According to GPT the real PS2 uses a timer interrupt to invoke a callback. For now, fire  the callback immediately
     void SetAlarm(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        uint32_t usec = getRegU32(ctx, 4);
+        uint16_t ticks = static_cast<uint16_t>(getRegU32(ctx, 4)); // HSYNC periods
         uint32_t handler = getRegU32(ctx, 5);
         uint32_t arg = getRegU32(ctx, 6);
 
         static int logCount = 0;
         if (logCount < 5)
         {
-            std::cout << "[SetAlarm] usec=" << usec
+            std::cout << "[SetAlarm] ticks=" << ticks
                       << " handler=0x" << std::hex << handler
                       << " arg=0x" << arg << std::dec << std::endl;
             ++logCount;
         }
 
-        // If the handler looks like a semaphore id, just kick it now.
-        if (arg)
+        // The handler runs with the gp of the code that armed it
+        int id = runtime->alarms().add(runtime->clock().hsyncCount(), ticks, handler, arg, getRegU32(ctx, 28));
+        if (id < 0)
         {
-            R5900Context localCtx = *ctx;
-            R5900Context *ctxPtr = &localCtx;
-            SET_GPR_U32(ctxPtr, 4, arg);
-            SignalSema(rdram, ctxPtr, runtime);
+            std::cerr << "SetAlarm error: all " << PS2AlarmService::kMaxAlarms << " alarms are in use" << std::endl;
         }
-
-        setReturnS32(ctx, 0);
+        setReturnS32(ctx, id);
     }
 
     void iSetAlarm(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -616,7 +957,8 @@ namespace ps2_syscalls
 
     void CancelAlarm(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int id = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, runtime->alarms().cancel(id) ? 0 : -1);
     }
 
     void iCancelAlarm(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -624,24 +966,91 @@ namespace ps2_syscalls
         CancelAlarm(rdram, ctx, runtime);
     }
 
+    void AddIntcHandler(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        int cause = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t handler = getRegU32(ctx, 5);
+        bool atHead = getRegU32(ctx, 6) != 0;
+        uint32_t arg = getRegU32(ctx, 7);
+        setReturnS32(ctx, runtime->memory().interrupts().addIntcHandler(cause, handler, atHead, arg, getRegU32(ctx, 28)));
+    }
+
+    void AddIntcHandler2(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        AddIntcHandler(rdram, ctx, runtime);
+    }
+
+    void RemoveIntcHandler(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        int cause = static_cast<int>(getRegU32(ctx, 4));
+        int id = static_cast<int>(getRegU32(ctx, 5));
+        setReturnS32(ctx, runtime->memory().interrupts().removeIntcHandler(cause, id) ? 0 : -1);
+    }
+
+    void AddDmacHandler(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        int channel = static_cast<int>(getRegU32(ctx, 4));
+        uint32_t handler = getRegU32(ctx, 5);
+        bool atHead = getRegU32(ctx, 6) != 0;
+        uint32_t arg = getRegU32(ctx, 7);
+        setReturnS32(ctx, runtime->memory().interrupts().addDmacHandler(channel, handler, atHead, arg, getRegU32(ctx, 28)));
+    }
+
+    void AddDmacHandler2(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        AddDmacHandler(rdram, ctx, runtime);
+    }
+
+    void RemoveDmacHandler(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        int channel = static_cast<int>(getRegU32(ctx, 4));
+        int id = static_cast<int>(getRegU32(ctx, 5));
+        setReturnS32(ctx, runtime->memory().interrupts().removeDmacHandler(channel, id) ? 0 : -1);
+    }
+
+    // The enable/disable calls return 1 when they changed the mask and 0 when it was already set that way
     void EnableIntc(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int cause = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, runtime->memory().interrupts().setIntcEnabled(cause, true) ? 1 : 0);
+    }
+
+    void iEnableIntc(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        EnableIntc(rdram, ctx, runtime);
     }
 
     void DisableIntc(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int cause = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, runtime->memory().interrupts().setIntcEnabled(cause, false) ? 1 : 0);
+    }
+
+    void iDisableIntc(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        DisableIntc(rdram, ctx, runtime);
     }
 
     void EnableDmac(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int channel = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, runtime->memory().interrupts().setDmacEnabled(channel, true) ? 1 : 0);
+    }
+
+    void iEnableDmac(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        EnableDmac(rdram, ctx, runtime);
     }
 
     void DisableDmac(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        setReturnS32(ctx, 0);
+        int channel = static_cast<int>(getRegU32(ctx, 4));
+        setReturnS32(ctx, runtime->memory().interrupts().setDmacEnabled(channel, false) ? 1 : 0);
+    }
+
+    void iDisableDmac(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        DisableDmac(rdram, ctx, runtime);
     }
 
     void SifStopModule(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -1179,30 +1588,26 @@ namespace ps2_syscalls
     void GsSetCrt(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         int interlaced = getRegU32(ctx, 4); // $a0 - 0=non-interlaced, 1=interlaced
-        int videoMode = getRegU32(ctx, 5);  // $a1 - 0=NTSC, 1=PAL, 2=VESA, 3=HiVision
+        int videoMode = getRegU32(ctx, 5);  // $a1 - 2=NTSC, 3=PAL, 0x1A+=VESA, 0x50+=DTV
         int frameMode = getRegU32(ctx, 6);  // $a2 - 0=field, 1=frame
 
         std::cout << "PS2 GsSetCrt: interlaced=" << interlaced
                   << ", videoMode=" << videoMode
                   << ", frameMode=" << frameMode << std::endl;
+
+        // Only PAL changes the field rate; everything else keeps the NTSC timing
+        runtime->setVideoMode(videoMode == 3 ? PS2Clock::VideoMode::PAL : PS2Clock::VideoMode::NTSC);
     }
 
     void GsGetIMR(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // TODO return IMR value from the Gs hardware this is just a stub.
-        // The IMR (Interrupt Mask Register) is a 64-bit register that controls which interrupts are enabled.
-        uint64_t imr = 0x0000000000000000ULL;
-
-        std::cout << "PS2 GsGetIMR: Returning IMR=0x" << std::hex << imr << std::dec << std::endl;
-
-        setReturnU64(ctx, imr); // Return in $v0/$v1
+        setReturnU64(ctx, runtime->memory().gs().imr); // Return in $v0/$v1
     }
 
     void GsPutIMR(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         uint64_t imr = getRegU32(ctx, 4) | ((uint64_t)getRegU32(ctx, 5) << 32); // $a0 = lower 32 bits, $a1 = upper 32 bits
-        std::cout << "PS2 GsPutIMR: Setting IMR=0x" << std::hex << imr << std::dec << std::endl;
-        // Do nothing for now.
+        runtime->memory().gs().imr = imr;
     }
 
     void GsSetVideoMode(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -0,0 +1,245 @@
+#include "ps2_timers.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr uint32_t REG_COUNT = 0x00;
+    constexpr uint32_t REG_MODE = 0x10;
+    constexpr uint32_t REG_COMP = 0x20;
+    constexpr uint32_t REG_HOLD = 0x30; // T0 and T1 only
+
+    constexpr uint64_t kCounterRange = 0x10000;
+}
+
+PS2Timers::PS2Timers()
+{
+    reset();
+}
+
+void PS2Timers::reset()
+{
+    m_timers.fill(Timer{});
+    m_pendingInterrupts = 0;
+}
+
+bool PS2Timers::isTimerRegister(uint32_t address)
+{
+    if (address < kBase || address >= kBase + kNumTimers * kStride)
+    {
+        return false;
+    }
+
+    uint32_t offset = (address - kBase) % kStride;
+    int index = static_cast<int>((address - kBase) / kStride);
+    return offset == REG_COUNT || offset == REG_MODE || offset == REG_COMP || (offset == REG_HOLD && index < 2);
+}
+
+uint32_t PS2Timers::read(uint32_t address)
+{
+    int index = static_cast<int>((address - kBase) / kStride);
+    sync(index);
+    const Timer &timer = m_timers[index];
+
+    switch ((address - kBase) % kStride)
+    {
+    case REG_COUNT:
+        return timer.count;
+    case REG_MODE:
+        return timer.mode;
+    case REG_COMP:
+        return timer.comp;
+    case REG_HOLD:
+        return timer.hold;
+    default:
+        return 0;
+    }
+}
+
+void PS2Timers::write(uint32_t address, uint32_t value)
+{
+    int index = static_cast<int>((address - kBase) / kStride);
+    sync(index);
+    Timer &timer = m_timers[index];
+
+    switch ((address - kBase) % kStride)
+    {
+    case REG_COUNT:
+        timer.count = value & 0xFFFF;
+        break;
+    case REG_MODE:
+    {
+        uint32_t flags = timer.mode & (MODE_EQUF | MODE_OVFF) & ~value;
+        timer.mode = (value & 0x3FF) | flags;
+        // A new clock source counts in different units, so restart the reference point
+        timer.synced = sourceTicks(timer.mode);
+        break;
+    }
+    case REG_COMP:
+        timer.comp = value & 0xFFFF;
+        break;
+    case REG_HOLD:
+        timer.hold = value & 0xFFFF;
+        break;
+    default:
+        break;
+    }
+}
+
+uint64_t PS2Timers::sourceTicks(uint32_t mode) const
+{
+    if (!m_clock)
+    {
+        return 0;
+    }
+
+    switch (mode & MODE_CLKS)
+    {
+    case 0:
+        return m_clock->busCycles();
+    case 1:
+        return m_clock->busCycles() / 16;
+    case 2:
+        return m_clock->busCycles() / 256;
+    default:
+        return m_clock->hsyncCount();
+    }
+}
+
+void PS2Timers::sync(int index)
+{
+    Timer &timer = m_timers[index];
+    uint64_t now = sourceTicks(timer.mode);
+    uint64_t elapsed = now - timer.synced;
+    timer.synced = now;
+
+    // Gate modes would need VBLANK/HBLANK edges between accesses; a gated timer counts freely
+    if (!(timer.mode & MODE_CUE))
+    {
+        return;
+    }
+
+    uint32_t before = timer.mode;
+    advance(timer, elapsed);
+
+    // The interrupt fires on the flag's rising edge, as long as the matching enable bit is set
+    uint32_t raised = timer.mode & ~before;
+    if (((raised & MODE_EQUF) && (timer.mode & MODE_CMPE)) || ((raised & MODE_OVFF) && (timer.mode & MODE_OVFE)))
+    {
+        m_pendingInterrupts |= 1u << index;
+    }
+}
+
+uint32_t PS2Timers::pollInterrupts()
+{
+    for (int i = 0; i < kNumTimers; i++)
+    {
+        if (m_timers[i].mode & (MODE_CMPE | MODE_OVFE))
+        {
+            sync(i);
+        }
+    }
+
+    uint32_t pending = m_pendingInterrupts;
+    m_pendingInterrupts = 0;
+    return pending;
+}
+
+std::optional<PS2Clock::HostClock::time_point> PS2Timers::nextInterruptTime() const
+{
+    if (!m_clock)
+    {
+        return std::nullopt;
+    }
+
+    std::optional<PS2Clock::HostClock::time_point> earliest;
+    for (const Timer &timer : m_timers)
+    {
+        if (!(timer.mode & MODE_CUE))
+        {
+            continue;
+        }
+
+        // Ticks until each flag that would still raise an interrupt gets set
+        std::optional<uint64_t> ticks;
+        if ((timer.mode & MODE_CMPE) && !(timer.mode & MODE_EQUF))
+        {
+            ticks = timer.comp > timer.count ? timer.comp - timer.count : timer.comp + kCounterRange - timer.count;
+        }
+        if ((timer.mode & MODE_OVFE) && !(timer.mode & MODE_OVFF))
+        {
+            uint64_t overflow = kCounterRange - timer.count;
+            ticks = ticks ? std::min(*ticks, overflow) : overflow;
+        }
+        if (!ticks)
+        {
+            continue;
+        }
+
+        uint64_t tick = timer.synced + *ticks;
+        PS2Clock::HostClock::time_point when;
+        switch (timer.mode & MODE_CLKS)
+        {
+        case 0:
+            when = m_clock->timeOfCycles(PS2Clock::kBusClockHz, tick);
+            break;
+        case 1:
+            when = m_clock->timeOfCycles(PS2Clock::kBusClockHz, tick * 16);
+            break;
+        case 2:
+            when = m_clock->timeOfCycles(PS2Clock::kBusClockHz, tick * 256);
+            break;
+        default:
+            when = m_clock->timeOfHsync(tick);
+            break;
+        }
+
+        if (!earliest || when < *earliest)
+        {
+            earliest = when;
+        }
+    }
+    return earliest;
+}
+
+void PS2Timers::advance(Timer &timer, uint64_t ticks)
+{
+    if (ticks == 0)
+    {
+        return;
+    }
+
+    const uint64_t count = timer.count;
+    const uint64_t comp = timer.comp;
+    const uint64_t total = count + ticks;
+    // Counter value (unwrapped) at which it next equals COMP
+    const uint64_t match = comp > count ? comp : comp + kCounterRange;
+
+    if ((timer.mode & MODE_ZRET) && comp != 0)
+    {
+        if (count > comp && total >= kCounterRange)
+        {
+            timer.mode |= MODE_OVFF;
+        }
+        if (total >= match)
+        {
+            // From the first match on, the counter cycles through 0..COMP-1
+            timer.mode |= MODE_EQUF;
+            timer.count = static_cast<uint32_t>((total - match) % comp);
+        }
+        else
+        {
+            timer.count = static_cast<uint32_t>(total % kCounterRange);
+        }
+        return;
+    }
+
+    if (total >= match)
+    {
+        timer.mode |= MODE_EQUF;
+    }
+    if (total >= kCounterRange)
+    {
+        timer.mode |= MODE_OVFF;
+    }
+    timer.count = static_cast<uint32_t>(total % kCounterRange);
+}
@@ -0,0 +1,672 @@
+#include "ps2_vif.h"
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+    constexpr uint32_t kVif0Base = 0x10003800;
+    constexpr uint32_t kVif1Base = 0x10003C00;
+    constexpr uint32_t kIntcVif0 = 4; // INTC cause of VIF0, VIF1 follows
+
+    // Register offsets from the unit's base
+    enum RegisterOffset : uint32_t
+    {
+        REG_STAT = 0x00,
+        REG_FBRST = 0x10,
+        REG_ERR = 0x20,
+        REG_MARK = 0x30,
+        REG_CYCLE = 0x40,
+        REG_MODE = 0x50,
+        REG_NUM = 0x60,
+        REG_MASK = 0x70,
+        REG_CODE = 0x80,
+        REG_ITOPS = 0x90,
+        REG_BASE = 0xA0,
+        REG_OFST = 0xB0,
+        REG_TOPS = 0xC0,
+        REG_ITOP = 0xD0,
+        REG_TOP = 0xE0,
+        REG_R0 = 0x100,
+        REG_C0 = 0x140,
+        REG_END = 0x180,
+    };
+
+    enum Command : uint32_t
+    {
+        CMD_NOP = 0x00,
+        CMD_STCYCL = 0x01,
+        CMD_OFFSET = 0x02,
+        CMD_BASE = 0x03,
+        CMD_ITOP = 0x04,
+        CMD_STMOD = 0x05,
+        CMD_MSKPATH3 = 0x06,
+        CMD_MARK = 0x07,
+        CMD_FLUSHE = 0x10,
+        CMD_FLUSH = 0x11,
+        CMD_FLUSHA = 0x13,
+        CMD_MSCAL = 0x14,
+        CMD_MSCALF = 0x15,
+        CMD_MSCNT = 0x17,
+        CMD_STMASK = 0x20,
+        CMD_STROW = 0x30,
+        CMD_STCOL = 0x31,
+        CMD_MPG = 0x4A,
+        CMD_DIRECT = 0x50,
+        CMD_DIRECTHL = 0x51,
+        CMD_UNPACK = 0x60, // 0x60-0x7F: bit 4 masks, bits 2-3 VN, bits 0-1 VL
+    };
+
+    inline uint32_t load32(const uint8_t *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint16_t load16(const uint8_t *p)
+    {
+        uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // Bytes of packed data behind one unpacked qword. VL 3 only exists as V4-5, one halfword.
+    constexpr uint32_t unpackStride(uint32_t vn, uint32_t vl)
+    {
+        return vl == 3 ? 2 : (vn + 1) * (4u >> vl);
+    }
+
+    // Loads exactly the bytes of one element group into the low lanes, so the last
+    // group of a command never reads past its data
+    template <uint32_t Bytes>
+    inline __m128i loadGroup(const uint8_t *p)
+    {
+        if constexpr (Bytes == 16)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        }
+        else if constexpr (Bytes == 12)
+        {
+            return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)),
+                                      _mm_cvtsi32_si128(static_cast<int>(load32(p + 8))));
+        }
+        else if constexpr (Bytes == 8)
+        {
+            return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+        }
+        else if constexpr (Bytes == 6)
+        {
+            return _mm_insert_epi16(_mm_cvtsi32_si128(static_cast<int>(load32(p))), load16(p + 4), 2);
+        }
+        else if constexpr (Bytes == 4)
+        {
+            return _mm_cvtsi32_si128(static_cast<int>(load32(p)));
+        }
+        else if constexpr (Bytes == 3)
+        {
+            return _mm_cvtsi32_si128(p[0] | (p[1] << 8) | (p[2] << 16));
+        }
+        else if constexpr (Bytes == 2)
+        {
+            return _mm_cvtsi32_si128(load16(p));
+        }
+        else
+        {
+            return _mm_cvtsi32_si128(p[0]);
+        }
+    }
+
+    // One element group widened to four 32-bit fields. V1 repeats X, V2 repeats XY,
+    // V3 leaves W zero.
+    template <uint32_t VN, uint32_t VL, bool Unsigned>
+    inline __m128i decode(const uint8_t *p)
+    {
+        if constexpr (VL == 3)
+        {
+            const uint32_t v = load16(p);
+            return _mm_setr_epi32((v & 0x1F) << 3, ((v >> 5) & 0x1F) << 3, ((v >> 10) & 0x1F) << 3, ((v >> 15) & 1) << 7);
+        }
+        else
+        {
+            __m128i v = loadGroup<unpackStride(VN, VL)>(p);
+            if constexpr (VL == 1)
+            {
+                v = _mm_unpacklo_epi16(v, v);
+                v = Unsigned ? _mm_srli_epi32(v, 16) : _mm_srai_epi32(v, 16);
+            }
+            else if constexpr (VL == 2)
+            {
+                v = _mm_unpacklo_epi8(v, v);
+                v = _mm_unpacklo_epi16(v, v);
+                v = Unsigned ? _mm_srli_epi32(v, 24) : _mm_srai_epi32(v, 24);
+            }
+
+            if constexpr (VN == 0)
+            {
+                v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 0, 0, 0));
+            }
+            else if constexpr (VN == 1)
+            {
+                v = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 1, 0));
+            }
+            return v;
+        }
+    }
+
+    // Writes `num` qwords following the CL/WL write cycle. Masked kernels pick each
+    // field from the data, the row, the column or the old contents as MASK says for
+    // the cycle's row; Mode 1 adds the row to the data, Mode 2 also keeps the sum as
+    // the new row.
+    template <uint32_t VN, uint32_t VL, bool Unsigned, bool Masked, uint32_t Mode>
+    void unpackKernel(PS2Vif::UnpackState &s, const uint8_t *src, uint32_t num)
+    {
+        constexpr uint32_t kStride = unpackStride(VN, VL);
+        const bool filling = s.cl < s.wl;
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.row));
+
+        __m128i useData[4];
+        __m128i useRow[4];
+        __m128i useCol[4];
+        __m128i keep[4];
+        bool anyKeep = false;
+        if constexpr (Masked)
+        {
+            for (uint32_t r = 0; r < 4; r++)
+            {
+                alignas(16) int32_t lanes[4][4];
+                for (uint32_t f = 0; f < 4; f++)
+                {
+                    const uint32_t m = (s.mask >> ((r * 4 + f) * 2)) & 3;
+                    for (uint32_t k = 0; k < 4; k++)
+                    {
+                        lanes[k][f] = m == k ? -1 : 0;
+                    }
+                    anyKeep |= m == 3;
+                }
+                useData[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes[0]));
+                useRow[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes[1]));
+                useCol[r] = _mm_and_si128(_mm_load_si128(reinterpret_cast<const __m128i *>(lanes[2])),
+                                          _mm_set1_epi32(static_cast<int>(s.col[r])));
+                keep[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes[3]));
+            }
+        }
+
+        for (uint32_t i = 0; i < num; i++)
+        {
+            __m128i v = _mm_setzero_si128();
+            if (!filling || s.cycle < s.cl)
+            {
+                v = decode<VN, VL, Unsigned>(src);
+                src += kStride;
+            }
+
+            const uint32_t r = std::min<uint32_t>(s.cycle, 3);
+            if constexpr (Mode == 1)
+            {
+                v = _mm_add_epi32(v, row);
+            }
+            else if constexpr (Mode == 2)
+            {
+                v = _mm_add_epi32(v, row);
+                row = Masked ? _mm_or_si128(_mm_and_si128(useData[r], v), _mm_andnot_si128(useData[r], row)) : v;
+            }
+
+            __m128i *dst = reinterpret_cast<__m128i *>(s.memory + (s.address & s.addressMask) * 16);
+            if constexpr (Masked)
+            {
+                v = _mm_or_si128(_mm_or_si128(_mm_and_si128(useData[r], v), _mm_and_si128(useRow[r], row)), useCol[r]);
+                if (anyKeep)
+                {
+                    v = _mm_or_si128(v, _mm_and_si128(keep[r], _mm_loadu_si128(dst)));
+                }
+            }
+            _mm_storeu_si128(dst, v);
+
+            s.address++;
+            if (++s.cycle == s.wl)
+            {
+                s.cycle = 0;
+                if (!filling)
+                {
+                    s.address += s.cl - s.wl;
+                }
+            }
+        }
+
+        if constexpr (Mode == 2)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(s.row), row);
+        }
+    }
+
+    using UnpackKernel = void (*)(PS2Vif::UnpackState &, const uint8_t *, uint32_t);
+
+    // Table index: bits 0-3 the UNPACK VN/VL, bit 4 USN, bit 5 the mask flag, bits 6-7 STMOD
+    template <uint32_t Index>
+    constexpr UnpackKernel kernelFor()
+    {
+        constexpr uint32_t vn = (Index >> 2) & 3;
+        constexpr uint32_t vl = Index & 3;
+        constexpr uint32_t mode = (Index >> 6) & 3;
+        if constexpr (vl == 3 && vn != 3)
+        {
+            return nullptr; // V1-5, V2-5 and V3-5 do not exist
+        }
+        else
+        {
+            return &unpackKernel<vn, vl, (Index & 0x10) != 0, (Index & 0x20) != 0, mode == 3 ? 0 : mode>;
+        }
+    }
+
+    template <size_t... Index>
+    constexpr std::array<UnpackKernel, sizeof...(Index)> makeKernelTable(std::index_sequence<Index...>)
+    {
+        return {kernelFor<Index>()...};
+    }
+
+    constexpr std::array<UnpackKernel, 256> kUnpackKernels = makeKernelTable(std::make_index_sequence<256>{});
+}
+
+PS2Vif::PS2Vif(int unit)
+    : m_unit(unit), m_base(unit == 0 ? kVif0Base : kVif1Base)
+{
+}
+
+void PS2Vif::attach(uint8_t *code, uint32_t codeSize, uint8_t *data, uint32_t dataSize)
+{
+    m_code = code;
+    m_codeSize = codeSize;
+    m_data = data;
+    m_dataSize = dataSize;
+}
+
+void PS2Vif::reset()
+{
+    m_regs = VIFRegisters{};
+    m_maskPath3 = false;
+    m_payload = Payload::None;
+    m_wordsLeft = 0;
+    m_wordIndex = 0;
+    m_mpgAddress = 0;
+    m_pending.clear();
+    m_interruptAfter = false;
+}
+
+bool PS2Vif::isRegister(uint32_t address) const
+{
+    return address >= m_base && address < m_base + REG_END && (address & 0xF) == 0;
+}
+
+uint32_t PS2Vif::read(uint32_t address) const
+{
+    const uint32_t offset = address - m_base;
+    if (offset >= REG_R0 && offset < REG_C0)
+    {
+        return m_regs.r[(offset - REG_R0) >> 4];
+    }
+    if (offset >= REG_C0 && offset < REG_END)
+    {
+        return m_regs.c[(offset - REG_C0) >> 4];
+    }
+
+    switch (offset)
+    {
+    case REG_STAT:
+        return m_regs.stat;
+    case REG_FBRST:
+        return m_regs.fbrst;
+    case REG_ERR:
+        return m_regs.err;
+    case REG_MARK:
+        return m_regs.mark;
+    case REG_CYCLE:
+        return m_regs.cycle;
+    case REG_MODE:
+        return m_regs.mode;
+    case REG_NUM:
+        return m_regs.num;
+    case REG_MASK:
+        return m_regs.mask;
+    case REG_CODE:
+        return m_regs.code;
+    case REG_ITOPS:
+        return m_regs.itops;
+    case REG_BASE:
+        return m_regs.base;
+    case REG_OFST:
+        return m_regs.ofst;
+    case REG_TOPS:
+        return m_regs.tops;
+    case REG_ITOP:
+        return m_regs.itop;
+    case REG_TOP:
+        return m_regs.top;
+    default:
+        return 0;
+    }
+}
+
+void PS2Vif::write(uint32_t address, uint32_t value)
+{
+    // Everything else is only set by VIF codes
+    switch (address - m_base)
+    {
+    case REG_FBRST:
+        if (value & 1) // RST
+        {
+            reset();
+        }
+        if (value & 8) // STC: cancel the stall and clear the interrupt and error status
+        {
+            m_regs.stat &= ~(STAT_INT | 0x1000 | STAT_ER1);
+        }
+        break;
+    case REG_ERR:
+        m_regs.err = value & 7;
+        break;
+    case REG_MARK:
+        m_regs.mark = value & 0xFFFF;
+        m_regs.stat &= ~STAT_MRK;
+        break;
+    default:
+        break;
+    }
+}
+
+uint32_t PS2Vif::transfer(const uint8_t *data, uint32_t qwc)
+{
+    uint32_t intc = 0;
+    const uint32_t words = qwc * 4;
+    uint32_t pos = 0;
+    while (pos < words)
+    {
+        if (m_payload == Payload::None)
+        {
+            intc |= command(load32(data + pos * 4));
+            pos++;
+            continue;
+        }
+
+        const uint32_t count = std::min(m_wordsLeft, words - pos);
+        intc |= payload(data + pos * 4, count);
+        pos += count;
+    }
+    return intc;
+}
+
+uint32_t PS2Vif::command(uint32_t code)
+{
+    m_regs.code = code;
+    const uint32_t imm = code & 0xFFFF;
+    const uint32_t num = (code >> 16) & 0xFF;
+    const uint32_t cmd = (code >> 24) & 0x7F;
+    m_interruptAfter = (code & 0x80000000u) != 0;
+    m_wordIndex = 0;
+
+    if (cmd >= CMD_UNPACK)
+    {
+        syncVu();
+        const uint32_t vn = (cmd >> 2) & 3;
+        const uint32_t vl = cmd & 3;
+        m_regs.num = num ? num : 256;
+        const uint32_t bytes = unpackDataQwords(m_regs.num) * unpackStride(vn, vl);
+        m_payload = Payload::Unpack;
+        m_wordsLeft = (bytes + 3) / 4;
+        if (m_wordsLeft == 0)
+        {
+            unpack(nullptr);
+            return finishCommand();
+        }
+        return 0;
+    }
+
+    switch (cmd)
+    {
+    case CMD_NOP:
+        break;
+    case CMD_FLUSHE:
+    case CMD_FLUSH:
+    case CMD_FLUSHA:
+        syncVu();
+        break;
+    case CMD_STCYCL:
+        m_regs.cycle = imm;
+        break;
+    case CMD_OFFSET:
+        m_regs.ofst = imm & 0x3FF;
+        m_regs.stat &= ~STAT_DBF;
+        m_regs.tops = m_regs.base;
+        break;
+    case CMD_BASE:
+        m_regs.base = imm & 0x3FF;
+        break;
+    case CMD_ITOP:
+        m_regs.itops = imm & 0x3FF;
+        break;
+    case CMD_STMOD:
+        m_regs.mode = imm & 3;
+        break;
+    case CMD_MSKPATH3:
+        m_maskPath3 = (imm & 0x8000) != 0;
+        break;
+    case CMD_MARK:
+        m_regs.mark = imm;
+        m_regs.stat |= STAT_MRK;
+        break;
+    case CMD_MSCAL:
+    case CMD_MSCALF:
+        syncVu();
+        startMicroprogram(imm * 8, false);
+        break;
+    case CMD_MSCNT:
+        syncVu();
+        startMicroprogram(0, true);
+        break;
+    case CMD_STMASK:
+        m_payload = Payload::StMask;
+        m_wordsLeft = 1;
+        return 0;
+    case CMD_STROW:
+        m_payload = Payload::StRow;
+        m_wordsLeft = 4;
+        return 0;
+    case CMD_STCOL:
+        m_payload = Payload::StCol;
+        m_wordsLeft = 4;
+        return 0;
+    case CMD_MPG:
+        syncVu();
+        if (m_codeWrite)
+        {
+            m_codeWrite();
+        }
+        m_regs.num = num ? num : 256;
+        m_payload = Payload::Mpg;
+        m_wordsLeft = m_regs.num * 2;
+        m_mpgAddress = imm * 8;
+        return 0;
+    case CMD_DIRECT:
+    case CMD_DIRECTHL:
+        if (m_unit == 1)
+        {
+            m_payload = Payload::Direct;
+            m_wordsLeft = (imm ? imm : 0x10000) * 4;
+            return 0;
+        }
+        m_regs.stat |= STAT_ER1;
+        break;
+    default:
+        m_regs.stat |= STAT_ER1;
+        break;
+    }
+    return finishCommand();
+}
+
+uint32_t PS2Vif::payload(const uint8_t *words, uint32_t count)
+{
+    uint32_t intc = 0;
+    switch (m_payload)
+    {
+    case Payload::StMask:
+        m_regs.mask = load32(words);
+        break;
+    case Payload::StRow:
+    case Payload::StCol:
+    {
+        uint32_t *target = m_payload == Payload::StRow ? m_regs.r : m_regs.c;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            target[m_wordIndex++] = load32(words + i * 4);
+        }
+        break;
+    }
+    case Payload::Mpg:
+        for (uint32_t i = 0; i < count; i++, m_mpgAddress += 4)
+        {
+            if (m_code)
+            {
+                std::memcpy(m_code + (m_mpgAddress & (m_codeSize - 1)), words + i * 4, 4);
+            }
+        }
+        m_regs.num = (m_wordsLeft - count) / 2;
+        break;
+    case Payload::Direct:
+        // Whole qwords go straight to the GIF; a qword split between transfers is put back together first
+        for (uint32_t i = 0; i < count;)
+        {
+            if ((m_wordIndex & 3) == 0 && count - i >= 4)
+            {
+                const uint32_t qwords = (count - i) / 4;
+                if (m_direct)
+                {
+                    intc |= m_direct(words + i * 4, qwords);
+                }
+                i += qwords * 4;
+                m_wordIndex += qwords * 4;
+                continue;
+            }
+            std::memcpy(m_directQword.data() + (m_wordIndex & 3) * 4, words + i * 4, 4);
+            i++;
+            if ((++m_wordIndex & 3) == 0 && m_direct)
+            {
+                intc |= m_direct(m_directQword.data(), 1);
+            }
+        }
+        break;
+    case Payload::Unpack:
+        if (m_pending.empty() && count == m_wordsLeft)
+        {
+            unpack(words);
+        }
+        else
+        {
+            m_pending.insert(m_pending.end(), words, words + count * 4);
+            if (count == m_wordsLeft)
+            {
+                unpack(m_pending.data());
+                m_pending.clear();
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    m_wordsLeft -= count;
+    if (m_wordsLeft == 0)
+    {
+        intc |= finishCommand();
+    }
+    return intc;
+}
+
+uint32_t PS2Vif::finishCommand()
+{
+    m_payload = Payload::None;
+    if (m_interruptAfter)
+    {
+        m_interruptAfter = false;
+        m_regs.stat |= STAT_INT;
+        return 1u << (kIntcVif0 + m_unit);
+    }
+    return 0;
+}
+
+void PS2Vif::syncVu()
+{
+    if (m_vuSync)
+    {
+        m_vuSync();
+    }
+}
+
+void PS2Vif::startMicroprogram(uint32_t address, bool resume)
+{
+    m_regs.itop = m_regs.itops;
+    if (m_unit == 1)
+    {
+        // Double buffering: the program gets TOPS as TOP, and TOPS flips to the other buffer
+        m_regs.top = m_regs.tops & 0x3FF;
+        m_regs.stat ^= STAT_DBF;
+        m_regs.tops = (m_regs.stat & STAT_DBF) ? m_regs.base + m_regs.ofst : m_regs.base;
+    }
+
+    if (m_microprogram)
+    {
+        m_microprogram(address, resume);
+    }
+    else if (!m_reportedMicroprogram)
+    {
+        m_reportedMicroprogram = true;
+        std::cerr << "[VIF" << m_unit << "] no VU attached, microprograms are not run" << std::endl;
+    }
+}
+
+uint32_t PS2Vif::unpackDataQwords(uint32_t num) const
+{
+    // CL and WL of 0 act as 256
+    const uint32_t cl = (m_regs.cycle & 0xFF) ? (m_regs.cycle & 0xFF) : 256;
+    const uint32_t wl = ((m_regs.cycle >> 8) & 0xFF) ? ((m_regs.cycle >> 8) & 0xFF) : 256;
+    if (cl >= wl)
+    {
+        return num;
+    }
+    return (num / wl) * cl + std::min(num % wl, cl);
+}
+
+void PS2Vif::unpack(const uint8_t *data)
+{
+    const uint32_t cmd = (m_regs.code >> 24) & 0x7F;
+    const uint32_t imm = m_regs.code & 0xFFFF;
+    const uint32_t num = m_regs.num;
+    m_regs.num = 0;
+
+    const uint32_t index = (cmd & 0xF) | ((imm & 0x4000) ? 0x10 : 0) | ((cmd & 0x10) ? 0x20 : 0) | (m_regs.mode << 6);
+    const UnpackKernel kernel = kUnpackKernels[index & 0xFF];
+    if (!kernel || !m_data)
+    {
+        m_regs.stat |= STAT_ER1;
+        return;
+    }
+
+    UnpackState state;
+    state.memory = m_data;
+    state.addressMask = m_dataSize / 16 - 1;
+    state.address = imm & 0x3FF;
+    if (m_unit == 1 && (imm & 0x8000)) // FLG: relative to the double buffer
+    {
+        state.address += m_regs.tops;
+    }
+    state.cl = (m_regs.cycle & 0xFF) ? (m_regs.cycle & 0xFF) : 256;
+    state.wl = ((m_regs.cycle >> 8) & 0xFF) ? ((m_regs.cycle >> 8) & 0xFF) : 256;
+    state.mask = m_regs.mask;
+    state.row = m_regs.r;
+    state.col = m_regs.c;
+
+    // Without data (all of a filling cycle from the registers) the kernel never reads it
+    static const uint8_t kNoData[16] = {};
+    kernel(state, data ? data : kNoData, num);
+}
@@ -0,0 +1,997 @@
+#include "ps2_vu.h"
+#include "ps2_interrupts.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+using ps2_vu::blend;
+using ps2_vu::laneMask;
+
+namespace
+{
+    // Upper word flag bits
+    constexpr uint32_t kUpperI = 0x80000000u; // lower word is a float for I
+    constexpr uint32_t kUpperE = 0x40000000u; // program ends after the next instruction
+
+    enum FmacOp
+    {
+        OP_ADD,
+        OP_SUB,
+        OP_MADD,
+        OP_MSUB,
+        OP_MAX,
+        OP_MINI,
+        OP_MUL,
+        OP_OPMSUB,
+        OP_OPMULA,
+    };
+
+    // FDIV latencies in instructions; the EFU ones are with each op
+    constexpr uint32_t kLatencyDiv = 7;
+    constexpr uint32_t kLatencyRsqrt = 13;
+
+    inline uint32_t load32(const uint8_t *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline float asFloat(uint32_t bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t asBits(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline __m128 broadcast(__m128 v, uint32_t field)
+    {
+        switch (field & 3)
+        {
+        case 0:
+            return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+        case 1:
+            return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        case 2:
+            return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+        default:
+            return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+    }
+
+    inline float lane(__m128 v, uint32_t field)
+    {
+        alignas(16) float f[4];
+        _mm_store_ps(f, v);
+        return f[field & 3];
+    }
+
+    inline int32_t signExtend(uint32_t value, int bits)
+    {
+        const uint32_t shift = 32 - bits;
+        return static_cast<int32_t>(value << shift) >> shift;
+    }
+}
+
+PS2VectorUnit::PS2VectorUnit(int unit, PS2InterruptController &interrupts)
+    : m_unit(unit), m_interrupts(interrupts)
+{
+    reset();
+}
+
+PS2VectorUnit::~PS2VectorUnit()
+{
+    stopWorker();
+}
+
+void PS2VectorUnit::attach(uint8_t *code, uint32_t codeSize, uint8_t *data, uint32_t dataSize)
+{
+    waitIdle();
+    m_code = code;
+    m_codeSize = codeSize;
+    m_data = data;
+    m_dataSize = dataSize;
+}
+
+void PS2VectorUnit::setThreaded(bool threaded)
+{
+    waitIdle();
+    if (!threaded)
+    {
+        stopWorker();
+    }
+    m_threaded = threaded;
+}
+
+void PS2VectorUnit::reset()
+{
+    waitIdle();
+    m_regs = Registers{};
+    m_regs.vf[0][3] = 1.0f; // VF0 reads as (0, 0, 0, 1)
+    m_cycle = 0;
+    m_pendingQ = PendingResult{};
+    m_pendingP = PendingResult{};
+    m_branchPending = false;
+    m_endPending = false;
+    m_intc = 0;
+    m_pendingIntc.store(0, std::memory_order_relaxed);
+}
+
+void PS2VectorUnit::start(uint32_t address, bool resume, uint32_t itop, uint32_t top)
+{
+    waitIdle();
+    m_regs.itop = itop;
+    m_regs.top = top;
+    if (!resume)
+    {
+        m_regs.pc = address;
+    }
+    if (!m_code || !m_data)
+    {
+        return;
+    }
+
+    if (!m_threaded)
+    {
+        run();
+        finishRun();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_worker.joinable())
+        {
+            m_quit = false;
+            m_worker = std::thread([this]() { workerLoop(); });
+        }
+        m_startRequested = true;
+        m_busy.store(true, std::memory_order_relaxed);
+    }
+    m_wake.notify_one();
+}
+
+void PS2VectorUnit::waitIdle()
+{
+    if (!m_busy.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return !m_startRequested && !m_running; });
+}
+
+bool PS2VectorUnit::running()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_startRequested || m_running;
+}
+
+void PS2VectorUnit::update()
+{
+    const uint32_t causes = m_pendingIntc.exchange(0, std::memory_order_acq_rel);
+    for (int cause = 0; cause < PS2InterruptController::kNumIntcCauses; cause++)
+    {
+        if (causes & (1u << cause))
+        {
+            m_interrupts.raiseIntc(cause);
+        }
+    }
+}
+
+void PS2VectorUnit::stopWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable())
+    {
+        m_worker.join();
+    }
+}
+
+void PS2VectorUnit::workerLoop()
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_quit || m_startRequested; });
+            if (m_quit)
+            {
+                return;
+            }
+            m_startRequested = false;
+            m_running = true;
+        }
+
+        run();
+        finishRun();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+            m_busy.store(false, std::memory_order_release);
+        }
+        m_idle.notify_all();
+    }
+}
+
+void PS2VectorUnit::run()
+{
+    for (Flags &flags : m_flagPipe)
+    {
+        flags = Flags{m_regs.mac, m_regs.status, m_regs.clip};
+    }
+    m_branchPending = false;
+    m_endPending = false;
+    m_runStart = m_cycle;
+
+    bool ended = false;
+    if (const PS2VuMicroprogram *program = findMicroprogram(m_regs.pc & (m_codeSize - 1) & ~7u))
+    {
+        m_recompiledRuns.fetch_add(1, std::memory_order_relaxed);
+        ended = program->function(*this);
+    }
+
+    // Interpret whatever the recompiled code did not cover
+    while (!ended)
+    {
+        ended = m_endPending;
+        step();
+        if (!ended && overBudget())
+        {
+            std::cerr << "[VU" << m_unit << "] microprogram ran " << (m_cycle - m_runStart)
+                      << " instructions without ending, stopped at pc=0x" << std::hex << m_regs.pc << std::dec << std::endl;
+            break;
+        }
+    }
+
+    // The FDIV and EFU units finish what they started after the program stops
+    commitPending(m_pendingQ, m_regs.q);
+    commitPending(m_pendingP, m_regs.p);
+    m_instructionCount.fetch_add(m_cycle - m_runStart, std::memory_order_relaxed);
+}
+
+void PS2VectorUnit::finishRun()
+{
+    const uint32_t causes = std::exchange(m_intc, 0);
+    if (causes == 0)
+    {
+        return;
+    }
+    m_pendingIntc.fetch_or(causes, std::memory_order_acq_rel);
+    if (m_notifier)
+    {
+        m_notifier();
+    }
+}
+
+void PS2VectorUnit::addMicroprogram(const PS2VuMicroprogram &program)
+{
+    waitIdle();
+    if (program.unit != m_unit || !program.function || program.size == 0)
+    {
+        return;
+    }
+    m_microprograms.push_back(program);
+    m_matched.clear();
+}
+
+void PS2VectorUnit::invalidateMicroprograms()
+{
+    m_matched.clear();
+}
+
+const PS2VuMicroprogram *PS2VectorUnit::findMicroprogram(uint32_t pc)
+{
+    if (m_microprograms.empty())
+    {
+        return nullptr;
+    }
+    auto matched = m_matched.find(pc);
+    if (matched != m_matched.end())
+    {
+        return matched->second;
+    }
+
+    // Hashing is only redone after micro memory changes, so it stays off the MSCAL path
+    const PS2VuMicroprogram *found = nullptr;
+    for (const PS2VuMicroprogram &program : m_microprograms)
+    {
+        if (pc >= program.address && pc - program.address < program.size &&
+            program.address + program.size <= m_codeSize &&
+            ps2VuMicrocodeHash(m_code + program.address, program.size) == program.hash)
+        {
+            found = &program;
+            break;
+        }
+    }
+    m_matched.emplace(pc, found);
+    return found;
+}
+
+void PS2VectorUnit::leaveRecompiled(uint32_t pc, bool branch, uint32_t target, bool end)
+{
+    m_regs.pc = pc;
+    m_branchPending = branch;
+    m_branchTarget = target;
+    m_endPending = end;
+}
+
+void PS2VectorUnit::step()
+{
+    const uint32_t pc = m_regs.pc & (m_codeSize - 1) & ~7u;
+    const uint32_t lower = load32(m_code + pc);
+    const uint32_t upper = load32(m_code + pc + 4);
+
+    beginInstruction();
+
+    const bool jump = m_branchPending;
+    const uint32_t target = m_branchTarget;
+    m_branchPending = false;
+
+    if (upper & kUpperI)
+    {
+        m_regs.i = asFloat(lower);
+    }
+    executeUpper(upper);
+    if (!(upper & kUpperI))
+    {
+        executeLower(lower, pc);
+    }
+    commitUpper();
+
+    endInstruction();
+    m_regs.pc = jump ? target : pc + 8;
+    if (upper & kUpperE)
+    {
+        m_endPending = true;
+    }
+}
+
+__m128 PS2VectorUnit::vf(int reg) const
+{
+    return _mm_load_ps(m_regs.vf[reg]);
+}
+
+void PS2VectorUnit::writeVf(int reg, uint32_t dest, __m128 value)
+{
+    if (reg == 0)
+    {
+        return;
+    }
+    _mm_store_ps(m_regs.vf[reg], blend(vf(reg), value, laneMask(dest)));
+}
+
+void PS2VectorUnit::writeFmac(int reg, bool toAcc, uint32_t dest, __m128 value)
+{
+    m_upperWrite.active = true;
+    m_upperWrite.toAcc = toAcc;
+    m_upperWrite.reg = reg;
+    m_upperWrite.value = ps2_vu::fmacResult(value, dest, m_regs.mac, m_regs.status);
+    m_upperWrite.mask = laneMask(dest);
+}
+
+void PS2VectorUnit::commitUpper()
+{
+    if (!m_upperWrite.active)
+    {
+        return;
+    }
+    m_upperWrite.active = false;
+    if (m_upperWrite.toAcc)
+    {
+        _mm_store_ps(m_regs.acc, blend(_mm_load_ps(m_regs.acc), m_upperWrite.value, m_upperWrite.mask));
+    }
+    else if (m_upperWrite.reg != 0)
+    {
+        _mm_store_ps(m_regs.vf[m_upperWrite.reg], blend(vf(m_upperWrite.reg), m_upperWrite.value, m_upperWrite.mask));
+    }
+}
+
+void PS2VectorUnit::executeUpper(uint32_t upper)
+{
+    const uint32_t dest = (upper >> 21) & 0xF;
+    const int ft = (upper >> 16) & 0x1F;
+    const int fs = (upper >> 11) & 0x1F;
+    const int fd = (upper >> 6) & 0x1F;
+    const uint32_t bc = upper & 3;
+    const uint32_t op = upper & 0x3F;
+
+    const __m128 a = ps2_vu::operand(vf(fs));
+    const __m128 t = ps2_vu::operand(vf(ft));
+    const __m128 q = _mm_set1_ps(ps2_vu::scalar(m_regs.q));
+    const __m128 i = _mm_set1_ps(ps2_vu::scalar(m_regs.i));
+
+    FmacOp fmac;
+    __m128 b;
+    bool toAcc = false;
+    int target = fd;
+
+    if (op < 0x1C)
+    {
+        static constexpr FmacOp kBroadcastOps[7] = {OP_ADD, OP_SUB, OP_MADD, OP_MSUB, OP_MAX, OP_MINI, OP_MUL};
+        fmac = kBroadcastOps[op >> 2];
+        b = broadcast(t, bc);
+    }
+    else if (op < 0x3C)
+    {
+        switch (op)
+        {
+        case 0x1C: fmac = OP_MUL; b = q; break;
+        case 0x1D: fmac = OP_MAX; b = i; break;
+        case 0x1E: fmac = OP_MUL; b = i; break;
+        case 0x1F: fmac = OP_MINI; b = i; break;
+        case 0x20: fmac = OP_ADD; b = q; break;
+        case 0x21: fmac = OP_MADD; b = q; break;
+        case 0x22: fmac = OP_ADD; b = i; break;
+        case 0x23: fmac = OP_MADD; b = i; break;
+        case 0x24: fmac = OP_SUB; b = q; break;
+        case 0x25: fmac = OP_MSUB; b = q; break;
+        case 0x26: fmac = OP_SUB; b = i; break;
+        case 0x27: fmac = OP_MSUB; b = i; break;
+        case 0x28: fmac = OP_ADD; b = t; break;
+        case 0x29: fmac = OP_MADD; b = t; break;
+        case 0x2A: fmac = OP_MUL; b = t; break;
+        case 0x2B: fmac = OP_MAX; b = t; break;
+        case 0x2C: fmac = OP_SUB; b = t; break;
+        case 0x2D: fmac = OP_MSUB; b = t; break;
+        case 0x2E: fmac = OP_OPMSUB; b = t; break;
+        case 0x2F: fmac = OP_MINI; b = t; break;
+        default:
+            return;
+        }
+    }
+    else
+    {
+        // Accumulator forms, conversions, ABS and CLIP; fd is part of the opcode
+        const uint32_t special = ((upper >> 4) & 0x7C) | bc;
+        toAcc = true;
+        if (special < 0x10 || (special >= 0x18 && special < 0x1C))
+        {
+            static constexpr FmacOp kAccOps[7] = {OP_ADD, OP_SUB, OP_MADD, OP_MSUB, OP_MAX, OP_MINI, OP_MUL};
+            fmac = kAccOps[special >> 2];
+            b = broadcast(t, bc);
+        }
+        else if (special < 0x18)
+        {
+            // ITOF0/4/12/15 and FTOI0/4/12/15 move VF[fs] to VF[ft] without touching the flags
+            static constexpr float kScale[4] = {1.0f, 16.0f, 4096.0f, 32768.0f};
+            const __m128 value = special < 0x14 ? ps2_vu::itof(vf(fs), kScale[bc]) : ps2_vu::ftoi(a, kScale[bc]);
+            m_upperWrite = UpperWrite{true, false, ft, value, laneMask(dest)};
+            return;
+        }
+        else
+        {
+            switch (special)
+            {
+            case 0x1C: fmac = OP_MUL; b = q; break;
+            case 0x1D:
+                // ABS: no flags
+                m_upperWrite = UpperWrite{true, false, ft, _mm_andnot_ps(_mm_set1_ps(-0.0f), a), laneMask(dest)};
+                return;
+            case 0x1E: fmac = OP_MUL; b = i; break;
+            case 0x1F:
+            {
+                // CLIP: x, y and z of VF[fs] against +-|VF[ft].w|, six bits per judgement
+                const float w = std::fabs(lane(t, 3));
+                uint32_t judgement = 0;
+                for (uint32_t field = 0; field < 3; field++)
+                {
+                    const float v = lane(a, field);
+                    judgement |= (v > w ? 1u : 0u) << (field * 2);
+                    judgement |= (v < -w ? 1u : 0u) << (field * 2 + 1);
+                }
+                m_regs.clip = ((m_regs.clip << 6) | judgement) & 0xFFFFFF;
+                return;
+            }
+            case 0x20: fmac = OP_ADD; b = q; break;
+            case 0x21: fmac = OP_MADD; b = q; break;
+            case 0x22: fmac = OP_ADD; b = i; break;
+            case 0x23: fmac = OP_MADD; b = i; break;
+            case 0x24: fmac = OP_SUB; b = q; break;
+            case 0x25: fmac = OP_MSUB; b = q; break;
+            case 0x26: fmac = OP_SUB; b = i; break;
+            case 0x27: fmac = OP_MSUB; b = i; break;
+            case 0x28: fmac = OP_ADD; b = t; break;
+            case 0x29: fmac = OP_MADD; b = t; break;
+            case 0x2A: fmac = OP_MUL; b = t; break;
+            case 0x2C: fmac = OP_SUB; b = t; break;
+            case 0x2D: fmac = OP_MSUB; b = t; break;
+            case 0x2E: fmac = OP_OPMULA; b = t; break;
+            default:
+                return; // NOP
+            }
+        }
+        target = 0;
+    }
+
+    const __m128 acc = ps2_vu::operand(_mm_load_ps(m_regs.acc));
+    __m128 result = _mm_setzero_ps();
+    switch (fmac)
+    {
+    case OP_ADD:
+        result = _mm_add_ps(a, b);
+        break;
+    case OP_SUB:
+        result = _mm_sub_ps(a, b);
+        break;
+    case OP_MUL:
+        result = _mm_mul_ps(a, b);
+        break;
+    case OP_MADD:
+        result = _mm_add_ps(acc, ps2_vu::operand(_mm_mul_ps(a, b)));
+        break;
+    case OP_MSUB:
+        result = _mm_sub_ps(acc, ps2_vu::operand(_mm_mul_ps(a, b)));
+        break;
+    case OP_OPMULA:
+    case OP_OPMSUB:
+    {
+        // Cross product terms: fs.yzx * ft.zxy
+        const __m128 product = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2)));
+        result = fmac == OP_OPMULA ? product : _mm_sub_ps(acc, ps2_vu::operand(product));
+        break;
+    }
+    case OP_MAX:
+    case OP_MINI:
+        // No flags
+        result = fmac == OP_MAX ? _mm_max_ps(a, b) : _mm_min_ps(a, b);
+        if (toAcc)
+        {
+            return;
+        }
+        m_upperWrite = UpperWrite{true, false, target, result, laneMask(dest)};
+        return;
+    }
+    writeFmac(target, toAcc, dest, result);
+}
+
+void PS2VectorUnit::setVi(int reg, uint32_t value)
+{
+    if ((reg & 15) != 0)
+    {
+        m_regs.vi[reg & 15] = static_cast<uint16_t>(value);
+    }
+}
+
+void PS2VectorUnit::commitPending(PendingResult &pending, float &target)
+{
+    if (pending.active)
+    {
+        target = pending.value;
+        pending.active = false;
+    }
+}
+
+void PS2VectorUnit::startQ(float value, uint32_t latency)
+{
+    // A new divide waits for the one in flight
+    commitPending(m_pendingQ, m_regs.q);
+    m_pendingQ = PendingResult{true, value, m_cycle + latency};
+}
+
+void PS2VectorUnit::startP(float value, uint32_t latency)
+{
+    commitPending(m_pendingP, m_regs.p);
+    m_pendingP = PendingResult{true, value, m_cycle + latency};
+}
+
+void PS2VectorUnit::kick(uint32_t qword)
+{
+    // Walk the GIF tags to the one with EOP to find the packet's length
+    const uint32_t qwords = m_dataSize / 16;
+    const uint32_t start = qword & (qwords - 1);
+    uint32_t length = 0;
+    for (;;)
+    {
+        uint64_t tag;
+        std::memcpy(&tag, dataQword(start + length), sizeof(tag));
+        const uint32_t nloop = tag & 0x7FFF;
+        const uint32_t flg = (tag >> 58) & 3;
+        const uint32_t nreg = ((tag >> 60) & 0xF) ? ((tag >> 60) & 0xF) : 16;
+        length += 1 + (flg == 0 ? nloop * nreg : flg == 1 ? (nloop * nreg + 1) / 2 : nloop);
+        if ((tag & 0x8000) || length >= qwords)
+        {
+            break;
+        }
+    }
+    length = std::min(length, qwords);
+
+    if (!m_kick)
+    {
+        return;
+    }
+    const uint32_t first = std::min(length, qwords - start);
+    m_intc |= m_kick(dataQword(start), first);
+    if (length > first)
+    {
+        m_intc |= m_kick(m_data, length - first);
+    }
+}
+
+void PS2VectorUnit::executeLower(uint32_t lower, uint32_t pc)
+{
+    const uint32_t dest = (lower >> 21) & 0xF;
+    const int it = (lower >> 16) & 0x1F;
+    const int is = (lower >> 11) & 0x1F;
+    const int id = (lower >> 6) & 0x1F;
+    const int32_t imm11 = signExtend(lower & 0x7FF, 11);
+    // VI fields are five bits wide, but there are only 16 integer registers
+    auto vi = [this](int reg) { return m_regs.vi[reg & 15]; };
+
+    if (lower & 0x80000000u)
+    {
+        switch (lower & 0x3F)
+        {
+        case 0x30: // IADD
+            setVi(id, vi(is) + vi(it));
+            break;
+        case 0x31: // ISUB
+            setVi(id, vi(is) - vi(it));
+            break;
+        case 0x32: // IADDI
+            setVi(it, vi(is) + signExtend((lower >> 6) & 0x1F, 5));
+            break;
+        case 0x34: // IAND
+            setVi(id, vi(is) & vi(it));
+            break;
+        case 0x35: // IOR
+            setVi(id, vi(is) | vi(it));
+            break;
+        case 0x3C:
+        case 0x3D:
+        case 0x3E:
+        case 0x3F:
+            executeLowerSpecial(lower);
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+
+    const uint32_t imm12 = ((lower >> 10) & 0x800) | (lower & 0x7FF);
+    const uint32_t imm15 = ((lower >> 10) & 0x7800) | (lower & 0x7FF);
+    const uint32_t imm24 = lower & 0xFFFFFF;
+    const uint32_t branchTarget = pc + 8 + imm11 * 8;
+    const Flags &flags = m_visibleFlags;
+
+    switch (lower >> 25)
+    {
+    case 0x00: // LQ
+        writeVf(it, dest, _mm_loadu_ps(reinterpret_cast<const float *>(dataQword(vi(is) + imm11))));
+        break;
+    case 0x01: // SQ
+    {
+        float *out = reinterpret_cast<float *>(dataQword(vi(it) + imm11));
+        _mm_storeu_ps(out, blend(_mm_loadu_ps(out), vf(is), laneMask(dest)));
+        break;
+    }
+    case 0x04: // ILW
+    {
+        const uint8_t *q = dataQword(vi(is) + imm11);
+        for (uint32_t field = 0; field < 4; field++)
+        {
+            if (dest & (8u >> field))
+            {
+                setVi(it, load32(q + field * 4));
+                break;
+            }
+        }
+        break;
+    }
+    case 0x05: // ISW
+    {
+        uint8_t *q = dataQword(vi(is) + imm11);
+        const uint32_t value = vi(it);
+        for (uint32_t field = 0; field < 4; field++)
+        {
+            if (dest & (8u >> field))
+            {
+                std::memcpy(q + field * 4, &value, 4);
+            }
+        }
+        break;
+    }
+    case 0x08: // IADDIU
+        setVi(it, vi(is) + imm15);
+        break;
+    case 0x09: // ISUBIU
+        setVi(it, vi(is) - imm15);
+        break;
+    case 0x10: // FCEQ
+        setVi(1, (flags.clip & 0xFFFFFF) == imm24);
+        break;
+    case 0x11: // FCSET
+        m_regs.clip = imm24;
+        break;
+    case 0x12: // FCAND
+        setVi(1, (flags.clip & imm24) != 0);
+        break;
+    case 0x13: // FCOR
+        setVi(1, ((flags.clip | imm24) & 0xFFFFFF) == 0xFFFFFF);
+        break;
+    case 0x14: // FSEQ
+        setVi(it, (flags.status & 0xFFF) == imm12);
+        break;
+    case 0x15: // FSSET: only the sticky bits can be set
+        m_regs.status = (m_regs.status & 0x3F) | (imm12 & 0xFC0);
+        break;
+    case 0x16: // FSAND
+        setVi(it, flags.status & imm12);
+        break;
+    case 0x17: // FSOR
+        setVi(it, ((flags.status | imm12) & 0xFFF) == 0xFFF);
+        break;
+    case 0x18: // FMEQ
+        setVi(it, (flags.mac & 0xFFFF) == vi(is));
+        break;
+    case 0x1A: // FMAND
+        setVi(it, flags.mac & vi(is));
+        break;
+    case 0x1B: // FMOR
+        setVi(it, ((flags.mac | vi(is)) & 0xFFFF) == 0xFFFF);
+        break;
+    case 0x1C: // FCGET
+        setVi(it, flags.clip & 0xFFF);
+        break;
+    case 0x20: // B
+        m_branchPending = true;
+        m_branchTarget = branchTarget;
+        break;
+    case 0x21: // BAL
+        setVi(it, (pc + 16) / 8);
+        m_branchPending = true;
+        m_branchTarget = branchTarget;
+        break;
+    case 0x24: // JR
+        m_branchPending = true;
+        m_branchTarget = vi(is) * 8u;
+        break;
+    case 0x25: // JALR
+        m_branchPending = true;
+        m_branchTarget = vi(is) * 8u;
+        setVi(it, (pc + 16) / 8);
+        break;
+    case 0x28: // IBEQ
+    case 0x29: // IBNE
+    case 0x2C: // IBLTZ
+    case 0x2D: // IBGTZ
+    case 0x2E: // IBLEZ
+    case 0x2F: // IBGEZ
+    {
+        const int16_t value = static_cast<int16_t>(vi(is));
+        bool taken = false;
+        switch (lower >> 25)
+        {
+        case 0x28: taken = vi(it) == vi(is); break;
+        case 0x29: taken = vi(it) != vi(is); break;
+        case 0x2C: taken = value < 0; break;
+        case 0x2D: taken = value > 0; break;
+        case 0x2E: taken = value <= 0; break;
+        default: taken = value >= 0; break;
+        }
+        if (taken)
+        {
+            m_branchPending = true;
+            m_branchTarget = branchTarget;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void PS2VectorUnit::executeLowerSpecial(uint32_t lower)
+{
+    const uint32_t dest = (lower >> 21) & 0xF;
+    const int ft = (lower >> 16) & 0x1F;
+    const int fs = (lower >> 11) & 0x1F;
+    const uint32_t fsf = (lower >> 21) & 3;
+    const uint32_t ftf = (lower >> 23) & 3;
+    auto vi = [this](int reg) { return m_regs.vi[reg & 15]; };
+
+    switch (((lower >> 4) & 0x7C) | (lower & 3))
+    {
+    case 0x30: // MOVE
+        writeVf(ft, dest, vf(fs));
+        break;
+    case 0x31: // MR32
+    {
+        const __m128 v = vf(fs);
+        writeVf(ft, dest, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 3, 2, 1)));
+        break;
+    }
+    case 0x34: // LQI
+        writeVf(ft, dest, _mm_loadu_ps(reinterpret_cast<const float *>(dataQword(vi(fs)))));
+        setVi(fs, vi(fs) + 1);
+        break;
+    case 0x35: // SQI
+    {
+        float *out = reinterpret_cast<float *>(dataQword(vi(ft)));
+        _mm_storeu_ps(out, blend(_mm_loadu_ps(out), vf(fs), laneMask(dest)));
+        setVi(ft, vi(ft) + 1);
+        break;
+    }
+    case 0x36: // LQD
+    {
+        const uint32_t address = vi(fs) - 1u;
+        setVi(fs, address);
+        writeVf(ft, dest, _mm_loadu_ps(reinterpret_cast<const float *>(dataQword(address))));
+        break;
+    }
+    case 0x37: // SQD
+    {
+        const uint32_t address = vi(ft) - 1u;
+        setVi(ft, address);
+        float *out = reinterpret_cast<float *>(dataQword(address));
+        _mm_storeu_ps(out, blend(_mm_loadu_ps(out), vf(fs), laneMask(dest)));
+        break;
+    }
+    case 0x38: // DIV
+    case 0x3A: // RSQRT
+    {
+        const float num = ps2_vu::scalar(m_regs.vf[fs][fsf]);
+        float den = ps2_vu::scalar(m_regs.vf[ft][ftf]);
+        m_regs.status &= ~(STATUS_I | STATUS_D);
+        const bool rsqrt = (lower & 3) == 2;
+        if (rsqrt)
+        {
+            if (den < 0.0f)
+            {
+                m_regs.status |= STATUS_I | (STATUS_I << 6);
+            }
+            den = std::sqrt(std::fabs(den));
+        }
+        float result;
+        if (den == 0.0f)
+        {
+            // 0/0 is invalid, x/0 a divide by zero; both give the largest value
+            m_regs.status |= num == 0.0f ? (STATUS_I | (STATUS_I << 6)) : (STATUS_D | (STATUS_D << 6));
+            const bool negative = (asBits(num) ^ asBits(m_regs.vf[ft][ftf])) & 0x80000000u;
+            result = asFloat((negative && !rsqrt ? 0x80000000u : 0u) | 0x7F7FFFFF);
+        }
+        else
+        {
+            result = ps2_vu::scalar(num / den);
+        }
+        startQ(result, rsqrt ? kLatencyRsqrt : kLatencyDiv);
+        break;
+    }
+    case 0x39: // SQRT
+    {
+        const float value = ps2_vu::scalar(m_regs.vf[ft][ftf]);
+        m_regs.status &= ~(STATUS_I | STATUS_D);
+        if (value < 0.0f)
+        {
+            m_regs.status |= STATUS_I | (STATUS_I << 6);
+        }
+        startQ(std::sqrt(std::fabs(value)), kLatencyDiv);
+        break;
+    }
+    case 0x3B: // WAITQ
+        commitPending(m_pendingQ, m_regs.q);
+        break;
+    case 0x3C: // MTIR
+        setVi(ft, asBits(m_regs.vf[fs][fsf]));
+        break;
+    case 0x3D: // MFIR
+        writeVf(ft, dest, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int16_t>(vi(fs)))));
+        break;
+    case 0x3E: // ILWR
+        for (uint32_t field = 0; field < 4; field++)
+        {
+            if (dest & (8u >> field))
+            {
+                setVi(ft, load32(dataQword(vi(fs)) + field * 4));
+                break;
+            }
+        }
+        break;
+    case 0x3F: // ISWR
+    {
+        const uint32_t value = vi(ft);
+        for (uint32_t field = 0; field < 4; field++)
+        {
+            if (dest & (8u >> field))
+            {
+                std::memcpy(dataQword(vi(fs)) + field * 4, &value, 4);
+            }
+        }
+        break;
+    }
+    case 0x40: // RNEXT
+    {
+        const uint32_t feedback = ((m_regs.r >> 4) & 1) ^ ((m_regs.r >> 22) & 1);
+        m_regs.r = (((m_regs.r << 1) ^ feedback) & 0x7FFFFF) | 0x3F800000;
+        writeVf(ft, dest, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(m_regs.r))));
+        break;
+    }
+    case 0x41: // RGET
+        writeVf(ft, dest, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(m_regs.r))));
+        break;
+    case 0x42: // RINIT
+        m_regs.r = 0x3F800000 | (asBits(m_regs.vf[fs][fsf]) & 0x7FFFFF);
+        break;
+    case 0x43: // RXOR
+        m_regs.r = 0x3F800000 | ((m_regs.r ^ asBits(m_regs.vf[fs][fsf])) & 0x7FFFFF);
+        break;
+    case 0x64: // MFP
+        writeVf(ft, dest, _mm_set1_ps(m_regs.p));
+        break;
+    case 0x68: // XTOP
+        setVi(ft, m_regs.top & (m_unit == 0 ? 0xFF : 0x3FF));
+        break;
+    case 0x69: // XITOP
+        setVi(ft, m_regs.itop & (m_unit == 0 ? 0xFF : 0x3FF));
+        break;
+    case 0x6C: // XGKICK
+        kick(vi(fs));
+        break;
+    case 0x70: // ESADD
+    case 0x71: // ERSADD
+    case 0x72: // ELENG
+    case 0x73: // ERLENG
+    {
+        const float *v = m_regs.vf[fs];
+        const float sum = ps2_vu::scalar(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        switch (lower & 3)
+        {
+        case 0: startP(sum, 11); break;
+        case 1: startP(ps2_vu::scalar(1.0f / sum), 18); break;
+        case 2: startP(std::sqrt(sum), 18); break;
+        default: startP(ps2_vu::scalar(1.0f / std::sqrt(sum)), 24); break;
+        }
+        break;
+    }
+    case 0x74: // EATANxy
+        startP(std::atan2(m_regs.vf[fs][1], m_regs.vf[fs][0]), 54);
+        break;
+    case 0x75: // EATANxz
+        startP(std::atan2(m_regs.vf[fs][2], m_regs.vf[fs][0]), 54);
+        break;
+    case 0x76: // ESUM
+    {
+        const float *v = m_regs.vf[fs];
+        startP(ps2_vu::scalar(v[0] + v[1] + v[2] + v[3]), 12);
+        break;
+    }
+    case 0x78: // ESQRT
+        startP(std::sqrt(std::fabs(ps2_vu::scalar(m_regs.vf[fs][fsf]))), 12);
+        break;
+    case 0x79: // ERSQRT
+        startP(ps2_vu::scalar(1.0f / std::sqrt(std::fabs(ps2_vu::scalar(m_regs.vf[fs][fsf])))), 18);
+        break;
+    case 0x7A: // ERCPR
+        startP(ps2_vu::scalar(1.0f / ps2_vu::scalar(m_regs.vf[fs][fsf])), 12);
+        break;
+    case 0x7B: // WAITP
+        commitPending(m_pendingP, m_regs.p);
+        break;
+    case 0x7C: // ESIN
+        startP(std::sin(ps2_vu::scalar(m_regs.vf[fs][fsf])), 29);
+        break;
+    case 0x7D: // EATAN
+        startP(std::atan(ps2_vu::scalar(m_regs.vf[fs][fsf])), 54);
+        break;
+    case 0x7E: // EEXP
+        startP(ps2_vu::scalar(std::exp(-ps2_vu::scalar(m_regs.vf[fs][fsf]))), 44);
+        break;
+    default:
+        break;
+    }
+}
@@ -7,13 +7,67 @@ int main(int argc, char *argv[])
 {
     if (argc < 2)
     {
-        std::cout << "Usage: " << argv[0] << " <elf_file>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <elf_file> [--pal] [--unthrottled | --vsync]"
+                  << " [--headless] [--frames N] [--seconds S] [--dump DIR] [--gs-threads N]" << std::endl;
         return 1;
     }
 
     std::string elfPath = argv[1];
 
     PS2Runtime runtime;
+    PS2Runtime::HeadlessOptions headless;
+    bool runHeadless = false;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--pal")
+        {
+            runtime.setVideoMode(PS2Clock::VideoMode::PAL);
+        }
+        else if (arg == "--unthrottled")
+        {
+            runtime.setFramePacing(PS2Runtime::FramePacing::Unthrottled);
+        }
+        else if (arg == "--vsync")
+        {
+            runtime.setFramePacing(PS2Runtime::FramePacing::HostVsync);
+        }
+        else if (arg == "--headless")
+        {
+            runHeadless = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            headless.maxFrames = std::stoull(argv[++i]);
+            runHeadless = true;
+        }
+        else if (arg == "--seconds" && i + 1 < argc)
+        {
+            headless.maxSeconds = std::stod(argv[++i]);
+            runHeadless = true;
+        }
+        else if (arg == "--dump" && i + 1 < argc)
+        {
+            headless.dumpDirectory = argv[++i];
+            runHeadless = true;
+        }
+        else if (arg == "--gs-threads" && i + 1 < argc)
+        {
+            runtime.setRasterizerThreads(static_cast<uint32_t>(std::stoul(argv[++i])));
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (runHeadless)
+    {
+        runtime.setHeadless(headless);
+    }
+
     if (!runtime.initialize("ps2xRuntime (Raylib host)"))
     {
         std::cerr << "Failed to initialize PS2 runtime" << std::endl;
@@ -31,4 +85,4 @@ int main(int argc, char *argv[])
     runtime.run();
 
     return 0;
-}
\ No newline at end of file
+}
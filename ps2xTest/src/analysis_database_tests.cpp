@@ -0,0 +1,109 @@
+#include "MiniTest.h"
+#include "ps2recomp/analysis_database.h"
+#include "ps2recomp/r5900_decoder.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace ps2recomp;
+namespace fs = std::filesystem;
+
+static fs::path writeFakeElf(const std::string &name, const std::string &contents)
+{
+    fs::path path = fs::temp_directory_path() / name;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+    return path;
+}
+
+void register_analysis_database_tests()
+{
+    MiniTest::Case("AnalysisDatabase", [](TestCase &tc)
+                   {
+    tc.Run("round-trips decoded code, CFGs, calls and jump tables", [](TestCase &t) {
+        fs::path elfPath = writeFakeElf("ps2x_adb_roundtrip.elf", "fake elf contents");
+        std::string dbPath = AnalysisDatabase::pathForElf(elfPath.string());
+
+        R5900Decoder decoder;
+        Function func;
+        func.name = "roundtrip_func";
+        func.start = 0x1000;
+        func.end = 0x100c;
+        func.isRecompiled = false;
+        func.isStub = false;
+
+        std::vector<Instruction> code{
+            decoder.decodeInstruction(0x1000, 0x24020001), // addiu v0, zero, 1
+            decoder.decodeInstruction(0x1004, 0x0C000800), // jal 0x2000
+            decoder.decodeInstruction(0x1008, 0x00000000)};
+
+        CFGNode node{};
+        node.startAddress = 0x1000;
+        node.endAddress = 0x1008;
+        node.instructions = code;
+        node.successors = {0x2000};
+        node.isJumpTarget = true;
+
+        std::vector<Function> functions{func};
+        std::unordered_map<uint32_t, std::vector<Instruction>> decoded{{func.start, code}};
+        std::unordered_map<uint32_t, CFG> cfgs{{func.start, CFG{{0x1000, node}}}};
+        std::vector<JumpTable> jumpTables{{0x3000, 2, {{0, 0x1000}, {1, 0x1008}}, 0x1004}};
+        std::unordered_map<uint32_t, std::vector<FunctionCall>> calls{{func.start, {{0x1004, 0x2000, "callee"}}}};
+
+        AnalysisSnapshot snapshot{functions, decoded, cfgs, jumpTables, calls};
+        t.IsTrue(AnalysisDatabase::save(dbPath, elfPath.string(), snapshot), "database should be written");
+
+        AnalysisDatabase db;
+        t.IsTrue(db.open(dbPath, elfPath.string()), "database should open for the same ELF");
+
+        const DbFunction *loaded = db.findFunction(0x1000);
+        t.IsNotNull(loaded, "function should be found by start address");
+        if (loaded)
+        {
+            t.Equals(std::string(db.functionName(*loaded)), std::string("roundtrip_func"), "function name should round-trip");
+            t.Equals(db.instructions(*loaded).size(), static_cast<size_t>(3), "all instructions should be stored");
+            t.Equals(db.instructions(*loaded)[1].raw, 0x0C000800u, "instruction words should round-trip");
+            t.IsTrue(db.instructions(*loaded)[1].isCall, "decoded flags should round-trip");
+
+            CFG cfg = db.loadCFG(*loaded);
+            t.IsTrue(cfg.contains(0x1000), "CFG node should round-trip");
+            t.Equals(cfg[0x1000].instructions.size(), static_cast<size_t>(3), "CFG node instructions should round-trip");
+            t.Equals(cfg[0x1000].successors.size(), static_cast<size_t>(1), "CFG edges should round-trip");
+
+            auto loadedCalls = db.loadCalls(*loaded);
+            t.Equals(loadedCalls.size(), static_cast<size_t>(1), "calls should round-trip");
+            t.IsTrue(!loadedCalls.empty() && loadedCalls[0].calleeName == "callee", "callee name should round-trip");
+        }
+
+        auto tables = db.loadJumpTables();
+        t.Equals(tables.size(), static_cast<size_t>(1), "jump tables should round-trip");
+        t.IsTrue(!tables.empty() && tables[0].entries.size() == 2 && tables[0].entries[1].target == 0x1008,
+                 "jump table entries should round-trip");
+        t.IsTrue(!tables.empty() && tables[0].jumpAddress == 0x1004, "the dispatching jr address should round-trip");
+
+        db.close();
+        fs::remove(dbPath);
+        fs::remove(elfPath);
+    });
+
+    tc.Run("rejects a database built from a different ELF", [](TestCase &t) {
+        fs::path elfPath = writeFakeElf("ps2x_adb_stale.elf", "original contents");
+        std::string dbPath = AnalysisDatabase::pathForElf(elfPath.string());
+
+        std::vector<Function> functions;
+        std::unordered_map<uint32_t, std::vector<Instruction>> decoded;
+        std::unordered_map<uint32_t, CFG> cfgs;
+        std::vector<JumpTable> jumpTables;
+        std::unordered_map<uint32_t, std::vector<FunctionCall>> calls;
+        AnalysisSnapshot snapshot{functions, decoded, cfgs, jumpTables, calls};
+
+        t.IsTrue(AnalysisDatabase::save(dbPath, elfPath.string(), snapshot), "database should be written");
+
+        writeFakeElf("ps2x_adb_stale.elf", "modified contents");
+
+        AnalysisDatabase db;
+        t.IsFalse(db.open(dbPath, elfPath.string()), "stale database should be rejected");
+
+        fs::remove(dbPath);
+        fs::remove(elfPath);
+    }); });
+}
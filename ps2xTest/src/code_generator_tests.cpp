@@ -84,6 +84,27 @@ void register_code_generator_tests()
         t.IsTrue(generated.find("goto label_2004;") != std::string::npos, "branch to delay slot should use goto");
     });
 
+    tc.Run("backward branches poll for interrupts", [](TestCase &t) {
+        Function func;
+        func.name = "loop_func";
+        func.start = 0x2800;
+        func.end = 0x2810;
+        func.isRecompiled = true;
+        func.isStub = false;
+
+        // 0x2800: nop (loop head)
+        // 0x2804: beq $1,$1, 0x2800 with delay slot at 0x2808
+        std::vector<Instruction> instructions;
+        instructions.push_back(makeNop(0x2800));
+        instructions.push_back(makeBranch(0x2804, static_cast<uint32_t>(-2))); // target = 0x2804 + 4 - 8 = 0x2800
+        instructions.push_back(makeNop(0x2808));
+
+        CodeGenerator gen({});
+        std::string generated = gen.generateFunction(func, instructions, false);
+
+        t.IsTrue(generated.find("runtime->loopSafePoint(); goto label_2800;") != std::string::npos, "loop back-edge should hit a safe point");
+    });
+
     tc.Run("branches outside function still set pc", [](TestCase &t) {
         Function func;
         func.name = "external_branch";
@@ -188,6 +209,48 @@ void register_code_generator_tests()
                  "jump table should use renamed function name");
         });
 
+        tc.Run("recovered jump table jr becomes switch with internal gotos", [](TestCase &t) {
+            Function func;
+            func.name = "switch_func";
+            func.start = 0x7000;
+            func.end = 0x7018;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            Instruction jr{};
+            jr.address = 0x7000;
+            jr.opcode = OPCODE_SPECIAL;
+            jr.function = SPECIAL_JR;
+            jr.rs = 2;
+            jr.hasDelaySlot = true;
+            jr.raw = (2u << 21) | SPECIAL_JR;
+
+            std::vector<Instruction> instructions{jr, makeNop(0x7004), makeNop(0x7008),
+                                                  makeNop(0x700C), makeNop(0x7010), makeNop(0x7014)};
+
+            JumpTable table{};
+            table.address = 0x20000;
+            table.jumpAddress = 0x7000;
+            table.entries = {{0, 0x7008}, {1, 0x7010}, {2, 0x7008}, {3, 0x9000}};
+
+            CodeGenerator gen({});
+            gen.setJumpTables({table});
+
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("label_7008:") != std::string::npos, "table target should get a label");
+            t.IsTrue(generated.find("label_7010:") != std::string::npos, "table target should get a label");
+            t.IsTrue(generated.find("switch ((jumpTarget - 0x7008) >> 2)") != std::string::npos,
+                     "switch should be range-based on the loaded target");
+            t.IsTrue(generated.find("goto label_7008;") != std::string::npos, "internal target should use goto");
+            t.IsTrue(generated.find("// index 0 2") != std::string::npos, "shared targets should collapse into one case");
+            t.IsTrue(generated.find("ctx->pc = 0x9000;") != std::string::npos, "external target should set ctx->pc");
+            t.IsTrue(generated.find("ctx->pc = jumpTarget; return;") != std::string::npos,
+                     "unknown targets should fall back to dynamic dispatch");
+            t.IsTrue(generated.find("ctx->pc = GPR_U32(ctx, 2)") == std::string::npos,
+                     "jr should no longer return to the dispatcher directly");
+        });
+
         tc.Run("reserved identifiers are sanitized and used in calls", [](TestCase &t) {
             Function func;
             func.name = "__is_pointer";
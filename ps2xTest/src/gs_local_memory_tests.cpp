@@ -0,0 +1,182 @@
+#include "MiniTest.h"
+#include "gs_local_memory.h"
+#include "ps2_runtime.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Block and column layouts as drawn in the GS User's Manual, typed in rather than
+    // derived so the swizzle formulas are checked against an independent source.
+
+    // Block number within a page, by block row then block column
+    constexpr uint8_t kBlocks32[4 * 8] = {
+        0, 1, 4, 5, 16, 17, 20, 21,
+        2, 3, 6, 7, 18, 19, 22, 23,
+        8, 9, 12, 13, 24, 25, 28, 29,
+        10, 11, 14, 15, 26, 27, 30, 31,
+    };
+    constexpr uint8_t kBlocks16[8 * 4] = {
+        0, 2, 8, 10,
+        1, 3, 9, 11,
+        4, 6, 12, 14,
+        5, 7, 13, 15,
+        16, 18, 24, 26,
+        17, 19, 25, 27,
+        20, 22, 28, 30,
+        21, 23, 29, 31,
+    };
+
+    // Storage unit within a 64-byte column, by pixel row then pixel column. The 8- and
+    // 4-bit layouts differ between even and odd columns of a block.
+    constexpr uint8_t kColumn32[2 * 8] = {
+        0, 1, 4, 5, 8, 9, 12, 13,
+        2, 3, 6, 7, 10, 11, 14, 15,
+    };
+    constexpr uint8_t kColumn16[2 * 16] = {
+        0, 2, 8, 10, 16, 18, 24, 26, 1, 3, 9, 11, 17, 19, 25, 27,
+        4, 6, 12, 14, 20, 22, 28, 30, 5, 7, 13, 15, 21, 23, 29, 31,
+    };
+    constexpr uint8_t kColumn8Even[4 * 16] = {
+        0, 4, 16, 20, 32, 36, 48, 52, 2, 6, 18, 22, 34, 38, 50, 54,
+        8, 12, 24, 28, 40, 44, 56, 60, 10, 14, 26, 30, 42, 46, 58, 62,
+        33, 37, 49, 53, 1, 5, 17, 21, 35, 39, 51, 55, 3, 7, 19, 23,
+        41, 45, 57, 61, 9, 13, 25, 29, 43, 47, 59, 63, 11, 15, 27, 31,
+    };
+    constexpr uint8_t kColumn8Odd[4 * 16] = {
+        32, 36, 48, 52, 0, 4, 16, 20, 34, 38, 50, 54, 2, 6, 18, 22,
+        40, 44, 56, 60, 8, 12, 24, 28, 42, 46, 58, 62, 10, 14, 26, 30,
+        1, 5, 17, 21, 33, 37, 49, 53, 3, 7, 19, 23, 35, 39, 51, 55,
+        9, 13, 25, 29, 41, 45, 57, 61, 11, 15, 27, 31, 43, 47, 59, 63,
+    };
+    constexpr uint8_t kColumn4Even[4 * 32] = {
+        0, 8, 32, 40, 64, 72, 96, 104, 2, 10, 34, 42, 66, 74, 98, 106,
+        4, 12, 36, 44, 68, 76, 100, 108, 6, 14, 38, 46, 70, 78, 102, 110,
+        16, 24, 48, 56, 80, 88, 112, 120, 18, 26, 50, 58, 82, 90, 114, 122,
+        20, 28, 52, 60, 84, 92, 116, 124, 22, 30, 54, 62, 86, 94, 118, 126,
+        65, 73, 97, 105, 1, 9, 33, 41, 67, 75, 99, 107, 3, 11, 35, 43,
+        69, 77, 101, 109, 5, 13, 37, 45, 71, 79, 103, 111, 7, 15, 39, 47,
+        81, 89, 113, 121, 17, 25, 49, 57, 83, 91, 115, 123, 19, 27, 51, 59,
+        85, 93, 117, 125, 21, 29, 53, 61, 87, 95, 119, 127, 23, 31, 55, 63,
+    };
+    constexpr uint8_t kColumn4Odd[4 * 32] = {
+        64, 72, 96, 104, 0, 8, 32, 40, 66, 74, 98, 106, 2, 10, 34, 42,
+        68, 76, 100, 108, 4, 12, 36, 44, 70, 78, 102, 110, 6, 14, 38, 46,
+        80, 88, 112, 120, 16, 24, 48, 56, 82, 90, 114, 122, 18, 26, 50, 58,
+        84, 92, 116, 124, 20, 28, 52, 60, 86, 94, 118, 126, 22, 30, 54, 62,
+        1, 9, 33, 41, 65, 73, 97, 105, 3, 11, 35, 43, 67, 75, 99, 107,
+        5, 13, 37, 45, 69, 77, 101, 109, 7, 15, 39, 47, 71, 79, 103, 111,
+        17, 25, 49, 57, 81, 89, 113, 121, 19, 27, 51, 59, 83, 91, 115, 123,
+        21, 29, 53, 61, 85, 93, 117, 125, 23, 31, 55, 63, 87, 95, 119, 127,
+    };
+
+    struct ReferenceLayout
+    {
+        uint32_t psm;
+        uint32_t bits;
+        uint32_t blockWidth;
+        uint32_t blockHeight;
+        uint32_t blocksAcross; // blocks per page row
+        uint32_t blocksDown;
+        const uint8_t *blocks;
+        uint32_t columnHeight; // pixel rows per 64-byte column
+        const uint8_t *evenColumn;
+        const uint8_t *oddColumn;
+    };
+
+    const ReferenceLayout kPSMCT32 = {GSLocalMemory::PSMCT32, 32, 8, 8, 8, 4, kBlocks32, 2, kColumn32, kColumn32};
+    const ReferenceLayout kPSMCT16 = {GSLocalMemory::PSMCT16, 16, 16, 8, 4, 8, kBlocks16, 2, kColumn16, kColumn16};
+    const ReferenceLayout kPSMT8 = {GSLocalMemory::PSMT8, 8, 16, 16, 8, 4, kBlocks32, 4, kColumn8Even, kColumn8Odd};
+    const ReferenceLayout kPSMT4 = {GSLocalMemory::PSMT4, 4, 32, 16, 4, 8, kBlocks16, 4, kColumn4Even, kColumn4Odd};
+
+    // Storage unit (word, halfword, byte or nibble) of VRAM holding pixel (x, y)
+    uint32_t referenceUnit(const ReferenceLayout &ref, uint32_t bp, uint32_t bw, uint32_t x, uint32_t y)
+    {
+        const uint32_t pageWidth = ref.blockWidth * ref.blocksAcross;
+        const uint32_t pageHeight = ref.blockHeight * ref.blocksDown;
+        const uint32_t page = (y / pageHeight) * (bw * 64 / pageWidth) + x / pageWidth;
+        const uint32_t blockInPage = ((y % pageHeight) / ref.blockHeight) * ref.blocksAcross + (x % pageWidth) / ref.blockWidth;
+        const uint32_t block = bp + page * GSLocalMemory::kBlocksPerPage + ref.blocks[blockInPage];
+
+        const uint32_t column = (y % ref.blockHeight) / ref.columnHeight;
+        const uint8_t *layout = (column & 1) ? ref.oddColumn : ref.evenColumn;
+        const uint32_t inColumn = layout[(y % ref.columnHeight) * ref.blockWidth + x % ref.blockWidth];
+        return block * (GSLocalMemory::kBlockSize * 8 / ref.bits) + column * (64 * 8 / ref.bits) + inColumn;
+    }
+
+    // Packed little-endian values of the given width; 4-bit values fill the low nibble first
+    void storeBits(std::vector<uint8_t> &data, uint32_t bits, size_t index, uint32_t value)
+    {
+        const size_t bit = index * bits;
+        for (uint32_t i = 0; i < bits; i++)
+        {
+            uint8_t &byte = data[(bit + i) / 8];
+            const uint8_t mask = static_cast<uint8_t>(1u << ((bit + i) % 8));
+            byte = static_cast<uint8_t>(((value >> i) & 1) ? (byte | mask) : (byte & ~mask));
+        }
+    }
+
+    // Writes a rectangle with writeImage and compares all of VRAM with the pixels placed by
+    // the reference layout, then reads it back with readImage. Pixel ids are 16 bits, so
+    // 8- and 4-bit formats take several passes, each storing a different slice of the id.
+    void checkRectangle(TestCase &t, const ReferenceLayout &ref, uint32_t bp, uint32_t bw,
+                        uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+    {
+        const uint32_t passes = std::max(1u, 16 / ref.bits);
+        const uint32_t mask = ref.bits == 32 ? ~0u : (1u << ref.bits) - 1;
+        for (uint32_t pass = 0; pass < passes; pass++)
+        {
+            std::vector<uint8_t> vram(PS2_GS_VRAM_SIZE, 0xA5);
+            std::vector<uint8_t> expected = vram;
+            std::vector<uint8_t> host(static_cast<size_t>(w) * h * ref.bits / 8);
+            for (uint32_t row = 0; row < h; row++)
+            {
+                for (uint32_t col = 0; col < w; col++)
+                {
+                    const size_t index = static_cast<size_t>(row) * w + col;
+                    const uint32_t value = (static_cast<uint32_t>(index + 1) >> (pass * ref.bits)) & mask;
+                    storeBits(host, ref.bits, index, value);
+                    storeBits(expected, ref.bits, referenceUnit(ref, bp, bw, x + col, y + row), value);
+                }
+            }
+
+            GSLocalMemory::writeImage(vram.data(), ref.psm, bp, bw, x, y, w, h, host.data());
+            const size_t misplaced = std::mismatch(vram.begin(), vram.end(), expected.begin()).first - vram.begin();
+            t.Equals(misplaced, vram.size(), "pass " + std::to_string(pass) + ": first VRAM byte off the reference layout at " +
+                                                 std::to_string(misplaced));
+
+            std::vector<uint8_t> readBack(host.size());
+            GSLocalMemory::readImage(vram.data(), ref.psm, bp, bw, x, y, w, h, readBack.data());
+            t.IsTrue(readBack == host, "pass " + std::to_string(pass) + ": readImage should return the written pixels");
+        }
+    }
+}
+
+void register_gs_local_memory_tests()
+{
+    MiniTest::Case("GSLocalMemory", [](TestCase &tc)
+                   {
+    // Each rectangle starts and ends mid-block and straddles a page corner, so it touches
+    // four pages and both whole and partial blocks.
+    tc.Run("PSMCT32 follows the reference block and column layout across pages", [](TestCase &t) {
+        checkRectangle(t, kPSMCT32, 64, 2, 50, 20, 30, 24);
+    });
+
+    tc.Run("PSMCT16 follows the reference block and column layout across pages", [](TestCase &t) {
+        checkRectangle(t, kPSMCT16, 96, 2, 40, 50, 40, 30);
+    });
+
+    tc.Run("PSMT8 follows the reference block and column layout across pages", [](TestCase &t) {
+        checkRectangle(t, kPSMT8, 32, 4, 100, 40, 48, 40);
+    });
+
+    tc.Run("PSMT4 follows the reference block and column layout across pages", [](TestCase &t) {
+        checkRectangle(t, kPSMT4, 128, 4, 96, 100, 64, 40);
+    });
+
+    tc.Run("a base pointer inside a page carries blocks into the next page", [](TestCase &t) {
+        checkRectangle(t, kPSMCT32, 20, 1, 0, 0, 64, 32);
+        checkRectangle(t, kPSMT4, 3, 2, 0, 0, 128, 16);
+    }); });
+}
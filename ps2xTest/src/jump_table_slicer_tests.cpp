@@ -0,0 +1,296 @@
+#include "MiniTest.h"
+#include "ps2recomp/elf_analyzer.h"
+#include "ps2recomp/elf_parser.h"
+#include "ps2recomp/jump_table_slicer.h"
+#include "ps2recomp/r5900_decoder.h"
+#include <elfio/elfio.hpp>
+#include <filesystem>
+
+using namespace ps2recomp;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t kCodeBase = 0x00100000;
+    constexpr uint32_t kDataBase = 0x00200000;
+
+    constexpr uint32_t kZero = 0;
+    constexpr uint32_t kV0 = 2;
+    constexpr uint32_t kV1 = 3;
+    constexpr uint32_t kA0 = 4;
+    constexpr uint32_t kT0 = 8;
+    constexpr uint32_t kGp = 28;
+    constexpr uint32_t kRa = 31;
+
+    uint32_t iType(uint32_t opcode, uint32_t rs, uint32_t rt, uint32_t immediate)
+    {
+        return (opcode << 26) | (rs << 21) | (rt << 16) | (immediate & 0xFFFF);
+    }
+
+    uint32_t rType(uint32_t rs, uint32_t rt, uint32_t rd, uint32_t sa, uint32_t function)
+    {
+        return (rs << 21) | (rt << 16) | (rd << 11) | (sa << 6) | function;
+    }
+
+    uint32_t lui(uint32_t rt, uint32_t immediate) { return iType(0x0F, 0, rt, immediate); }
+    uint32_t addiu(uint32_t rt, uint32_t rs, uint32_t immediate) { return iType(0x09, rs, rt, immediate); }
+    uint32_t sltiu(uint32_t rt, uint32_t rs, uint32_t immediate) { return iType(0x0B, rs, rt, immediate); }
+    uint32_t lw(uint32_t rt, uint32_t offset, uint32_t base) { return iType(0x23, base, rt, offset); }
+    uint32_t sltu(uint32_t rd, uint32_t rs, uint32_t rt) { return rType(rs, rt, rd, 0, 0x2B); }
+    uint32_t addu(uint32_t rd, uint32_t rs, uint32_t rt) { return rType(rs, rt, rd, 0, 0x21); }
+    uint32_t sll(uint32_t rd, uint32_t rt, uint32_t sa) { return rType(0, rt, rd, sa, 0x00); }
+    uint32_t jr(uint32_t rs) { return rType(rs, 0, 0, 0, 0x08); }
+    constexpr uint32_t kNop = 0;
+
+    // Branch offsets count words from the delay slot
+    uint32_t beq(uint32_t rs, uint32_t rt, size_t from, size_t to)
+    {
+        return iType(0x04, rs, rt, static_cast<uint32_t>(to - from - 1));
+    }
+
+    uint32_t bne(uint32_t rs, uint32_t rt, size_t from, size_t to)
+    {
+        return iType(0x05, rs, rt, static_cast<uint32_t>(to - from - 1));
+    }
+
+    // Appends `count` cases that each return, and the table that points at them
+    void appendCases(std::vector<uint32_t> &code, std::vector<uint32_t> &table, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            table.push_back(kCodeBase + static_cast<uint32_t>(code.size()) * 4);
+            code.push_back(jr(kRa));
+            code.push_back(kNop);
+        }
+    }
+
+    fs::path writeFixtureElf(const std::string &name, const std::vector<uint32_t> &code, const std::vector<uint32_t> &data)
+    {
+        ELFIO::elfio writer;
+        writer.create(ELFIO::ELFCLASS32, ELFIO::ELFDATA2LSB);
+        writer.set_type(ELFIO::ET_EXEC);
+        writer.set_machine(ELFIO::EM_MIPS);
+
+        ELFIO::section *text = writer.sections.add(".text");
+        text->set_type(ELFIO::SHT_PROGBITS);
+        text->set_flags(ELFIO::SHF_ALLOC | ELFIO::SHF_EXECINSTR);
+        text->set_addr_align(4);
+        text->set_address(kCodeBase);
+        text->set_data(reinterpret_cast<const char *>(code.data()), static_cast<ELFIO::Elf_Word>(code.size() * 4));
+
+        ELFIO::section *rodata = writer.sections.add(".rodata");
+        rodata->set_type(ELFIO::SHT_PROGBITS);
+        rodata->set_flags(ELFIO::SHF_ALLOC);
+        rodata->set_addr_align(4);
+        rodata->set_address(kDataBase);
+        rodata->set_data(reinterpret_cast<const char *>(data.data()), static_cast<ELFIO::Elf_Word>(data.size() * 4));
+
+        fs::path path = fs::temp_directory_path() / name;
+        writer.save(path.string());
+        return path;
+    }
+
+    struct SliceOutcome
+    {
+        bool parsed = false;
+        JumpTableSliceResult result = JumpTableSliceResult::NotTableLoad;
+        JumpTable table{};
+    };
+
+    // Writes the code and data to an ELF, then slices the first jr that is not a return
+    // over the CFG the analyzer builds for it
+    SliceOutcome sliceFixture(const std::string &name, const std::vector<uint32_t> &code, const std::vector<uint32_t> &data,
+                              uint32_t gpValue = 0)
+    {
+        SliceOutcome outcome;
+        fs::path path = writeFixtureElf(name, code, data);
+        ElfParser parser(path.string());
+        outcome.parsed = parser.parse();
+        if (outcome.parsed)
+        {
+            R5900Decoder decoder;
+            std::vector<Instruction> instructions;
+            for (size_t i = 0; i < code.size(); i++)
+            {
+                instructions.push_back(decoder.decodeInstruction(kCodeBase + static_cast<uint32_t>(i) * 4, code[i]));
+            }
+
+            Function function{};
+            function.name = name;
+            function.start = kCodeBase;
+            function.end = kCodeBase + static_cast<uint32_t>(code.size()) * 4;
+            const CFG cfg = ElfAnalyzer::buildCFG(function, instructions);
+
+            JumpTableSlicer slicer(parser, parser.getSections(), gpValue);
+            for (size_t i = 0; i < instructions.size(); i++)
+            {
+                const Instruction &inst = instructions[i];
+                if (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_JR && inst.rs != kRa)
+                {
+                    outcome.result = slicer.resolve(function, instructions, &cfg, i, outcome.table);
+                    break;
+                }
+            }
+        }
+        fs::remove(path);
+        return outcome;
+    }
+
+    // The usual compiled switch: sltiu/beq guard, scaled index in the delay slot, lui/addiu base
+    std::vector<uint32_t> sltiuSwitch(uint32_t cases, uint32_t bound, std::vector<uint32_t> &table)
+    {
+        std::vector<uint32_t> code{
+            sltiu(kV0, kA0, bound),
+            0, // beq to the default case
+            sll(kV1, kA0, 2),
+            lui(kV0, kDataBase >> 16),
+            addiu(kV0, kV0, kDataBase & 0xFFFF),
+            addu(kV0, kV0, kV1),
+            lw(kV0, 0, kV0),
+            jr(kV0),
+            kNop,
+        };
+        appendCases(code, table, cases);
+        code[1] = beq(kV0, kZero, 1, code.size());
+        code.push_back(jr(kRa)); // default
+        code.push_back(kNop);
+        return code;
+    }
+}
+
+void register_jump_table_slicer_tests()
+{
+    MiniTest::Case("JumpTableSlicer", [](TestCase &tc)
+                   {
+    tc.Run("bounds the index with an sltiu and beq guard", [](TestCase &t) {
+        std::vector<uint32_t> table;
+        std::vector<uint32_t> code = sltiuSwitch(4, 4, table);
+
+        SliceOutcome outcome = sliceFixture("ps2x_slice_sltiu.elf", code, table);
+        t.IsTrue(outcome.parsed, "the fixture ELF should parse");
+        t.Equals(outcome.result, JumpTableSliceResult::Resolved, "the table should be resolved");
+        t.Equals(outcome.table.address, kDataBase, "the table should start at the lui/addiu base");
+        t.Equals(outcome.table.jumpAddress, kCodeBase + 0x1C, "the table should belong to the jr");
+        t.Equals(outcome.table.entries.size(), static_cast<size_t>(4), "the sltiu immediate should bound the table");
+        t.IsTrue(outcome.table.entries.size() == 4 && outcome.table.entries[3].target == table[3],
+                 "entries should hold the case addresses");
+    });
+
+    tc.Run("bounds the index with an sltu and bne guard", [](TestCase &t) {
+        std::vector<uint32_t> code{
+            addiu(kT0, kZero, 5),
+            sltu(kV0, kA0, kT0),
+            0, // bne to the dispatch
+            kNop,
+            jr(kRa), // out of range
+            kNop,
+            sll(kV1, kA0, 2), // dispatch
+            lui(kV0, kDataBase >> 16),
+            addu(kV0, kV0, kV1),
+            lw(kV0, 0x10, kV0),
+            jr(kV0),
+            kNop,
+        };
+        code[2] = bne(kV0, kZero, 2, 6);
+        std::vector<uint32_t> data(4, 0);
+        appendCases(code, data, 5);
+
+        SliceOutcome outcome = sliceFixture("ps2x_slice_sltu.elf", code, data);
+        t.IsTrue(outcome.parsed, "the fixture ELF should parse");
+        t.Equals(outcome.result, JumpTableSliceResult::Resolved, "the table should be resolved");
+        t.Equals(outcome.table.address, kDataBase + 0x10, "the load offset should be part of the base");
+        t.Equals(outcome.table.entries.size(), static_cast<size_t>(5), "the constant compared by sltu should bound the table");
+    });
+
+    tc.Run("finds a $gp-relative table base", [](TestCase &t) {
+        // The SDK's small-data switch: the scaled index is added to $gp and the
+        // load offset is the table's %gp_rel, so the base is only known from $gp
+        constexpr uint32_t kGpValue = kDataBase + 0x7FF0;
+        std::vector<uint32_t> code{
+            sltiu(kV0, kA0, 3),
+            0, // beq to the default case
+            sll(kV1, kA0, 2),
+            addu(kV0, kV1, kGp),
+            lw(kV0, static_cast<uint32_t>(0x20 - 0x7FF0), kV0),
+            jr(kV0),
+            kNop,
+        };
+        std::vector<uint32_t> data(8, 0);
+        appendCases(code, data, 3);
+        code[1] = beq(kV0, kZero, 1, code.size());
+        code.push_back(jr(kRa));
+        code.push_back(kNop);
+
+        SliceOutcome outcome = sliceFixture("ps2x_slice_gp.elf", code, data, kGpValue);
+        t.IsTrue(outcome.parsed, "the fixture ELF should parse");
+        t.Equals(outcome.result, JumpTableSliceResult::Resolved, "the table should be resolved");
+        t.Equals(outcome.table.address, kDataBase + 0x20, "the base should be $gp plus the load offset");
+        t.Equals(outcome.table.entries.size(), static_cast<size_t>(3), "the sltiu immediate should bound the table");
+
+        SliceOutcome unknownGp = sliceFixture("ps2x_slice_gp_unknown.elf", code, data);
+        t.Equals(unknownGp.result, JumpTableSliceResult::UnknownBase, "without a $gp value the base is unknown");
+    });
+
+    tc.Run("rejects a guard on a different definition of the index", [](TestCase &t) {
+        // The table is indexed by the incoming a0, but the check is on a0 + 1
+        std::vector<uint32_t> code{
+            sll(kV1, kA0, 2),
+            addiu(kA0, kA0, 1),
+            sltiu(kV0, kA0, 4),
+            0, // beq to the default case
+            kNop,
+            lui(kV0, kDataBase >> 16),
+            addu(kV0, kV0, kV1),
+            lw(kV0, 0, kV0),
+            jr(kV0),
+            kNop,
+        };
+        std::vector<uint32_t> table;
+        appendCases(code, table, 4);
+        code[3] = beq(kV0, kZero, 3, code.size());
+        code.push_back(jr(kRa));
+        code.push_back(kNop);
+
+        SliceOutcome outcome = sliceFixture("ps2x_slice_redefined.elf", code, table);
+        t.IsTrue(outcome.parsed, "the fixture ELF should parse");
+        t.Equals(outcome.result, JumpTableSliceResult::NoBound, "a guard on the old index should not bound the new one");
+    });
+
+    tc.Run("rejects a bound that runs past the code entries", [](TestCase &t) {
+        std::vector<uint32_t> table;
+        std::vector<uint32_t> code = sltiuSwitch(4, 6, table);
+        table.push_back(kDataBase);  // points at data
+        table.push_back(0x12345678); // points nowhere
+
+        SliceOutcome outcome = sliceFixture("ps2x_slice_overbound.elf", code, table);
+        t.IsTrue(outcome.parsed, "the fixture ELF should parse");
+        t.Equals(outcome.result, JumpTableSliceResult::NoEntries, "slots past the cases are not code");
+        t.IsTrue(outcome.table.entries.empty(), "an unresolved table should be left empty");
+    });
+
+    tc.Run("follows the delay slot of a taken branch", [](TestCase &t) {
+        // The scaled index is only defined in the guard's delay slot, which runs before
+        // the taken edge reaches the dispatch
+        std::vector<uint32_t> code{
+            sltiu(kV0, kA0, 3),
+            0, // bne to the dispatch
+            sll(kV1, kA0, 2),
+            jr(kRa), // out of range
+            kNop,
+            lui(kV0, kDataBase >> 16), // dispatch
+            addu(kV0, kV0, kV1),
+            lw(kV0, 0x40, kV0),
+            jr(kV0),
+            kNop,
+        };
+        code[1] = bne(kV0, kZero, 1, 5);
+        std::vector<uint32_t> data(16, 0);
+        appendCases(code, data, 3);
+
+        SliceOutcome outcome = sliceFixture("ps2x_slice_delay_slot.elf", code, data);
+        t.IsTrue(outcome.parsed, "the fixture ELF should parse");
+        t.Equals(outcome.result, JumpTableSliceResult::Resolved, "the index should be found in the delay slot");
+        t.Equals(outcome.table.address, kDataBase + 0x40, "the table should start at the load offset");
+        t.Equals(outcome.table.entries.size(), static_cast<size_t>(3), "the guard before the branch should bound the table");
+    }); });
+}
@@ -1,11 +1,33 @@
 #include "MiniTest.h"
 
+void register_analysis_database_tests();
 void register_code_generator_tests();
+void register_gs_local_memory_tests();
+void register_jump_table_slicer_tests();
+void register_ps2_alarms_tests();
+void register_ps2_dmac_tests();
+void register_ps2_runtime_tests();
+void register_ps2_scheduler_tests();
+void register_ps2_syscalls_tests();
+void register_ps2_vif_tests();
 void register_r5900_decoder_tests();
+void register_vu_differential_tests();
+void register_vu_recompiler_tests();
 
 int main()
 {
+    register_analysis_database_tests();
     register_code_generator_tests();
+    register_gs_local_memory_tests();
+    register_jump_table_slicer_tests();
+    register_ps2_alarms_tests();
+    register_ps2_dmac_tests();
+    register_ps2_runtime_tests();
+    register_ps2_scheduler_tests();
+    register_ps2_syscalls_tests();
+    register_ps2_vif_tests();
     register_r5900_decoder_tests();
+    register_vu_differential_tests();
+    register_vu_recompiler_tests();
     return MiniTest::Run();
 }
@@ -0,0 +1,90 @@
+#include "MiniTest.h"
+#include "ps2_alarms.h"
+#include <set>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kHandler = 0x100200;
+
+    // Advances to one tick before `expire`, then onto it, and reports whether the alarm
+    // with argument `arg` fired exactly on that tick
+    bool firesExactlyAt(PS2AlarmService &alarms, uint64_t expire, uint32_t arg)
+    {
+        std::vector<PS2AlarmService::Expired> expired;
+        alarms.advance(expire - 1, expired);
+        for (const auto &alarm : expired)
+        {
+            if (alarm.arg == arg)
+            {
+                return false;
+            }
+        }
+        expired.clear();
+        alarms.advance(expire, expired);
+        return expired.size() == 1 && expired[0].arg == arg;
+    }
+}
+
+void register_ps2_alarms_tests()
+{
+    MiniTest::Case("PS2AlarmService", [](TestCase &tc)
+                   {
+    tc.Run("an alarm due on a level 1 cascade tick fires on that tick", [](TestCase &t) {
+        PS2AlarmService alarms;
+        alarms.add(0, 256, kHandler, 1, 0);
+        alarms.add(300, 212, kHandler, 2, 0);
+        t.IsTrue(firesExactlyAt(alarms, 256, 1), "a 256-tick alarm should fire on tick 256");
+        t.IsTrue(firesExactlyAt(alarms, 512, 2), "an alarm due on tick 512 should fire on it");
+    });
+
+    tc.Run("an alarm due on a level 2 cascade tick fires on that tick", [](TestCase &t) {
+        PS2AlarmService alarms;
+        alarms.add(0, 16384, kHandler, 1, 0);
+        alarms.add(0, 16384 + 256, kHandler, 2, 0);
+        alarms.add(100, 0xFFFF, kHandler, 3, 0);
+        t.IsTrue(firesExactlyAt(alarms, 16384, 1), "a 16384-tick alarm should fire on tick 16384");
+        t.IsTrue(firesExactlyAt(alarms, 16384 + 256, 2), "an alarm cascaded through both levels should fire on time");
+        t.IsTrue(firesExactlyAt(alarms, 100 + 0xFFFF, 3), "the longest alarm should fire on time");
+        t.IsFalse(alarms.nextExpiry().has_value(), "no alarm should be left");
+    });
+
+    tc.Run("a stale id does not cancel the alarm reusing its slot", [](TestCase &t) {
+        PS2AlarmService alarms;
+        const int cancelled = alarms.add(0, 10, kHandler, 1, 0);
+        t.IsTrue(alarms.cancel(cancelled), "the first cancel should succeed");
+        const int reused = alarms.add(0, 20, kHandler, 2, 0);
+        t.Equals(reused & (PS2AlarmService::kMaxAlarms - 1), cancelled & (PS2AlarmService::kMaxAlarms - 1),
+                 "the new alarm should reuse the freed slot");
+        t.IsTrue(reused != cancelled, "the reused slot should get a new id");
+        t.IsFalse(alarms.cancel(cancelled), "the stale id should not cancel the new alarm");
+
+        // The same holds for the id of an alarm that already fired
+        t.IsTrue(firesExactlyAt(alarms, 20, 2), "the new alarm should still fire");
+        const int next = alarms.add(20, 5, kHandler, 3, 0);
+        t.IsFalse(alarms.cancel(reused), "the id of a fired alarm should not cancel its successor");
+        t.IsTrue(alarms.cancel(next), "the current id should cancel");
+    });
+
+    tc.Run("a full pool rejects new alarms without touching armed ones", [](TestCase &t) {
+        PS2AlarmService alarms;
+        std::set<int> ids;
+        for (int i = 0; i < PS2AlarmService::kMaxAlarms; i++)
+        {
+            ids.insert(alarms.add(0, static_cast<uint16_t>(100 + i), kHandler, static_cast<uint32_t>(i), 0));
+        }
+        t.Equals(ids.size(), static_cast<size_t>(PS2AlarmService::kMaxAlarms), "every pool slot should give a distinct id");
+        t.IsTrue(*ids.begin() >= 0, "every pool slot should be granted");
+        t.Equals(alarms.add(0, 50, kHandler, 99, 0), -1, "the 65th alarm should be refused");
+
+        std::vector<PS2AlarmService::Expired> expired;
+        alarms.advance(100 + PS2AlarmService::kMaxAlarms, expired);
+        t.Equals(expired.size(), static_cast<size_t>(PS2AlarmService::kMaxAlarms), "all armed alarms should fire");
+        bool inOrder = true;
+        for (size_t i = 0; i < expired.size(); i++)
+        {
+            inOrder &= expired[i].arg == i && expired[i].ticks == 100 + i;
+        }
+        t.IsTrue(inOrder, "each armed alarm should keep its own tick count and argument");
+    }); });
+}
@@ -0,0 +1,272 @@
+#include "MiniTest.h"
+#include "ps2_dmac.h"
+#include "ps2_interrupts.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <initializer_list>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kRamSize = 0x100000;
+    constexpr uint32_t kScratchpadSize = 0x4000;
+    constexpr uint32_t kGif = 0x1000A000;
+    constexpr uint32_t kFromSpr = 0x1000D000;
+
+    // Source chain tag IDs
+    constexpr uint32_t kRefe = 0;
+    constexpr uint32_t kCnt = 1;
+    constexpr uint32_t kRef = 3;
+    constexpr uint32_t kCall = 5;
+    constexpr uint32_t kRet = 6;
+    constexpr uint32_t kEnd = 7;
+
+    constexpr uint32_t kChainFromMemory = PS2Dmac::CHCR_STR | (1 << 2) | PS2Dmac::CHCR_DIR;
+    constexpr uint32_t kGifCis = 1u << PS2Dmac::GIF;
+
+    void putTag(std::vector<uint8_t> &memory, uint32_t at, uint32_t id, uint32_t qwc, uint32_t address = 0, bool irq = false)
+    {
+        const uint64_t tag = qwc | (static_cast<uint64_t>(id) << 28) | (static_cast<uint64_t>(irq) << 31) |
+                             (static_cast<uint64_t>(address) << 32);
+        std::memcpy(memory.data() + at, &tag, sizeof(tag));
+    }
+
+    // One qword per marker, the marker in its first word
+    void putData(std::vector<uint8_t> &memory, uint32_t at, std::initializer_list<uint32_t> markers)
+    {
+        for (uint32_t marker : markers)
+        {
+            std::memcpy(memory.data() + at, &marker, sizeof(marker));
+            at += 16;
+        }
+    }
+
+    // A DMAC with the GIF channel's sink recording the first word of every qword it is sent
+    struct DmacRig
+    {
+        std::vector<uint8_t> rdram = std::vector<uint8_t>(kRamSize);
+        std::vector<uint8_t> scratchpad = std::vector<uint8_t>(kScratchpadSize);
+        std::vector<uint32_t> received;
+        PS2InterruptController interrupts;
+        PS2Dmac dmac{interrupts};
+
+        explicit DmacRig(bool threaded = false)
+        {
+            dmac.setThreaded(threaded);
+            dmac.attach(rdram.data(), kRamSize, scratchpad.data());
+            dmac.setSink(PS2Dmac::GIF, [this](const uint8_t *data, uint32_t qwc)
+                         {
+                             for (uint32_t i = 0; i < qwc; i++)
+                             {
+                                 uint32_t marker;
+                                 std::memcpy(&marker, data + i * 16, sizeof(marker));
+                                 received.push_back(marker);
+                             }
+                             return 0u;
+                         });
+        }
+
+        void startGifChain(uint32_t tadr, uint32_t flags = 0)
+        {
+            dmac.write(kGif + PS2Dmac::TADR, tadr);
+            dmac.write(kGif + PS2Dmac::QWC, 0);
+            dmac.write(kGif + PS2Dmac::CHCR, kChainFromMemory | flags);
+        }
+
+        uint32_t gif(uint32_t reg) { return dmac.read(kGif + reg); }
+        uint32_t dstat() const { return interrupts.read(PS2InterruptController::D_STAT) & 0xFFFF; }
+    };
+}
+
+void register_ps2_dmac_tests()
+{
+    MiniTest::Case("PS2Dmac", [](TestCase &tc)
+                   {
+    tc.Run("CALL and RET nest through both ASR slots", [](TestCase &t) {
+        DmacRig rig;
+        putTag(rig.rdram, 0x1000, kCall, 1, 0x2000);
+        putData(rig.rdram, 0x1010, {1});
+        putTag(rig.rdram, 0x2000, kCall, 1, 0x3000);
+        putData(rig.rdram, 0x2010, {2});
+        putTag(rig.rdram, 0x3000, kRet, 1);
+        putData(rig.rdram, 0x3010, {3});
+        putTag(rig.rdram, 0x2020, kRet, 1);
+        putData(rig.rdram, 0x2030, {4});
+        putTag(rig.rdram, 0x1020, kEnd, 1);
+        putData(rig.rdram, 0x1030, {5});
+        rig.startGifChain(0x1000);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{1, 2, 3, 4, 5}, "the payloads should arrive in call order");
+        t.Equals(rig.dstat(), kGifCis, "only the GIF's CIS should be raised");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at END");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_ASP, 0u, "both returns should pop the ASR stack");
+        t.Equals(rig.gif(PS2Dmac::ASR0), 0x1020u, "ASR0 should hold the outer return address");
+        t.Equals(rig.gif(PS2Dmac::ASR1), 0x2020u, "ASR1 should hold the inner return address");
+    });
+
+    tc.Run("a third nested CALL raises a bus error", [](TestCase &t) {
+        DmacRig rig;
+        putTag(rig.rdram, 0x1000, kCall, 1, 0x2000);
+        putData(rig.rdram, 0x1010, {1});
+        putTag(rig.rdram, 0x2000, kCall, 1, 0x3000);
+        putData(rig.rdram, 0x2010, {2});
+        putTag(rig.rdram, 0x3000, kCall, 1, 0x4000);
+        putData(rig.rdram, 0x3010, {3});
+        putTag(rig.rdram, 0x4000, kEnd, 1);
+        putData(rig.rdram, 0x4010, {4});
+        rig.startGifChain(0x1000);
+
+        t.IsTrue(rig.received.size() >= 2 && rig.received[0] == 1 && rig.received[1] == 2, "the first two calls should be sent");
+        t.IsTrue(std::find(rig.received.begin(), rig.received.end(), 4u) == rig.received.end(), "the chain should stop at the overflow");
+        t.Equals(rig.dstat(), kGifCis | (1u << PS2Dmac::kBusErrorInterrupt), "BEIS and the GIF's CIS should be raised");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear");
+    });
+
+    tc.Run("REFE sends its referenced data and ends the chain", [](TestCase &t) {
+        DmacRig rig;
+        putTag(rig.rdram, 0x1000, kRef, 2, 0x4000);
+        putData(rig.rdram, 0x4000, {10, 11});
+        putTag(rig.rdram, 0x1010, kRefe, 1, 0x5000);
+        putData(rig.rdram, 0x5000, {12});
+        putTag(rig.rdram, 0x1020, kCnt, 1);
+        putData(rig.rdram, 0x1030, {99});
+        rig.startGifChain(0x1000);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{10, 11, 12}, "REF and REFE data should be sent, nothing after REFE");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at REFE");
+        t.Equals(rig.gif(PS2Dmac::TADR), 0x1020u, "TADR should point past the REFE tag");
+        t.Equals(rig.gif(PS2Dmac::MADR), 0x5010u, "MADR should point past the referenced data");
+        t.Equals(rig.gif(PS2Dmac::QWC), 0u, "QWC should be used up");
+        t.Equals(rig.dstat(), kGifCis, "only the GIF's CIS should be raised");
+    });
+
+    tc.Run("END ends the chain after its own data", [](TestCase &t) {
+        DmacRig rig;
+        putTag(rig.rdram, 0x1000, kCnt, 1);
+        putData(rig.rdram, 0x1010, {20});
+        putTag(rig.rdram, 0x1020, kEnd, 2);
+        putData(rig.rdram, 0x1030, {21, 22});
+        putTag(rig.rdram, 0x1050, kCnt, 1);
+        putData(rig.rdram, 0x1060, {99});
+        rig.startGifChain(0x1000);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{20, 21, 22}, "CNT and END data should be sent, nothing after END");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at END");
+        t.Equals(rig.gif(PS2Dmac::MADR), 0x1050u, "MADR should point past the END data");
+        t.Equals(rig.dstat(), kGifCis, "only the GIF's CIS should be raised");
+    });
+
+    tc.Run("TIE stops at a tag with IRQ and a restart carries on from TADR", [](TestCase &t) {
+        DmacRig rig;
+        putTag(rig.rdram, 0x1000, kCnt, 1, 0, true);
+        putData(rig.rdram, 0x1010, {30});
+        putTag(rig.rdram, 0x1020, kEnd, 1);
+        putData(rig.rdram, 0x1030, {31});
+        rig.startGifChain(0x1000, PS2Dmac::CHCR_TIE);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{30}, "the chain should stop after the IRQ tag's data");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at the IRQ tag");
+        t.Equals(rig.gif(PS2Dmac::TADR), 0x1020u, "TADR should point at the next tag");
+        t.Equals(rig.dstat(), kGifCis, "the GIF's CIS should be raised");
+
+        rig.interrupts.write(PS2InterruptController::D_STAT, kGifCis);
+        rig.dmac.write(kGif + PS2Dmac::CHCR, kChainFromMemory | PS2Dmac::CHCR_TIE);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{30, 31}, "the restart should send the rest of the chain");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at END");
+        t.Equals(rig.dstat(), kGifCis, "the GIF's CIS should be raised again");
+    });
+
+    tc.Run("the IRQ bit does not stop a chain without TIE", [](TestCase &t) {
+        DmacRig rig;
+        putTag(rig.rdram, 0x1000, kCnt, 1, 0, true);
+        putData(rig.rdram, 0x1010, {30});
+        putTag(rig.rdram, 0x1020, kEnd, 1);
+        putData(rig.rdram, 0x1030, {31});
+        rig.startGifChain(0x1000);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{30, 31}, "the whole chain should be sent");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at END");
+    });
+
+    tc.Run("an MFIFO drain parks on an empty ring and resumes when fromSPR fills it", [](TestCase &t) {
+        constexpr uint32_t kRing = 0x10000;
+        DmacRig rig;
+        putTag(rig.scratchpad, 0x00, kCnt, 1);
+        putData(rig.scratchpad, 0x10, {40});
+        putTag(rig.scratchpad, 0x20, kEnd, 1);
+        putData(rig.scratchpad, 0x30, {41});
+
+        rig.dmac.write(PS2Dmac::D_RBOR, kRing);
+        rig.dmac.write(PS2Dmac::D_RBSR, 0x3FF0);
+        rig.dmac.write(PS2Dmac::D_CTRL, 1 | (3 << 2)); // DMAE, MFD: GIF drains the ring
+
+        auto fillRing = [&rig](uint32_t madr, uint32_t sadr) {
+            rig.dmac.write(kFromSpr + PS2Dmac::MADR, madr);
+            rig.dmac.write(kFromSpr + PS2Dmac::SADR, sadr);
+            rig.dmac.write(kFromSpr + PS2Dmac::QWC, 2);
+            rig.dmac.write(kFromSpr + PS2Dmac::CHCR, PS2Dmac::CHCR_STR);
+        };
+
+        fillRing(kRing, 0x00);
+        rig.startGifChain(kRing);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{40}, "the drain should send what the ring holds");
+        t.IsTrue(rig.dstat() & (1u << PS2Dmac::kMfifoEmptyInterrupt), "an empty ring should raise MEIS");
+        t.IsFalse(rig.dstat() & kGifCis, "the parked drain should not finish");
+        t.IsTrue(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, "the parked drain should keep STR");
+        t.IsTrue(rig.dmac.busy(PS2Dmac::GIF), "the parked drain should stay busy");
+
+        fillRing(kRing + 0x20, 0x20);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{40, 41}, "the drain should resume once the ring is refilled");
+        t.IsTrue(rig.dstat() & kGifCis, "the drain should finish at END");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear at END");
+        t.IsFalse(rig.dmac.busy(PS2Dmac::GIF), "the drain should no longer be busy");
+    });
+
+    tc.Run("a threaded transfer keeps STR until the guest sees it finish", [](TestCase &t) {
+        DmacRig rig(true);
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        std::atomic<int> notified{0};
+        rig.dmac.setSink(PS2Dmac::GIF, [&rig, released](const uint8_t *data, uint32_t qwc)
+                         {
+                             released.wait();
+                             for (uint32_t i = 0; i < qwc; i++)
+                             {
+                                 uint32_t marker;
+                                 std::memcpy(&marker, data + i * 16, sizeof(marker));
+                                 rig.received.push_back(marker);
+                             }
+                             return 0u;
+                         });
+        rig.dmac.setCompletionNotifier([&notified]()
+                                       {
+                                           notified++;
+                                           notified.notify_all();
+                                       });
+
+        putTag(rig.rdram, 0x1000, kCnt, 1);
+        putData(rig.rdram, 0x1010, {50});
+        putTag(rig.rdram, 0x1020, kEnd, 1);
+        putData(rig.rdram, 0x1030, {51});
+        rig.startGifChain(0x1000);
+
+        t.IsTrue(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, "STR should stay set while the worker runs");
+        t.Equals(rig.gif(PS2Dmac::TADR), 0x1000u, "TADR should hold its start value while the worker runs");
+        t.Equals(rig.dstat(), 0u, "nothing should be raised while the worker runs");
+
+        release.set_value();
+        rig.dmac.waitIdle();
+        // The worker calls the notifier after it goes idle
+        notified.wait(0);
+
+        t.IsTrue(rig.received == std::vector<uint32_t>{50, 51}, "the chain should be sent in order");
+        t.Equals(rig.gif(PS2Dmac::CHCR) & PS2Dmac::CHCR_STR, 0u, "STR should clear once the guest updates");
+        t.Equals(rig.gif(PS2Dmac::TADR), 0x1020u, "TADR should be written back");
+        t.Equals(rig.dstat(), kGifCis, "the GIF's CIS should be raised");
+    }); });
+}
@@ -0,0 +1,92 @@
+#include "MiniTest.h"
+#include "ps2_runtime.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t kSpinEntry = 0x100000;
+    constexpr auto kHangTimeout = std::chrono::seconds(20);
+
+    // A polling loop that never makes a syscall, so only loop safe points see the limits
+    void spinForever(uint8_t *, R5900Context *, PS2Runtime *runtime)
+    {
+        for (;;)
+        {
+            runtime->loopSafePoint();
+        }
+    }
+
+    struct HeadlessRun
+    {
+        bool finished = false;
+        double seconds = 0.0;
+        uint64_t frames = 0;
+    };
+
+    // Runs spinForever headless and gives up after kHangTimeout. A run that hangs is
+    // detached and its runtime leaked, so the test fails instead of blocking the suite.
+    HeadlessRun runSpinningGuest(const PS2Runtime::HeadlessOptions &options)
+    {
+        HeadlessRun result;
+        auto *runtime = new PS2Runtime();
+        runtime->setHeadless(options);
+        if (!runtime->initialize("ps2x_tests"))
+        {
+            delete runtime;
+            return result;
+        }
+        runtime->registerFunction(kSpinEntry, spinForever);
+        runtime->cpu().pc = kSpinEntry;
+
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        const auto start = std::chrono::steady_clock::now();
+        std::thread runner([runtime, done]()
+                           {
+                               runtime->run();
+                               done->store(true);
+                           });
+
+        while (!done->load() && std::chrono::steady_clock::now() - start < kHangTimeout)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!done->load())
+        {
+            runner.detach();
+            return result;
+        }
+
+        runner.join();
+        result.finished = true;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.frames = runtime->presentedFrames();
+        delete runtime;
+        return result;
+    }
+}
+
+void register_ps2_runtime_tests()
+{
+    MiniTest::Case("PS2Runtime", [](TestCase &tc)
+                   {
+    tc.Run("a headless time limit stops a spinning guest", [](TestCase &t) {
+        PS2Runtime::HeadlessOptions options;
+        options.maxSeconds = 0.5;
+        HeadlessRun run = runSpinningGuest(options);
+
+        t.IsTrue(run.finished, "run() should return once the time limit is reached");
+        t.IsTrue(run.seconds >= 0.5, "the guest should run until the limit");
+    });
+
+    tc.Run("a headless frame limit stops a spinning guest", [](TestCase &t) {
+        PS2Runtime::HeadlessOptions options;
+        options.maxFrames = 5;
+        HeadlessRun run = runSpinningGuest(options);
+
+        t.IsTrue(run.finished, "run() should return once the frame limit is reached");
+        t.Equals(run.frames, static_cast<uint64_t>(5), "exactly the allowed frames should be presented");
+    }); });
+}
@@ -0,0 +1,127 @@
+#include "MiniTest.h"
+#include "ps2_runtime.h"
+#include "ps2_scheduler.h"
+
+namespace
+{
+    constexpr uint32_t kEntry = 0x100000;
+    constexpr uint32_t kWorkerEntry = 0x100100;
+
+    // What the guest entry saw, read back once the scheduler returns
+    struct SleepResult
+    {
+        int wakeupResult = 0;
+        uint32_t pendingWakeups = 0;
+        int sleepResult = -1;
+        bool slept = false;
+    };
+
+    SleepResult g_interruptWakeup;
+    SleepResult g_threadWakeup;
+
+    // Mirrors iWakeupThread from a handler delivered at the safe point in front of SleepThread
+    void wakeSelfFromInterrupt(uint8_t *, R5900Context *, PS2Runtime *runtime)
+    {
+        PS2Scheduler &scheduler = runtime->scheduler();
+        scheduler.post([&scheduler]()
+                       { g_interruptWakeup.wakeupResult = scheduler.wakeup(PS2Scheduler::kSelfThreadId); });
+        scheduler.safePoint();
+
+        g_interruptWakeup.pendingWakeups = scheduler.thread(scheduler.currentThreadId())->wakeupCount;
+        if (g_interruptWakeup.pendingWakeups != 0)
+        {
+            // Only sleep when the wakeup was counted, so a regression fails instead of hanging
+            g_interruptWakeup.sleepResult = scheduler.sleep();
+            g_interruptWakeup.slept = true;
+        }
+    }
+
+    void wakeSelfFromThread(uint8_t *, R5900Context *, PS2Runtime *runtime)
+    {
+        PS2Scheduler &scheduler = runtime->scheduler();
+        g_threadWakeup.wakeupResult = scheduler.wakeup(PS2Scheduler::kSelfThreadId);
+        g_threadWakeup.pendingWakeups = scheduler.thread(scheduler.currentThreadId())->wakeupCount;
+    }
+
+    // Host state a terminated thread leaves on its fiber stack
+    struct TerminateResult
+    {
+        int starts = 0;
+        int unwound = 0;
+        int terminateResult[2] = {-1, -1};
+        int restartResult = -1;
+    };
+
+    TerminateResult g_terminate;
+
+    struct StackGuard
+    {
+        ~StackGuard() { g_terminate.unwound++; }
+    };
+
+    void sleepHoldingGuard(uint8_t *, R5900Context *, PS2Runtime *runtime)
+    {
+        StackGuard guard;
+        g_terminate.starts++;
+        runtime->scheduler().sleep();
+    }
+
+    // The worker outranks main, so each StartThread runs it up to its SleepThread
+    void terminateSleepingWorker(uint8_t *, R5900Context *context, PS2Runtime *runtime)
+    {
+        PS2Scheduler &scheduler = runtime->scheduler();
+        PS2Scheduler::ThreadParams params;
+        params.entry = kWorkerEntry;
+        params.priority = 0;
+        int worker = scheduler.createThread(params);
+
+        scheduler.startThread(worker, 0, *context);
+        g_terminate.terminateResult[0] = scheduler.terminateThread(worker);
+        g_terminate.restartResult = scheduler.startThread(worker, 0, *context);
+        g_terminate.terminateResult[1] = scheduler.terminateThread(worker);
+    }
+
+    void runMainThread(PS2Runtime::RecompiledFunction entry)
+    {
+        PS2Runtime runtime;
+        runtime.registerFunction(kEntry, entry);
+        runtime.registerFunction(kWorkerEntry, sleepHoldingGuard);
+        R5900Context context{};
+        runtime.scheduler().run(&runtime, nullptr, &context, kEntry);
+    }
+}
+
+void register_ps2_scheduler_tests()
+{
+    MiniTest::Case("PS2Scheduler", [](TestCase &tc)
+                   {
+    tc.Run("counts a wakeup of the interrupted thread from a handler", [](TestCase &t) {
+        g_interruptWakeup = SleepResult{};
+        runMainThread(wakeSelfFromInterrupt);
+
+        t.Equals(g_interruptWakeup.wakeupResult, 0, "iWakeupThread on the interrupted thread should succeed");
+        t.Equals(g_interruptWakeup.pendingWakeups, 1u, "the wakeup should be counted");
+        t.IsTrue(g_interruptWakeup.slept, "the thread should reach SleepThread");
+        t.Equals(g_interruptWakeup.sleepResult, 0, "SleepThread should consume the counted wakeup without blocking");
+    });
+
+    tc.Run("rejects a thread waking itself outside a handler", [](TestCase &t) {
+        g_threadWakeup = SleepResult{};
+        runMainThread(wakeSelfFromThread);
+
+        t.Equals(g_threadWakeup.wakeupResult, -1, "WakeupThread on the calling thread should fail");
+        t.Equals(g_threadWakeup.pendingWakeups, 0u, "a rejected wakeup should not be counted");
+    });
+
+    tc.Run("unwinds the stack of a terminated thread", [](TestCase &t) {
+        g_terminate = TerminateResult{};
+        runMainThread(terminateSleepingWorker);
+
+        t.Equals(g_terminate.terminateResult[0], 0, "TerminateThread should stop the sleeping worker");
+        t.Equals(g_terminate.restartResult, 0, "a terminated thread should start again");
+        t.Equals(g_terminate.terminateResult[1], 0, "the restarted worker should terminate as well");
+        t.Equals(g_terminate.starts, 2, "the restarted worker should run from its entry");
+        t.Equals(g_terminate.unwound, 2, "host objects on both abandoned stacks should be destroyed");
+    });
+                   });
+}
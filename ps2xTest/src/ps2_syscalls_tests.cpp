@@ -0,0 +1,113 @@
+#include "MiniTest.h"
+#include "ps2_runtime.h"
+#include "ps2_runtime_macros.h"
+#include "ps2_scheduler.h"
+#include "ps2_syscalls.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kEntry = 0x100000;
+    constexpr uint32_t kWaiterEntry = 0x100100;
+    constexpr uint32_t kParamAddress = 0x1000;
+    constexpr uint32_t kAlarmHandler = 0x100200;
+
+    // Loads the argument registers and makes the syscall like generated code does
+    int32_t callSyscall(void (*syscall)(uint8_t *, R5900Context *, PS2Runtime *), uint8_t *rdram, R5900Context *ctx,
+                        PS2Runtime *runtime, uint32_t a0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0)
+    {
+        SET_GPR_U32(ctx, 4, a0);
+        SET_GPR_U32(ctx, 5, a1);
+        SET_GPR_U32(ctx, 6, a2);
+        SET_GPR_U32(ctx, 7, a3);
+        syscall(rdram, ctx, runtime);
+        return static_cast<int32_t>(getRegU32(ctx, 2));
+    }
+
+    struct EventFlagResult
+    {
+        int flag = -1;
+        int waits = 0;
+        int waitResult[2] = {1, 1};
+        int terminateResult = -1;
+        uint32_t waitingAfterTerminate = ~0u;
+    };
+
+    EventFlagResult g_eventFlag;
+
+    // Waits for bit 0 of the flag; outranks main, so it runs as soon as it starts
+    void waitForBit(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        int slot = g_eventFlag.waits++;
+        g_eventFlag.waitResult[slot] = callSyscall(ps2_syscalls::WaitEventFlag, rdram, ctx, runtime, g_eventFlag.flag, 1, 0, 0);
+    }
+
+    void terminateEventFlagWaiter(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+    {
+        // EventFlagParam: attr 0 allows a single waiter
+        const uint32_t param[3] = {0, 0, 0};
+        std::memcpy(getMemPtr(rdram, kParamAddress), param, sizeof(param));
+        g_eventFlag.flag = callSyscall(ps2_syscalls::CreateEventFlag, rdram, ctx, runtime, kParamAddress);
+
+        PS2Scheduler &scheduler = runtime->scheduler();
+        PS2Scheduler::ThreadParams params;
+        params.entry = kWaiterEntry;
+        params.priority = 0;
+        int first = scheduler.createThread(params);
+        int second = scheduler.createThread(params);
+
+        scheduler.startThread(first, 0, *ctx);
+        g_eventFlag.terminateResult = callSyscall(ps2_syscalls::TerminateThread, rdram, ctx, runtime, first);
+
+        // EventFlagStatus: attr, option, initBits, currBits, numThreads
+        callSyscall(ps2_syscalls::ReferEventFlagStatus, rdram, ctx, runtime, g_eventFlag.flag, kParamAddress);
+        std::memcpy(&g_eventFlag.waitingAfterTerminate, getMemPtr(rdram, kParamAddress + 16), 4);
+
+        scheduler.startThread(second, 0, *ctx);
+        callSyscall(ps2_syscalls::SetEventFlag, rdram, ctx, runtime, g_eventFlag.flag, 1);
+        callSyscall(ps2_syscalls::DeleteEventFlag, rdram, ctx, runtime, g_eventFlag.flag);
+    }
+}
+
+void register_ps2_syscalls_tests()
+{
+    MiniTest::Case("PS2Syscalls", [](TestCase &tc)
+                   {
+    tc.Run("a terminated waiter does not keep a single-waiter event flag busy", [](TestCase &t) {
+        g_eventFlag = EventFlagResult{};
+        std::vector<uint8_t> rdram(PS2_RAM_SIZE);
+        PS2Runtime runtime;
+        runtime.registerFunction(kEntry, terminateEventFlagWaiter);
+        runtime.registerFunction(kWaiterEntry, waitForBit);
+        R5900Context context{};
+        runtime.scheduler().run(&runtime, rdram.data(), &context, kEntry);
+
+        t.IsTrue(g_eventFlag.flag > 0, "CreateEventFlag should return an id");
+        t.Equals(g_eventFlag.terminateResult, 2, "TerminateThread should stop the first waiter");
+        t.Equals(g_eventFlag.waitingAfterTerminate, 0u, "the terminated waiter should not be counted");
+        t.Equals(g_eventFlag.waits, 2, "both waiters should have called WaitEventFlag");
+        t.Equals(g_eventFlag.waitResult[0], 1, "the terminated wait should never return");
+        t.Equals(g_eventFlag.waitResult[1], 0, "the second waiter should block and be woken by SetEventFlag");
+    });
+
+    tc.Run("SetAlarm fails once every alarm is in use", [](TestCase &t) {
+        std::vector<uint8_t> rdram(PS2_RAM_SIZE);
+        PS2Runtime runtime;
+        R5900Context context{};
+        std::vector<int32_t> ids;
+        for (int i = 0; i < PS2AlarmService::kMaxAlarms; i++)
+        {
+            ids.push_back(callSyscall(ps2_syscalls::SetAlarm, rdram.data(), &context, &runtime, 0xFFFF, kAlarmHandler, i));
+        }
+        const int32_t refused = callSyscall(ps2_syscalls::SetAlarm, rdram.data(), &context, &runtime, 0xFFFF, kAlarmHandler, 99);
+
+        t.Equals(refused, -1, "the 65th SetAlarm should return an error");
+        bool allCancelled = true;
+        for (int32_t id : ids)
+        {
+            allCancelled &= id >= 0 && callSyscall(ps2_syscalls::CancelAlarm, rdram.data(), &context, &runtime, id) == 0;
+        }
+        t.IsTrue(allCancelled, "every alarm armed before the refusal should still cancel by its id");
+    }); });
+}
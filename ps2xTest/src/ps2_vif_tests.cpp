@@ -0,0 +1,157 @@
+#include "MiniTest.h"
+#include "ps2_vif.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kDataSize = 16 * 1024; // VU1 data memory
+    constexpr uint32_t kFill = 0xEEEEEEEE;    // untouched VU memory
+
+    constexpr uint32_t kStMask = 0x20000000;
+    constexpr uint32_t kStRow = 0x30000000;
+    constexpr uint32_t kStCol = 0x31000000;
+
+    // UNPACK formats (VN << 2 | VL) and flags
+    constexpr uint32_t kV3_16 = 0x09;
+    constexpr uint32_t kV4_32 = 0x0C;
+    constexpr uint32_t kV4_5 = 0x0F;
+    constexpr uint32_t kMasked = 0x10;
+    constexpr uint32_t kUnsigned = 0x4000;
+
+    constexpr uint32_t stcycl(uint32_t cl, uint32_t wl)
+    {
+        return 0x01000000 | (wl << 8) | cl;
+    }
+
+    constexpr uint32_t stmod(uint32_t mode)
+    {
+        return 0x05000000 | mode;
+    }
+
+    constexpr uint32_t unpack(uint32_t format, uint32_t num, uint32_t imm)
+    {
+        return ((0x60 | format) << 24) | (num << 16) | imm;
+    }
+
+    using Qword = std::array<uint32_t, 4>;
+
+    struct UnpackCase
+    {
+        const char *name;
+        std::vector<uint32_t> stream; // VIF codes and data, padded to qwords with NOPs
+        std::vector<std::pair<uint32_t, Qword>> expected; // VU data memory, by qword address
+        bool checkRow = false;
+        Qword row{};
+    };
+
+    const std::vector<UnpackCase> &unpackCases()
+    {
+        static const std::vector<UnpackCase> cases = {
+            {"V4-5 expands RGBA5551 to 8 bits per field",
+             {stcycl(1, 1), unpack(kV4_5, 2, 0x10),
+              // 0xC0BF: A 1, B 0x10, G 0x05, R 0x1F; 0x7FE1: A 0, B 0x1F, G 0x1F, R 0x01
+              0x7FE1C0BF, 0},
+             {{0x10, {0xF8, 0x28, 0x80, 0x80}}, {0x11, {0x08, 0xF8, 0xF8, 0}}}},
+
+            {"V3-16 sign-extends and leaves W zero",
+             {stcycl(1, 1), unpack(kV3_16, 2, 0x20), 0x7FFF8000, 0x0001FFFE, 0x1234FF00, 0, 0, 0},
+             {{0x20, {0xFFFF8000, 0x7FFF, 0xFFFFFFFE, 0}}, {0x21, {1, 0xFFFFFF00, 0x1234, 0}}}},
+
+            {"V3-16 with USN zero-extends",
+             {stcycl(1, 1), unpack(kV3_16, 2, 0x20 | kUnsigned), 0x7FFF8000, 0x0001FFFE, 0x1234FF00, 0, 0, 0},
+             {{0x20, {0x8000, 0x7FFF, 0xFFFE, 0}}, {0x21, {1, 0xFF00, 0x1234, 0}}}},
+
+            {"a masked unpack takes each field from data, row, column or memory",
+             {kStRow, 0x100, 0x200, 0x300, 0x400,
+              kStCol, 0xC0, 0xC1, 0xC2, 0xC3,
+              // Cycle 0: X data, Y row, Z column, W kept; cycle 1: X kept, Y column, Z row, W data
+              kStMask, 0x1BE4,
+              stcycl(4, 4), unpack(kV4_32 | kMasked, 2, 0x30),
+              0x11, 0x12, 0x13, 0x14,
+              0x21, 0x22, 0x23, 0x24,
+              0, 0},
+             {{0x30, {0x11, 0x200, 0xC0, kFill}}, {0x31, {kFill, 0xC1, 0x300, 0x24}}}},
+
+            {"mode 1 adds the row without changing it",
+             {kStRow, 1, 2, 3, 4, stmod(1), stcycl(1, 1), unpack(kV4_32, 2, 0x40),
+              10, 20, 30, 40,
+              100, 200, 300, 400},
+             {{0x40, {11, 22, 33, 44}}, {0x41, {101, 202, 303, 404}}},
+             true,
+             {1, 2, 3, 4}},
+
+            {"mode 2 accumulates into the row",
+             {kStRow, 1, 2, 3, 4, stmod(2), stcycl(1, 1), unpack(kV4_32, 2, 0x40),
+              10, 20, 30, 40,
+              100, 200, 300, 400},
+             {{0x40, {11, 22, 33, 44}}, {0x41, {111, 222, 333, 444}}},
+             true,
+             {111, 222, 333, 444}},
+
+            {"CL above WL skips qwords",
+             {stcycl(2, 1), unpack(kV4_32, 2, 0x50),
+              1, 2, 3, 4,
+              5, 6, 7, 8,
+              0, 0},
+             {{0x50, {1, 2, 3, 4}}, {0x51, {kFill, kFill, kFill, kFill}}, {0x52, {5, 6, 7, 8}}}},
+
+            {"WL above CL fills from the mask",
+             {kStCol, 0xC0, 0xC1, 0xC2, 0xC3,
+              // Cycle 0 from the data, cycle 1 all column
+              kStMask, 0xAA00,
+              stcycl(1, 2), unpack(kV4_32 | kMasked, 4, 0x60),
+              1, 2, 3, 4,
+              5, 6, 7, 8,
+              0, 0, 0},
+             {{0x60, {1, 2, 3, 4}}, {0x61, {0xC1, 0xC1, 0xC1, 0xC1}},
+              {0x62, {5, 6, 7, 8}}, {0x63, {0xC1, 0xC1, 0xC1, 0xC1}}}},
+        };
+        return cases;
+    }
+
+    // Feeds the stream to VIF1, `chunk` qwords per transfer, and checks VU memory and the row
+    void runCase(TestCase &t, const UnpackCase &c, uint32_t chunk)
+    {
+        std::vector<uint32_t> data(kDataSize / 4, kFill);
+        PS2Vif vif(1);
+        vif.attach(nullptr, 0, reinterpret_cast<uint8_t *>(data.data()), kDataSize);
+
+        const uint32_t qwc = static_cast<uint32_t>(c.stream.size() / 4);
+        for (uint32_t q = 0; q < qwc; q += chunk)
+        {
+            vif.transfer(reinterpret_cast<const uint8_t *>(c.stream.data() + q * 4), std::min(chunk, qwc - q));
+        }
+
+        const std::string how = chunk == 1 ? " (one qword per transfer)" : "";
+        t.Equals(c.stream.size() % 4, static_cast<size_t>(0), "the stream should be whole qwords");
+        t.IsFalse(vif.regs().stat & PS2Vif::STAT_ER1, "the stream should not raise a VIF error" + how);
+        for (const auto &[address, expected] : c.expected)
+        {
+            Qword actual;
+            std::memcpy(actual.data(), &data[address * 4], sizeof(actual));
+            t.IsTrue(actual == expected, "qword " + std::to_string(address) + " should match" + how);
+        }
+        if (c.checkRow)
+        {
+            const Qword row = {vif.regs().r[0], vif.regs().r[1], vif.regs().r[2], vif.regs().r[3]};
+            t.IsTrue(row == c.row, "the row registers should match" + how);
+        }
+    }
+}
+
+void register_ps2_vif_tests()
+{
+    MiniTest::Case("PS2Vif", [](TestCase &tc)
+                   {
+    for (const UnpackCase &c : unpackCases())
+    {
+        tc.Run(c.name, [&c](TestCase &t) {
+            runCase(t, c, ~0u);
+            runCase(t, c, 1);
+        });
+    } });
+}
@@ -0,0 +1,259 @@
+#include "MiniTest.h"
+#include "ps2_interrupts.h"
+#include "ps2_vu.h"
+#include "vu_test_programs.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kMemorySize = 16 * 1024;
+    constexpr int kRandomRounds = 4;
+
+    // VU1 with its own micro and data memory, run on the calling thread
+    struct TestVu
+    {
+        PS2InterruptController interrupts;
+        std::vector<uint8_t> code = std::vector<uint8_t>(kMemorySize);
+        std::vector<uint8_t> data = std::vector<uint8_t>(kMemorySize);
+        PS2VectorUnit vu{1, interrupts};
+
+        TestVu()
+        {
+            vu.setThreaded(false);
+            vu.attach(code.data(), kMemorySize, data.data(), kMemorySize);
+        }
+
+        void load(const VuTestProgram &program)
+        {
+            vu.reset();
+            std::fill(code.begin(), code.end(), 0);
+            std::fill(data.begin(), data.end(), 0);
+            std::memcpy(code.data() + program.loadAddress, program.words, program.wordCount * 4);
+            vu.invalidateMicroprograms();
+        }
+
+        uint64_t run(const VuTestProgram &program)
+        {
+            const uint64_t before = vu.instructionCount();
+            vu.start(program.entry, false, 0x12, 0x34);
+            return vu.instructionCount() - before;
+        }
+    };
+
+    const VuTestProgram *findProgram(const std::string &name)
+    {
+        for (size_t i = 0; i < kVuTestProgramCount; i++)
+        {
+            if (name == kVuTestPrograms[i].name)
+            {
+                return &kVuTestPrograms[i];
+            }
+        }
+        return nullptr;
+    }
+
+    float randomFloat(std::mt19937 &rng, int range, float scale)
+    {
+        return static_cast<float>(static_cast<int>(rng() % (2 * range + 1)) - range) / scale;
+    }
+
+    // Registers and data memory a program can work on, with the odd huge, zero or
+    // non-float value so clamping and the flags get exercised
+    void randomizeState(std::mt19937 &rng, PS2VectorUnit::Registers &regs, std::vector<uint8_t> &data)
+    {
+        for (size_t offset = 0; offset < data.size(); offset += 4)
+        {
+            const uint32_t raw = rng();
+            const float value = randomFloat(rng, 10000, 64.0f);
+            if (rng() % 4)
+            {
+                std::memcpy(data.data() + offset, &value, 4);
+            }
+            else
+            {
+                std::memcpy(data.data() + offset, &raw, 4);
+            }
+        }
+
+        for (int reg = 1; reg < 32; reg++)
+        {
+            for (int lane = 0; lane < 4; lane++)
+            {
+                float value = randomFloat(rng, 1000, 8.0f);
+                if (rng() % 40 == 0)
+                {
+                    value = 3e38f;
+                }
+                if (rng() % 40 == 0)
+                {
+                    value = 0.0f;
+                }
+                regs.vf[reg][lane] = value;
+            }
+        }
+        for (int lane = 0; lane < 4; lane++)
+        {
+            regs.acc[lane] = randomFloat(rng, 1000, 4.0f);
+        }
+        for (int reg = 1; reg < 15; reg++)
+        {
+            regs.vi[reg] = static_cast<uint16_t>(rng() % 0x400);
+        }
+        regs.vi[15] = static_cast<uint16_t>(1 + rng() % 3); // the loop count
+        regs.q = 1.5f;
+        regs.p = -2.0f;
+        regs.i = 0.75f;
+        regs.r = 0x3F800000 | (rng() & 0x7FFFFF);
+        regs.status = rng() & 0xFC0;
+        regs.mac = rng() & 0xFFFF;
+        regs.clip = rng() & 0xFFFFFF;
+    }
+
+    // Empty when both units ended in the same state, otherwise what differs first
+    std::string difference(TestVu &a, TestVu &b)
+    {
+        const PS2VectorUnit::Registers &x = a.vu.registers();
+        const PS2VectorUnit::Registers &y = b.vu.registers();
+        for (int reg = 0; reg < 32; reg++)
+        {
+            if (std::memcmp(x.vf[reg], y.vf[reg], sizeof(x.vf[reg])) != 0)
+            {
+                return "VF" + std::to_string(reg);
+            }
+        }
+        for (int reg = 0; reg < 16; reg++)
+        {
+            if (x.vi[reg] != y.vi[reg])
+            {
+                return "VI" + std::to_string(reg);
+            }
+        }
+        if (std::memcmp(x.acc, y.acc, sizeof(x.acc)) != 0)
+        {
+            return "ACC";
+        }
+        if (std::memcmp(&x.q, &y.q, 4) != 0 || std::memcmp(&x.p, &y.p, 4) != 0 ||
+            std::memcmp(&x.i, &y.i, 4) != 0 || x.r != y.r)
+        {
+            return "Q, P, I or R";
+        }
+        if (x.mac != y.mac || x.status != y.status || x.clip != y.clip)
+        {
+            return "flags";
+        }
+        if (x.pc != y.pc)
+        {
+            return "pc";
+        }
+        if (a.data != b.data)
+        {
+            return "data memory";
+        }
+        return "";
+    }
+}
+
+void register_vu_differential_tests()
+{
+    MiniTest::Case("VuDifferential", [](TestCase &tc)
+                   {
+    tc.Run("recompiled random programs match the interpreter", [](TestCase &t) {
+        TestVu interpreted;
+        TestVu recompiled;
+        for (size_t i = 0; i < kVuTestProgramCount; i++)
+        {
+            recompiled.vu.addMicroprogram(kVuTestPrograms[i].program);
+        }
+
+        std::mt19937 rng(7);
+        int runs = 0;
+        int mismatches = 0;
+        std::string first;
+        for (size_t i = 0; i < kVuTestProgramCount; i++)
+        {
+            const VuTestProgram &program = kVuTestPrograms[i];
+            if (std::strncmp(program.name, "random", 6) != 0)
+            {
+                continue;
+            }
+
+            for (int round = 0; round < kRandomRounds; round++)
+            {
+                interpreted.load(program);
+                recompiled.load(program);
+                randomizeState(rng, interpreted.vu.registers(), interpreted.data);
+                recompiled.vu.registers() = interpreted.vu.registers();
+                recompiled.data = interpreted.data;
+
+                const uint64_t interpretedCount = interpreted.run(program);
+                const uint64_t recompiledCount = recompiled.run(program);
+                runs++;
+
+                std::string differs = difference(interpreted, recompiled);
+                if (differs.empty() && interpretedCount != recompiledCount)
+                {
+                    differs = "instruction count";
+                }
+                if (!differs.empty() && mismatches++ == 0)
+                {
+                    first = std::string(program.name) + ", round " + std::to_string(round) + ": " + differs;
+                }
+            }
+        }
+
+        t.Equals(mismatches, 0, "recompiled runs should end like interpreted ones (first: " + first + ")");
+        t.Equals(recompiled.vu.recompiledRuns(), static_cast<uint64_t>(runs), "every run should start in recompiled code");
+        t.Equals(interpreted.vu.recompiledRuns(), static_cast<uint64_t>(0), "the reference unit should only interpret");
+    });
+
+    // Named programs set VI1-VI5 along the path they take; see tools/vu_test_program_generator.cpp
+    struct Handoff
+    {
+        const char *name;
+        uint16_t vi[6];
+        uint32_t pc;
+    };
+    static const Handoff kHandoffs[] = {
+        {"branch in a delay slot", {0, 1, 0, 1, 0, 1}, 0x40},
+        {"E bit in a delay slot", {0, 1, 0, 1, 0, 0}, 0x28},
+        {"jump out of the program", {0, 6, 1, 1, 0, 0}, 0x40},
+        {"branch off the end of the program", {0, 1, 1, 0, 1, 0}, 0x30},
+    };
+
+    for (const Handoff &handoff : kHandoffs)
+    {
+        tc.Run(std::string("hands a run to the interpreter: ") + handoff.name, [&handoff](TestCase &t) {
+            const VuTestProgram *program = findProgram(handoff.name);
+            t.IsNotNull(program, "the generator should have emitted the program");
+            if (!program)
+            {
+                return;
+            }
+
+            TestVu interpreted;
+            TestVu recompiled;
+            recompiled.vu.addMicroprogram(program->program);
+            interpreted.load(*program);
+            recompiled.load(*program);
+            const uint64_t interpretedCount = interpreted.run(*program);
+            const uint64_t recompiledCount = recompiled.run(*program);
+
+            t.Equals(recompiled.vu.recompiledRuns(), static_cast<uint64_t>(1), "the run should start in recompiled code");
+            const std::string differs = difference(interpreted, recompiled);
+            t.IsTrue(differs.empty(), "the interpreter should finish the run the same way (" + differs + " differs)");
+            t.Equals(recompiledCount, interpretedCount, "both should count the same instructions");
+
+            const PS2VectorUnit::Registers &regs = recompiled.vu.registers();
+            for (int reg = 1; reg < 6; reg++)
+            {
+                t.Equals(regs.vi[reg], handoff.vi[reg], "VI" + std::to_string(reg) + " should show the path taken");
+            }
+            t.Equals(regs.pc, handoff.pc, "the program should stop after the E bit's delay slot");
+        });
+    }
+                   });
+}
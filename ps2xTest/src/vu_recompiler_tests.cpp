@@ -0,0 +1,204 @@
+#include "MiniTest.h"
+#include "ps2recomp/vu_recompiler.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ps2recomp;
+
+namespace
+{
+    constexpr uint32_t kUpperNop = 0x000002FF;    // NOP
+    constexpr uint32_t kUpperEnd = 0x400002FF;    // NOP with the E bit
+    constexpr uint32_t kLowerNop = 0x8000033C;    // MOVE.none VF0, VF0
+    constexpr uint32_t kLowerXgkick = 0x80000EFC; // XGKICK VI1
+
+    uint32_t vifMpg(uint32_t num, uint32_t loadAddress)
+    {
+        return (0x4Au << 24) | ((num & 0xFF) << 16) | (loadAddress / 8);
+    }
+
+    // ADD.xyzw fd, fs, ft
+    uint32_t upperAdd(int fd, int fs, int ft)
+    {
+        return (0xFu << 21) | (ft << 16) | (fs << 11) | (fd << 6) | 0x28;
+    }
+
+    // IADDIU it, is, imm / ISUBIU it, is, imm
+    uint32_t lowerIaddiu(int it, int is, uint32_t imm)
+    {
+        return (0x08u << 25) | (it << 16) | (is << 11) | imm;
+    }
+
+    uint32_t lowerIsubiu(int it, int is, uint32_t imm)
+    {
+        return (0x09u << 25) | (it << 16) | (is << 11) | imm;
+    }
+
+    // IBNE it, is, offset (in instructions, from the delay slot)
+    uint32_t lowerIbne(int it, int is, int32_t offset)
+    {
+        return (0x29u << 25) | (it << 16) | (is << 11) | (static_cast<uint32_t>(offset) & 0x7FF);
+    }
+
+    uint32_t lowerJr(int is)
+    {
+        return (0x24u << 25) | (is << 11);
+    }
+
+    void append(std::vector<uint8_t> &out, uint32_t word)
+    {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &word, 4);
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    void appendInstruction(std::vector<uint8_t> &out, uint32_t upper, uint32_t lower)
+    {
+        append(out, lower);
+        append(out, upper);
+    }
+
+    // A DMA tag and a VIF NOP, so the MPG that follows lands at 4 mod 8
+    void appendMpg(std::vector<uint8_t> &out, uint32_t num, uint32_t loadAddress)
+    {
+        append(out, 0x10000000 | (num / 2 + 1));
+        append(out, 0);
+        append(out, 0);
+        append(out, vifMpg(num, loadAddress));
+    }
+
+    std::vector<uint8_t> loopProgram()
+    {
+        std::vector<uint8_t> code;
+        appendInstruction(code, kUpperNop, lowerIaddiu(1, 0, 4));         // 0x00
+        appendInstruction(code, upperAdd(2, 2, 1), lowerIsubiu(1, 1, 1)); // 0x08: loop
+        appendInstruction(code, kUpperNop, lowerIbne(1, 0, -2));          // 0x10
+        appendInstruction(code, kUpperNop, kLowerNop);                    // 0x18: delay slot
+        appendInstruction(code, kUpperEnd, kLowerNop);                    // 0x20
+        appendInstruction(code, kUpperNop, kLowerNop);                    // 0x28
+        return code;
+    }
+}
+
+void register_vu_recompiler_tests()
+{
+    MiniTest::Case("VuRecompiler", [](TestCase &tc)
+                   {
+    tc.Run("finds the microcode a VIF MPG uploads", [](TestCase &t) {
+        std::vector<uint8_t> data(16, 0);
+        appendMpg(data, 4, 0x100);
+        appendInstruction(data, kUpperNop, kLowerNop);
+        appendInstruction(data, kUpperNop, kLowerNop);
+        appendInstruction(data, kUpperEnd, kLowerNop);
+        appendInstruction(data, kUpperNop, kLowerNop);
+        data.resize(data.size() + 16, 0);
+
+        auto programs = VuRecompiler::findMpgUploads(data.data(), static_cast<uint32_t>(data.size()), 0x200000);
+        t.Equals(programs.size(), static_cast<size_t>(1), "one upload should be found");
+        if (!programs.empty())
+        {
+            t.Equals(programs[0].address, 0x200020u, "the code should start after the MPG command");
+            t.Equals(programs[0].size, 32u, "the size should come from NUM");
+            t.Equals(programs[0].loadAddress, 0x100u, "the load address should come from the immediate");
+            t.Equals(programs[0].unit, -1, "a small program without XGKICK could be for either VU");
+        }
+    });
+
+    tc.Run("joins a program uploaded by several MPGs", [](TestCase &t) {
+        std::vector<uint8_t> data;
+        appendMpg(data, 2, 0x800);
+        appendInstruction(data, kUpperNop, kLowerNop);
+        appendInstruction(data, kUpperNop, kLowerXgkick);
+        appendMpg(data, 2, 0x810);
+        appendInstruction(data, kUpperEnd, kLowerNop);
+        appendInstruction(data, kUpperNop, kLowerNop);
+
+        auto programs = VuRecompiler::findMpgUploads(data.data(), static_cast<uint32_t>(data.size()), 0);
+        t.Equals(programs.size(), static_cast<size_t>(1), "the uploads should be joined");
+        if (!programs.empty())
+        {
+            t.Equals(programs[0].size, 32u, "the joined program should cover both uploads");
+            t.Equals(programs[0].loadAddress, 0x800u, "the joined program should start at the first load address");
+            t.Equals(programs[0].unit, 1, "XGKICK should mark the program as VU1 code");
+        }
+    });
+
+    tc.Run("ignores uploads that are not code", [](TestCase &t) {
+        std::vector<uint8_t> noEnd;
+        appendMpg(noEnd, 2, 0);
+        appendInstruction(noEnd, kUpperNop, kLowerNop);
+        appendInstruction(noEnd, kUpperNop, kLowerNop);
+        t.IsTrue(VuRecompiler::findMpgUploads(noEnd.data(), static_cast<uint32_t>(noEnd.size()), 0).empty(),
+                 "an upload without an E bit should be ignored");
+
+        std::vector<uint8_t> debugBits;
+        appendMpg(debugBits, 2, 0);
+        appendInstruction(debugBits, kUpperEnd | 0x10000000, kLowerNop);
+        appendInstruction(debugBits, kUpperNop, kLowerNop);
+        t.IsTrue(VuRecompiler::findMpgUploads(debugBits.data(), static_cast<uint32_t>(debugBits.size()), 0).empty(),
+                 "an upload with the D or T bit set should be ignored");
+
+        std::vector<uint8_t> tooLarge;
+        appendMpg(tooLarge, 2, 0x3FF8);
+        appendInstruction(tooLarge, kUpperEnd, kLowerNop);
+        appendInstruction(tooLarge, kUpperNop, kLowerNop);
+        t.IsTrue(VuRecompiler::findMpgUploads(tooLarge.data(), static_cast<uint32_t>(tooLarge.size()), 0).empty(),
+                 "an upload past the end of micro memory should be ignored");
+    });
+
+    tc.Run("emits a label per instruction and direct branches", [](TestCase &t) {
+        VuRecompiler recompiler;
+        recompiler.addProgram({0x300000, 48, 0, 1}, loopProgram());
+        t.Equals(recompiler.programCount(), static_cast<size_t>(1), "the program should be added");
+
+        std::string code = recompiler.generateFunction(0);
+        t.IsTrue(code.find("pc_0028:") != std::string::npos, "every instruction should get a label");
+        t.IsTrue(code.find("case 0x8:") != std::string::npos, "every instruction should be an entry point");
+        t.IsTrue(code.find("_mm_add_ps(ua, ub)") != std::string::npos, "ADD should be inlined as SSE");
+        t.IsTrue(code.find("ps2_vu::fmacResult") != std::string::npos, "FMAC results should set the flags");
+        t.IsTrue(code.find("goto pc_0008;") != std::string::npos, "a branch inside the program should be a goto");
+        t.IsTrue(code.find("vu.overBudget()") != std::string::npos, "backward branches should check the budget");
+        t.IsTrue(code.find("return true;") != std::string::npos, "the E bit should end the program");
+        t.IsTrue(code.find("goto dispatch;") == std::string::npos, "static branches should not need the dispatcher");
+    });
+
+    tc.Run("dispatches register jumps and hands rare ops to the interpreter", [](TestCase &t) {
+        std::vector<uint8_t> program;
+        appendInstruction(program, kUpperNop, 0x800003BC | (3u << 16) | (1u << 11)); // DIV Q, VF1x, VF3x
+        appendInstruction(program, kUpperNop, lowerJr(2));
+        appendInstruction(program, kUpperEnd, kLowerNop);
+        appendInstruction(program, kUpperNop, kLowerNop);
+
+        VuRecompiler recompiler;
+        recompiler.addProgram({0x300000, 32, 0x40, 0}, program);
+        std::string code = recompiler.generateFunction(0);
+        t.IsTrue(code.find("goto dispatch;") != std::string::npos, "JR should go through the dispatcher");
+        t.IsTrue(code.find("dispatch:") != std::string::npos, "the dispatcher should be emitted");
+        t.IsTrue(code.find("vu.executeLower(0x80030BBCu, 0x40);") != std::string::npos, "DIV should call the interpreter");
+    });
+
+    tc.Run("registers programs by hash", [](TestCase &t) {
+        std::vector<uint8_t> code = loopProgram();
+        VuMicroprogram info{0x300000, 48, 0, -1};
+        const uint64_t hash = VuRecompiler::hashCode(code);
+        const std::string name = VuRecompiler::functionName(info, hash);
+
+        VuRecompiler recompiler;
+        recompiler.addProgram(info, code);
+        recompiler.addProgram(info, code);
+        t.Equals(recompiler.programCount(), static_cast<size_t>(1), "the same upload should only be recompiled once");
+
+        char hashText[32];
+        std::snprintf(hashText, sizeof(hashText), "0x%016llXull", static_cast<unsigned long long>(hash));
+        std::string output = recompiler.generateOutput();
+        t.IsTrue(output.find("static bool " + name + "(PS2VectorUnit &vu)") != std::string::npos, "the function should be emitted");
+        t.IsTrue(output.find("void registerVuMicroprograms(PS2Runtime &runtime)") != std::string::npos, "a registration function should be emitted");
+        t.IsTrue(output.find(std::string("{1, 0x0, 0x30, ") + hashText + ", " + name + "}") != std::string::npos,
+                 "the program should be registered for VU1 with its hash");
+        t.IsTrue(output.find(std::string("{0, 0x0, 0x30, ") + hashText + ", " + name + "}") != std::string::npos,
+                 "a program that fits VU0 should be registered for it too");
+    });
+                   });
+}
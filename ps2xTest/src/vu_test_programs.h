@@ -0,0 +1,22 @@
+#ifndef VU_TEST_PROGRAMS_H
+#define VU_TEST_PROGRAMS_H
+
+#include "ps2_vu.h"
+#include <cstddef>
+#include <cstdint>
+
+// A microprogram recompiled at build time by tools/vu_test_program_generator.cpp
+struct VuTestProgram
+{
+    const char *name;
+    const uint32_t *words; // lower, upper pairs as they sit in micro memory
+    uint32_t wordCount;
+    uint32_t loadAddress;
+    uint32_t entry;
+    PS2VuMicroprogram program; // covers all of words, or only the start of it
+};
+
+extern const VuTestProgram kVuTestPrograms[];
+extern const size_t kVuTestProgramCount;
+
+#endif // VU_TEST_PROGRAMS_H
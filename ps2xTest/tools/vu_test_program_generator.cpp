@@ -0,0 +1,434 @@
+// Writes the VU microprograms the differential tests run, recompiled by VuRecompiler,
+// together with their code so the tests can run the same bytes on the interpreter.
+//
+// Random programs come from a fixed seed, so every build tests the same code. They mix
+// FMAC ops, loads and stores, integer ops, flag ops, FDIV/EFU and forward branches, and
+// end with a BAL/JR call and a counted backward loop. Every fourth program is loaded at
+// an offset, entered mid-program, or registered only in part. The named programs each
+// exercise one way of handing a run back to the interpreter.
+
+#include "ps2recomp/vu_recompiler.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ps2recomp;
+
+namespace
+{
+    constexpr uint32_t kRandomSeed = 12345;
+    constexpr int kRandomPrograms = 120;
+
+    constexpr uint32_t kUpperI = 0x80000000u;
+    constexpr uint32_t kUpperE = 0x40000000u;
+    constexpr uint32_t kUpperDebug = 0x18000000u; // D and T
+    constexpr uint32_t kUpperNop = 0x000002FF;
+    constexpr uint32_t kUpperEnd = kUpperNop | kUpperE;
+    constexpr uint32_t kLowerNop = 0x8000033C; // MOVE.none VF0, VF0
+
+    enum LowerOp : uint32_t
+    {
+        OP_LQ = 0x00,
+        OP_SQ = 0x01,
+        OP_ILW = 0x04,
+        OP_ISW = 0x05,
+        OP_IADDIU = 0x08,
+        OP_ISUBIU = 0x09,
+        OP_B = 0x20,
+        OP_BAL = 0x21,
+        OP_JR = 0x24,
+        OP_IBNE = 0x29,
+    };
+
+    struct MicroInstruction
+    {
+        uint32_t lower;
+        uint32_t upper;
+    };
+
+    struct TestProgram
+    {
+        std::string name;
+        std::vector<MicroInstruction> code;
+        uint32_t loadAddress = 0;
+        uint32_t entry = 0;
+        size_t registered = 0; // instructions handed to the recompiler
+    };
+
+    uint32_t upperOp(uint32_t op, uint32_t dest, int ft, int fs, int fd)
+    {
+        return (dest << 21) | (ft << 16) | (fs << 11) | (fd << 6) | op;
+    }
+
+    uint32_t upperSpecial(uint32_t special, uint32_t dest, int ft, int fs)
+    {
+        return (dest << 21) | (ft << 16) | (fs << 11) | ((special >> 2) << 6) | 0x3C | (special & 3);
+    }
+
+    uint32_t lowerOp(uint32_t op, uint32_t dest, int it, int is, int32_t imm11)
+    {
+        return (op << 25) | (dest << 21) | (it << 16) | (is << 11) | (static_cast<uint32_t>(imm11) & 0x7FF);
+    }
+
+    uint32_t lowerSpecial(uint32_t special, uint32_t dest, int ft, int fs)
+    {
+        return 0x80000000u | (dest << 21) | (ft << 16) | (fs << 11) | ((special >> 2) << 6) | 0x3C | (special & 3);
+    }
+
+    // Branch offsets count instructions from the delay slot
+    uint32_t lowerBranch(uint32_t op, int it, int is, size_t from, size_t to)
+    {
+        return lowerOp(op, 0, it, is, static_cast<int32_t>(to) - static_cast<int32_t>(from) - 1);
+    }
+
+    uint32_t floatBits(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        return bits;
+    }
+
+    class RandomProgramBuilder
+    {
+    public:
+        explicit RandomProgramBuilder(uint32_t seed) : m_rng(seed) {}
+
+        TestProgram build(int index)
+        {
+            std::vector<MicroInstruction> p;
+
+            // VI15 counts the loop at the end; VI14 holds the BAL return address
+            p.push_back({lowerOp(OP_IADDIU, 0, 15, 0, 1 + pick(3)), randomUpper()});
+            const size_t bodyStart = p.size();
+            const size_t bodyLength = 6 + pick(24);
+            for (size_t i = 0; i < bodyLength; i++)
+            {
+                p.push_back(randomInstruction());
+            }
+            const size_t bodyEnd = p.size();
+            addForwardBranches(p, bodyStart, bodyEnd);
+            if (pick(20) == 0)
+            {
+                p[bodyStart + pick(static_cast<uint32_t>(bodyLength) - 2)].upper |= kUpperE;
+            }
+
+            const size_t call = p.size();
+            p.push_back({0, randomUpper()});
+            p.push_back({randomLower(), randomUpper()});
+            p.push_back({lowerOp(OP_ISUBIU, 0, 15, 15, 1), randomUpper()});
+            const size_t loop = p.size();
+            p.push_back({lowerBranch(OP_IBNE, 0, 15, loop, bodyStart), randomUpper()});
+            p.push_back({randomLower(), randomUpper()});
+            for (uint32_t i = pick(4); i > 0; i--)
+            {
+                p.push_back(randomInstruction());
+            }
+            p.push_back({randomLower(), randomUpper() | kUpperE});
+            p.push_back({randomLower(), randomUpper()});
+
+            const size_t subroutine = p.size();
+            p[call].lower = lowerBranch(OP_BAL, 14, 0, call, subroutine);
+            for (uint32_t i = pick(5); i > 0; i--)
+            {
+                p.push_back(randomInstruction());
+            }
+            p.push_back({lowerOp(OP_JR, 0, 0, 14, 0), randomUpper()});
+            p.push_back({randomLower(), randomUpper()});
+
+            for (MicroInstruction &instruction : p)
+            {
+                instruction.upper &= ~kUpperDebug;
+            }
+
+            TestProgram program;
+            program.name = "random " + std::to_string(index);
+            program.code = std::move(p);
+            program.registered = program.code.size();
+            switch (index % 4)
+            {
+            case 1:
+                program.loadAddress = 0x200 + 8 * pick(64);
+                break;
+            case 2:
+                program.registered = program.code.size() / 2;
+                break;
+            case 3:
+                program.entry = static_cast<uint32_t>(8 * bodyStart);
+                break;
+            default:
+                break;
+            }
+            program.entry += program.loadAddress;
+            return program;
+        }
+
+    private:
+        std::mt19937 m_rng;
+
+        uint32_t pick(uint32_t count) { return m_rng() % count; }
+        uint32_t randomDest() { return pick(3) ? 0xF : pick(16); }
+        // VI14 and VI15 are left to the call and the loop
+        int randomVi() { return static_cast<int>(pick(14)); }
+
+        // Operand fields are drawn one per statement, so the programs do not depend on the
+        // order a compiler evaluates function arguments in
+        struct Operands
+        {
+            uint32_t dest;
+            int t;
+            int s;
+            int d;
+            uint32_t imm11;
+        };
+
+        Operands randomOperands(uint32_t registers)
+        {
+            Operands operands;
+            operands.dest = randomDest();
+            operands.t = static_cast<int>(pick(registers));
+            operands.s = static_cast<int>(pick(registers));
+            operands.d = static_cast<int>(pick(registers));
+            operands.imm11 = pick(0x800);
+            return operands;
+        }
+
+        uint32_t randomUpper()
+        {
+            const uint32_t op = pick(0x40);
+            if (op >= 0x3C)
+            {
+                const uint32_t special = pick(0x30);
+                const Operands o = randomOperands(32);
+                return upperSpecial(special, o.dest, o.t, o.s);
+            }
+            const Operands o = randomOperands(32);
+            return upperOp(op, o.dest, o.t, o.s, o.d);
+        }
+
+        uint32_t randomLower()
+        {
+            // LQ/SQ, ILW/ISW, IADDIU/ISUBIU
+            static constexpr uint32_t kPairs[] = {OP_LQ, OP_ILW, OP_IADDIU};
+            // FCEQ..FCGET, FSAND..FSOR, FMEQ..FMOR
+            static constexpr uint32_t kFlagOps[] = {0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x1A, 0x1B, 0x1C};
+            // IADD, ISUB, IADDI, IAND, IOR
+            static constexpr uint32_t kIntegerOps[] = {0x30, 0x31, 0x32, 0x34, 0x35};
+            // Moves, LQI/SQI/LQD/SQD, FDIV, MTIR/MFIR, ILWR/ISWR, RINIT..RXOR, WAITQ/WAITP and EFU ops
+            static constexpr uint32_t kSpecials[] = {0x30, 0x30, 0x31, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C,
+                                                     0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x42, 0x43, 0x64, 0x68, 0x69, 0x70, 0x71,
+                                                     0x72, 0x73, 0x74, 0x75, 0x76, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E};
+
+            const uint32_t kind = pick(12);
+            if (kind == 0)
+            {
+                return kLowerNop;
+            }
+            if (kind <= 3)
+            {
+                const uint32_t op = kPairs[kind - 1] + pick(2);
+                const Operands o = randomOperands(14);
+                if (op >= OP_IADDIU)
+                {
+                    // Never VI0, so the result is kept
+                    return lowerOp(op, o.dest, 1 + o.t % 13, o.s, static_cast<int32_t>(o.imm11));
+                }
+                return lowerOp(op, o.dest, o.t, o.s, static_cast<int32_t>(o.imm11 % 64) - 32);
+            }
+            if (kind == 4)
+            {
+                const uint32_t op = kFlagOps[pick(12)];
+                const Operands o = randomOperands(14);
+                return lowerOp(op, o.dest, o.t, o.s, static_cast<int32_t>(o.imm11));
+            }
+            if (kind == 5)
+            {
+                const uint32_t op = kIntegerOps[pick(5)];
+                const Operands o = randomOperands(14);
+                return 0x80000000u | (o.t << 16) | (o.s << 11) | (o.d << 6) | op;
+            }
+            const uint32_t special = kSpecials[pick(sizeof(kSpecials) / sizeof(kSpecials[0]))];
+            const Operands o = randomOperands(14);
+            return lowerSpecial(special, o.dest, o.t, o.s);
+        }
+
+        MicroInstruction randomInstruction()
+        {
+            if (pick(10) == 0)
+            {
+                return {floatBits(static_cast<float>(pick(2000)) / 100.0f - 10.0f), randomUpper() | kUpperI};
+            }
+            return {randomLower(), randomUpper()};
+        }
+
+        // Conditional branches forward to anywhere up to the end of the body. Now and then
+        // the delay slot holds another branch or an E bit, which the interpreter finishes.
+        void addForwardBranches(std::vector<MicroInstruction> &p, size_t begin, size_t end)
+        {
+            static constexpr uint32_t kBranchOps[] = {0x20, 0x28, 0x29, 0x2C, 0x2D, 0x2E, 0x2F};
+            for (size_t i = begin; i + 2 < end; i++)
+            {
+                if (pick(7) != 0 || (p[i].upper & kUpperI))
+                {
+                    continue;
+                }
+                const uint32_t op = kBranchOps[pick(7)];
+                const int it = randomVi();
+                const int is = randomVi();
+                p[i].lower = lowerBranch(op, it, is, i, i + 2 + pick(static_cast<uint32_t>(end - i - 1)));
+                if (pick(12) == 0 && i + 3 < end && !(p[i + 1].upper & kUpperI))
+                {
+                    p[i + 1].lower = lowerBranch(OP_B, 0, 0, i + 1, i + 3 + pick(static_cast<uint32_t>(end - i - 2)));
+                }
+                if (pick(15) == 0)
+                {
+                    p[i + 1].upper |= kUpperE;
+                }
+                i += 2;
+            }
+        }
+    };
+
+    // IADDIU reg, VI0, value
+    uint32_t loadVi(int reg, uint32_t value)
+    {
+        return lowerOp(OP_IADDIU, 0, reg, 0, static_cast<int32_t>(value));
+    }
+
+    TestProgram namedProgram(const char *name, std::vector<MicroInstruction> code, size_t registered)
+    {
+        TestProgram program;
+        program.name = name;
+        program.code = std::move(code);
+        program.registered = registered;
+        return program;
+    }
+
+    // Each sets VI registers along the path it should take, so the tests can check where it went
+    std::vector<TestProgram> handoffPrograms()
+    {
+        std::vector<TestProgram> programs;
+
+        programs.push_back(namedProgram("branch in a delay slot",
+                                        {
+                                            {loadVi(1, 1), kUpperNop},
+                                            {lowerBranch(OP_B, 0, 0, 1, 4), kUpperNop},
+                                            {lowerBranch(OP_B, 0, 0, 2, 6), kUpperNop},
+                                            {loadVi(2, 1), kUpperNop},
+                                            {loadVi(3, 1), kUpperNop}, // delay slot of the second branch
+                                            {loadVi(4, 1), kUpperNop},
+                                            {loadVi(5, 1), kUpperEnd},
+                                            {kLowerNop, kUpperNop},
+                                        },
+                                        8));
+
+        programs.push_back(namedProgram("E bit in a delay slot",
+                                        {
+                                            {loadVi(1, 1), kUpperNop},
+                                            {lowerBranch(OP_B, 0, 0, 1, 4), kUpperNop},
+                                            {kLowerNop, kUpperEnd},
+                                            {loadVi(2, 1), kUpperNop},
+                                            {loadVi(3, 1), kUpperNop}, // runs as the E bit's delay slot
+                                            {loadVi(4, 1), kUpperNop},
+                                            {kLowerNop, kUpperEnd},
+                                            {kLowerNop, kUpperNop},
+                                        },
+                                        8));
+
+        programs.push_back(namedProgram("jump out of the program",
+                                        {
+                                            {loadVi(1, 6), kUpperNop},
+                                            {lowerOp(OP_JR, 0, 0, 1, 0), kUpperNop},
+                                            {loadVi(2, 1), kUpperNop},
+                                            {kLowerNop, kUpperNop},
+                                            {loadVi(4, 1), kUpperNop},
+                                            {kLowerNop, kUpperNop},
+                                            {loadVi(3, 1), kUpperEnd}, // 0x30, past what was registered
+                                            {kLowerNop, kUpperNop},
+                                        },
+                                        4));
+
+        programs.push_back(namedProgram("branch off the end of the program",
+                                        {
+                                            {loadVi(1, 1), kUpperNop},
+                                            {lowerBranch(OP_B, 0, 0, 1, 4), kUpperNop},
+                                            {loadVi(2, 1), kUpperNop}, // delay slot, past what was registered
+                                            {loadVi(3, 1), kUpperNop},
+                                            {loadVi(4, 1), kUpperEnd},
+                                            {kLowerNop, kUpperNop},
+                                        },
+                                        2));
+
+        return programs;
+    }
+
+    std::string quoted(const std::string &text)
+    {
+        return "\"" + text + "\"";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output.cpp>" << std::endl;
+        return 1;
+    }
+
+    std::vector<TestProgram> programs = handoffPrograms();
+    RandomProgramBuilder builder(kRandomSeed);
+    for (int i = 0; i < kRandomPrograms; i++)
+    {
+        programs.push_back(builder.build(i));
+    }
+
+    VuRecompiler recompiler;
+    std::string words;
+    std::string table = "const VuTestProgram kVuTestPrograms[] = {\n";
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        const TestProgram &program = programs[i];
+
+        std::vector<uint8_t> bytes(program.registered * sizeof(MicroInstruction));
+        std::memcpy(bytes.data(), program.code.data(), bytes.size());
+        const VuMicroprogram info{0x100000u + static_cast<uint32_t>(i) * 0x1000u, static_cast<uint32_t>(bytes.size()), program.loadAddress, 1};
+        const uint64_t hash = VuRecompiler::hashCode(bytes);
+        recompiler.addProgram(info, bytes);
+
+        words += "static const uint32_t kWords" + std::to_string(i) + "[] = {";
+        for (size_t n = 0; n < program.code.size(); n++)
+        {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%s0x%08X, 0x%08X", n == 0 ? "\n    " : n % 4 ? ", " : ",\n    ", program.code[n].lower, program.code[n].upper);
+            words += text;
+        }
+        words += "};\n";
+
+        char entry[256];
+        std::snprintf(entry, sizeof(entry), "    {%s, kWords%zu, %zu, 0x%X, 0x%X, {1, 0x%X, 0x%X, 0x%016llXull, %s}},\n",
+                      quoted(program.name).c_str(), i, program.code.size() * 2, program.loadAddress, program.entry,
+                      program.loadAddress, static_cast<unsigned>(bytes.size()), static_cast<unsigned long long>(hash),
+                      VuRecompiler::functionName(info, hash).c_str());
+        table += entry;
+    }
+    table += "};\n";
+
+    std::ofstream out(argv[1], std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Failed to open " << argv[1] << " for writing" << std::endl;
+        return 1;
+    }
+    out << "// Generated by vu_test_program_generator, do not edit\n";
+    out << "#include \"vu_test_programs.h\"\n";
+    out << recompiler.generateOutput() << "\n";
+    out << words << "\n";
+    out << table;
+    out << "const size_t kVuTestProgramCount = sizeof(kVuTestPrograms) / sizeof(kVuTestPrograms[0]);\n";
+    return out ? 0 : 1;
+}